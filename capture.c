@@ -0,0 +1,518 @@
+/**
+ * @file capture.c
+ * @note Copyright (C) 2026 The linuxptp contributors
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+#include <arpa/inet.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "capture.h"
+#include "config.h"
+#include "print.h"
+
+/*
+ * The frames are copied by the event loop into a ring of preallocated
+ * slots and a background thread turns them into pcapng blocks. The
+ * transports hand over the PTP message without the lower layer headers,
+ * so the writer puts back the headers of the transport: an Ethernet
+ * header with the PTP EtherType for IEEE 802.3, an IPv4 or IPv6 header
+ * and a UDP header with the PTP event or general port for UDP. The
+ * addresses of the IP headers are not known here and are left
+ * unspecified. Each interface and transport pair has its own interface
+ * description block with the matching link type.
+ *
+ * The block time stamp is the hardware time stamp of the message if it
+ * has one, else the software time stamp, else the system time of the
+ * capture. All of them are also stored in custom options of the
+ * enhanced packet block, each holding the enterprise number, one of the
+ * ts_kind values as 32 bits and the time stamp in ns as 64 bits, in the
+ * byte order of the section.
+ */
+
+#define CAPTURE_MAX_IFACES 64
+#define CAPTURE_SNAPLEN 1536
+#define ETH_HLEN 14
+#define IP4_HLEN 20
+#define IP6_HLEN 40
+#define UDP_HLEN 8
+#define MAX_HLEN (IP6_HLEN + UDP_HLEN)
+#define WRITER_IDLE_NS 10000000
+
+/* No enterprise number is assigned to linuxptp, use the documentation one. */
+#define CAPTURE_PEN 32473
+
+#define BT_SHB 0x0A0D0D0A
+#define BT_IDB 0x00000001
+#define BT_ISB 0x00000005
+#define BT_EPB 0x00000006
+
+#define OPT_ENDOFOPT 0
+#define OPT_CUSTOM_BIN 2989
+#define SHB_USERAPPL 4
+#define IF_NAME 2
+#define IF_TSRESOL 9
+#define EPB_FLAGS 2
+#define ISB_IFRECV 4
+#define ISB_IFDROP 5
+
+#define LINKTYPE_ETHERNET 1
+#define LINKTYPE_IPV4 228
+#define LINKTYPE_IPV6 229
+
+#define PTP_EVENT_PORT 319
+#define PTP_GENERAL_PORT 320
+
+enum ts_kind {
+	TS_KIND_CAPTURE,
+	TS_KIND_SOFTWARE,
+	TS_KIND_HARDWARE,
+};
+
+enum slot_kind {
+	SLOT_IDB,
+	SLOT_EPB,
+};
+
+struct slot {
+	enum slot_kind kind;
+	int iface;
+	enum capture_dir dir;
+	int event;
+	enum timestamp_type ts_type;
+	struct timespec now;
+	int64_t ts;
+	int64_t sw;
+	unsigned int len;
+	unsigned char data[CAPTURE_SNAPLEN];
+};
+
+struct capture_iface {
+	char name[MAX_IFNAME_SIZE + 1];
+	enum transport_type type;
+	int fd[2];
+	uint64_t recv;
+	uint64_t drop;
+};
+
+int capture_active;
+
+static FILE *capture_fp;
+static struct slot *ring;
+static unsigned int ring_len;
+static uint64_t ring_head;	/* next slot to be written by the thread */
+static uint64_t ring_tail;	/* next slot to be filled by the event loop */
+static struct capture_iface ifaces[CAPTURE_MAX_IFACES];
+static int num_ifaces;
+static int writer_stop;
+static pthread_t writer;
+
+static const unsigned char eth_hdr[ETH_HLEN] = {
+	0x01, 0x1b, 0x19, 0x00, 0x00, 0x00, /* PTP primary multicast */
+	0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+	0x88, 0xf7,
+};
+
+static void put_bytes(unsigned char *blk, unsigned int *len,
+		      const void *data, unsigned int size)
+{
+	memcpy(blk + *len, data, size);
+	*len += size;
+	while (*len % 4)
+		blk[(*len)++] = 0;
+}
+
+static int link_type(enum transport_type type)
+{
+	switch (type) {
+	case TRANS_UDP_IPV4:
+		return LINKTYPE_IPV4;
+	case TRANS_UDP_IPV6:
+		return LINKTYPE_IPV6;
+	default:
+		return LINKTYPE_ETHERNET;
+	}
+}
+
+static unsigned int header_len(enum transport_type type)
+{
+	switch (type) {
+	case TRANS_UDP_IPV4:
+		return IP4_HLEN + UDP_HLEN;
+	case TRANS_UDP_IPV6:
+		return IP6_HLEN + UDP_HLEN;
+	default:
+		return ETH_HLEN;
+	}
+}
+
+static uint16_t ip4_checksum(const unsigned char *hdr)
+{
+	uint32_t sum = 0;
+	int i;
+
+	for (i = 0; i < IP4_HLEN; i += 2)
+		sum += hdr[i] << 8 | hdr[i + 1];
+	while (sum >> 16)
+		sum = (sum & 0xffff) + (sum >> 16);
+	return ~sum;
+}
+
+/* Write the headers of the transport in front of a message of size bytes. */
+static void put_header(unsigned char *blk, unsigned int *len,
+		       enum transport_type type, int event, unsigned int size)
+{
+	uint16_t port = htons(event ? PTP_EVENT_PORT : PTP_GENERAL_PORT);
+	unsigned char *hdr = blk + *len, *udp;
+	uint16_t val;
+
+	switch (type) {
+	case TRANS_UDP_IPV4:
+		memset(hdr, 0, IP4_HLEN);
+		hdr[0] = 0x45;
+		val = htons(IP4_HLEN + UDP_HLEN + size);
+		memcpy(hdr + 2, &val, sizeof(val));
+		hdr[8] = 1; /* TTL */
+		hdr[9] = IPPROTO_UDP;
+		val = htons(ip4_checksum(hdr));
+		memcpy(hdr + 10, &val, sizeof(val));
+		udp = hdr + IP4_HLEN;
+		break;
+	case TRANS_UDP_IPV6:
+		memset(hdr, 0, IP6_HLEN);
+		hdr[0] = 0x60;
+		val = htons(UDP_HLEN + size);
+		memcpy(hdr + 4, &val, sizeof(val));
+		hdr[6] = IPPROTO_UDP;
+		hdr[7] = 1; /* hop limit */
+		udp = hdr + IP6_HLEN;
+		break;
+	default:
+		memcpy(hdr, eth_hdr, ETH_HLEN);
+		*len += ETH_HLEN;
+		return;
+	}
+	/* The checksum is left zero, i.e. not computed. */
+	memset(udp, 0, UDP_HLEN);
+	memcpy(udp, &port, sizeof(port));
+	memcpy(udp + 2, &port, sizeof(port));
+	val = htons(UDP_HLEN + size);
+	memcpy(udp + 4, &val, sizeof(val));
+	*len += header_len(type);
+}
+
+static void put_u16(unsigned char *blk, unsigned int *len, uint16_t val)
+{
+	memcpy(blk + *len, &val, sizeof(val));
+	*len += sizeof(val);
+}
+
+static void put_u32(unsigned char *blk, unsigned int *len, uint32_t val)
+{
+	memcpy(blk + *len, &val, sizeof(val));
+	*len += sizeof(val);
+}
+
+static void put_option(unsigned char *blk, unsigned int *len, uint16_t code,
+		       const void *data, uint16_t size)
+{
+	memcpy(blk + *len, &code, sizeof(code));
+	memcpy(blk + *len + 2, &size, sizeof(size));
+	*len += 4;
+	if (size)
+		put_bytes(blk, len, data, size);
+}
+
+/* Fill in the lengths of a block whose body ends at len and write it. */
+static void write_block(unsigned char *blk, unsigned int len, uint32_t type)
+{
+	uint32_t total = len + 4;
+
+	memcpy(blk, &type, sizeof(type));
+	memcpy(blk + 4, &total, sizeof(total));
+	memcpy(blk + len, &total, sizeof(total));
+	fwrite(blk, total, 1, capture_fp);
+}
+
+static void write_shb(void)
+{
+	const char *appl = "ptp4l";
+	unsigned char blk[64];
+	unsigned int len = 8;
+	int64_t section = -1;
+
+	put_u32(blk, &len, 0x1A2B3C4D);
+	put_u16(blk, &len, 1); /* major version */
+	put_u16(blk, &len, 0); /* minor version */
+	memcpy(blk + len, &section, sizeof(section));
+	len += sizeof(section);
+	put_option(blk, &len, SHB_USERAPPL, appl, strlen(appl));
+	put_option(blk, &len, OPT_ENDOFOPT, NULL, 0);
+	write_block(blk, len, BT_SHB);
+}
+
+static void write_idb(struct capture_iface *iface)
+{
+	unsigned char blk[MAX_IFNAME_SIZE + 64];
+	uint8_t tsresol = 9; /* nanoseconds */
+	unsigned int len = 8;
+
+	put_u16(blk, &len, link_type(iface->type));
+	put_u16(blk, &len, 0);
+	put_u32(blk, &len, header_len(iface->type) + CAPTURE_SNAPLEN);
+	put_option(blk, &len, IF_NAME, iface->name, strlen(iface->name));
+	put_option(blk, &len, IF_TSRESOL, &tsresol, sizeof(tsresol));
+	put_option(blk, &len, OPT_ENDOFOPT, NULL, 0);
+	write_block(blk, len, BT_IDB);
+}
+
+static void write_isb(int index, struct timespec *now)
+{
+	uint64_t ns = now->tv_sec * 1000000000ULL + now->tv_nsec;
+	unsigned char blk[64];
+	unsigned int len = 8;
+
+	put_u32(blk, &len, index);
+	put_u32(blk, &len, ns >> 32);
+	put_u32(blk, &len, ns);
+	put_option(blk, &len, ISB_IFRECV, &ifaces[index].recv,
+		   sizeof(ifaces[index].recv));
+	put_option(blk, &len, ISB_IFDROP, &ifaces[index].drop,
+		   sizeof(ifaces[index].drop));
+	put_option(blk, &len, OPT_ENDOFOPT, NULL, 0);
+	write_block(blk, len, BT_ISB);
+}
+
+static void put_ts_option(unsigned char *blk, unsigned int *len,
+			  enum ts_kind kind, int64_t ns)
+{
+	unsigned char data[16];
+	uint32_t val;
+
+	val = CAPTURE_PEN;
+	memcpy(data, &val, sizeof(val));
+	val = kind;
+	memcpy(data + 4, &val, sizeof(val));
+	memcpy(data + 8, &ns, sizeof(ns));
+	put_option(blk, len, OPT_CUSTOM_BIN, data, sizeof(data));
+}
+
+static void write_epb(struct slot *s)
+{
+	static unsigned char blk[MAX_HLEN + CAPTURE_SNAPLEN + 128];
+	enum transport_type type = ifaces[s->iface].type;
+	int64_t now = s->now.tv_sec * 1000000000LL + s->now.tv_nsec;
+	uint32_t flags = s->dir == CAPTURE_RX ? 1 : 2;
+	unsigned int len = 8, caplen;
+	int64_t hw, sw;
+	uint64_t ns;
+
+	hw = s->ts_type != TS_SOFTWARE ? s->ts : 0;
+	sw = s->ts_type == TS_SOFTWARE ? s->ts : s->sw;
+	ns = hw ? hw : sw ? sw : now;
+	caplen = header_len(type) + s->len;
+
+	put_u32(blk, &len, s->iface);
+	put_u32(blk, &len, ns >> 32);
+	put_u32(blk, &len, ns);
+	put_u32(blk, &len, caplen);
+	put_u32(blk, &len, caplen);
+	put_header(blk, &len, type, s->event, s->len);
+	put_bytes(blk, &len, s->data, s->len);
+
+	put_option(blk, &len, EPB_FLAGS, &flags, sizeof(flags));
+	if (hw)
+		put_ts_option(blk, &len, TS_KIND_HARDWARE, hw);
+	if (sw)
+		put_ts_option(blk, &len, TS_KIND_SOFTWARE, sw);
+	put_ts_option(blk, &len, TS_KIND_CAPTURE, now);
+	put_option(blk, &len, OPT_ENDOFOPT, NULL, 0);
+	write_block(blk, len, BT_EPB);
+}
+
+static void *writer_thread(void *arg)
+{
+	struct timespec idle = { 0, WRITER_IDLE_NS };
+	struct slot *s;
+
+	while (1) {
+		if (ring_head == __atomic_load_n(&ring_tail, __ATOMIC_ACQUIRE)) {
+			fflush(capture_fp);
+			if (__atomic_load_n(&writer_stop, __ATOMIC_ACQUIRE))
+				break;
+			nanosleep(&idle, NULL);
+			continue;
+		}
+		s = &ring[ring_head % ring_len];
+		switch (s->kind) {
+		case SLOT_IDB:
+			write_idb(&ifaces[s->iface]);
+			break;
+		case SLOT_EPB:
+			write_epb(s);
+			break;
+		}
+		__atomic_store_n(&ring_head, ring_head + 1, __ATOMIC_RELEASE);
+	}
+	return NULL;
+}
+
+/* Only the event loop calls this, there is a single producer. */
+static struct slot *slot_get(void)
+{
+	uint64_t head = __atomic_load_n(&ring_head, __ATOMIC_ACQUIRE);
+
+	if (ring_tail - head >= ring_len)
+		return NULL;
+	return &ring[ring_tail % ring_len];
+}
+
+static void slot_put(void)
+{
+	__atomic_store_n(&ring_tail, ring_tail + 1, __ATOMIC_RELEASE);
+}
+
+int capture_open(const char *path, unsigned int size)
+{
+	capture_fp = fopen(path, "w");
+	if (!capture_fp) {
+		pr_err("failed to open %s: %m", path);
+		return -1;
+	}
+	ring_len = size / sizeof(*ring);
+	if (!ring_len)
+		ring_len = 1;
+	ring = calloc(ring_len, sizeof(*ring));
+	if (!ring) {
+		pr_err("failed to allocate the capture buffer");
+		goto no_ring;
+	}
+	ring_head = 0;
+	ring_tail = 0;
+	num_ifaces = 0;
+	writer_stop = 0;
+
+	write_shb();
+
+	if (pthread_create(&writer, NULL, writer_thread, NULL)) {
+		pr_err("failed to start the capture thread");
+		goto no_thread;
+	}
+	capture_active = 1;
+	return 0;
+
+no_thread:
+	free(ring);
+	ring = NULL;
+no_ring:
+	fclose(capture_fp);
+	capture_fp = NULL;
+	return -1;
+}
+
+void capture_close(void)
+{
+	struct timespec now;
+	int i;
+
+	if (!capture_active)
+		return;
+	capture_active = 0;
+	__atomic_store_n(&writer_stop, 1, __ATOMIC_RELEASE);
+	pthread_join(writer, NULL);
+
+	clock_gettime(CLOCK_REALTIME, &now);
+	for (i = 0; i < num_ifaces; i++)
+		write_isb(i, &now);
+	fclose(capture_fp);
+	capture_fp = NULL;
+	free(ring);
+	ring = NULL;
+}
+
+void capture_add_interface(const char *name, enum transport_type type,
+			   struct fdarray *fda)
+{
+	struct capture_iface *iface;
+	struct slot *s;
+	int i;
+
+	if (!capture_active)
+		return;
+
+	for (i = 0; i < num_ifaces; i++) {
+		if (!strcmp(ifaces[i].name, name) && ifaces[i].type == type)
+			break;
+	}
+	if (i == CAPTURE_MAX_IFACES) {
+		pr_warning("too many interfaces, not capturing %s", name);
+		return;
+	}
+	iface = &ifaces[i];
+	iface->fd[0] = fda->fd[FD_EVENT];
+	iface->fd[1] = fda->fd[FD_GENERAL];
+	if (i < num_ifaces)
+		return;
+
+	s = slot_get();
+	if (!s) {
+		pr_warning("capture buffer full, not capturing %s", name);
+		return;
+	}
+	snprintf(iface->name, sizeof(iface->name), "%s", name);
+	iface->type = type;
+	num_ifaces++;
+	s->kind = SLOT_IDB;
+	s->iface = i;
+	slot_put();
+}
+
+void capture_frame(int fd, enum capture_dir dir, const void *buf, int len,
+		   struct hw_timestamp *hwts)
+{
+	struct slot *s;
+	int i;
+
+	if (fd < 0 || len <= 0)
+		return;
+	for (i = 0; i < num_ifaces; i++) {
+		if (ifaces[i].fd[0] == fd || ifaces[i].fd[1] == fd)
+			break;
+	}
+	if (i == num_ifaces)
+		return;
+
+	ifaces[i].recv++;
+	s = slot_get();
+	if (!s) {
+		ifaces[i].drop++;
+		return;
+	}
+	s->kind = SLOT_EPB;
+	s->iface = i;
+	s->dir = dir;
+	s->event = ifaces[i].fd[0] == fd;
+	clock_gettime(CLOCK_REALTIME, &s->now);
+	s->ts_type = hwts ? hwts->type : TS_SOFTWARE;
+	s->ts = hwts ? tmv_to_nanoseconds(hwts->ts) : 0;
+	s->sw = hwts ? tmv_to_nanoseconds(hwts->sw) : 0;
+	s->len = len < CAPTURE_SNAPLEN ? len : CAPTURE_SNAPLEN;
+	memcpy(s->data, buf, s->len);
+	slot_put();
+}
@@ -0,0 +1,69 @@
+/**
+ * @file capture.h
+ * @brief Writes the PTP frames and their time stamps to a pcapng file.
+ * @note Copyright (C) 2026 The linuxptp contributors
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+#ifndef HAVE_CAPTURE_H
+#define HAVE_CAPTURE_H
+
+#include "fd.h"
+#include "msg.h"
+#include "transport.h"
+
+enum capture_dir {
+	CAPTURE_RX,
+	CAPTURE_TX,
+};
+
+extern int capture_active;
+
+/**
+ * Create the capture file and start the writer thread.
+ * @param path  The name of the pcapng file.
+ * @param size  The size of the frame buffer in bytes.
+ * @return      Zero on success, non-zero otherwise.
+ */
+int capture_open(const char *path, unsigned int size);
+
+/**
+ * Write the queued frames, stop the writer thread and close the file.
+ */
+void capture_close(void);
+
+/**
+ * Associate the event and general descriptors of a port with an
+ * interface of the capture file. Frames on descriptors which were not
+ * added are not captured.
+ * @param name  The name of the interface.
+ * @param type  The type of the port's transport, selecting the link type.
+ * @param fda   The descriptors of the port's transport.
+ */
+void capture_add_interface(const char *name, enum transport_type type,
+			   struct fdarray *fda);
+
+/**
+ * Queue a frame for writing. Use only when @ref capture_active is set.
+ * @param fd    The descriptor on which the frame was received or sent.
+ * @param dir   One of the @ref capture_dir values.
+ * @param buf   The PTP message in the network byte order.
+ * @param len   The length of the message.
+ * @param hwts  The time stamps of the message, or NULL if none.
+ */
+void capture_frame(int fd, enum capture_dir dir, const void *buf, int len,
+		   struct hw_timestamp *hwts);
+
+#endif
@@ -0,0 +1,157 @@
+/**
+ * @file chronysock.c
+ * @brief Implements a servo sending the samples to chronyd over its SOCK
+ *        reference clock socket.
+ * @note Copyright (C) 2026 The linuxptp contributors
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include "chronysock.h"
+#include "config.h"
+#include "print.h"
+#include "servo_private.h"
+
+/* Identifier of the protocol */
+#define SOCK_MAGIC 0x534f434b
+
+/* Declaration of the sample from chrony (refclock_sock.c) */
+struct sock_sample {
+	struct timeval tv;	/* system time of the measurement */
+	double offset;		/* true time minus system time in seconds */
+	int pulse;		/* non-zero if the seconds are not known */
+	int leap;		/* 0 - normal, 1 - insert, 2 - delete */
+	int _pad;
+	int magic;
+};
+
+/*
+ * Unlike the SHM segment, which chronyd polls at its own rate, the socket
+ * delivers each sample to chronyd as soon as it is measured. chronyd binds
+ * the socket, so the samples are dropped until it is running.
+ */
+struct chronysock_servo {
+	struct servo servo;
+	struct sockaddr_un addr;
+	int fd;
+	int leap;
+	int failed;
+};
+
+static void chronysock_destroy(struct servo *servo)
+{
+	struct chronysock_servo *s =
+		container_of(servo, struct chronysock_servo, servo);
+
+	close(s->fd);
+	free(s);
+}
+
+static double chronysock_sample(struct servo *servo,
+				int64_t offset,
+				uint64_t local_ts,
+				double weight,
+				enum servo_state *state)
+{
+	struct chronysock_servo *s =
+		container_of(servo, struct chronysock_servo, servo);
+	struct sock_sample sample;
+
+	memset(&sample, 0, sizeof(sample));
+	sample.tv.tv_sec = local_ts / NS_PER_SEC;
+	sample.tv.tv_usec = local_ts % NS_PER_SEC / 1000;
+	sample.offset = -offset / 1e9;
+	sample.magic = SOCK_MAGIC;
+
+	switch (s->leap) {
+	case -1:
+		sample.leap = 2;
+		break;
+	case 1:
+		sample.leap = 1;
+		break;
+	default:
+		sample.leap = 0;
+	}
+
+	if (sendto(s->fd, &sample, sizeof(sample), 0,
+		   (struct sockaddr *) &s->addr, sizeof(s->addr)) < 0) {
+		if (!s->failed)
+			pr_warning("chronysock: failed to send to %s: %m",
+				   s->addr.sun_path);
+		s->failed = 1;
+	} else if (s->failed) {
+		pr_info("chronysock: sending samples to %s", s->addr.sun_path);
+		s->failed = 0;
+	}
+
+	*state = SERVO_UNLOCKED;
+	return 0.0;
+}
+
+static void chronysock_sync_interval(struct servo *servo, double interval)
+{
+}
+
+static void chronysock_reset(struct servo *servo)
+{
+}
+
+static void chronysock_leap(struct servo *servo, int leap)
+{
+	struct chronysock_servo *s =
+		container_of(servo, struct chronysock_servo, servo);
+
+	s->leap = leap;
+}
+
+struct servo *chronysock_servo_create(struct config *cfg)
+{
+	const char *path = config_get_string(cfg, NULL, "chronysock_path");
+	struct chronysock_servo *s;
+
+	if (strlen(path) >= sizeof(s->addr.sun_path)) {
+		pr_err("chronysock: path %s is too long", path);
+		return NULL;
+	}
+
+	s = calloc(1, sizeof(*s));
+	if (!s)
+		return NULL;
+
+	s->servo.destroy = chronysock_destroy;
+	s->servo.sample = chronysock_sample;
+	s->servo.sync_interval = chronysock_sync_interval;
+	s->servo.reset = chronysock_reset;
+	s->servo.leap = chronysock_leap;
+
+	s->addr.sun_family = AF_UNIX;
+	strncpy(s->addr.sun_path, path, sizeof(s->addr.sun_path) - 1);
+
+	s->fd = socket(AF_UNIX, SOCK_DGRAM | SOCK_NONBLOCK, 0);
+	if (s->fd < 0) {
+		pr_err("chronysock: socket failed: %m");
+		free(s);
+		return NULL;
+	}
+
+	return &s->servo;
+}
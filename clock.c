@@ -19,6 +19,7 @@
 #include <errno.h>
 #include <time.h>
 #include <linux/net_tstamp.h>
+#include <math.h>
 #include <poll.h>
 #include <stdlib.h>
 #include <string.h>
@@ -29,8 +30,11 @@
 #include "clock.h"
 #include "clockadj.h"
 #include "clockcheck.h"
+#include "ensemble.h"
 #include "foreign.h"
 #include "filter.h"
+#include "history.h"
+#include "holdover.h"
 #include "missing.h"
 #include "msg.h"
 #include "phc.h"
@@ -39,10 +43,13 @@
 #include "stats.h"
 #include "print.h"
 #include "rtnl.h"
+#include "tie.h"
 #include "tlv.h"
+#include "trace.h"
 #include "tsproc.h"
 #include "uds.h"
 #include "util.h"
+#include "warmstart.h"
 
 #ifdef SJA1105_SYNC
 #include "sja1105.h"
@@ -124,14 +131,25 @@ struct clock {
 	struct clock_description desc;
 	struct clock_stats stats;
 	int stats_interval;
+	struct history *history;
+	struct tie *tie;
+	int tie_log_interval;
+	struct warmstart *warm;
+	struct holdover *holdover;
+	struct ClockQuality holdover_quality; /* quality outside holdover */
+	UInteger8 holdover_gm_class; /* class of the lost grand master */
+	int holdover_class;
+	int holdover_degraded_class;
+	int holdover_limit;
+	uint64_t holdover_update;
+	struct ensemble *ensemble;
+	int trace_dumped;
 	struct clockcheck *sanity_check;
 	struct interface uds_interface;
 	struct syfu_relay_info syfu_relay;
 	LIST_HEAD(clock_subscribers_head, clock_subscriber) subscribers;
 };
 
-struct clock the_clock;
-
 static void handle_state_decision_event(struct clock *c);
 static int clock_resize_pollfd(struct clock *c, int new_nports);
 static void clock_remove_port(struct clock *c, struct port *p);
@@ -277,10 +295,25 @@ void clock_destroy(struct clock *c)
 	stats_destroy(c->stats.offset);
 	stats_destroy(c->stats.freq);
 	stats_destroy(c->stats.delay);
+	if (c->history) {
+		history_destroy(c->history);
+	}
+	if (c->tie) {
+		tie_destroy(c->tie);
+	}
+	if (c->warm) {
+		warmstart_destroy(c->warm);
+	}
+	if (c->holdover) {
+		holdover_destroy(c->holdover);
+	}
+	if (c->ensemble) {
+		ensemble_destroy(c->ensemble);
+	}
 	if (c->sanity_check) {
 		clockcheck_destroy(c->sanity_check);
 	}
-	memset(c, 0, sizeof(*c));
+	free(c);
 	msg_cleanup();
 	tc_cleanup();
 }
@@ -324,6 +357,109 @@ static void clock_management_send_error(struct port *p,
 		pr_err("failed to send management error status");
 }
 
+static int clock_get_history(struct clock *c, struct ptp_message *req,
+			     struct servo_history_np *shn)
+{
+	struct servo_history_np *query = NULL;
+	struct servo_history_record_np *r;
+	enum history_resolution res = HISTORY_RAW;
+	struct management_tlv *tlv;
+	struct history_record rec;
+	unsigned int start = 0;
+
+	if (req) {
+		tlv = (struct management_tlv *) req->management.suffix;
+		if (tlv->length >= sizeof(tlv->id) + sizeof(*query)) {
+			query = (struct servo_history_np *) tlv->data;
+			res = query->resolution;
+			start = query->start;
+		}
+	}
+	if (res >= HISTORY_RESOLUTION_CNT) {
+		res = HISTORY_RAW;
+	}
+	shn->resolution = res;
+	shn->reserved = 0;
+	shn->total = history_count(c->history, res);
+	shn->start = start;
+	shn->count = 0;
+
+	while (shn->count < SERVO_HISTORY_PAGE_MAX &&
+	       !history_get(c->history, res, start + shn->count, &rec)) {
+		r = &shn->record[shn->count];
+		r->time = rec.time;
+		r->offset = rec.offset;
+		r->offset_min = rec.offset_min;
+		r->offset_max = rec.offset_max;
+		r->delay = rec.delay;
+		r->freq = (Integer32) rec.freq;
+		r->count = rec.count;
+		shn->count++;
+	}
+	return sizeof(*shn) + shn->count * sizeof(*r);
+}
+
+static int clock_get_time_error(struct clock *c,
+				struct time_error_stats_np *tes)
+{
+	struct time_error_window_np *w;
+	struct tie_result r;
+	int i;
+
+	tes->samples = tie_num_samples(c->tie);
+	tes->logSampleInterval = c->tie_log_interval;
+	tes->count = TIE_WINDOWS;
+	tes->mtieLimit = config_get_int(c->config, NULL, "tie_mtie_limit");
+	tes->tdevLimit = config_get_double(c->config, NULL, "tie_tdev_limit") *
+		65536.0;
+
+	for (i = 0; i < TIE_WINDOWS; i++) {
+		tie_get_result(c->tie, i, &r);
+		w = &tes->window[i];
+		memset(w, 0, sizeof(*w));
+		w->window = r.window;
+		if (r.mtie_valid)
+			w->flags |= TIME_ERROR_MTIE_VALID;
+		if (r.tdev_valid)
+			w->flags |= TIME_ERROR_TDEV_VALID;
+		if (r.mtie_violation)
+			w->flags |= TIME_ERROR_MTIE_VIOLATION;
+		if (r.tdev_violation)
+			w->flags |= TIME_ERROR_TDEV_VIOLATION;
+		w->mtie = r.mtie;
+		w->tdev = r.tdev * 65536.0;
+	}
+	return sizeof(*tes) + TIE_WINDOWS * sizeof(*w);
+}
+
+static int clock_get_ensemble(struct clock *c, struct ensemble_np *en)
+{
+	struct ensemble_master_np *em;
+	struct ensemble_info info;
+	int i;
+
+	memset(en, 0, sizeof(*en));
+	for (i = 0; !ensemble_get(c->ensemble, i, &info); i++) {
+		em = &en->master[i];
+		memset(em, 0, sizeof(*em));
+		em->master = info.master;
+		if (info.primary) {
+			em->flags |= ENSEMBLE_PRIMARY;
+			info.delay = tmv_to_nanoseconds(c->path_delay);
+		}
+		if (info.learning)
+			em->flags |= ENSEMBLE_LEARNING;
+		if (info.rejected)
+			em->flags |= ENSEMBLE_REJECTED;
+		em->weight = info.weight * 65536.0;
+		em->offset = info.offset;
+		em->delay = info.delay;
+		em->stddev = info.stddev * 65536.0;
+	}
+	en->count = i;
+	return sizeof(*en) + i * sizeof(*em);
+}
+
 /* The 'p' and 'req' paremeters are needed for the GET actions that operate
  * on per-client datasets. If such actions do not apply to the caller, it is
  * allowed to pass both of them as NULL.
@@ -335,12 +471,27 @@ static int clock_management_fill_response(struct clock *c, struct port *p,
 	struct grandmaster_settings_np *gsn;
 	struct management_tlv_datum *mtd;
 	struct subscribe_events_np *sen;
+	struct servo_history_np *shn;
+	struct time_error_stats_np *tes;
+	struct servo_gains_np *sgn;
 	struct management_tlv *tlv;
+	struct ensemble_np *en;
 	struct time_status_np *tsn;
+	struct servo_gains gains;
 	struct tlv_extra *extra;
+	struct trace_np *trn;
 	struct PTPText *text;
 	int datalen = 0;
 
+	if ((id == TLV_SERVO_HISTORY_NP && !c->history) ||
+	    (id == TLV_TIME_ERROR_STATS_NP && !c->tie) ||
+	    (id == TLV_TRACE_NP && !trace_size()) ||
+	    (id == TLV_SERVO_GAINS_NP && servo_gains(c->servo, &gains)) ||
+	    (id == TLV_ENSEMBLE_NP && !c->ensemble)) {
+		/* Disabled in the configuration. */
+		return 0;
+	}
+
 	extra = tlv_extra_alloc();
 	if (!extra) {
 		pr_err("failed to allocate TLV descriptor");
@@ -442,6 +593,36 @@ static int clock_management_fill_response(struct clock *c, struct port *p,
 		}
 		sen = (struct subscribe_events_np *)tlv->data;
 		clock_get_subscription(c, req, sen->bitmask, &sen->duration);
+		datalen = sizeof(*sen);
+		break;
+	case TLV_SERVO_HISTORY_NP:
+		shn = (struct servo_history_np *)tlv->data;
+		datalen = clock_get_history(c, req, shn);
+		break;
+	case TLV_TIME_ERROR_STATS_NP:
+		tes = (struct time_error_stats_np *)tlv->data;
+		datalen = clock_get_time_error(c, tes);
+		break;
+	case TLV_TRACE_NP:
+		trn = (struct trace_np *)tlv->data;
+		trn->size = trace_size();
+		trn->dumped = c->trace_dumped;
+		trn->written = trace_written();
+		datalen = sizeof(*trn);
+		break;
+	case TLV_SERVO_GAINS_NP:
+		sgn = (struct servo_gains_np *)tlv->data;
+		memset(sgn, 0, sizeof(*sgn));
+		sgn->mode = gains.mode;
+		sgn->kp = gains.kp * 4294967296.0;
+		sgn->ki = gains.ki * 4294967296.0;
+		sgn->noise = gains.noise * 65536.0;
+		sgn->wander = gains.wander * 65536.0;
+		datalen = sizeof(*sgn);
+		break;
+	case TLV_ENSEMBLE_NP:
+		en = (struct ensemble_np *)tlv->data;
+		datalen = clock_get_ensemble(c, en);
 		break;
 	default:
 		/* The caller should *not* respond to this message. */
@@ -478,6 +659,21 @@ static int clock_management_get_response(struct clock *c, struct port *p,
 	return respond;
 }
 
+static int clock_management_command(struct clock *c, struct port *p,
+				    int id, struct ptp_message *req)
+{
+	switch (id) {
+	case TLV_TRACE_NP:
+		if (p != c->uds_port || !trace_size()) {
+			/* Only the UDS port allowed. */
+			break;
+		}
+		clock_trace_dump(c);
+		return clock_management_get_response(c, p, id, req);
+	}
+	return 0;
+}
+
 static int clock_management_set(struct clock *c, struct port *p,
 				int id, struct ptp_message *req, int *changed)
 {
@@ -862,31 +1058,27 @@ struct clock *clock_create(enum clock_type type, struct config *config,
 	enum timestamp_type timestamping;
 	int fadj = 0, max_adj = 0, sw_ts;
 	int phc_index, required_modes = 0;
-	struct clock *c = &the_clock;
+	struct clock *c;
 	struct port *p;
 	unsigned char oui[OUI_LEN];
-	char phc[32], *tmp;
-	struct interface *iface, *udsif = &c->uds_interface;
+	char phc[32], key[64], *tmp;
+	struct interface *iface, *udsif;
 	struct timespec ts;
-	int sfl;
+	double warm_freq, sync_rate;
+	int sfl, warm = 0;
 
 	clock_gettime(CLOCK_REALTIME, &ts);
 	srandom(ts.tv_sec ^ ts.tv_nsec);
 
-	if (c->nports) {
-		clock_destroy(c);
+	if (type == CLOCK_TYPE_MANAGEMENT) {
+		return NULL;
 	}
-
-	switch (type) {
-	case CLOCK_TYPE_ORDINARY:
-	case CLOCK_TYPE_BOUNDARY:
-	case CLOCK_TYPE_P2P:
-	case CLOCK_TYPE_E2E:
-		c->type = type;
-		break;
-	case CLOCK_TYPE_MANAGEMENT:
+	c = calloc(1, sizeof(*c));
+	if (!c) {
 		return NULL;
 	}
+	c->type = type;
+	udsif = &c->uds_interface;
 
 	/* Initialize the defaultDS. */
 	c->dds.clockQuality.clockClass =
@@ -904,23 +1096,23 @@ struct clock *clock_create(enum clock_type type, struct config *config,
 	if (count_char(tmp, ';') != 2 ||
 	    static_ptp_text_set(&c->desc.productDescription, tmp)) {
 		pr_err("invalid productDescription '%s'", tmp);
-		return NULL;
+		goto err;
 	}
 	tmp = config_get_string(config, NULL, "revisionData");
 	if (count_char(tmp, ';') != 2 ||
 	    static_ptp_text_set(&c->desc.revisionData, tmp)) {
 		pr_err("invalid revisionData '%s'", tmp);
-		return NULL;
+		goto err;
 	}
 	tmp = config_get_string(config, NULL, "userDescription");
 	if (static_ptp_text_set(&c->desc.userDescription, tmp)) {
 		pr_err("invalid userDescription '%s'", tmp);
-		return NULL;
+		goto err;
 	}
 	tmp = config_get_string(config, NULL, "manufacturerIdentity");
 	if (OUI_LEN != sscanf(tmp, "%hhx:%hhx:%hhx", &oui[0], &oui[1], &oui[2])) {
 		pr_err("invalid manufacturerIdentity '%s'", tmp);
-		return NULL;
+		goto err;
 	}
 	memcpy(c->desc.manufacturerIdentity, oui, OUI_LEN);
 
@@ -932,7 +1124,7 @@ struct clock *clock_create(enum clock_type type, struct config *config,
 	if (!config_get_int(config, NULL, "gmCapable") &&
 	    c->dds.flags & DDS_SLAVE_ONLY) {
 		pr_err("Cannot mix 1588 slaveOnly with 802.1AS !gmCapable");
-		return NULL;
+		goto err;
 	}
 	if (!config_get_int(config, NULL, "gmCapable") ||
 	    c->dds.flags & DDS_SLAVE_ONLY) {
@@ -944,7 +1136,7 @@ struct clock *clock_create(enum clock_type type, struct config *config,
 
 	/* Harmonize the twoStepFlag with the time_stamping option. */
 	if (config_harmonize_onestep(config)) {
-		return NULL;
+		goto err;
 	}
 	if (config_get_int(config, NULL, "twoStepFlag")) {
 		c->dds.flags |= DDS_TWO_STEP_FLAG;
@@ -970,7 +1162,7 @@ struct clock *clock_create(enum clock_type type, struct config *config,
 		    ((iface->ts_info.so_timestamping & required_modes) != required_modes)) {
 			pr_err("interface '%s' does not support "
 			       "requested timestamping mode", iface->name);
-			return NULL;
+			goto err;
 		}
 	}
 
@@ -990,7 +1182,7 @@ struct clock *clock_create(enum clock_type type, struct config *config,
 	} else {
 		pr_err("PTP device not specified and automatic determination"
 		       " is not supported. Please specify PTP device.");
-		return NULL;
+		goto err;
 	}
 	if (phc_index >= 0) {
 		pr_info("selected /dev/ptp%d as PTP clock", phc_index);
@@ -1001,13 +1193,13 @@ struct clock *clock_create(enum clock_type type, struct config *config,
 		if (generate_clock_identity(&c->dds.clockIdentity,
 					    iface->name)) {
 			pr_err("failed to generate a clock identity");
-			return NULL;
+			goto err;
 		}
 	} else {
 		if (str2cid(config_get_string(config, NULL, "clockIdentity"),
 					      &c->dds.clockIdentity)) {
 			pr_err("failed to set clock identity");
-			return NULL;
+			goto err;
 		}
 	}
 
@@ -1016,18 +1208,18 @@ struct clock *clock_create(enum clock_type type, struct config *config,
 		 config_get_string(config, NULL, "uds_address"));
 	if (config_set_section_int(config, udsif->name,
 				   "announceReceiptTimeout", 0)) {
-		return NULL;
+		goto err;
 	}
 	if (config_set_section_int(config, udsif->name,
 				    "delay_mechanism", DM_AUTO)) {
-		return NULL;
+		goto err;
 	}
 	if (config_set_section_int(config, udsif->name,
 				    "network_transport", TRANS_UDS)) {
-		return NULL;
+		goto err;
 	}
 	if (config_set_section_int(config, udsif->name, "delay_filter_length", 1)) {
-		return NULL;
+		goto err;
 	}
 
 	c->config = config;
@@ -1048,19 +1240,19 @@ struct clock *clock_create(enum clock_type type, struct config *config,
 		c->clkid = phc_open(phc);
 		if (c->clkid == CLOCK_INVALID) {
 			pr_err("Failed to open %s: %m", phc);
-			return NULL;
+			goto err;
 		}
 		max_adj = phc_max_adj(c->clkid);
 		if (!max_adj) {
 			pr_err("clock is not adjustable");
-			return NULL;
+			goto err;
 		}
 		clockadj_init(c->clkid);
 	} else if (phc_device) {
 		c->clkid = phc_open(phc_device);
 		if (c->clkid == CLOCK_INVALID) {
 			pr_err("Failed to open %s: %m", phc_device);
-			return NULL;
+			goto err;
 		}
 		max_adj = clockadj_max_freq(c->clkid);
 		clockadj_init(c->clkid);
@@ -1082,10 +1274,23 @@ struct clock *clock_create(enum clock_type type, struct config *config,
 		   the actual frequency of the clock. */
 		clockadj_set_freq(c->clkid, fadj);
 	}
+	if (!c->free_running) {
+		snprintf(key, sizeof(key), "ptp4l-%s",
+			 cid2str(&c->dds.clockIdentity));
+		c->warm = warmstart_create(config, key);
+	}
+	if (c->warm && !warmstart_load(c->warm, max_adj, &warm_freq)) {
+		fadj = (int) -warm_freq;
+		clockadj_set_freq(c->clkid, -warm_freq);
+		warm = 1;
+	}
 	c->servo = servo_create(c->config, servo, -fadj, max_adj, sw_ts);
 	if (!c->servo) {
 		pr_err("Failed to create clock servo");
-		return NULL;
+		goto err;
+	}
+	if (warm) {
+		servo_warm_start(c->servo, warm_freq);
 	}
 	c->servo_state = SERVO_UNLOCKED;
 	c->servo_type = servo;
@@ -1096,10 +1301,19 @@ struct clock *clock_create(enum clock_type type, struct config *config,
 	}
 	c->tsproc = tsproc_create(config_get_int(config, NULL, "tsproc_mode"),
 				  config_get_int(config, NULL, "delay_filter"),
-				  config_get_int(config, NULL, "delay_filter_length"));
+				  config_get_int(config, NULL, "delay_filter_length"),
+				  config_get_int(config, NULL, "delay_filter_percentile"));
 	if (!c->tsproc) {
 		pr_err("Failed to create time stamp processor");
-		return NULL;
+		goto err;
+	}
+	if (config_get_int(config, NULL, "offset_filter_length") &&
+	    tsproc_set_offset_filter(c->tsproc,
+			config_get_int(config, NULL, "offset_filter"),
+			config_get_int(config, NULL, "offset_filter_length"),
+			config_get_int(config, NULL, "offset_filter_percentile"))) {
+		pr_err("Failed to create offset filter");
+		goto err;
 	}
 	c->initial_delay = dbl_tmv(config_get_int(config, NULL, "initial_delay"));
 	c->master_local_rr = 1.0;
@@ -1110,14 +1324,51 @@ struct clock *clock_create(enum clock_type type, struct config *config,
 	c->stats.delay = stats_create();
 	if (!c->stats.offset || !c->stats.freq || !c->stats.delay) {
 		pr_err("failed to create stats");
-		return NULL;
+		goto err;
+	}
+	if (config_get_int(config, NULL, "servo_history")) {
+		sync_rate = pow(2.0, -config_get_int(config, NULL,
+						     "logSyncInterval"));
+		c->history = history_create(sync_rate);
+		if (!c->history) {
+			pr_err("failed to create servo history");
+			goto err;
+		}
+	}
+	if (config_get_int(config, NULL, "tie_monitor")) {
+		c->tie = tie_create(config_get_int(config, NULL, "tie_mtie_limit"),
+				    config_get_double(config, NULL, "tie_tdev_limit"));
+		if (!c->tie) {
+			pr_err("failed to create time error monitor");
+			goto err;
+		}
+	}
+	if (!c->free_running && config_get_int(config, NULL, "holdover")) {
+		c->holdover = holdover_create(config);
+		if (!c->holdover) {
+			pr_err("failed to create holdover");
+			goto err;
+		}
+		c->holdover_class =
+			config_get_int(config, NULL, "holdover_clock_class");
+		c->holdover_degraded_class =
+			config_get_int(config, NULL, "holdover_degraded_class");
+		c->holdover_limit =
+			config_get_int(config, NULL, "holdover_limit");
+	}
+	if (!c->free_running && config_get_int(config, NULL, "ensemble")) {
+		c->ensemble = ensemble_create(config);
+		if (!c->ensemble) {
+			pr_err("failed to create ensemble");
+			goto err;
+		}
 	}
 	sfl = config_get_int(config, NULL, "sanity_freq_limit");
 	if (sfl) {
 		c->sanity_check = clockcheck_create(sfl);
 		if (!c->sanity_check) {
 			pr_err("Failed to create clock sanity check");
-			return NULL;
+			goto err;
 		}
 	}
 
@@ -1138,14 +1389,14 @@ struct clock *clock_create(enum clock_type type, struct config *config,
 
 	if (clock_resize_pollfd(c, 0)) {
 		pr_err("failed to allocate pollfd");
-		return NULL;
+		goto err;
 	}
 
 	/* Create the UDS interface. */
 	c->uds_port = port_open(phc_index, timestamping, 0, udsif, c);
 	if (!c->uds_port) {
 		pr_err("failed to open the UDS port");
-		return NULL;
+		goto err;
 	}
 	clock_fda_changed(c);
 
@@ -1153,7 +1404,7 @@ struct clock *clock_create(enum clock_type type, struct config *config,
 	STAILQ_FOREACH(iface, &config->interfaces, list) {
 		if (clock_add_port(c, phc_index, timestamping, iface)) {
 			pr_err("failed to open port %s", iface->name);
-			return NULL;
+			goto err;
 		}
 	}
 
@@ -1165,6 +1416,9 @@ struct clock *clock_create(enum clock_type type, struct config *config,
 	port_dispatch(c->uds_port, EV_INITIALIZE, 0);
 
 	return c;
+err:
+	free(c);
+	return NULL;
 }
 
 struct dataset *clock_best_foreign(struct clock *c)
@@ -1223,6 +1477,11 @@ static void clock_get_follow_up_info(struct clock *c, struct follow_up_info_tlv
 	       sizeof(f->lastGmPhaseChange));
 }
 
+struct ensemble *clock_ensemble(struct clock *c)
+{
+	return c->ensemble;
+}
+
 int clock_free_running(struct clock *c)
 {
 	return c->free_running ? 1 : 0;
@@ -1402,6 +1661,8 @@ int clock_manage(struct clock *c, struct port *p, struct ptp_message *msg)
 			return changed;
 		break;
 	case COMMAND:
+		if (clock_management_command(c, p, mgt->id, msg))
+			return changed;
 		break;
 	default:
 		return changed;
@@ -1450,6 +1711,11 @@ int clock_manage(struct clock *c, struct port *p, struct ptp_message *msg)
 	case TLV_TIME_STATUS_NP:
 	case TLV_GRANDMASTER_SETTINGS_NP:
 	case TLV_SUBSCRIBE_EVENTS_NP:
+	case TLV_SERVO_HISTORY_NP:
+	case TLV_TIME_ERROR_STATS_NP:
+	case TLV_TRACE_NP:
+	case TLV_SERVO_GAINS_NP:
+	case TLV_ENSEMBLE_NP:
 		clock_management_send_error(p, msg, TLV_NOT_SUPPORTED);
 		break;
 	default:
@@ -1479,7 +1745,9 @@ void clock_notify_event(struct clock *c, enum notification event)
 	int id;
 
 	switch (event) {
-	/* set id */
+	case NOTIFY_TIME_ERROR:
+		id = TLV_TIME_ERROR_STATS_NP;
+		break;
 	default:
 		return;
 	}
@@ -1512,6 +1780,83 @@ void clock_set_sde(struct clock *c, int sde)
 	c->sde = sde;
 }
 
+static uint64_t clock_monotonic_ns(void)
+{
+	struct timespec now;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return now.tv_sec * NS_PER_SEC + now.tv_nsec;
+}
+
+static void clock_holdover_update(struct clock *c)
+{
+	struct ClockQuality q = c->holdover_quality;
+	uint64_t now = clock_monotonic_ns();
+	double error;
+	int accuracy;
+
+	/* Steer the frequency along the prediction once per second. */
+	if (c->holdover_update && now - c->holdover_update < NS_PER_SEC) {
+		return;
+	}
+	c->holdover_update = now;
+	clockadj_set_freq(c->clkid, -holdover_freq(c->holdover, now));
+
+	/*
+	 * Keep the holdover class of a clock which was synchronized to a
+	 * grand master with a better class while the estimated time error
+	 * is within the limit, and degrade it afterwards. The accuracy
+	 * follows the estimated time error.
+	 */
+	error = holdover_error(c->holdover, now);
+	if (q.clockClass != 255 && c->holdover_gm_class < c->holdover_class) {
+		q.clockClass = error <= c->holdover_limit ?
+			c->holdover_class : c->holdover_degraded_class;
+	}
+	accuracy = holdover_accuracy(error);
+	if (q.clockAccuracy == 0xfe || accuracy > q.clockAccuracy) {
+		q.clockAccuracy = accuracy;
+	}
+	if (q.clockClass == c->dds.clockQuality.clockClass &&
+	    q.clockAccuracy == c->dds.clockQuality.clockAccuracy) {
+		return;
+	}
+	pr_notice("holdover: estimated time error %.0f ns, "
+		  "clockClass %hhu clockAccuracy 0x%02hhx",
+		  error, q.clockClass, q.clockAccuracy);
+	c->dds.clockQuality = q;
+	if (cid_eq(&c->best_id, &c->dds.clockIdentity)) {
+		c->dad.pds.grandmasterClockQuality = q;
+	}
+	c->sde = 1;
+}
+
+static void clock_holdover_start(struct clock *c)
+{
+	if (holdover_start(c->holdover, clock_monotonic_ns())) {
+		pr_notice("not enough servo samples to start holdover");
+		return;
+	}
+	pr_notice("entering holdover");
+	c->holdover_quality = c->dds.clockQuality;
+	c->holdover_gm_class = c->dad.pds.grandmasterClockQuality.clockClass;
+	c->holdover_update = 0;
+	clock_holdover_update(c);
+}
+
+static void clock_holdover_stop(struct clock *c)
+{
+	double freq = holdover_freq(c->holdover, clock_monotonic_ns());
+
+	pr_notice("leaving holdover");
+	holdover_stop(c->holdover);
+	c->dds.clockQuality = c->holdover_quality;
+	/* Continue from the predicted frequency with the new master. */
+	servo_reset(c->servo);
+	servo_warm_start(c->servo, freq);
+	c->servo_state = SERVO_UNLOCKED;
+}
+
 int clock_poll(struct clock *c)
 {
 #ifdef SJA1105_SYNC
@@ -1534,6 +1879,7 @@ int clock_poll(struct clock *c)
 		pollfd_num += 1;
 #endif
 	cnt = poll(c->pollfd, pollfd_num, -1);
+	trace_point(TRACE_POLL_WAKEUP, 0, TRACE_NO_MSG, 0, cnt);
 	if (cnt < 0) {
 		if (EINTR == errno) {
 			return 0;
@@ -1565,6 +1911,8 @@ int clock_poll(struct clock *c)
 		for (i = 0; i < N_POLLFD; i++) {
 			if (cur[i].revents & (POLLIN|POLLPRI)) {
 				event = port_event(p, i);
+				trace_point(TRACE_EVENT_DONE, port_number(p),
+					    TRACE_NO_MSG, 0, event);
 				if (EV_STATE_DECISION_EVENT == event) {
 					c->sde = 1;
 				}
@@ -1607,6 +1955,10 @@ int clock_poll(struct clock *c)
 		}
 	}
 
+	if (c->holdover && holdover_active(c->holdover)) {
+		clock_holdover_update(c);
+	}
+
 	if (c->sde) {
 		handle_state_decision_event(c);
 		c->sde = 0;
@@ -1701,16 +2053,61 @@ int clock_switch_phc(struct clock *c, int phc_index)
 	return 0;
 }
 
+static void clock_tie_update(struct clock *c)
+{
+	if (!tie_sample(c->tie, tmv_to_nanoseconds(c->master_offset))) {
+		return;
+	}
+	pr_warning("time error exceeds the MTIE/TDEV mask");
+	clock_notify_event(c, NOTIFY_TIME_ERROR);
+}
+
+static void clock_history_update(struct clock *c, double adj)
+{
+	struct timespec now;
+
+	if (clock_gettime(CLOCK_MONOTONIC, &now)) {
+		return;
+	}
+	history_sample(c->history, now.tv_sec * NS_PER_SEC + now.tv_nsec,
+		       tmv_to_nanoseconds(c->master_offset), adj,
+		       tmv_to_nanoseconds(c->path_delay));
+}
+
+static void clock_holdover_sample(struct clock *c, enum servo_state state,
+				  double adj)
+{
+	switch (state) {
+	case SERVO_UNLOCKED:
+	case SERVO_JUMP:
+		holdover_reset(c->holdover);
+		break;
+	case SERVO_LOCKED:
+	case SERVO_LOCKED_STABLE:
+		holdover_sample(c->holdover, clock_monotonic_ns(), adj,
+				tmv_to_nanoseconds(c->master_offset));
+		break;
+	}
+}
+
 enum servo_state clock_synchronize(struct clock *c, tmv_t ingress, tmv_t origin)
 {
 	double adj, weight;
 	enum servo_state state = SERVO_UNLOCKED;
+	struct port *p;
+	int r;
+
+	trace_point(TRACE_SYNC_START, 0, TRACE_NO_MSG, 0, 0);
 
 	c->ingress_ts = ingress;
 
 	tsproc_down_ts(c->tsproc, origin, ingress);
 
-	if (tsproc_update_offset(c->tsproc, &c->master_offset, &weight)) {
+	r = tsproc_update_offset(c->tsproc, &c->master_offset, &weight);
+	if (r > 0) {
+		/* No new offset, the servo keeps its state. */
+		return c->servo_state;
+	} else if (r) {
 		if (c->free_running) {
 			return clock_no_adjust(c, ingress, origin);
 		} else {
@@ -1718,6 +2115,13 @@ enum servo_state clock_synchronize(struct clock *c, tmv_t ingress, tmv_t origin)
 		}
 	}
 
+	if (c->ensemble) {
+		c->master_offset =
+			ensemble_combine(c->ensemble,
+					 &c->dad.pds.parentPortIdentity,
+					 c->master_offset, ingress);
+	}
+
 	if (clock_utc_correct(c, ingress)) {
 		return c->servo_state;
 	}
@@ -1728,10 +2132,26 @@ enum servo_state clock_synchronize(struct clock *c, tmv_t ingress, tmv_t origin)
 		return clock_no_adjust(c, ingress, origin);
 	}
 
+	trace_point(TRACE_SERVO_START, 0, TRACE_NO_MSG, 0, 0);
 	adj = servo_sample(c->servo, tmv_to_nanoseconds(c->master_offset),
 			   tmv_to_nanoseconds(ingress), weight, &state);
+	trace_point(TRACE_SERVO_DONE, 0, TRACE_NO_MSG, 0,
+		    tmv_to_nanoseconds(c->master_offset));
 	c->servo_state = state;
 
+	if (c->warm) {
+		warmstart_sample(c->warm, state, adj,
+				 tmv_to_nanoseconds(c->master_offset));
+	}
+
+	if (c->history) {
+		clock_history_update(c, adj);
+	}
+
+	if (c->holdover) {
+		clock_holdover_sample(c, state, adj);
+	}
+
 	if (c->stats.max_count > 1) {
 		clock_stats_update(&c->stats, tmv_dbl(c->master_offset), adj);
 	} else {
@@ -1742,12 +2162,17 @@ enum servo_state clock_synchronize(struct clock *c, tmv_t ingress, tmv_t origin)
 	}
 
 	tsproc_set_clock_rate_ratio(c->tsproc, clock_rate_ratio(c));
+	if (c->ensemble) {
+		ensemble_set_clock_rate_ratio(c->ensemble, clock_rate_ratio(c));
+	}
 
 	switch (state) {
 	case SERVO_UNLOCKED:
 		break;
 	case SERVO_JUMP:
+		trace_point(TRACE_ADJ_START, 0, TRACE_NO_MSG, 0, 0);
 		clockadj_set_freq(c->clkid, -adj);
+		trace_point(TRACE_ADJ_DONE, 0, TRACE_NO_MSG, 0, (int64_t) adj);
 		clockadj_step(c->clkid, -tmv_to_nanoseconds(c->master_offset));
 		c->ingress_ts = tmv_zero();
 		if (c->sanity_check) {
@@ -1756,21 +2181,51 @@ enum servo_state clock_synchronize(struct clock *c, tmv_t ingress, tmv_t origin)
 					-tmv_to_nanoseconds(c->master_offset));
 		}
 		tsproc_reset(c->tsproc, 0);
+		if (c->ensemble) {
+			ensemble_reset(c->ensemble);
+		}
+		LIST_FOREACH(p, &c->ports, list) {
+			port_clock_stepped(p);
+		}
+		if (c->tie) {
+			tie_reset(c->tie);
+		}
 		break;
 	case SERVO_LOCKED:
 	case SERVO_LOCKED_STABLE:
+		trace_point(TRACE_ADJ_START, 0, TRACE_NO_MSG, 0, 0);
 		clockadj_set_freq(c->clkid, -adj);
+		trace_point(TRACE_ADJ_DONE, 0, TRACE_NO_MSG, 0, (int64_t) adj);
 		if (c->clkid == CLOCK_REALTIME) {
 			sysclk_set_sync();
 		}
 		if (c->sanity_check) {
 			clockcheck_set_freq(c->sanity_check, -adj);
 		}
+		if (c->tie) {
+			clock_tie_update(c);
+		}
 		break;
 	}
 	return state;
 }
 
+int clock_trace_dump(struct clock *c)
+{
+	const char *path = config_get_string(c->config, NULL, "trace_file");
+	int n;
+
+	n = trace_dump(path);
+	if (n < 0) {
+		pr_err("failed to write trace to %s: %m", path);
+		c->trace_dumped = 0;
+		return -1;
+	}
+	pr_info("wrote %d trace records to %s", n, path);
+	c->trace_dumped = n;
+	return n;
+}
+
 void clock_sync_interval(struct clock *c, int n)
 {
 	int shift;
@@ -1793,6 +2248,12 @@ void clock_sync_interval(struct clock *c, int n)
 	}
 	c->stats.max_count = (1 << shift);
 
+	if (c->tie && c->tie_log_interval != n) {
+		/* The estimator assumes a constant sampling interval. */
+		tie_reset(c->tie);
+		c->tie_log_interval = n;
+	}
+
 	servo_sync_interval(c->servo, n < 0 ? 1.0 / (1 << -n) : 1 << n);
 }
 
@@ -1806,6 +2267,36 @@ void clock_update_time_properties(struct clock *c, struct timePropertiesDS tds)
 	c->tds = tds;
 }
 
+/*
+ * Continue with the measurements of a hot standby port leading to the
+ * new master if there are any.
+ */
+static int clock_standby_takeover(struct clock *c, struct foreign_clock *best)
+{
+	if (!best) {
+		return -1;
+	}
+	return port_standby_takeover(best->port, &c->tsproc, &c->path_delay,
+				     &c->nrr);
+}
+
+static void clock_holdover_check(struct clock *c, struct ClockIdentity *best_id)
+{
+	int local = cid_eq(best_id, &c->dds.clockIdentity);
+
+	if (holdover_active(c->holdover)) {
+		if (!local) {
+			clock_holdover_stop(c);
+		}
+		return;
+	}
+	if (local && !cid_eq(&c->best_id, &c->dds.clockIdentity) &&
+	    (c->servo_state == SERVO_LOCKED ||
+	     c->servo_state == SERVO_LOCKED_STABLE)) {
+		clock_holdover_start(c);
+	}
+}
+
 static void handle_state_decision_event(struct clock *c)
 {
 	struct foreign_clock *best = NULL, *fc;
@@ -1836,15 +2327,24 @@ static void handle_state_decision_event(struct clock *c)
 	}
 
 	if (!cid_eq(&best_id, &c->best_id)) {
+		if (c->holdover) {
+			clock_holdover_check(c, &best_id);
+		}
 		clock_freq_est_reset(c);
-		tsproc_reset(c->tsproc, 1);
-		if (!tmv_is_zero(c->initial_delay))
-			tsproc_set_delay(c->tsproc, c->initial_delay);
+		if (clock_standby_takeover(c, best)) {
+			tsproc_reset(c->tsproc, 1);
+			if (!tmv_is_zero(c->initial_delay))
+				tsproc_set_delay(c->tsproc, c->initial_delay);
+			c->path_delay = c->initial_delay;
+			c->nrr = 1.0;
+		}
 		c->ingress_ts = tmv_zero();
-		c->path_delay = c->initial_delay;
-		c->nrr = 1.0;
 		fresh_best = 1;
 		clock_disable_syfu_relay(c);
+	} else if (best && !pid_eq(&best->dataset.sender,
+				   &c->dad.pds.parentPortIdentity)) {
+		/* The same grand master is reachable via another path. */
+		clock_standby_takeover(c, best);
 	}
 
 	c->best = best;
@@ -32,6 +32,7 @@
 #define POW2_41 ((double)(1ULL << 41))
 
 struct ptp_message; /*forward declaration*/
+struct ensemble;
 
 struct syfu_relay_info {
 	tmv_t precise_origin_ts;
@@ -151,6 +152,13 @@ struct port *clock_first_port(struct clock *c);
  */
 void clock_follow_up_info(struct clock *c, struct follow_up_info_tlv *f);
 
+/**
+ * Obtain the ensemble combining the offsets of several masters.
+ * @param c  The clock instance.
+ * @return   The ensemble, or NULL if the ensemble mode is disabled.
+ */
+struct ensemble *clock_ensemble(struct clock *c);
+
 /**
  * Determine if a clock is free running or not.
  * @param c  The clock instance.
@@ -277,6 +285,13 @@ void clock_set_sde(struct clock *c, int sde);
  */
 int clock_poll(struct clock *c);
 
+/**
+ * Write the content of the trace ring to the configured trace file.
+ * @param c A pointer to a clock instance obtained with clock_create().
+ * @return  The number of records written, or -1 on error.
+ */
+int clock_trace_dump(struct clock *c);
+
 /**
  * Obtain the servo struct.
  * @param c The clock instance.
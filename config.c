@@ -31,6 +31,9 @@
 #include "hash.h"
 #include "print.h"
 #include "util.h"
+#ifdef SJA1105_SYNC
+#include "sja1105.h"
+#endif
 
 enum config_section {
 	GLOBAL_SECTION,
@@ -134,10 +137,22 @@ static struct config_enum clock_servo_enu[] = {
 	{ "pi",     CLOCK_SERVO_PI     },
 	{ "linreg", CLOCK_SERVO_LINREG },
 	{ "ntpshm", CLOCK_SERVO_NTPSHM },
+	{ "kalman", CLOCK_SERVO_KALMAN },
 	{ "nullf",  CLOCK_SERVO_NULLF  },
+	{ "chronysock", CLOCK_SERVO_CHRONYSOCK },
 	{ NULL, 0 },
 };
 
+#ifdef SJA1105_SYNC
+static struct config_enum sja1105_sync_servo_enu[] = {
+	{ "builtin", SJA1105_SERVO_BUILTIN },
+	{ "pi",      CLOCK_SERVO_PI        },
+	{ "linreg",  CLOCK_SERVO_LINREG    },
+	{ "kalman",  CLOCK_SERVO_KALMAN    },
+	{ NULL, 0 },
+};
+#endif
+
 static struct config_enum clock_type_enu[] = {
 	{ "OC",      CLOCK_TYPE_ORDINARY },
 	{ "BC",      CLOCK_TYPE_BOUNDARY },
@@ -155,6 +170,9 @@ static struct config_enum dataset_comp_enu[] = {
 static struct config_enum delay_filter_enu[] = {
 	{ "moving_average", FILTER_MOVING_AVERAGE },
 	{ "moving_median",  FILTER_MOVING_MEDIAN  },
+	{ "moving_median_heap", FILTER_MOVING_MEDIAN_HEAP },
+	{ "moving_minimum", FILTER_MOVING_MINIMUM },
+	{ "percentile_mean", FILTER_PERCENTILE_MEAN },
 	{ NULL, 0 },
 };
 
@@ -214,7 +232,10 @@ struct config_item config_tab[] = {
 	GLOB_ITEM_INT("assume_two_step", 0, 0, 1),
 	PORT_ITEM_INT("boundary_clock_jbod", 0, 0, 1),
 	PORT_ITEM_ENU("BMCA", BMCA_PTP, bmca_enu),
+	GLOB_ITEM_INT("capture_buffer_size", 1048576, 4096, INT_MAX),
+	GLOB_ITEM_STR("capture_file", ""),
 	GLOB_ITEM_INT("check_fup_sync", 0, 0, 1),
+	GLOB_ITEM_STR("chronysock_path", "/var/run/chrony.ptp.sock"),
 	GLOB_ITEM_INT("clockAccuracy", 0xfe, 0, UINT8_MAX),
 	GLOB_ITEM_INT("clockClass", 248, 0, UINT8_MAX),
 	GLOB_ITEM_STR("clockIdentity", "000000.0000.000000"),
@@ -224,11 +245,13 @@ struct config_item config_tab[] = {
 	PORT_ITEM_INT("delayAsymmetry", 0, INT_MIN, INT_MAX),
 	PORT_ITEM_ENU("delay_filter", FILTER_MOVING_MEDIAN, delay_filter_enu),
 	PORT_ITEM_INT("delay_filter_length", 10, 1, INT_MAX),
+	PORT_ITEM_INT("delay_filter_percentile", 25, 1, 100),
 	PORT_ITEM_ENU("delay_mechanism", DM_E2E, delay_mech_enu),
 	GLOB_ITEM_INT("dscp_event", 0, 0, 63),
 	GLOB_ITEM_INT("dscp_general", 0, 0, 63),
 	GLOB_ITEM_INT("domainNumber", 0, 0, 127),
 	PORT_ITEM_INT("egressLatency", 0, INT_MIN, INT_MAX),
+	GLOB_ITEM_INT("ensemble", 0, 0, 1),
 	PORT_ITEM_INT("fault_badpeernet_interval", 16, INT32_MIN, INT32_MAX),
 	PORT_ITEM_INT("fault_reset_interval", 4, INT8_MIN, INT8_MAX),
 	GLOB_ITEM_DBL("first_step_threshold", 0.00002, 0.0, DBL_MAX),
@@ -238,6 +261,13 @@ struct config_item config_tab[] = {
 	GLOB_ITEM_INT("G.8275.defaultDS.localPriority", 128, 1, UINT8_MAX),
 	PORT_ITEM_INT("G.8275.portDS.localPriority", 128, 1, UINT8_MAX),
 	GLOB_ITEM_INT("gmCapable", 1, 0, 1),
+	GLOB_ITEM_INT("holdover", 0, 0, 1),
+	GLOB_ITEM_INT("holdover_clock_class", 7, 0, UINT8_MAX),
+	GLOB_ITEM_INT("holdover_degraded_class", 52, 0, UINT8_MAX),
+	GLOB_ITEM_INT("holdover_limit", 1000, 1, INT_MAX),
+	GLOB_ITEM_DBL("holdover_wander", 0.01, 0.0, DBL_MAX),
+	GLOB_ITEM_INT("holdover_window", 600, 48, INT_MAX),
+	PORT_ITEM_INT("hot_standby", 0, 0, 1),
 	GLOB_ITEM_ENU("hwts_filter", HWTS_FILTER_NORMAL, hwts_filter_enu),
 	PORT_ITEM_INT("hybrid_e2e", 0, 0, 1),
 	PORT_ITEM_INT("ignore_source_id", 0, 0, 1),
@@ -247,11 +277,16 @@ struct config_item config_tab[] = {
 	GLOB_ITEM_INT("initial_delay", 0, 0, INT_MAX),
 	PORT_ITEM_INT("inhibit_delay_req", 0, 0, 1),
 	PORT_ITEM_INT("inhibit_multicast_service", 0, 0, 1),
+	GLOB_ITEM_DBL("kalman_frequency_noise", 1.0, 0.0, DBL_MAX),
+	GLOB_ITEM_DBL("kalman_measurement_noise", 0.0, 0.0, DBL_MAX),
+	GLOB_ITEM_DBL("kalman_phase_noise", 0.0, 0.0, DBL_MAX),
+	GLOB_ITEM_DBL("kalman_time_constant", 0.0, 0.0, DBL_MAX),
 	GLOB_ITEM_INT("kernel_leap", 1, 0, 1),
 	PORT_ITEM_INT("logAnnounceInterval", 1, INT8_MIN, INT8_MAX),
 	PORT_ITEM_INT("logMinDelayReqInterval", 0, INT8_MIN, INT8_MAX),
 	PORT_ITEM_INT("logMinPdelayReqInterval", 0, INT8_MIN, INT8_MAX),
 	PORT_ITEM_INT("logSyncInterval", 0, INT8_MIN, INT8_MAX),
+	GLOB_ITEM_INT("logging_buffer_size", 0, 0, 1 << 20),
 	GLOB_ITEM_INT("logging_level", LOG_INFO, PRINT_LEVEL_MIN, PRINT_LEVEL_MAX),
 	PORT_ITEM_INT("masterOnly", 0, 0, 1),
 	GLOB_ITEM_INT("maxStepsRemoved", 255, 2, UINT8_MAX),
@@ -263,10 +298,14 @@ struct config_item config_tab[] = {
 	PORT_ITEM_INT("net_sync_monitor", 0, 0, 1),
 	PORT_ITEM_ENU("network_transport", TRANS_UDP_IPV4, nw_trans_enu),
 	GLOB_ITEM_INT("ntpshm_segment", 0, INT_MIN, INT_MAX),
+	GLOB_ITEM_ENU("offset_filter", FILTER_MOVING_MINIMUM, delay_filter_enu),
+	GLOB_ITEM_INT("offset_filter_length", 0, 0, INT_MAX),
+	GLOB_ITEM_INT("offset_filter_percentile", 25, 1, 100),
 	GLOB_ITEM_INT("offsetScaledLogVariance", 0xffff, 0, UINT16_MAX),
 	PORT_ITEM_INT("operLogPdelayReqInterval", 0, INT8_MIN, INT8_MAX),
 	PORT_ITEM_INT("operLogSyncInterval", 0, INT8_MIN, INT8_MAX),
 	PORT_ITEM_INT("path_trace_enabled", 0, 0, 1),
+	GLOB_ITEM_INT("pi_adaptive", 0, 0, 1),
 	GLOB_ITEM_DBL("pi_integral_const", 0.0, 0.0, DBL_MAX),
 	GLOB_ITEM_DBL("pi_integral_exponent", 0.4, -DBL_MAX, DBL_MAX),
 	GLOB_ITEM_DBL("pi_integral_norm_max", 0.3, DBL_MIN, 2.0),
@@ -286,16 +325,26 @@ struct config_item config_tab[] = {
 	GLOB_ITEM_INT("sja1105_max_offset", 0, 10, INT_MAX),
 	GLOB_ITEM_DBL("sja1105_sync_kp", 0.096, 0.0, 1.0),
 	GLOB_ITEM_DBL("sja1105_sync_ki", 0.007, 0.0, 1.0),
+	GLOB_ITEM_ENU("sja1105_sync_servo", SJA1105_SERVO_BUILTIN,
+		      sja1105_sync_servo_enu),
 #endif
+	GLOB_ITEM_INT("servo_history", 0, 0, 1),
+	GLOB_ITEM_STR("servo_history_file", "/var/run/phc2sys.history"),
 	GLOB_ITEM_INT("servo_num_offset_values", 10, 0, INT_MAX),
 	GLOB_ITEM_INT("servo_offset_threshold", 0, 0, INT_MAX),
 	GLOB_ITEM_INT("slaveOnly", 0, 0, 1),
 	GLOB_ITEM_DBL("step_threshold", 0.0, 0.0, DBL_MAX),
 	GLOB_ITEM_INT("summary_interval", 0, INT_MIN, INT_MAX),
 	PORT_ITEM_INT("syncReceiptTimeout", 0, 0, UINT8_MAX),
+	GLOB_ITEM_DBL("sysoff_sample_rate", 0.0, 0.0, 1000.0),
 	GLOB_ITEM_INT("tc_spanning_tree", 0, 0, 1),
+	GLOB_ITEM_INT("tie_monitor", 0, 0, 1),
+	GLOB_ITEM_INT("tie_mtie_limit", 0, 0, INT_MAX),
+	GLOB_ITEM_DBL("tie_tdev_limit", 0.0, 0.0, DBL_MAX),
 	GLOB_ITEM_INT("timeSource", INTERNAL_OSCILLATOR, 0x10, 0xfe),
 	GLOB_ITEM_ENU("time_stamping", TS_HARDWARE, timestamping_enu),
+	GLOB_ITEM_INT("trace_buffer_size", 0, 0, 1 << 24),
+	GLOB_ITEM_STR("trace_file", "/var/run/ptp4l.trace"),
 	PORT_ITEM_INT("transportSpecific", 0, 0, 0x0F),
 	PORT_ITEM_ENU("tsproc_mode", TSPROC_FILTER, tsproc_enu),
 	GLOB_ITEM_INT("twoStepFlag", 1, 0, 1),
@@ -310,6 +359,9 @@ struct config_item config_tab[] = {
 	GLOB_ITEM_STR("userDescription", ""),
 	GLOB_ITEM_INT("utc_offset", CURRENT_UTC_OFFSET, 0, INT_MAX),
 	GLOB_ITEM_INT("verbose", 0, 0, 1),
+	GLOB_ITEM_STR("warm_start_dir", ""),
+	GLOB_ITEM_INT("warm_start_interval", 60, 1, INT_MAX),
+	GLOB_ITEM_INT("warm_start_max_age", 3600, 0, INT_MAX),
 };
 
 static struct unicast_master_table *current_uc_mtab;
@@ -864,16 +916,28 @@ struct config *config_create(void)
 		return NULL;
 	}
 
+	cfg->global = malloc(sizeof(config_tab));
+	if (!cfg->global) {
+		free(cfg->opts);
+		free(cfg);
+		return NULL;
+	}
+	memcpy(cfg->global, config_tab, sizeof(config_tab));
+
 	cfg->htab = hash_create();
 	if (!cfg->htab) {
+		free(cfg->global);
 		free(cfg->opts);
 		free(cfg);
 		return NULL;
 	}
 
-	/* Populate the hash table with global defaults. */
+	/*
+	 * Populate the hash table with global defaults. Every configuration
+	 * has its own copy, so that several of them can coexist.
+	 */
 	for (i = 0; i < N_CONFIG_ITEMS; i++) {
-		ci = &config_tab[i];
+		ci = &cfg->global[i];
 		ci->flags |= CFG_ITEM_STATIC;
 		snprintf(buf, sizeof(buf), "global.%s", ci->label);
 		if (hash_insert(cfg->htab, buf, ci)) {
@@ -884,9 +948,9 @@ struct config *config_create(void)
 
 	/* Perform a Built In Self Test.*/
 	for (i = 0; i < N_CONFIG_ITEMS; i++) {
-		ci = &config_tab[i];
+		ci = &cfg->global[i];
 		ci = config_global_item(cfg, ci->label);
-		if (ci != &config_tab[i]) {
+		if (ci != &cfg->global[i]) {
 			fprintf(stderr, "config BIST failed at %s\n",
 				config_tab[i].label);
 			goto fail;
@@ -895,6 +959,7 @@ struct config *config_create(void)
 	return cfg;
 fail:
 	hash_destroy(cfg->htab, NULL);
+	free(cfg->global);
 	free(cfg->opts);
 	free(cfg);
 	return NULL;
@@ -922,6 +987,7 @@ void config_destroy(struct config *cfg)
 		free(table);
 	}
 	hash_destroy(cfg->htab, config_item_free);
+	free(cfg->global);
 	free(cfg->opts);
 	free(cfg);
 }
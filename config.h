@@ -56,6 +56,9 @@ struct config {
 	/* hash of all non-legacy items */
 	struct hash *htab;
 
+	/* private copy of the global items */
+	struct config_item *global;
+
 	/* unicast master tables */
 	STAILQ_HEAD(ucmtab_head, unicast_master_table) unicast_master_tables;
 };
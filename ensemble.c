@@ -0,0 +1,421 @@
+/**
+ * @file ensemble.c
+ * @brief Combines the offsets measured with several masters.
+ * @note Copyright (C) 2026 The linuxptp contributors
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+#include <math.h>
+#include <stdlib.h>
+#include <sys/queue.h>
+
+#include "ensemble.h"
+#include "missing.h"
+#include "print.h"
+#include "tsproc.h"
+#include "util.h"
+
+/* Number of deviations from the other masters needed to be combined */
+#define MIN_SAMPLES 8
+/* Length of the running average of the squared deviations */
+#define AVG_LEN 64
+/* Smallest variance relative to the mean square of the deviations */
+#define MIN_VAR_RATIO (1.0 / 16.0)
+/* Deviation assumed before it was measured, in nanoseconds */
+#define INITIAL_STDDEV 1000.0
+/* Smallest deviation used for the weights, in nanoseconds */
+#define MIN_STDDEV 1.0
+/* Deviation from the median after which an offset is an outlier */
+#define OUTLIER_SIGMAS 4.0
+/* Maximum age of an offset to be combined with the primary one */
+#define MAX_AGE (2 * NS_PER_SEC)
+/* Time without Sync messages after which a master is forgotten */
+#define EXPIRE_AGE (16 * NS_PER_SEC)
+
+/*
+ * Each master has its own time stamp processor. When the primary master
+ * provides a new offset, the offsets of the other masters measured since
+ * the previous one are combined with it. The weight of a master is the
+ * inverse of the mean squared deviation of its offsets from the weighted
+ * mean of the other masters, so a master behind a network with a large
+ * packet delay variation contributes less. Offsets which deviate from
+ * the median of all offsets by more than four of their standard
+ * deviations are ignored.
+ */
+
+struct member {
+	LIST_ENTRY(member) list;
+	struct PortIdentity master;
+	struct tsproc *tsp;
+	/* Sync or Follow_Up waiting for its pair */
+	int have_sync;
+	int have_fup;
+	UInteger16 sync_seq;
+	UInteger16 fup_seq;
+	tmv_t sync_ingress;
+	tmv_t sync_correction;
+	tmv_t fup_origin;
+	tmv_t last_sync;
+	/* Latest measurement */
+	tmv_t offset;
+	tmv_t ingress;
+	tmv_t delay;
+	int fresh;
+	/* Statistics */
+	unsigned int count;
+	double msq;
+	double var;
+	double weight;
+	int rejected;
+	/* Used in the combination */
+	double x;
+	int used;
+};
+
+struct ensemble {
+	LIST_HEAD(members_head, member) members;
+	unsigned int num_members;
+	struct PortIdentity primary;
+	struct config *cfg;
+	double rr;
+};
+
+static struct member *member_create(struct ensemble *e,
+				    struct PortIdentity *master)
+{
+	struct config *cfg = e->cfg;
+	struct member *m;
+
+	if (e->num_members >= ENSEMBLE_MAX_MEMBERS) {
+		return NULL;
+	}
+	m = calloc(1, sizeof(*m));
+	if (!m) {
+		return NULL;
+	}
+	m->tsp = tsproc_create(config_get_int(cfg, NULL, "tsproc_mode"),
+			       config_get_int(cfg, NULL, "delay_filter"),
+			       config_get_int(cfg, NULL, "delay_filter_length"),
+			       config_get_int(cfg, NULL, "delay_filter_percentile"));
+	if (!m->tsp) {
+		free(m);
+		return NULL;
+	}
+	if (config_get_int(cfg, NULL, "offset_filter_length") &&
+	    tsproc_set_offset_filter(m->tsp,
+			config_get_int(cfg, NULL, "offset_filter"),
+			config_get_int(cfg, NULL, "offset_filter_length"),
+			config_get_int(cfg, NULL, "offset_filter_percentile"))) {
+		tsproc_destroy(m->tsp);
+		free(m);
+		return NULL;
+	}
+	m->master = *master;
+	m->var = INITIAL_STDDEV * INITIAL_STDDEV;
+	m->msq = 2.0 * m->var;
+	LIST_INSERT_HEAD(&e->members, m, list);
+	e->num_members++;
+	pr_info("ensemble: added master %s", pid2str(master));
+	return m;
+}
+
+static void member_destroy(struct ensemble *e, struct member *m)
+{
+	LIST_REMOVE(m, list);
+	e->num_members--;
+	tsproc_destroy(m->tsp);
+	free(m);
+}
+
+static struct member *member_find(struct ensemble *e,
+				  struct PortIdentity *master)
+{
+	struct member *m;
+
+	LIST_FOREACH(m, &e->members, list) {
+		if (pid_eq(&m->master, master)) {
+			return m;
+		}
+	}
+	return member_create(e, master);
+}
+
+static void member_sample(struct ensemble *e, struct member *m,
+			  tmv_t origin, tmv_t ingress)
+{
+	tsproc_set_clock_rate_ratio(m->tsp, e->rr);
+	tsproc_down_ts(m->tsp, origin, ingress);
+	if (tsproc_update_offset(m->tsp, &m->offset, NULL)) {
+		return;
+	}
+	m->ingress = ingress;
+	m->fresh = 1;
+}
+
+struct ensemble *ensemble_create(struct config *cfg)
+{
+	struct ensemble *e;
+
+	e = calloc(1, sizeof(*e));
+	if (!e) {
+		return NULL;
+	}
+	LIST_INIT(&e->members);
+	e->cfg = cfg;
+	e->rr = 1.0;
+	return e;
+}
+
+void ensemble_destroy(struct ensemble *e)
+{
+	while (!LIST_EMPTY(&e->members)) {
+		member_destroy(e, LIST_FIRST(&e->members));
+	}
+	free(e);
+}
+
+void ensemble_sync(struct ensemble *e, struct ptp_message *msg)
+{
+	tmv_t ingress = msg->hwts.ts, correction;
+	struct member *m;
+
+	m = member_find(e, &msg->header.sourcePortIdentity);
+	if (!m) {
+		return;
+	}
+	m->last_sync = ingress;
+	correction = correction_to_tmv(msg->header.correction);
+
+	if (one_step(msg)) {
+		member_sample(e, m, tmv_add(timestamp_to_tmv(msg->ts.pdu),
+					    correction), ingress);
+		return;
+	}
+	if (m->have_fup && m->fup_seq == msg->header.sequenceId) {
+		member_sample(e, m, tmv_add(m->fup_origin, correction),
+			      ingress);
+		m->have_fup = 0;
+		return;
+	}
+	m->have_sync = 1;
+	m->sync_seq = msg->header.sequenceId;
+	m->sync_ingress = ingress;
+	m->sync_correction = correction;
+}
+
+void ensemble_follow_up(struct ensemble *e, struct ptp_message *msg)
+{
+	struct member *m;
+	tmv_t origin;
+
+	m = member_find(e, &msg->header.sourcePortIdentity);
+	if (!m) {
+		return;
+	}
+	origin = tmv_add(timestamp_to_tmv(msg->ts.pdu),
+			 correction_to_tmv(msg->header.correction));
+
+	if (m->have_sync && m->sync_seq == msg->header.sequenceId) {
+		member_sample(e, m, tmv_add(origin, m->sync_correction),
+			      m->sync_ingress);
+		m->have_sync = 0;
+		return;
+	}
+	m->have_fup = 1;
+	m->fup_seq = msg->header.sequenceId;
+	m->fup_origin = origin;
+}
+
+void ensemble_delay(struct ensemble *e, struct PortIdentity *master,
+		    tmv_t req, tmv_t rx)
+{
+	struct member *m;
+
+	m = member_find(e, master);
+	if (!m) {
+		return;
+	}
+	tsproc_up_ts(m->tsp, req, rx);
+	tsproc_update_delay(m->tsp, &m->delay);
+}
+
+static int cmp_double(const void *a, const void *b)
+{
+	const double *x = a, *y = b;
+
+	return *x < *y ? -1 : *x > *y ? 1 : 0;
+}
+
+tmv_t ensemble_combine(struct ensemble *e, struct PortIdentity *primary,
+		       tmv_t offset, tmv_t ingress)
+{
+	double x[ENSEMBLE_MAX_MEMBERS], median, w, sw, swx, r2, a;
+	unsigned int n, accepted, combined;
+	struct member *m, *p, *tmp;
+	int64_t age;
+
+	p = member_find(e, primary);
+	if (!p) {
+		return offset;
+	}
+	e->primary = *primary;
+	p->offset = offset;
+	p->ingress = ingress;
+	p->last_sync = ingress;
+	p->fresh = 1;
+
+	/* Select the recent offsets relative to the primary one. */
+	n = 0;
+	LIST_FOREACH_SAFE(m, &e->members, list, tmp) {
+		if (tmv_to_nanoseconds(tmv_sub(ingress, m->last_sync)) >
+		    EXPIRE_AGE) {
+			pr_info("ensemble: removed master %s",
+				pid2str(&m->master));
+			member_destroy(e, m);
+			continue;
+		}
+		m->used = 0;
+		m->rejected = 0;
+		m->weight = 0.0;
+		if (!m->fresh) {
+			continue;
+		}
+		m->fresh = 0;
+		age = tmv_to_nanoseconds(tmv_sub(ingress, m->ingress));
+		if (llabs(age) > MAX_AGE) {
+			continue;
+		}
+		m->x = tmv_dbl(tmv_sub(m->offset, offset));
+		m->used = 1;
+		if (m == p || m->count >= MIN_SAMPLES) {
+			x[n++] = m->x;
+		}
+	}
+
+	/* Reject the outliers if there are enough masters to find them. */
+	accepted = n;
+	if (n >= 3) {
+		qsort(x, n, sizeof(x[0]), cmp_double);
+		median = n % 2 ? x[n / 2] : (x[n / 2 - 1] + x[n / 2]) / 2.0;
+		LIST_FOREACH(m, &e->members, list) {
+			if (!m->used || (m != p && m->count < MIN_SAMPLES)) {
+				continue;
+			}
+			if (fabs(m->x - median) >
+			    OUTLIER_SIGMAS * sqrt(m->msq)) {
+				m->rejected = 1;
+				accepted--;
+			}
+		}
+		if (!accepted) {
+			p->rejected = 0;
+		}
+	}
+
+	sw = swx = 0.0;
+	combined = 0;
+	LIST_FOREACH(m, &e->members, list) {
+		if (!m->used || m->rejected ||
+		    (m != p && m->count < MIN_SAMPLES)) {
+			continue;
+		}
+		m->weight = 1.0 / fmax(m->var, MIN_STDDEV * MIN_STDDEV);
+		sw += m->weight;
+		swx += m->weight * m->x;
+		combined++;
+	}
+
+	/*
+	 * Update the deviations from the weighted mean of the other
+	 * masters, so the noise of a master does not hide itself. The
+	 * mean square of the deviations includes the variance of the mean,
+	 * which is subtracted. With only two masters their variances cannot
+	 * be separated and both get a half of the mean square. The
+	 * difference is noisy, so it is kept above a fraction of the mean
+	 * square. Outliers are clamped to limit their effect on the
+	 * estimate.
+	 */
+	LIST_FOREACH(m, &e->members, list) {
+		if (!m->used) {
+			continue;
+		}
+		w = m->weight;
+		if (sw - w <= 0.0) {
+			continue;
+		}
+		r2 = m->x - (swx - w * m->x) / (sw - w);
+		r2 = fmin(r2 * r2, OUTLIER_SIGMAS * OUTLIER_SIGMAS * m->msq);
+		if (m->count < AVG_LEN) {
+			m->count++;
+		}
+		a = 1.0 / m->count;
+		m->msq += a * (r2 - m->msq);
+		if (combined - (w > 0.0) < 2) {
+			m->var = m->msq / 2.0;
+		} else {
+			m->var = m->msq - 1.0 / (sw - w);
+		}
+		m->var = fmax(m->var, MIN_VAR_RATIO * m->msq);
+		m->var = fmax(m->var, MIN_STDDEV * MIN_STDDEV);
+	}
+
+	LIST_FOREACH(m, &e->members, list) {
+		m->weight = sw > 0.0 ? m->weight / sw : 0.0;
+	}
+	if (sw <= 0.0) {
+		p->weight = 1.0;
+		return offset;
+	}
+	return tmv_add(offset, dbl_tmv(swx / sw));
+}
+
+void ensemble_set_clock_rate_ratio(struct ensemble *e, double rr)
+{
+	e->rr = rr;
+}
+
+void ensemble_reset(struct ensemble *e)
+{
+	struct member *m;
+
+	LIST_FOREACH(m, &e->members, list) {
+		tsproc_reset(m->tsp, 0);
+		m->have_sync = 0;
+		m->have_fup = 0;
+		m->fresh = 0;
+	}
+}
+
+int ensemble_get(struct ensemble *e, unsigned int index,
+		 struct ensemble_info *info)
+{
+	struct member *m;
+
+	LIST_FOREACH(m, &e->members, list) {
+		if (index--) {
+			continue;
+		}
+		info->master = m->master;
+		info->primary = pid_eq(&m->master, &e->primary);
+		info->learning = !info->primary && m->count < MIN_SAMPLES;
+		info->rejected = m->rejected;
+		info->offset = tmv_to_nanoseconds(m->offset);
+		info->delay = tmv_to_nanoseconds(m->delay);
+		info->stddev = sqrt(m->var);
+		info->weight = m->weight;
+		return 0;
+	}
+	return -1;
+}
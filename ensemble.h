@@ -0,0 +1,122 @@
+/**
+ * @file ensemble.h
+ * @brief Combines the offsets measured with several masters.
+ * @note Copyright (C) 2026 The linuxptp contributors
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+#ifndef HAVE_ENSEMBLE_H
+#define HAVE_ENSEMBLE_H
+
+#include "config.h"
+#include "ddt.h"
+#include "msg.h"
+#include "tmv.h"
+
+/** The maximum number of masters in the ensemble. */
+#define ENSEMBLE_MAX_MEMBERS 16
+
+/** Opaque type */
+struct ensemble;
+
+/**
+ * The contribution of one master to the combined offset.
+ */
+struct ensemble_info {
+	struct PortIdentity master;
+	int primary;	/* selected by the BMCA */
+	int learning;	/* not enough samples to be combined yet */
+	int rejected;	/* an outlier in the last combination */
+	int64_t offset;	/* last offset in nanoseconds */
+	int64_t delay;	/* path delay in nanoseconds */
+	double stddev;	/* deviation from the other masters in nanoseconds */
+	double weight;	/* share of the last combined offset */
+};
+
+/**
+ * Create a new ensemble.
+ * @param cfg  The configuration providing the time stamp processing
+ *             options of the clock.
+ * @return     A pointer to a new ensemble on success, NULL otherwise.
+ */
+struct ensemble *ensemble_create(struct config *cfg);
+
+/**
+ * Destroy an ensemble.
+ * @param e  Pointer obtained via @ref ensemble_create().
+ */
+void ensemble_destroy(struct ensemble *e);
+
+/**
+ * Process a Sync message from a master which is not the primary one.
+ * @param e  Pointer obtained via @ref ensemble_create().
+ * @param m  The Sync message with the corrections applied by the port.
+ */
+void ensemble_sync(struct ensemble *e, struct ptp_message *m);
+
+/**
+ * Process a Follow_Up message from a master which is not the primary one.
+ * @param e  Pointer obtained via @ref ensemble_create().
+ * @param m  The Follow_Up message.
+ */
+void ensemble_follow_up(struct ensemble *e, struct ptp_message *m);
+
+/**
+ * Process a delay measurement with a master which is not the primary one.
+ * @param e       Pointer obtained via @ref ensemble_create().
+ * @param master  The identity of the master.
+ * @param req     The transmission time of the Delay_Req message.
+ * @param rx      The corrected reception time from the Delay_Resp message.
+ */
+void ensemble_delay(struct ensemble *e, struct PortIdentity *master,
+		    tmv_t req, tmv_t rx);
+
+/**
+ * Combine the offset measured with the primary master with the recent
+ * offsets of the other masters.
+ * @param e        Pointer obtained via @ref ensemble_create().
+ * @param primary  The identity of the primary master.
+ * @param offset   The offset measured with the primary master.
+ * @param ingress  The local time of the measurement.
+ * @return         The combined offset.
+ */
+tmv_t ensemble_combine(struct ensemble *e, struct PortIdentity *primary,
+		       tmv_t offset, tmv_t ingress);
+
+/**
+ * Set the ratio between the frequency of the local clock and the
+ * frequency of the masters.
+ * @param e   Pointer obtained via @ref ensemble_create().
+ * @param rr  The clock rate ratio.
+ */
+void ensemble_set_clock_rate_ratio(struct ensemble *e, double rr);
+
+/**
+ * Forget the time stamps, e.g. after the local clock was stepped.
+ * @param e  Pointer obtained via @ref ensemble_create().
+ */
+void ensemble_reset(struct ensemble *e);
+
+/**
+ * Get the contribution of a master.
+ * @param e      Pointer obtained via @ref ensemble_create().
+ * @param index  The index of the master, starting from zero.
+ * @param info   Returns the contribution of the master.
+ * @return       Zero on success, non-zero if the index is out of range.
+ */
+int ensemble_get(struct ensemble *e, unsigned int index,
+		 struct ensemble_info *info);
+
+#endif
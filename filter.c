@@ -18,16 +18,25 @@
  */
 
 #include "filter_private.h"
+#include "hmedian.h"
 #include "mave.h"
 #include "mmedian.h"
+#include "mmin.h"
 
-struct filter *filter_create(enum filter_type type, int length)
+struct filter *filter_create(enum filter_type type, int length,
+			     int percentile)
 {
 	switch (type) {
 	case FILTER_MOVING_AVERAGE:
 		return mave_create(length);
 	case FILTER_MOVING_MEDIAN:
 		return mmedian_create(length);
+	case FILTER_MOVING_MEDIAN_HEAP:
+		return hmedian_create(length);
+	case FILTER_MOVING_MINIMUM:
+		return mmin_create(length);
+	case FILTER_PERCENTILE_MEAN:
+		return pmean_create(length, percentile);
 	default:
 		return NULL;
 	}
@@ -43,6 +52,20 @@ tmv_t filter_sample(struct filter *filter, tmv_t sample)
 	return filter->sample(filter, sample);
 }
 
+tmv_t filter_sample_keyed(struct filter *filter, tmv_t key, tmv_t sample)
+{
+	if (!filter->sample_keyed)
+		return filter->sample(filter, sample);
+	return filter->sample_keyed(filter, key, sample);
+}
+
+int filter_selected(struct filter *filter)
+{
+	if (!filter->selected)
+		return 1;
+	return filter->selected(filter);
+}
+
 void filter_reset(struct filter *filter)
 {
 	filter->reset(filter);
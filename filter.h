@@ -31,15 +31,21 @@ struct filter;
 enum filter_type {
 	FILTER_MOVING_AVERAGE,
 	FILTER_MOVING_MEDIAN,
+	FILTER_MOVING_MEDIAN_HEAP,
+	FILTER_MOVING_MINIMUM,
+	FILTER_PERCENTILE_MEAN,
 };
 
 /**
  * Create a new instance of a filter.
- * @param type    The type of the filter to create.
- * @param length  The filter's length.
+ * @param type        The type of the filter to create.
+ * @param length      The filter's length.
+ * @param percentile  The percentage of the samples with the smallest keys
+ *                    averaged by the percentile mean filter.
  * @return A pointer to a new filter on success, NULL otherwise.
  */
-struct filter *filter_create(enum filter_type type, int length);
+struct filter *filter_create(enum filter_type type, int length,
+			     int percentile);
 
 /**
  * Destroy an instance of a filter.
@@ -55,6 +61,28 @@ void filter_destroy(struct filter *filter);
  */
 tmv_t filter_sample(struct filter *filter, tmv_t sample);
 
+/**
+ * Feed a sample with a key into a filter. The moving minimum filter returns
+ * the sample with the smallest key in its window and the percentile mean
+ * filter averages the samples with the smallest keys. The other filters
+ * ignore the key. Feeding a sample without a key is equivalent to using the
+ * sample as its own key.
+ * @param filter    Pointer to a filter obtained via @ref filter_create().
+ * @param key       The key by which the sample is selected.
+ * @param sample    The input sample.
+ * @return The output value.
+ */
+tmv_t filter_sample_keyed(struct filter *filter, tmv_t key, tmv_t sample);
+
+/**
+ * Check whether the last sample fed into a filter is one of the samples
+ * selected by their keys for the output. Filters which don't select samples
+ * always return 1.
+ * @param filter    Pointer to a filter obtained via @ref filter_create().
+ * @return 1 if the last sample is selected, 0 otherwise.
+ */
+int filter_selected(struct filter *filter);
+
 /**
  * Reset a filter.
  * @param filter   Pointer to a filter obtained via @ref filter_create().
@@ -27,6 +27,10 @@ struct filter {
 
 	tmv_t (*sample)(struct filter *filter, tmv_t sample);
 
+	tmv_t (*sample_keyed)(struct filter *filter, tmv_t key, tmv_t sample);
+
+	int (*selected)(struct filter *filter);
+
 	void (*reset)(struct filter *filter);
 };
 
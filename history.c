@@ -0,0 +1,236 @@
+/**
+ * @file history.c
+ * @note Copyright (C) 2026 The linuxptp contributors
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+#include <inttypes.h>
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "history.h"
+
+#define NS_PER_SEC UINT64_C(1000000000)
+#define NS_PER_MIN (60 * NS_PER_SEC)
+
+/* One minute of raw samples at the given rate, one hour of seconds, one
+   day of minutes. */
+#define RAW_SECONDS 60
+#define RAW_MIN_LEN 64
+#define SECOND_LEN 3600
+#define MINUTE_LEN 1440
+
+struct ring {
+	struct history_record *rec;
+	unsigned int len;
+	unsigned int head; /* index of the next record to be written */
+	unsigned int cnt;
+};
+
+/* Aggregate under construction. */
+struct bucket {
+	uint64_t period;
+	uint64_t time;
+	unsigned int count;
+	unsigned int delay_count;
+	double offset_sum;
+	double freq_sum;
+	double delay_sum;
+	int64_t offset_min;
+	int64_t offset_max;
+};
+
+struct history {
+	struct ring ring[HISTORY_RESOLUTION_CNT];
+	struct bucket bucket[HISTORY_RESOLUTION_CNT];
+};
+
+static const char *resolution_str[HISTORY_RESOLUTION_CNT] = {
+	"raw",
+	"second",
+	"minute",
+};
+
+static const uint64_t period_ns[HISTORY_RESOLUTION_CNT] = {
+	0,
+	NS_PER_SEC,
+	NS_PER_MIN,
+};
+
+static void ring_push(struct ring *r, struct history_record *rec)
+{
+	r->rec[r->head] = *rec;
+	r->head = (r->head + 1) % r->len;
+	if (r->cnt < r->len)
+		r->cnt++;
+}
+
+static void bucket_add(struct bucket *b, struct history_record *rec)
+{
+	if (!b->count) {
+		b->time = rec->time;
+		b->offset_min = rec->offset_min;
+		b->offset_max = rec->offset_max;
+	} else {
+		if (b->offset_min > rec->offset_min)
+			b->offset_min = rec->offset_min;
+		if (b->offset_max < rec->offset_max)
+			b->offset_max = rec->offset_max;
+	}
+	b->count += rec->count;
+	b->offset_sum += (double) rec->offset * rec->count;
+	b->freq_sum += rec->freq * rec->count;
+	if (rec->delay >= 0) {
+		b->delay_sum += (double) rec->delay * rec->count;
+		b->delay_count += rec->count;
+	}
+}
+
+static void bucket_to_record(struct bucket *b, struct history_record *rec)
+{
+	rec->time = b->time;
+	rec->offset = b->offset_sum / b->count;
+	rec->offset_min = b->offset_min;
+	rec->offset_max = b->offset_max;
+	rec->delay = b->delay_count ? b->delay_sum / b->delay_count : -1;
+	rec->freq = b->freq_sum / b->count;
+	rec->count = b->count;
+}
+
+/*
+ * Feed a record into the bucket of the given resolution. When the
+ * record belongs to a new period, the finished bucket is stored in
+ * the ring and passed on to the next coarser resolution.
+ */
+static void history_fold(struct history *h, int res,
+			 struct history_record *rec)
+{
+	struct bucket *b = &h->bucket[res];
+	struct history_record agg;
+	uint64_t period = rec->time / period_ns[res];
+
+	if (b->count && b->period != period) {
+		bucket_to_record(b, &agg);
+		ring_push(&h->ring[res], &agg);
+		if (res + 1 < HISTORY_RESOLUTION_CNT)
+			history_fold(h, res + 1, &agg);
+		memset(b, 0, sizeof(*b));
+	}
+	b->period = period;
+	bucket_add(b, rec);
+}
+
+struct history *history_create(double rate)
+{
+	unsigned int len[HISTORY_RESOLUTION_CNT] = {
+		RAW_MIN_LEN, SECOND_LEN, MINUTE_LEN,
+	};
+	struct history *h;
+	int i;
+
+	if (rate * RAW_SECONDS > RAW_MIN_LEN)
+		len[HISTORY_RAW] = ceil(rate * RAW_SECONDS);
+
+	h = calloc(1, sizeof(*h));
+	if (!h)
+		return NULL;
+
+	for (i = 0; i < HISTORY_RESOLUTION_CNT; i++) {
+		h->ring[i].rec = calloc(len[i], sizeof(*h->ring[i].rec));
+		if (!h->ring[i].rec) {
+			history_destroy(h);
+			return NULL;
+		}
+		h->ring[i].len = len[i];
+	}
+	return h;
+}
+
+void history_destroy(struct history *h)
+{
+	int i;
+
+	for (i = 0; i < HISTORY_RESOLUTION_CNT; i++)
+		free(h->ring[i].rec);
+	free(h);
+}
+
+void history_sample(struct history *h, uint64_t ts, int64_t offset,
+		    double freq, int64_t delay)
+{
+	struct history_record rec;
+
+	rec.time = ts;
+	rec.offset = offset;
+	rec.offset_min = offset;
+	rec.offset_max = offset;
+	rec.delay = delay < 0 ? -1 : delay;
+	rec.freq = freq;
+	rec.count = 1;
+
+	ring_push(&h->ring[HISTORY_RAW], &rec);
+	history_fold(h, HISTORY_SECOND, &rec);
+}
+
+unsigned int history_count(struct history *h, enum history_resolution res)
+{
+	if (res >= HISTORY_RESOLUTION_CNT)
+		return 0;
+	return h->ring[res].cnt;
+}
+
+int history_get(struct history *h, enum history_resolution res,
+		unsigned int age, struct history_record *rec)
+{
+	struct ring *r;
+
+	if (res >= HISTORY_RESOLUTION_CNT)
+		return -1;
+	r = &h->ring[res];
+	if (age >= r->cnt)
+		return -1;
+	*rec = r->rec[(r->head + r->len - 1 - age) % r->len];
+	return 0;
+}
+
+void history_dump(struct history *h, const char *label, FILE *fp)
+{
+	struct history_record rec;
+	unsigned int age;
+	int res;
+
+	for (res = 0; res < HISTORY_RESOLUTION_CNT; res++) {
+		for (age = history_count(h, res); age > 0; age--) {
+			history_get(h, res, age - 1, &rec);
+			fprintf(fp, "%s %s %" PRIu64 ".%09" PRIu64
+				" offset %9" PRId64 " min %9" PRId64
+				" max %9" PRId64 " freq %+9.0f"
+				" delay %6" PRId64 " count %u\n",
+				label, resolution_str[res],
+				rec.time / NS_PER_SEC, rec.time % NS_PER_SEC,
+				rec.offset, rec.offset_min, rec.offset_max,
+				rec.freq, rec.delay, rec.count);
+		}
+	}
+	fflush(fp);
+}
+
+const char *history_resolution_str(enum history_resolution res)
+{
+	if (res >= HISTORY_RESOLUTION_CNT)
+		return "unknown";
+	return resolution_str[res];
+}
@@ -0,0 +1,113 @@
+/**
+ * @file history.h
+ * @brief Implements a multi-resolution history of servo samples.
+ * @note Copyright (C) 2026 The linuxptp contributors
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+#ifndef HAVE_HISTORY_H
+#define HAVE_HISTORY_H
+
+#include <stdint.h>
+#include <stdio.h>
+
+/** Opaque type */
+struct history;
+
+/**
+ * Defines the resolutions kept in the history.
+ */
+enum history_resolution {
+	HISTORY_RAW,	/* every sample */
+	HISTORY_SECOND,	/* one second aggregates */
+	HISTORY_MINUTE,	/* one minute aggregates */
+	HISTORY_RESOLUTION_CNT,
+};
+
+/**
+ * One entry of the history. For raw samples the count is one and the
+ * minimum and maximum offsets are equal to the offset.
+ */
+struct history_record {
+	uint64_t time;       /* CLOCK_MONOTONIC nanoseconds of the first sample */
+	int64_t offset;      /* mean offset in nanoseconds */
+	int64_t offset_min;
+	int64_t offset_max;
+	int64_t delay;       /* mean delay in nanoseconds, -1 if unknown */
+	double freq;         /* mean frequency adjustment in ppb */
+	unsigned int count;  /* number of samples in the entry */
+};
+
+/**
+ * Create a new history. All of the storage is allocated up front.
+ * @param rate  The expected number of samples per second. The raw samples
+ *              are kept for one minute at this rate, i.e. for a shorter
+ *              time if the samples come faster.
+ * @return A pointer to a new history on success, NULL otherwise.
+ */
+struct history *history_create(double rate);
+
+/**
+ * Destroy a history.
+ * @param h  Pointer to a history obtained via @ref history_create().
+ */
+void history_destroy(struct history *h);
+
+/**
+ * Add a servo sample to the history.
+ * @param h       Pointer to a history obtained via @ref history_create().
+ * @param ts      The CLOCK_MONOTONIC time of the sample in nanoseconds.
+ * @param offset  The measured offset in nanoseconds.
+ * @param freq    The frequency adjustment in ppb.
+ * @param delay   The measured delay in nanoseconds, negative if unknown.
+ */
+void history_sample(struct history *h, uint64_t ts, int64_t offset,
+		    double freq, int64_t delay);
+
+/**
+ * Obtain the number of records stored at a given resolution.
+ * @param h    Pointer to a history obtained via @ref history_create().
+ * @param res  The resolution of interest.
+ * @return     The number of available records.
+ */
+unsigned int history_count(struct history *h, enum history_resolution res);
+
+/**
+ * Read one record from the history.
+ * @param h    Pointer to a history obtained via @ref history_create().
+ * @param res  The resolution of interest.
+ * @param age  Index of the record, zero being the newest one.
+ * @param rec  Returns the record.
+ * @return     Zero on success, non-zero if no such record exists.
+ */
+int history_get(struct history *h, enum history_resolution res,
+		unsigned int age, struct history_record *rec);
+
+/**
+ * Write all of the records in a human readable form.
+ * @param h      Pointer to a history obtained via @ref history_create().
+ * @param label  Name printed in front of every line.
+ * @param fp     The output stream.
+ */
+void history_dump(struct history *h, const char *label, FILE *fp);
+
+/**
+ * Obtain the name of a resolution.
+ * @param res  The resolution of interest.
+ * @return     A static string.
+ */
+const char *history_resolution_str(enum history_resolution res);
+
+#endif
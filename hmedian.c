@@ -0,0 +1,311 @@
+/**
+ * @file hmedian.c
+ * @brief Moving median and percentile mean filters using two indexed heaps.
+ * @note Copyright (C) 2026 The linuxptp contributors
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+#include <stdlib.h>
+
+#include "hmedian.h"
+#include "filter_private.h"
+
+/*
+ * The lower part of the window is kept in a max-heap and the upper part
+ * in a min-heap, so the median is at the top of the heaps. The heaps
+ * hold indices of the circular buffer of samples and every slot of the
+ * buffer knows its position in the heaps, so the oldest sample can be
+ * replaced in place in O(log n) time.
+ *
+ * The percentile mean filter orders the samples by a key and keeps the
+ * requested percentage of them in the lower heap together with the sum
+ * of their values.
+ */
+
+enum { LO, HI };
+
+struct heap {
+	int *slot;
+	int len;
+};
+
+struct hmedian {
+	struct filter filter;
+	int cnt;
+	int len;
+	int index;
+	struct heap heap[2];
+	/* Heap and position of every slot. */
+	int *which;
+	int *pos;
+	/* Keys stored in circular buffer. */
+	tmv_t *samples;
+	/* Values of the percentile mean, NULL for the median. */
+	tmv_t *values;
+	tmv_t sum;
+	int percentile;
+};
+
+/* Returns true if a should be above b in the heap h. */
+static int above(struct hmedian *m, int h, int a, int b)
+{
+	int cmp = tmv_cmp(m->samples[a], m->samples[b]);
+
+	return h == LO ? cmp > 0 : cmp < 0;
+}
+
+static void heap_set(struct hmedian *m, int h, int i, int slot)
+{
+	m->heap[h].slot[i] = slot;
+	m->which[slot] = h;
+	m->pos[slot] = i;
+}
+
+static int heap_up(struct hmedian *m, int h, int i)
+{
+	int *slot = m->heap[h].slot, s = slot[i], parent;
+
+	while (i > 0) {
+		parent = (i - 1) / 2;
+		if (!above(m, h, s, slot[parent]))
+			break;
+		heap_set(m, h, i, slot[parent]);
+		i = parent;
+	}
+	heap_set(m, h, i, s);
+	return i;
+}
+
+static void heap_down(struct hmedian *m, int h, int i)
+{
+	int *slot = m->heap[h].slot, s = slot[i], len = m->heap[h].len;
+	int child;
+
+	while ((child = 2 * i + 1) < len) {
+		if (child + 1 < len &&
+		    above(m, h, slot[child + 1], slot[child]))
+			child++;
+		if (!above(m, h, slot[child], s))
+			break;
+		heap_set(m, h, i, slot[child]);
+		i = child;
+	}
+	heap_set(m, h, i, s);
+}
+
+static void heap_push(struct hmedian *m, int h, int slot)
+{
+	if (m->values && h == LO)
+		m->sum = tmv_add(m->sum, m->values[slot]);
+	heap_set(m, h, m->heap[h].len++, slot);
+	heap_up(m, h, m->heap[h].len - 1);
+}
+
+static int heap_pop(struct hmedian *m, int h)
+{
+	struct heap *heap = &m->heap[h];
+	int top = heap->slot[0];
+
+	if (m->values && h == LO)
+		m->sum = tmv_sub(m->sum, m->values[top]);
+	if (--heap->len) {
+		heap_set(m, h, 0, heap->slot[heap->len]);
+		heap_down(m, h, 0);
+	}
+	return top;
+}
+
+/* Swaps the tops of the heaps if they are out of order. */
+static void heap_order(struct hmedian *m)
+{
+	int lo, hi;
+
+	if (!m->heap[LO].len || !m->heap[HI].len)
+		return;
+	lo = m->heap[LO].slot[0];
+	hi = m->heap[HI].slot[0];
+	if (tmv_cmp(m->samples[lo], m->samples[hi]) <= 0)
+		return;
+	if (m->values)
+		m->sum = tmv_add(m->sum, tmv_sub(m->values[hi], m->values[lo]));
+	heap_set(m, LO, 0, hi);
+	heap_set(m, HI, 0, lo);
+	heap_down(m, LO, 0);
+	heap_down(m, HI, 0);
+}
+
+/* Returns the number of samples which should be in the lower heap. */
+static int lower_length(struct hmedian *m)
+{
+	int n;
+
+	if (!m->values)
+		return (m->cnt + 1) / 2;
+	n = (m->cnt * m->percentile + 99) / 100;
+	return n > 0 ? n : 1;
+}
+
+static void hmedian_destroy(struct filter *filter)
+{
+	struct hmedian *m = container_of(filter, struct hmedian, filter);
+	free(m->heap[LO].slot);
+	free(m->heap[HI].slot);
+	free(m->which);
+	free(m->pos);
+	free(m->samples);
+	free(m->values);
+	free(m);
+}
+
+static void hmedian_insert(struct hmedian *m, tmv_t key, tmv_t value)
+{
+	int h, s = m->index, lo_len;
+
+	if (m->cnt < m->len) {
+		m->samples[s] = key;
+		if (m->values)
+			m->values[s] = value;
+		m->cnt++;
+		if (m->heap[LO].len &&
+		    tmv_cmp(key, m->samples[m->heap[LO].slot[0]]) > 0)
+			heap_push(m, HI, s);
+		else
+			heap_push(m, LO, s);
+		lo_len = lower_length(m);
+		while (m->heap[LO].len > lo_len)
+			heap_push(m, HI, heap_pop(m, LO));
+		while (m->heap[LO].len < lo_len && m->heap[HI].len)
+			heap_push(m, LO, heap_pop(m, HI));
+	} else {
+		/* Replace the oldest sample in its heap. */
+		h = m->which[s];
+		m->samples[s] = key;
+		if (m->values) {
+			if (h == LO) {
+				m->sum = tmv_add(m->sum, tmv_sub(value,
+							m->values[s]));
+			}
+			m->values[s] = value;
+		}
+		heap_down(m, h, heap_up(m, h, m->pos[s]));
+		heap_order(m);
+	}
+
+	m->index = (1 + m->index) % m->len;
+}
+
+static tmv_t hmedian_sample(struct filter *filter, tmv_t sample)
+{
+	struct hmedian *m = container_of(filter, struct hmedian, filter);
+
+	hmedian_insert(m, sample, sample);
+
+	if (m->cnt % 2)
+		return m->samples[m->heap[LO].slot[0]];
+	else
+		return tmv_div(tmv_add(m->samples[m->heap[LO].slot[0]],
+				       m->samples[m->heap[HI].slot[0]]), 2);
+}
+
+static tmv_t pmean_sample_keyed(struct filter *filter, tmv_t key,
+				tmv_t sample)
+{
+	struct hmedian *m = container_of(filter, struct hmedian, filter);
+
+	hmedian_insert(m, key, sample);
+
+	return tmv_div(m->sum, m->heap[LO].len);
+}
+
+static tmv_t pmean_sample(struct filter *filter, tmv_t sample)
+{
+	return pmean_sample_keyed(filter, sample, sample);
+}
+
+static int pmean_selected(struct filter *filter)
+{
+	struct hmedian *m = container_of(filter, struct hmedian, filter);
+
+	if (!m->cnt)
+		return 0;
+	return m->which[(m->index + m->len - 1) % m->len] == LO;
+}
+
+static void hmedian_reset(struct filter *filter)
+{
+	struct hmedian *m = container_of(filter, struct hmedian, filter);
+	m->cnt = 0;
+	m->index = 0;
+	m->heap[LO].len = 0;
+	m->heap[HI].len = 0;
+	m->sum = tmv_zero();
+}
+
+static struct hmedian *hmedian_alloc(int length, int lo_length)
+{
+	struct hmedian *m;
+
+	if (length < 1)
+		return NULL;
+	m = calloc(1, sizeof(*m));
+	if (!m)
+		return NULL;
+	m->filter.destroy = hmedian_destroy;
+	m->filter.reset = hmedian_reset;
+	m->heap[LO].slot = calloc(lo_length, sizeof(int));
+	m->heap[HI].slot = calloc(length, sizeof(int));
+	m->which = calloc(length, sizeof(*m->which));
+	m->pos = calloc(length, sizeof(*m->pos));
+	m->samples = calloc(length, sizeof(*m->samples));
+	if (!m->heap[LO].slot || !m->heap[HI].slot || !m->which ||
+	    !m->pos || !m->samples) {
+		hmedian_destroy(&m->filter);
+		return NULL;
+	}
+	m->len = length;
+	return m;
+}
+
+struct filter *hmedian_create(int length)
+{
+	struct hmedian *m;
+
+	m = hmedian_alloc(length, length / 2 + 1);
+	if (!m)
+		return NULL;
+	m->filter.sample = hmedian_sample;
+	return &m->filter;
+}
+
+struct filter *pmean_create(int length, int percentile)
+{
+	struct hmedian *m;
+
+	if (percentile < 1 || percentile > 100)
+		return NULL;
+	m = hmedian_alloc(length, length);
+	if (!m)
+		return NULL;
+	m->filter.sample = pmean_sample;
+	m->filter.sample_keyed = pmean_sample_keyed;
+	m->filter.selected = pmean_selected;
+	m->values = calloc(length, sizeof(*m->values));
+	if (!m->values) {
+		hmedian_destroy(&m->filter);
+		return NULL;
+	}
+	m->percentile = percentile;
+	return &m->filter;
+}
@@ -0,0 +1,228 @@
+/**
+ * @file holdover.c
+ * @brief Predicts the frequency of a clock which lost its reference.
+ * @note Copyright (C) 2026 The linuxptp contributors
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+#include <math.h>
+#include <stdlib.h>
+
+#include "holdover.h"
+#include "print.h"
+
+/* Length of the intervals over which the samples are averaged */
+#define BUCKET_LEN UINT64_C(16000000000)
+/* Minimum number of intervals needed to fit the frequency */
+#define MIN_BUCKETS 3
+/* Number of standard deviations included in the error bound */
+#define SIGMAS 3.0
+
+/*
+ * The frequency adjustments of the locked servo are averaged over
+ * intervals of 16 seconds. When the holdover starts, a line is fitted to
+ * the averages from the configured window, which gives the frequency at
+ * the start, the ageing of the oscillator and their uncertainties. The
+ * ageing is extrapolated only if it is significant, otherwise it would
+ * just add the noise of the fit to the prediction.
+ */
+
+struct bucket {
+	uint64_t time;	/* CLOCK_MONOTONIC time of the middle */
+	double freq;	/* mean frequency adjustment */
+	double offset2;	/* mean squared offset */
+};
+
+struct holdover {
+	struct bucket *buckets;
+	unsigned int len;
+	unsigned int head;	/* index of the next bucket to be written */
+	unsigned int cnt;
+	/* Interval being accumulated */
+	uint64_t start;
+	double freq_sum;
+	double offset2_sum;
+	unsigned int count;
+	/* Configuration */
+	uint64_t window;
+	double wander;
+	/* Prediction */
+	int active;
+	uint64_t t0;
+	double freq0;
+	double ageing;
+	double freq_err;
+	double ageing_err;
+	double offset_err;
+};
+
+struct holdover *holdover_create(struct config *cfg)
+{
+	struct holdover *h;
+	int window;
+
+	h = calloc(1, sizeof(*h));
+	if (!h)
+		return NULL;
+
+	window = config_get_int(cfg, NULL, "holdover_window");
+	h->window = window * UINT64_C(1000000000);
+	h->len = h->window / BUCKET_LEN;
+	if (h->len < MIN_BUCKETS)
+		h->len = MIN_BUCKETS;
+	h->wander = config_get_double(cfg, NULL, "holdover_wander");
+
+	h->buckets = calloc(h->len, sizeof(*h->buckets));
+	if (!h->buckets) {
+		free(h);
+		return NULL;
+	}
+	return h;
+}
+
+void holdover_destroy(struct holdover *h)
+{
+	free(h->buckets);
+	free(h);
+}
+
+void holdover_sample(struct holdover *h, uint64_t ts, double freq,
+		     int64_t offset)
+{
+	struct bucket *b;
+
+	if (h->count && ts - h->start >= BUCKET_LEN) {
+		b = &h->buckets[h->head];
+		b->time = h->start + BUCKET_LEN / 2;
+		b->freq = h->freq_sum / h->count;
+		b->offset2 = h->offset2_sum / h->count;
+		h->head = (h->head + 1) % h->len;
+		if (h->cnt < h->len)
+			h->cnt++;
+		h->count = 0;
+	}
+	if (!h->count) {
+		h->start = ts;
+		h->freq_sum = 0.0;
+		h->offset2_sum = 0.0;
+	}
+	h->freq_sum += freq;
+	h->offset2_sum += (double) offset * offset;
+	h->count++;
+}
+
+void holdover_reset(struct holdover *h)
+{
+	h->head = 0;
+	h->cnt = 0;
+	h->count = 0;
+}
+
+int holdover_start(struct holdover *h, uint64_t ts)
+{
+	double t, y, st = 0.0, sy = 0.0, stt = 0.0, sty = 0.0, so = 0.0;
+	double a, b, res, sxx, var;
+	struct bucket *bk;
+	unsigned int i, n = 0;
+
+	/* Fit freq = a + b * t with t in seconds relative to the start. */
+	for (i = 0; i < h->cnt; i++) {
+		bk = &h->buckets[(h->head + h->len - 1 - i) % h->len];
+		if (ts - bk->time > h->window)
+			break;
+		t = ((int64_t) (bk->time - ts)) / 1e9;
+		st += t;
+		sy += bk->freq;
+		stt += t * t;
+		sty += t * bk->freq;
+		so += bk->offset2;
+		n++;
+	}
+	if (n < MIN_BUCKETS)
+		return -1;
+
+	sxx = stt - st * st / n;
+	b = (sty - st * sy / n) / sxx;
+	a = (sy - b * st) / n;
+
+	res = 0.0;
+	for (i = 0; i < n; i++) {
+		bk = &h->buckets[(h->head + h->len - 1 - i) % h->len];
+		t = ((int64_t) (bk->time - ts)) / 1e9;
+		y = bk->freq - a - b * t;
+		res += y * y;
+	}
+	var = res / (n - 2);
+
+	h->ageing_err = sqrt(var / sxx);
+	if (fabs(b) > 2.0 * h->ageing_err) {
+		h->freq0 = a;
+		h->ageing = b;
+		h->freq_err = sqrt(var * (1.0 / n + st * st / (n * n) / sxx));
+	} else {
+		/* Use the mean frequency at the middle of the window. */
+		h->freq0 = sy / n;
+		h->ageing = 0.0;
+		h->freq_err = sqrt(var / n) + fabs(b * st / n);
+	}
+	h->offset_err = sqrt(so / n);
+	h->t0 = ts;
+	h->active = 1;
+
+	pr_info("holdover: freq %.3f ppb +/- %.3f ageing %.6f ppb/s "
+		"+/- %.6f rms offset %.0f ns", h->freq0, h->freq_err,
+		h->ageing, h->ageing_err, h->offset_err);
+	return 0;
+}
+
+void holdover_stop(struct holdover *h)
+{
+	h->active = 0;
+	holdover_reset(h);
+}
+
+int holdover_active(struct holdover *h)
+{
+	return h->active;
+}
+
+double holdover_freq(struct holdover *h, uint64_t ts)
+{
+	return h->freq0 + h->ageing * (ts - h->t0) / 1e9;
+}
+
+double holdover_error(struct holdover *h, uint64_t ts)
+{
+	double t = (ts - h->t0) / 1e9;
+
+	return SIGMAS * (h->offset_err + h->freq_err * t) +
+		0.5 * (SIGMAS * h->ageing_err + h->wander) * t * t;
+}
+
+int holdover_accuracy(double error)
+{
+	static const double limits[] = {
+		25.0, 100.0, 250.0, 1e3, 2.5e3, 10e3, 25e3, 100e3, 250e3,
+		1e6, 2.5e6, 10e6, 25e6, 100e6, 250e6, 1e9, 10e9,
+	};
+	unsigned int i;
+
+	/* The accuracies from 25 ns (0x20) to 10 s (0x30) and above. */
+	for (i = 0; i < sizeof(limits) / sizeof(limits[0]); i++) {
+		if (error <= limits[i])
+			return 0x20 + i;
+	}
+	return 0x31;
+}
@@ -0,0 +1,105 @@
+/**
+ * @file holdover.h
+ * @brief Predicts the frequency of a clock which lost its reference.
+ * @note Copyright (C) 2026 The linuxptp contributors
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+#ifndef HAVE_HOLDOVER_H
+#define HAVE_HOLDOVER_H
+
+#include <stdint.h>
+
+#include "config.h"
+
+/** Opaque type */
+struct holdover;
+
+/**
+ * Create a new holdover predictor.
+ * @param cfg  The configuration providing the holdover_* options.
+ * @return     A pointer to a new holdover predictor on success, NULL
+ *             otherwise.
+ */
+struct holdover *holdover_create(struct config *cfg);
+
+/**
+ * Destroy a holdover predictor.
+ * @param h  Pointer obtained via @ref holdover_create().
+ */
+void holdover_destroy(struct holdover *h);
+
+/**
+ * Record the frequency adjustment of a locked servo.
+ * @param h       Pointer obtained via @ref holdover_create().
+ * @param ts      The CLOCK_MONOTONIC time of the sample in nanoseconds.
+ * @param freq    The frequency adjustment in ppb.
+ * @param offset  The measured offset in nanoseconds.
+ */
+void holdover_sample(struct holdover *h, uint64_t ts, double freq,
+		     int64_t offset);
+
+/**
+ * Forget the recorded samples, e.g. when the servo is unlocked.
+ * @param h  Pointer obtained via @ref holdover_create().
+ */
+void holdover_reset(struct holdover *h);
+
+/**
+ * Start the holdover by fitting a line to the recent frequency
+ * adjustments.
+ * @param h   Pointer obtained via @ref holdover_create().
+ * @param ts  The CLOCK_MONOTONIC time of the start in nanoseconds.
+ * @return    Zero on success, non-zero if there are not enough samples.
+ */
+int holdover_start(struct holdover *h, uint64_t ts);
+
+/**
+ * Stop the holdover and forget the recorded samples.
+ * @param h  Pointer obtained via @ref holdover_create().
+ */
+void holdover_stop(struct holdover *h);
+
+/**
+ * Find out whether the holdover is running.
+ * @param h  Pointer obtained via @ref holdover_create().
+ * @return   One if the holdover is running, zero otherwise.
+ */
+int holdover_active(struct holdover *h);
+
+/**
+ * Predict the frequency adjustment during the holdover.
+ * @param h   Pointer obtained via @ref holdover_create().
+ * @param ts  The CLOCK_MONOTONIC time in nanoseconds.
+ * @return    The frequency adjustment in ppb.
+ */
+double holdover_freq(struct holdover *h, uint64_t ts);
+
+/**
+ * Estimate the bound of the time error accumulated during the holdover.
+ * @param h   Pointer obtained via @ref holdover_create().
+ * @param ts  The CLOCK_MONOTONIC time in nanoseconds.
+ * @return    The estimated bound in nanoseconds.
+ */
+double holdover_error(struct holdover *h, uint64_t ts);
+
+/**
+ * Convert a time error bound to the clockAccuracy enumeration.
+ * @param error  The time error bound in nanoseconds.
+ * @return       The smallest clockAccuracy value covering the error.
+ */
+int holdover_accuracy(double error);
+
+#endif
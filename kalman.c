@@ -0,0 +1,329 @@
+/**
+ * @file kalman.c
+ * @brief Implements a clock servo based on a Kalman filter.
+ * @note Copyright (C) 2026 The linuxptp contributors
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+#include <stdlib.h>
+#include <math.h>
+
+#include "config.h"
+#include "kalman.h"
+#include "print.h"
+#include "servo_private.h"
+
+/* Initial measurement noise with hardware and software time stamping */
+#define HWTS_INITIAL_NOISE 1000.0
+#define SWTS_INITIAL_NOISE 100000.0
+/* Smoothing factor of the online estimate of the measurement noise */
+#define NOISE_SMOOTH 0.05
+/* Ratio of the variance to the squared mean absolute deviation (pi / 2) */
+#define MAD_TO_VAR 1.5708
+/* Minimum part of the innovation variance due to the measurement noise */
+#define MIN_NOISE_RATIO 0.25
+/* Minimum measurement noise variance in ns^2 */
+#define MIN_NOISE_VAR 1.0
+/* Maximum innovation in standard deviations */
+#define MAX_INNOVATION 3.0
+/* Number of innovations with the same sign indicating a change */
+#define MAX_RUN 10
+/* Uncertainty of a frequency known from a previous run in ppb */
+#define WARM_FREQ_NOISE 100.0
+/* Minimum weight of a sample */
+#define MIN_WEIGHT 0.01
+
+/*
+ * The state is the offset of the clock x in nanoseconds and the frequency
+ * correction f in ppb, which would make the clock run at the frequency of
+ * the master. Between two samples the offset changes by the difference
+ * between f and the frequency adjustment which was applied to the clock.
+ * The frequency has a random walk, the offset may have an additional
+ * white frequency noise, and the measurements have a white noise, whose
+ * variance is scaled by the inverse of the weight of the sample.
+ */
+struct kalman_servo {
+	struct servo servo;
+	/* State estimate and its covariance */
+	double x;
+	double f;
+	double p[2][2];
+	/* Measurement noise variance in ns^2 */
+	double r;
+	/* Smoothed absolute innovation */
+	double innovation;
+	double noise_samples;
+	/* Consecutive innovations with the same sign, negative if below */
+	int run;
+	uint64_t last_ts;
+	double last_freq;
+	double interval;
+	int count;
+	int warm;
+	/* configuration: */
+	double configured_r;
+	double q_phase;
+	double q_freq;
+	double time_constant;
+};
+
+static void kalman_destroy(struct servo *servo)
+{
+	struct kalman_servo *s = container_of(servo, struct kalman_servo, servo);
+	free(s);
+}
+
+static void kalman_init(struct kalman_servo *s, int64_t offset)
+{
+	s->x = offset;
+	s->f = s->last_freq;
+	s->p[0][0] = s->r;
+	s->p[0][1] = s->p[1][0] = 0.0;
+	if (s->warm)
+		s->p[1][1] = WARM_FREQ_NOISE * WARM_FREQ_NOISE;
+	else
+		s->p[1][1] = s->servo.max_frequency * s->servo.max_frequency;
+}
+
+static enum servo_state kalman_lock(struct kalman_servo *s, int64_t offset)
+{
+	struct servo *servo = &s->servo;
+
+	if ((servo->first_update &&
+	     servo->first_step_threshold &&
+	     servo->first_step_threshold < llabs(offset)) ||
+	    (servo->step_threshold &&
+	     servo->step_threshold < llabs(offset))) {
+		/* The clock will be stepped by the offset. */
+		s->x = 0.0;
+		return SERVO_JUMP;
+	}
+
+	return SERVO_LOCKED;
+}
+
+/* Advances the state by dt seconds with the frequency u applied. */
+static void kalman_predict(struct kalman_servo *s, double dt, double u)
+{
+	double p00 = s->p[0][0], p01 = s->p[0][1], p11 = s->p[1][1];
+
+	s->x += (s->f - u) * dt;
+	s->p[0][0] = p00 + 2.0 * dt * p01 + dt * dt * p11 +
+		s->q_phase * dt + s->q_freq * dt * dt * dt / 3.0;
+	s->p[0][1] = s->p[1][0] = p01 + dt * p11 + s->q_freq * dt * dt / 2.0;
+	s->p[1][1] = p11 + s->q_freq * dt;
+}
+
+static void kalman_update(struct kalman_servo *s, int64_t offset,
+			  double weight, double dt)
+{
+	double k0, k1, v, vc, var, p00 = s->p[0][0], p01 = s->p[0][1];
+
+	v = offset - s->x;
+	var = p00 + s->r / weight;
+
+	/* Limit outliers, which are common with packet delay variation. */
+	vc = v;
+	if (v * v > MAX_INNOVATION * MAX_INNOVATION * var)
+		vc = copysign(MAX_INNOVATION * sqrt(var), v);
+
+	/*
+	 * Estimate the measurement noise from the mean absolute innovation,
+	 * which is less sensitive to outliers than its variance. The first
+	 * innovation depends mostly on the initial frequency and is skipped.
+	 */
+	if (!s->configured_r && s->count > 1) {
+		if (s->noise_samples < 1.0 / NOISE_SMOOTH)
+			s->noise_samples++;
+		s->innovation += (fabs(vc) * sqrt(weight) - s->innovation) /
+			s->noise_samples;
+		var = MAD_TO_VAR * s->innovation * s->innovation;
+		s->r = var - p00 * weight;
+		if (s->r < var * MIN_NOISE_RATIO)
+			s->r = var * MIN_NOISE_RATIO;
+		if (s->r < MIN_NOISE_VAR)
+			s->r = MIN_NOISE_VAR;
+		var = p00 + s->r / weight;
+	}
+
+	/*
+	 * A run of innovations with the same sign is unlikely with a white
+	 * noise. It indicates a change of the frequency faster than the model
+	 * expects or wrong estimates after a transient, which the limitation
+	 * of outliers would otherwise preserve. Increase the uncertainty of
+	 * the state to follow the measurements again.
+	 */
+	if ((v > 0.0) != (s->run > 0))
+		s->run = 0;
+	s->run += v > 0.0 ? 1 : -1;
+	if (abs(s->run) < MAX_RUN) {
+		v = vc;
+	} else {
+		/*
+		 * The offset and the frequency may both be wrong by up to v
+		 * and v / dt, the following samples will tell which one it was.
+		 */
+		p00 = s->p[0][0] += v * v;
+		s->p[1][1] += v * v / (dt * dt);
+		var = p00 + s->r / weight;
+		s->run = 0;
+	}
+
+	k0 = p00 / var;
+	k1 = p01 / var;
+
+	s->x += k0 * v;
+	s->f += k1 * v;
+	s->p[1][1] -= k1 * p01;
+	s->p[0][0] -= k0 * p00;
+	s->p[0][1] = s->p[1][0] = s->p[0][1] - k0 * p01;
+}
+
+static double kalman_sample(struct servo *servo,
+			    int64_t offset,
+			    uint64_t local_ts,
+			    double weight,
+			    enum servo_state *state)
+{
+	struct kalman_servo *s = container_of(servo, struct kalman_servo, servo);
+	double dt, tc, ppb = s->last_freq;
+
+	if (weight < MIN_WEIGHT)
+		weight = MIN_WEIGHT;
+	else if (weight > 1.0)
+		weight = 1.0;
+
+	dt = s->count ? ((int64_t) (local_ts - s->last_ts)) / 1e9 : 0.0;
+	if (s->count && dt <= 0.0) {
+		/* The time stamps went backwards, start again. */
+		s->count = 0;
+	}
+
+	switch (s->count) {
+	case 0:
+		kalman_init(s, offset);
+		*state = SERVO_UNLOCKED;
+		s->count = 1;
+		if (!s->warm)
+			break;
+
+		/* The frequency is known from a previous run. */
+		s->warm = 0;
+		*state = kalman_lock(s, offset);
+		ppb = s->f;
+		s->count = 2;
+		break;
+	case 1:
+		kalman_predict(s, dt, s->last_freq);
+		kalman_update(s, offset, weight, dt);
+
+		if (s->f < -servo->max_frequency)
+			s->f = -servo->max_frequency;
+		else if (s->f > servo->max_frequency)
+			s->f = servo->max_frequency;
+
+		*state = kalman_lock(s, offset);
+		ppb = s->f;
+		s->count = 2;
+		break;
+	case 2:
+		/* Start again after a large offset, like the PI servo. */
+		if (servo->step_threshold &&
+		    servo->step_threshold < llabs(offset)) {
+			*state = SERVO_UNLOCKED;
+			s->count = 0;
+			break;
+		}
+
+		kalman_predict(s, dt, s->last_freq);
+		kalman_update(s, offset, weight, dt);
+
+		/* Correct the estimated offset in the time constant. */
+		tc = s->time_constant > 0.0 ? s->time_constant : s->interval;
+		if (tc < dt)
+			tc = dt;
+		ppb = s->f + s->x / tc;
+		if (ppb < -servo->max_frequency)
+			ppb = -servo->max_frequency;
+		else if (ppb > servo->max_frequency)
+			ppb = servo->max_frequency;
+		*state = SERVO_LOCKED;
+		break;
+	}
+
+	pr_debug("kalman: offset %.0f freq %.0f sdev %.0f %.3f noise %.0f",
+		 s->x, s->f, sqrt(s->p[0][0]), sqrt(s->p[1][1]), sqrt(s->r));
+
+	s->last_ts = local_ts;
+	s->last_freq = ppb;
+	return ppb;
+}
+
+static void kalman_sync_interval(struct servo *servo, double interval)
+{
+	struct kalman_servo *s = container_of(servo, struct kalman_servo, servo);
+
+	s->interval = interval;
+}
+
+static void kalman_reset(struct servo *servo)
+{
+	struct kalman_servo *s = container_of(servo, struct kalman_servo, servo);
+
+	s->count = 0;
+	s->warm = 0;
+}
+
+static void kalman_warm_start(struct servo *servo, double freq)
+{
+	struct kalman_servo *s = container_of(servo, struct kalman_servo, servo);
+
+	s->last_freq = freq;
+	s->warm = 1;
+}
+
+struct servo *kalman_servo_create(struct config *cfg, int fadj, int sw_ts)
+{
+	struct kalman_servo *s;
+	double noise;
+
+	s = calloc(1, sizeof(*s));
+	if (!s)
+		return NULL;
+
+	s->servo.destroy = kalman_destroy;
+	s->servo.sample = kalman_sample;
+	s->servo.sync_interval = kalman_sync_interval;
+	s->servo.reset = kalman_reset;
+	s->servo.warm_start = kalman_warm_start;
+	s->last_freq = fadj;
+	s->interval = 1.0;
+
+	noise = config_get_double(cfg, NULL, "kalman_measurement_noise");
+	s->configured_r = noise * noise;
+	if (!noise)
+		noise = sw_ts ? SWTS_INITIAL_NOISE : HWTS_INITIAL_NOISE;
+	s->r = noise * noise;
+	s->innovation = noise / sqrt(MAD_TO_VAR);
+	s->noise_samples = 1.0;
+
+	noise = config_get_double(cfg, NULL, "kalman_phase_noise");
+	s->q_phase = noise * noise;
+	noise = config_get_double(cfg, NULL, "kalman_frequency_noise");
+	s->q_freq = noise * noise;
+	s->time_constant = config_get_double(cfg, NULL, "kalman_time_constant");
+
+	return &s->servo;
+}
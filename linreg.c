@@ -18,6 +18,7 @@
  * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
  */
 #include <stdlib.h>
+#include <string.h>
 #include <math.h>
 
 #include "linreg.h"
@@ -45,6 +46,22 @@ struct point {
 	double w;
 };
 
+/*
+ * Weighted sums of the points in a window relative to an anchor, which
+ * doesn't move with the reference. The sums are recomputed around the
+ * newest point once per window length to keep the values small and drop
+ * the rounding errors accumulated by removing points.
+ */
+struct sums {
+	struct point anchor;
+	unsigned int updates;
+	double w;
+	double x;
+	double y;
+	double xx;
+	double xy;
+};
+
 struct result {
 	/* Slope and intercept from latest regression */
 	double slope;
@@ -71,6 +88,8 @@ struct linreg_servo {
 	uint64_t last_update;
 	/* Regression results for all sizes */
 	struct result results[MAX_SIZE - MIN_SIZE + 1];
+	/* Sums of the newest points for all sizes */
+	struct sums sums[MAX_SIZE - MIN_SIZE + 1];
 	/* Selected size */
 	unsigned int size;
 	/* Current frequency offset of the clock */
@@ -81,6 +100,8 @@ struct linreg_servo {
 	double frequency_ratio;
 	/* Upcoming leap second */
 	int leap;
+	/* Frequency known from a previous run */
+	int warm;
 };
 
 static void linreg_destroy(struct servo *servo)
@@ -123,26 +144,77 @@ static void update_reference(struct linreg_servo *s, uint64_t local_ts)
 	s->last_update = local_ts;
 }
 
+static void update_sums(struct sums *sums, struct point *p, int sign)
+{
+	double x, y, w;
+
+	x = (int64_t)(p->x - sums->anchor.x);
+	y = (int64_t)(p->y - sums->anchor.y);
+	w = sign * p->w;
+
+	sums->w += w;
+	sums->x += x * w;
+	sums->y += y * w;
+	sums->xx += x * x * w;
+	sums->xy += x * y * w;
+}
+
+static void recompute_sums(struct linreg_servo *s, struct sums *sums,
+			   unsigned int n)
+{
+	unsigned int i;
+
+	memset(sums, 0, sizeof(*sums));
+	sums->anchor = s->points[s->last_point];
+	sums->updates = 1;
+
+	for (i = 0; i < n && i < s->num_points; i++)
+		update_sums(sums, &s->points[(MAX_POINTS + s->last_point - i) %
+					     MAX_POINTS], 1);
+}
+
 static void add_sample(struct linreg_servo *s, int64_t offset, double weight)
 {
+	unsigned int n, size;
+	struct sums *sums;
+	struct point *p;
+
 	s->last_point = (s->last_point + 1) % MAX_POINTS;
+	p = &s->points[s->last_point];
 
-	s->points[s->last_point].x = s->reference.x;
-	s->points[s->last_point].y = s->reference.y - offset;
-	s->points[s->last_point].w = weight;
+	/* Remove the oldest points from the full windows */
+	for (size = MIN_SIZE; size <= MAX_SIZE; size++) {
+		n = 1 << size;
+		if (n > s->num_points)
+			break;
+		update_sums(&s->sums[size - MIN_SIZE],
+			    &s->points[(MAX_POINTS + s->last_point - n) %
+				       MAX_POINTS], -1);
+	}
+
+	p->x = s->reference.x;
+	p->y = s->reference.y - offset;
+	p->w = weight;
 
 	if (s->num_points < MAX_POINTS)
 		s->num_points++;
+
+	for (size = MIN_SIZE; size <= MAX_SIZE; size++) {
+		n = 1 << size;
+		sums = &s->sums[size - MIN_SIZE];
+		if (sums->updates && sums->updates++ < n)
+			update_sums(sums, p, 1);
+		else
+			recompute_sums(s, sums, n);
+	}
 }
 
 static void regress(struct linreg_servo *s)
 {
-	double x, y, y0, e, x_sum, y_sum, xy_sum, x2_sum, w, w_sum;
-	unsigned int i, l, n, size;
+	double x0, y0, e, x_sum, y_sum, xy_sum, x2_sum, w_sum;
+	unsigned int n, size;
 	struct result *res;
-
-	x_sum = 0.0, y_sum = 0.0, xy_sum = 0.0, x2_sum = 0.0; w_sum = 0.0;
-	i = 0;
+	struct sums *sums;
 
 	y0 = (int64_t)(s->points[s->last_point].y - s->reference.y);
 
@@ -167,25 +239,22 @@ static void regress(struct linreg_servo *s)
 			}
 		}
 
-		for (; i < n; i++) {
-			/* Iterate points from newest to oldest */
-			l = (MAX_POINTS + s->last_point - i) % MAX_POINTS;
-
-			x = (int64_t)(s->points[l].x - s->reference.x);
-			y = (int64_t)(s->points[l].y - s->reference.y);
-			w = s->points[l].w;
-
-			x_sum += x * w;
-			y_sum += y * w;
-			xy_sum += x * y * w;
-			x2_sum += x * x * w;
-			w_sum += w;
-		}
+		sums = &s->sums[size - MIN_SIZE];
+		x_sum = sums->x;
+		y_sum = sums->y;
+		xy_sum = sums->xy;
+		x2_sum = sums->xx;
+		w_sum = sums->w;
 
 		/* Get new intercept and slope */
 		res->slope = (xy_sum - x_sum * y_sum / w_sum) /
 				(x2_sum - x_sum * x_sum / w_sum);
 		res->intercept = (y_sum - res->slope * x_sum) / w_sum;
+
+		/* Move the intercept from the anchor to the reference */
+		x0 = (int64_t)(sums->anchor.x - s->reference.x);
+		res->intercept += (int64_t)(sums->anchor.y - s->reference.y) -
+			res->slope * x0;
 	}
 }
 
@@ -213,6 +282,25 @@ static void update_size(struct linreg_servo *s)
 	s->size = best_size;
 }
 
+/*
+ * Samples may be skipped, e.g. by the offset filter. Correct the offset in
+ * the mean interval between the points used in the regression.
+ */
+static double mean_interval(struct linreg_servo *s)
+{
+	unsigned int n = 1 << s->size;
+	struct point *first;
+	double interval;
+
+	if (s->size < MIN_SIZE)
+		return s->update_interval;
+
+	first = &s->points[(MAX_POINTS + s->last_point - n + 1) % MAX_POINTS];
+	interval = (s->points[s->last_point].x - first->x) / 1e9 / (n - 1);
+
+	return interval > s->update_interval ? interval : s->update_interval;
+}
+
 static double linreg_sample(struct servo *servo,
 			    int64_t offset,
 			    uint64_t local_ts,
@@ -220,7 +308,8 @@ static double linreg_sample(struct servo *servo,
 			    enum servo_state *state)
 {
 	struct linreg_servo *s = container_of(servo, struct linreg_servo, servo);
-	struct result *res;
+	struct result *res, warm_res;
+	double interval;
 	int corr_interval;
 
 	/*
@@ -237,14 +326,20 @@ static double linreg_sample(struct servo *servo,
 
 	update_size(s);
 
-	if (s->size < MIN_SIZE) {
+	if (s->size >= MIN_SIZE) {
+		res = &s->results[s->size - MIN_SIZE];
+	} else if (s->warm) {
+		/* Keep the known frequency and correct the offset. */
+		warm_res.slope = 1.0 + s->clock_freq / 1e9;
+		warm_res.intercept = offset;
+		warm_res.err = 0.0;
+		res = &warm_res;
+	} else {
 		/* Not enough points, wait for more */
 		*state = SERVO_UNLOCKED;
 		return -s->clock_freq;
 	}
 
-	res = &s->results[s->size - MIN_SIZE];
-
 	pr_debug("linreg: points %d slope %.9f intercept %.0f err %.0f",
 		 1 << s->size, res->slope, res->intercept, res->err);
 
@@ -273,7 +368,8 @@ static double linreg_sample(struct servo *servo,
 	 * the system clock's maximum adjustment of 10% that's acceptable.
 	 */
 	corr_interval = s->size <= 4 ? 1 : s->size / 2;
-	s->clock_freq += res->intercept / s->update_interval / corr_interval;
+	interval = mean_interval(s);
+	s->clock_freq += res->intercept / interval / corr_interval;
 
 	/* Clamp the frequency to the allowed maximum */
 	if (s->clock_freq > servo->max_frequency)
@@ -300,8 +396,10 @@ static void linreg_reset(struct servo *servo)
 
 	s->num_points = 0;
 	s->last_update = 0;
+	memset(s->sums, 0, sizeof(s->sums));
 	s->size = 0;
 	s->frequency_ratio = 1.0;
+	s->warm = 0;
 
 	for (i = MIN_SIZE; i <= MAX_SIZE; i++) {
 		s->results[i - MIN_SIZE].slope = 0.0;
@@ -309,6 +407,14 @@ static void linreg_reset(struct servo *servo)
 	}
 }
 
+static void linreg_warm_start(struct servo *servo, double freq)
+{
+	struct linreg_servo *s = container_of(servo, struct linreg_servo, servo);
+
+	s->clock_freq = -freq;
+	s->warm = 1;
+}
+
 static double linreg_rate_ratio(struct servo *servo)
 {
 	struct linreg_servo *s = container_of(servo, struct linreg_servo, servo);
@@ -344,9 +450,60 @@ struct servo *linreg_servo_create(int fadj)
 	s->servo.reset = linreg_reset;
 	s->servo.rate_ratio = linreg_rate_ratio;
 	s->servo.leap = linreg_leap;
+	s->servo.warm_start = linreg_warm_start;
 
 	s->clock_freq = -fadj;
 	s->frequency_ratio = 1.0;
 
 	return &s->servo;
 }
+
+/*
+ * Two-pass regression of the newest points relative to the reference, as
+ * the servo computed it before it kept the sums.
+ */
+static void regress_two_pass(struct linreg_servo *s, unsigned int n,
+			     double *slope, double *intercept)
+{
+	double x, y, w, x_sum = 0.0, y_sum = 0.0, xy_sum = 0.0;
+	double x2_sum = 0.0, w_sum = 0.0;
+	unsigned int i, l;
+
+	for (i = 0; i < n; i++) {
+		l = (MAX_POINTS + s->last_point - i) % MAX_POINTS;
+		x = (int64_t)(s->points[l].x - s->reference.x);
+		y = (int64_t)(s->points[l].y - s->reference.y);
+		w = s->points[l].w;
+		x_sum += x * w;
+		y_sum += y * w;
+		xy_sum += x * y * w;
+		x2_sum += x * x * w;
+		w_sum += w;
+	}
+	*slope = (xy_sum - x_sum * y_sum / w_sum) /
+		(x2_sum - x_sum * x_sum / w_sum);
+	*intercept = (y_sum - *slope * x_sum) / w_sum;
+}
+
+void linreg_check(struct servo *servo, double *slope_diff,
+		  double *intercept_diff)
+{
+	struct linreg_servo *s = container_of(servo, struct linreg_servo, servo);
+	double slope, intercept;
+	unsigned int size, n;
+	struct result *res;
+
+	*slope_diff = 0.0;
+	*intercept_diff = 0.0;
+
+	for (size = MIN_SIZE; size <= MAX_SIZE; size++) {
+		n = 1 << size;
+		if (n > s->num_points)
+			break;
+		res = &s->results[size - MIN_SIZE];
+		regress_two_pass(s, n, &slope, &intercept);
+		*slope_diff = fmax(*slope_diff, fabs(res->slope - slope));
+		*intercept_diff = fmax(*intercept_diff,
+				       fabs(res->intercept - intercept));
+	}
+}
@@ -23,4 +23,16 @@
 
 struct servo *linreg_servo_create(int fadj);
 
+/**
+ * Compare the regressions of all sizes, computed from the sums updated with
+ * each sample, with a two-pass regression of the stored points. This is
+ * only used for testing.
+ * @param servo           Pointer to a linreg servo.
+ * @param slope_diff      Set to the maximum difference of the slopes.
+ * @param intercept_diff  Set to the maximum difference of the intercepts
+ *                        in nanoseconds.
+ */
+void linreg_check(struct servo *servo, double *slope_diff,
+		  double *intercept_diff);
+
 #endif
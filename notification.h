@@ -22,6 +22,7 @@
 
 enum notification {
 	NOTIFY_PORT_STATE,
+	NOTIFY_TIME_ERROR,
 };
 
 #endif
@@ -289,7 +289,7 @@ static int nsm_open(struct nsm *nsm, struct config *cfg)
 	}
 	nsm->port_identity.portNumber = 1;
 
-	nsm->tsproc = tsproc_create(TSPROC_RAW, FILTER_MOVING_AVERAGE, 10);
+	nsm->tsproc = tsproc_create(TSPROC_RAW, FILTER_MOVING_AVERAGE, 10, 0);
 	if (!nsm->tsproc) {
 		pr_err("failed to create time stamp processor");
 		goto no_tsproc;
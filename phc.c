@@ -108,3 +108,39 @@ int phc_has_pps(clockid_t clkid)
 		return 0;
 	return caps.pps;
 }
+
+int phc_pin_setfunc(clockid_t clkid, unsigned int pin, unsigned int func,
+		    unsigned int chan)
+{
+	struct ptp_pin_desc desc;
+	int err;
+
+	memset(&desc, 0, sizeof(desc));
+	desc.index = pin;
+	desc.func = func;
+	desc.chan = chan;
+
+	err = ioctl(CLOCKID_TO_FD(clkid), PTP_PIN_SETFUNC, &desc);
+	if (err)
+		perror("PTP_PIN_SETFUNC");
+	return err;
+}
+
+int phc_extts_enable(clockid_t clkid, unsigned int index, int enable)
+{
+	struct ptp_extts_request req;
+	int err;
+
+	memset(&req, 0, sizeof(req));
+	req.index = index;
+	req.flags = enable ? PTP_ENABLE_FEATURE | PTP_RISING_EDGE : 0;
+
+#ifdef PTP_EXTTS_REQUEST2
+	err = ioctl(CLOCKID_TO_FD(clkid), PTP_EXTTS_REQUEST2, &req);
+#else
+	err = ioctl(CLOCKID_TO_FD(clkid), PTP_EXTTS_REQUEST, &req);
+#endif
+	if (err)
+		perror("PTP_EXTTS_REQUEST");
+	return err;
+}
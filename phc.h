@@ -56,4 +56,29 @@ int phc_max_adj(clockid_t clkid);
  */
 int phc_has_pps(clockid_t clkid);
 
+/**
+ * Assigns a function to a programmable pin of a PTP hardware clock device.
+ *
+ * @param clkid A clock ID obtained using phc_open().
+ * @param pin   The index of the pin.
+ * @param func  The function of the pin, e.g. PTP_PF_EXTTS.
+ * @param chan  The channel of the function.
+ *
+ * @return Zero on success, non-zero otherwise.
+ */
+int phc_pin_setfunc(clockid_t clkid, unsigned int pin, unsigned int func,
+		    unsigned int chan);
+
+/**
+ * Enables or disables time stamping of the rising edges on an external
+ * time stamp channel. The events can be read from the clock device.
+ *
+ * @param clkid  A clock ID obtained using phc_open().
+ * @param index  The index of the channel.
+ * @param enable Non-zero to enable the channel, zero to disable it.
+ *
+ * @return Zero on success, non-zero otherwise.
+ */
+int phc_extts_enable(clockid_t clkid, unsigned int index, int enable);
+
 #endif
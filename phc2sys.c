@@ -24,6 +24,7 @@
 #include <limits.h>
 #include <net/if.h>
 #include <poll.h>
+#include <signal.h>
 #include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
@@ -41,6 +42,7 @@
 #include "clockcheck.h"
 #include "ds.h"
 #include "fsm.h"
+#include "history.h"
 #include "missing.h"
 #include "notification.h"
 #include "ntpshm.h"
@@ -56,12 +58,14 @@
 #include "uds.h"
 #include "util.h"
 #include "version.h"
+#include "warmstart.h"
 
 #define KP 0.7
 #define KI 0.3
 #define NS_PER_SEC 1000000000LL
 
 #define PHC_PPS_OFFSET_LIMIT 10000000
+#define EXTTS_EVENTS 16
 #define PMC_UPDATE_INTERVAL (60 * NS_PER_SEC)
 #define PMC_SUBSCRIBE_DURATION 180	/* 3 minutes */
 /* Note that PMC_SUBSCRIBE_DURATION has to be longer than
@@ -75,6 +79,7 @@ struct clock {
 	clockid_t clkid;
 	int phc_index;
 	int sysoff_method;
+	struct sysoff_sampler *sampler;
 	int is_utc;
 	int dest_only;
 	int state;
@@ -89,7 +94,17 @@ struct clock {
 	struct stats *offset_stats;
 	struct stats *freq_stats;
 	struct stats *delay_stats;
+	struct history *history;
 	struct clockcheck *sanity_check;
+	struct warmstart *warm;
+};
+
+struct extts {
+	LIST_ENTRY(extts) list;
+	char *device;
+	unsigned int index;
+	int pin;
+	struct clock *clock;
 };
 
 struct port {
@@ -102,9 +117,11 @@ struct port {
 struct node {
 	unsigned int stats_max_count;
 	int sanity_freq_limit;
+	int servo_history;
 	enum servo_type servo_type;
 	int phc_readings;
 	double phc_interval;
+	double sysoff_rate;
 	int sync_offset;
 	int forced_sync_offset;
 	int utc_offset_traceable;
@@ -117,12 +134,14 @@ struct node {
 	int clock_identity_set;
 	struct ClockIdentity clock_identity;
 	LIST_HEAD(port_head, port) ports;
+	LIST_HEAD(extts_head, extts) extts;
 	LIST_HEAD(clock_head, clock) clocks;
 	LIST_HEAD(dst_clock_head, clock) dst_clocks;
 	struct clock *master;
 };
 
 static struct config *phc2sys_config;
+static volatile sig_atomic_t history_dump_requested;
 
 static int update_pmc(struct node *node, int subscribe);
 static int clock_handle_leap(struct node *node, struct clock *clock,
@@ -171,8 +190,8 @@ static clockid_t clock_open(char *device, int *phc_index)
 
 static struct servo *servo_add(struct node *node, struct clock *clock)
 {
-	double ppb;
-	int max_ppb;
+	double ppb, warm_freq;
+	int max_ppb, warm = 0;
 	struct servo *servo;
 
 	clockadj_init(clock->clkid);
@@ -191,12 +210,22 @@ static struct servo *servo_add(struct node *node, struct clock *clock)
 		}
 	}
 
+	/* The saved frequency is not valid after switching to another PHC. */
+	if (clock->warm && !clock->servo &&
+	    !warmstart_load(clock->warm, max_ppb, &warm_freq)) {
+		ppb = -warm_freq;
+		clockadj_set_freq(clock->clkid, ppb);
+		warm = 1;
+	}
+
 	servo = servo_create(phc2sys_config, node->servo_type,
 			     -ppb, max_ppb, 0);
 	if (!servo) {
 		pr_err("Failed to create servo");
 		return NULL;
 	}
+	if (warm)
+		servo_warm_start(servo, warm_freq);
 
 	servo_sync_interval(servo, node->phc_interval);
 
@@ -208,6 +237,7 @@ static struct clock *clock_add(struct node *node, char *device)
 	struct clock *c;
 	clockid_t clkid = CLOCK_INVALID;
 	int phc_index = -1;
+	char key[64], *name;
 
 	if (device) {
 		clkid = clock_open(device, &phc_index);
@@ -243,6 +273,13 @@ static struct clock *clock_add(struct node *node, char *device)
 			return NULL;
 		}
 	}
+	if (node->servo_history) {
+		c->history = history_create(1.0 / node->phc_interval);
+		if (!c->history) {
+			pr_err("failed to create servo history");
+			return NULL;
+		}
+	}
 	if (node->sanity_freq_limit) {
 		c->sanity_check = clockcheck_create(node->sanity_freq_limit);
 		if (!c->sanity_check) {
@@ -251,6 +288,13 @@ static struct clock *clock_add(struct node *node, char *device)
 		}
 	}
 
+	if (device) {
+		name = strrchr(device, '/');
+		snprintf(key, sizeof(key), "phc2sys-%s",
+			 name ? name + 1 : device);
+		c->warm = warmstart_create(phc2sys_config, key);
+	}
+
 	if (clkid != CLOCK_INVALID)
 		c->servo = servo_add(node, c);
 
@@ -267,12 +311,21 @@ static void clock_cleanup(struct node *node)
 	struct clock *c, *tmp;
 
 	LIST_FOREACH_SAFE(c, &node->clocks, list, tmp) {
+		if (c->sampler) {
+			sysoff_sampler_destroy(c->sampler);
+		}
 		if (c->servo) {
 			servo_destroy(c->servo);
 		}
 		if (c->sanity_check) {
 			clockcheck_destroy(c->sanity_check);
 		}
+		if (c->warm) {
+			warmstart_destroy(c->warm);
+		}
+		if (c->history) {
+			history_destroy(c->history);
+		}
 		if (c->delay_stats) {
 			stats_destroy(c->delay_stats);
 		}
@@ -298,6 +351,109 @@ static void port_cleanup(struct node *node)
 	}
 }
 
+/* Parses 'device:channel[:pin]'. */
+static int extts_add(struct node *node, char *arg)
+{
+	char *chan, *pin, *end;
+	struct extts *e;
+
+	e = calloc(1, sizeof(*e));
+	if (!e) {
+		fprintf(stderr, "failed to allocate memory\n");
+		return -1;
+	}
+	e->device = strdup(arg);
+	e->pin = -1;
+	LIST_INSERT_HEAD(&node->extts, e, list);
+
+	chan = strchr(e->device, ':');
+	if (!chan)
+		goto bad;
+	*chan++ = '\0';
+	pin = strchr(chan, ':');
+	if (pin)
+		*pin++ = '\0';
+	e->index = strtoul(chan, &end, 10);
+	if (!*chan || *end)
+		goto bad;
+	if (pin) {
+		e->pin = strtoul(pin, &end, 10);
+		if (!*pin || *end)
+			goto bad;
+	}
+	return 0;
+bad:
+	fprintf(stderr, "invalid external time stamp input '%s'\n", arg);
+	return -1;
+}
+
+static void extts_cleanup(struct node *node)
+{
+	struct extts *e, *tmp;
+
+	LIST_FOREACH_SAFE(e, &node->extts, list, tmp) {
+		free(e->device);
+		free(e);
+	}
+}
+
+/*
+ * Each external time stamp input adds its PHC as a slave clock. Several
+ * channels may time stamp pulses for the same clock.
+ */
+static int extts_init(struct node *node)
+{
+	struct extts *e, *e2;
+	struct clock *c;
+
+	LIST_FOREACH(e, &node->extts, list) {
+		LIST_FOREACH(e2, &node->extts, list) {
+			if (e2 != e && e2->clock &&
+			    !strcmp(e2->device, e->device))
+				break;
+		}
+		if (e2) {
+			e->clock = e2->clock;
+			continue;
+		}
+		c = clock_add(node, e->device);
+		if (!c)
+			return -1;
+		if (c->clkid == CLOCK_REALTIME) {
+			fprintf(stderr, "%s has no external time stamps\n",
+				e->device);
+			return -1;
+		}
+		c->state = PS_MASTER;
+		LIST_INSERT_HEAD(&node->dst_clocks, c, dst_list);
+		e->clock = c;
+	}
+	return 0;
+}
+
+static int extts_enable(struct node *node, int enable)
+{
+	struct extts *e;
+	int err = 0;
+
+	LIST_FOREACH(e, &node->extts, list) {
+		if (enable && e->pin >= 0 &&
+		    phc_pin_setfunc(e->clock->clkid, e->pin, PTP_PF_EXTTS,
+				    e->index)) {
+			pr_err("%s: cannot assign pin %d to channel %u",
+			       e->device, e->pin, e->index);
+			return -1;
+		}
+		if (phc_extts_enable(e->clock->clkid, e->index, enable)) {
+			pr_err("%s: cannot %s external time stamps on "
+			       "channel %u", e->device,
+			       enable ? "enable" : "disable", e->index);
+			err = -1;
+		}
+	}
+	return err;
+}
+
 static struct port *port_get(struct node *node, unsigned int number)
 {
 	struct port *p;
@@ -593,6 +749,44 @@ static void update_clock_stats(struct clock *clock, unsigned int max_count,
 	stats_reset(clock->delay_stats);
 }
 
+static void update_clock_history(struct clock *clock, int64_t offset,
+				 double freq, int64_t delay)
+{
+	struct timespec now;
+
+	if (clock_gettime(CLOCK_MONOTONIC, &now))
+		return;
+	history_sample(clock->history, now.tv_sec * NS_PER_SEC + now.tv_nsec,
+		       offset, freq, delay);
+}
+
+static void handle_history_signal(int s)
+{
+	history_dump_requested = 1;
+}
+
+static void dump_history(struct node *node)
+{
+	const char *path;
+	struct clock *c;
+	FILE *fp;
+
+	history_dump_requested = 0;
+
+	path = config_get_string(phc2sys_config, NULL, "servo_history_file");
+	fp = fopen(path, "w");
+	if (!fp) {
+		pr_err("failed to open %s: %m", path);
+		return;
+	}
+	LIST_FOREACH(c, &node->clocks, list) {
+		if (c->history)
+			history_dump(c->history, c->device, fp);
+	}
+	fclose(fp);
+	pr_info("servo history written to %s", path);
+}
+
 static void update_clock(struct node *node, struct clock *clock,
 			 int64_t offset, uint64_t ts, int64_t delay)
 {
@@ -610,6 +804,12 @@ static void update_clock(struct node *node, struct clock *clock,
 	ppb = servo_sample(clock->servo, offset, ts, 1.0, &state);
 	clock->servo_state = state;
 
+	if (clock->warm)
+		warmstart_sample(clock->warm, state, ppb, offset);
+
+	if (clock->history)
+		update_clock_history(clock, offset, ppb, delay);
+
 	switch (state) {
 	case SERVO_UNLOCKED:
 		break;
@@ -692,6 +892,8 @@ static int do_pps_loop(struct node *node, struct clock *clock, int fd)
 	}
 
 	while (is_running()) {
+		if (history_dump_requested)
+			dump_history(node);
 		if (!read_pps(fd, &pps_offset, &pps_ts)) {
 			continue;
 		}
@@ -725,6 +927,143 @@ static int do_pps_loop(struct node *node, struct clock *clock, int fd)
 	return 0;
 }
 
+/*
+ * Converts a time stamp of a pulse captured by the slave PHC to the
+ * offset from the start of the second of the master.
+ */
+static int extts_offset(struct node *node, struct clock *clock,
+			uint64_t ts, int64_t *offset)
+{
+	clockid_t src = node->master->clkid;
+	struct timespec tsrc, tdst;
+	int64_t src_ts, rem;
+
+	if (src == CLOCK_INVALID) {
+		*offset = ts % NS_PER_SEC;
+		if (*offset > NS_PER_SEC / 2)
+			*offset -= NS_PER_SEC;
+		return 0;
+	}
+
+	/*
+	 * The master clock is needed only for the whole number of
+	 * seconds, so a single reading of the two clocks is good enough.
+	 */
+	if (clock_gettime(clock->clkid, &tdst) ||
+	    clock_gettime(src, &tsrc)) {
+		pr_err("failed to read clock: %m");
+		return -1;
+	}
+	src_ts = ts - (tdst.tv_sec - tsrc.tv_sec) * NS_PER_SEC -
+		(tdst.tv_nsec - tsrc.tv_nsec);
+
+	rem = src_ts % NS_PER_SEC;
+	if (rem > NS_PER_SEC / 2)
+		rem -= NS_PER_SEC;
+	if (llabs(rem) > PHC_PPS_OFFSET_LIMIT) {
+		pr_warning("%s: pulse is not in sync with master (%+lld ns)",
+			   clock->device, (long long) rem);
+		return -1;
+	}
+	*offset = ts - (src_ts - rem);
+	return 0;
+}
+
+static void extts_event(struct node *node, struct clock *clock,
+			struct ptp_extts_event *ev)
+{
+	struct extts *e;
+	int64_t offset;
+	uint64_t ts;
+
+	LIST_FOREACH(e, &node->extts, list) {
+		if (e->clock == clock && e->index == ev->index)
+			break;
+	}
+	if (!e)
+		return;
+
+	ts = ev->t.sec * NS_PER_SEC + ev->t.nsec;
+	if (extts_offset(node, clock, ts, &offset))
+		return;
+	if (update_pmc(node, 0) < 0)
+		return;
+	update_clock(node, clock, offset, ts, -1);
+}
+
+static int do_extts_loop(struct node *node)
+{
+	struct ptp_extts_event ev[EXTTS_EVENTS];
+	struct pollfd pfd[EXTTS_EVENTS];
+	struct clock *clocks[EXTTS_EVENTS];
+	unsigned int i, j, n = 0, channels;
+	struct extts *e;
+	ssize_t cnt;
+	int r = 0;
+
+	node->master->source_label = "extts";
+	if (node->master->clkid == CLOCK_INVALID)
+		node->sync_offset = 0;
+
+	LIST_FOREACH(e, &node->extts, list) {
+		for (i = 0; i < n; i++) {
+			if (clocks[i] == e->clock)
+				break;
+		}
+		if (i < n)
+			continue;
+		if (n == EXTTS_EVENTS) {
+			pr_err("too many clocks with external time stamps");
+			return -1;
+		}
+		clocks[n] = e->clock;
+		pfd[n].fd = CLOCKID_TO_FD(e->clock->clkid);
+		pfd[n].events = POLLIN | POLLPRI;
+		n++;
+	}
+	/* Each channel is expected to capture one pulse per second. */
+	for (i = 0; i < n; i++) {
+		channels = 0;
+		LIST_FOREACH(e, &node->extts, list) {
+			if (e->clock == clocks[i])
+				channels++;
+		}
+		servo_sync_interval(clocks[i]->servo, 1.0 / channels);
+	}
+
+	if (extts_enable(node, 1)) {
+		extts_enable(node, 0);
+		return -1;
+	}
+
+	while (is_running()) {
+		if (history_dump_requested)
+			dump_history(node);
+		if (poll(pfd, n, 1000) < 0) {
+			if (errno == EINTR)
+				continue;
+			pr_err("poll failed: %m");
+			r = -1;
+			break;
+		}
+		for (i = 0; i < n; i++) {
+			if (!(pfd[i].revents & (POLLIN | POLLPRI)))
+				continue;
+			cnt = read(pfd[i].fd, ev, sizeof(ev));
+			if (cnt < 0) {
+				pr_err("%s: failed to read events: %m",
+				       clocks[i]->device);
+				continue;
+			}
+			for (j = 0; j < cnt / sizeof(ev[0]); j++)
+				extts_event(node, clocks[i], &ev[j]);
+		}
+	}
+
+	extts_enable(node, 0);
+	return r;
+}
+
 static int update_needed(struct clock *c)
 {
 	switch (c->state) {
@@ -742,18 +1081,84 @@ static int update_needed(struct clock *c)
 	return 0;
 }
 
+/*
+ * Returns 1 if the offset of the system clock from the PHC was measured,
+ * 0 if the sampler has no new samples yet and -1 on error. The drift of
+ * the offset is known only with the sampler, otherwise it is 0.
+ */
+static int measure_sysoff(struct node *node, struct clock *c,
+			  int64_t *offset, uint64_t *ts, int64_t *delay,
+			  double *drift)
+{
+	if (node->sysoff_rate > 0.0 && !c->sampler) {
+		c->sampler = sysoff_sampler_create(CLOCKID_TO_FD(c->clkid),
+						   c->sysoff_method,
+						   node->phc_readings,
+						   node->sysoff_rate);
+		if (!c->sampler) {
+			pr_err("failed to start sysoff sampler");
+			return -1;
+		}
+	}
+	if (c->sampler)
+		return sysoff_sampler_get(c->sampler, offset, ts, delay,
+					  drift) ? 0 : 1;
+
+	*drift = 0.0;
+	if (sysoff_measure(CLOCKID_TO_FD(c->clkid), c->sysoff_method,
+			   node->phc_readings, offset, ts, delay) < 0)
+		return -1;
+	return 1;
+}
+
+struct master_reading {
+	int valid;
+	int r;
+	int64_t offset;
+	uint64_t ts;
+	int64_t delay;
+	double drift;
+};
+
+/* Measures the master against the system clock at most once per update. */
+static int master_sysoff(struct node *node, struct master_reading *mr)
+{
+	if (!mr->valid) {
+		mr->r = measure_sysoff(node, node->master, &mr->offset,
+				       &mr->ts, &mr->delay, &mr->drift);
+		mr->valid = 1;
+	}
+	return mr->r;
+}
+
+/* All samplers measure the offset of a PHC from the system clock. */
+static void flush_samplers(struct node *node)
+{
+	struct clock *c;
+
+	LIST_FOREACH(c, &node->clocks, list) {
+		if (c->sampler)
+			sysoff_sampler_flush(c->sampler);
+	}
+}
+
 static int do_loop(struct node *node, int subscriptions)
 {
+	struct clock *clock, *sampled;
+	struct master_reading mr;
 	struct timespec interval;
-	struct clock *clock;
+	int64_t offset, master_offset, delay;
 	uint64_t ts;
-	int64_t offset, delay;
+	double drift;
+	int r;
 
 	interval.tv_sec = node->phc_interval;
 	interval.tv_nsec = (node->phc_interval - interval.tv_sec) * 1e9;
 
 	while (is_running()) {
 		clock_nanosleep(CLOCK_MONOTONIC, 0, &interval, NULL);
+		if (history_dump_requested)
+			dump_history(node);
 		if (update_pmc(node, subscriptions) < 0)
 			continue;
 
@@ -772,6 +1177,7 @@ static int do_loop(struct node *node, int subscriptions)
 		if (!node->master)
 			continue;
 
+		mr.valid = 0;
 		LIST_FOREACH(clock, &node->dst_clocks, dst_list) {
 			if (!update_needed(clock))
 				continue;
@@ -788,24 +1194,60 @@ static int do_loop(struct node *node, int subscriptions)
 				return -1;
 			}
 
+			sampled = NULL;
 			if (clock->clkid == CLOCK_REALTIME &&
 			    node->master->sysoff_method >= 0) {
 				/* use sysoff */
-				if (sysoff_measure(CLOCKID_TO_FD(node->master->clkid),
-						   node->master->sysoff_method,
-						   node->phc_readings,
-						   &offset, &ts, &delay) < 0)
+				sampled = node->master;
+				r = master_sysoff(node, &mr);
+				if (r < 0)
 					return -1;
+				if (!r)
+					continue;
+				offset = mr.offset;
+				ts = mr.ts;
+				delay = mr.delay;
 			} else if (node->master->clkid == CLOCK_REALTIME &&
 				   clock->sysoff_method >= 0) {
 				/* use reversed sysoff */
-				if (sysoff_measure(CLOCKID_TO_FD(clock->clkid),
-						   clock->sysoff_method,
-						   node->phc_readings,
-						   &offset, &ts, &delay) < 0)
+				sampled = clock;
+				r = measure_sysoff(node, sampled, &offset,
+						   &ts, &delay, &drift);
+				if (r < 0)
 					return -1;
+				if (!r)
+					continue;
 				ts += offset;
 				offset = -offset;
+			} else if (node->master->sysoff_method >= 0 &&
+				   clock->sysoff_method >= 0) {
+				/*
+				 * Compose the sysoff of both clocks, the
+				 * reading of the master is shared by all
+				 * slave clocks.
+				 */
+				r = master_sysoff(node, &mr);
+				if (r < 0)
+					return -1;
+				if (!r)
+					continue;
+				sampled = clock;
+				r = measure_sysoff(node, sampled, &offset,
+						   &ts, &delay, &drift);
+				if (r < 0)
+					return -1;
+				if (!r)
+					continue;
+				/*
+				 * The sampler estimates the offsets at
+				 * different times, bring the master's one
+				 * to the time of the slave's.
+				 */
+				master_offset = mr.offset + (int64_t)
+					(mr.drift * (int64_t) (ts - mr.ts));
+				ts -= offset;
+				offset = master_offset - offset;
+				delay += mr.delay;
 			} else {
 				/* use phc */
 				if (!read_phc(node->master->clkid, clock->clkid,
@@ -814,6 +1256,15 @@ static int do_loop(struct node *node, int subscriptions)
 					continue;
 			}
 			update_clock(node, clock, offset, ts, delay);
+			/* samples taken before the adjustment are stale */
+			if (clock->clkid == CLOCK_REALTIME)
+				flush_samplers(node);
+			else if (sampled && sampled->sampler)
+				sysoff_sampler_flush(sampled->sampler);
+			/* the reading of the master is off after a step */
+			if (clock->clkid == CLOCK_REALTIME &&
+			    clock->servo_state == SERVO_JUMP)
+				mr.valid = 0;
 		}
 	}
 	return 0;
@@ -1355,12 +1806,16 @@ static void usage(char *progname)
 		" manual configuration:\n"
 		" -c [dev|name]  slave clock (CLOCK_REALTIME)\n"
 		" -d [dev]       master PPS device\n"
+		" -e [dev:chan[:pin]]\n"
+		"                external time stamp input of a slave PHC\n"
+		"                capturing the PPS of the master, may be repeated\n"
 		" -s [dev|name]  master clock\n"
 		" -O [offset]    slave-master time offset (0)\n"
 		" -w             wait for ptp4l\n"
 		" common options:\n"
 		" -f [file]      configuration file\n"
-		" -E [pi|linreg] clock servo (pi)\n"
+		" -E [pi|linreg|kalman|ntpshm|chronysock]\n"
+		"                clock servo (pi)\n"
 		" -P [kp]        proportional constant (0.7)\n"
 		" -I [ki]        integration constant (0.3)\n"
 		" -S [step]      step threshold (disabled)\n"
@@ -1413,7 +1868,7 @@ int main(int argc, char *argv[])
 	progname = strrchr(argv[0], '/');
 	progname = progname ? 1+progname : argv[0];
 	while (EOF != (c = getopt_long(argc, argv,
-				"arc:d:f:s:E:P:I:S:F:R:N:O:L:M:i:u:wn:xz:l:t:mqvh",
+				"arc:d:e:f:s:E:P:I:S:F:R:N:O:L:M:i:u:wn:xz:l:t:mqvh",
 				opts, &index))) {
 		switch (c) {
 		case 0:
@@ -1438,6 +1893,10 @@ int main(int argc, char *argv[])
 				goto end;
 			}
 			break;
+		case 'e':
+			if (extts_add(&node, optarg))
+				goto end;
+			break;
 		case 'f':
 			config = optarg;
 			break;
@@ -1458,6 +1917,12 @@ int main(int argc, char *argv[])
 			} else if (!strcasecmp(optarg, "ntpshm")) {
 				config_set_int(cfg, "clock_servo",
 					       CLOCK_SERVO_NTPSHM);
+			} else if (!strcasecmp(optarg, "kalman")) {
+				config_set_int(cfg, "clock_servo",
+					       CLOCK_SERVO_KALMAN);
+			} else if (!strcasecmp(optarg, "chronysock")) {
+				config_set_int(cfg, "clock_servo",
+					       CLOCK_SERVO_CHRONYSOCK);
 			} else {
 				fprintf(stderr,
 					"invalid servo name %s\n", optarg);
@@ -1578,12 +2043,18 @@ int main(int argc, char *argv[])
 		return c;
 	}
 
-	if (autocfg && (src_name || dst_name || pps_fd >= 0 || wait_sync || node.forced_sync_offset)) {
+	if (autocfg && (src_name || dst_name || pps_fd >= 0 || wait_sync || node.forced_sync_offset ||
+			!LIST_EMPTY(&node.extts))) {
 		fprintf(stderr,
 			"autoconfiguration cannot be mixed with manual config options.\n");
 		goto bad_usage;
 	}
-	if (!autocfg && pps_fd < 0 && !src_name) {
+	if (!LIST_EMPTY(&node.extts) && (pps_fd >= 0 || dst_name)) {
+		fprintf(stderr,
+			"external time stamps cannot be mixed with -d or -c.\n");
+		goto bad_usage;
+	}
+	if (!autocfg && pps_fd < 0 && !src_name && LIST_EMPTY(&node.extts)) {
 		fprintf(stderr,
 			"autoconfiguration or valid source clock must be selected.\n");
 		goto bad_usage;
@@ -1595,7 +2066,8 @@ int main(int argc, char *argv[])
 		goto bad_usage;
 	}
 
-	if (node.servo_type == CLOCK_SERVO_NTPSHM) {
+	if (node.servo_type == CLOCK_SERVO_NTPSHM ||
+	    node.servo_type == CLOCK_SERVO_CHRONYSOCK) {
 		node.kernel_leap = 0;
 		node.sanity_freq_limit = 0;
 	}
@@ -1605,14 +2077,26 @@ int main(int argc, char *argv[])
 	print_set_verbose(config_get_int(cfg, NULL, "verbose"));
 	print_set_syslog(config_get_int(cfg, NULL, "use_syslog"));
 	print_set_level(config_get_int(cfg, NULL, "logging_level"));
+	if (print_set_async(config_get_int(cfg, NULL, "logging_buffer_size"))) {
+		fprintf(stderr, "failed to start the logging thread\n");
+		goto end;
+	}
 
 	node.servo_type = config_get_int(cfg, NULL, "clock_servo");
-	if (node.servo_type == CLOCK_SERVO_NTPSHM) {
+	if (node.servo_type == CLOCK_SERVO_NTPSHM ||
+	    node.servo_type == CLOCK_SERVO_CHRONYSOCK) {
 		config_set_int(cfg, "kernel_leap", 0);
 		config_set_int(cfg, "sanity_freq_limit", 0);
 	}
 	node.kernel_leap = config_get_int(cfg, NULL, "kernel_leap");
 	node.sanity_freq_limit = config_get_int(cfg, NULL, "sanity_freq_limit");
+	node.servo_history = config_get_int(cfg, NULL, "servo_history");
+	node.sysoff_rate = config_get_double(cfg, NULL, "sysoff_sample_rate");
+	if (node.servo_history &&
+	    SIG_ERR == signal(SIGUSR1, handle_history_signal)) {
+		fprintf(stderr, "cannot handle SIGUSR1\n");
+		goto end;
+	}
 
 	if (autocfg) {
 		if (init_pmc(cfg, &node))
@@ -1633,6 +2117,34 @@ int main(int argc, char *argv[])
 	src->state = PS_SLAVE;
 	node.master = src;
 
+	if (!LIST_EMPTY(&node.extts)) {
+		if (extts_init(&node))
+			goto end;
+		if (wait_sync) {
+			if (init_pmc(cfg, &node))
+				goto end;
+			while (is_running()) {
+				r = run_pmc_wait_sync(&node, 1000);
+				if (r < 0)
+					goto end;
+				if (r > 0)
+					break;
+				pr_notice("Waiting for ptp4l...");
+			}
+			if (!node.forced_sync_offset &&
+			    run_pmc_get_utc_offset(&node, 1000) <= 0) {
+				pr_err("failed to get UTC offset");
+				r = -1;
+				goto end;
+			}
+			if (node.forced_sync_offset ||
+			    src->clkid != CLOCK_REALTIME)
+				close_pmc(&node);
+		}
+		r = do_extts_loop(&node);
+		goto end;
+	}
+
 	dst = clock_add(&node, dst_name ? dst_name : "CLOCK_REALTIME");
 	free(dst_name);
 	if (!dst) {
@@ -1693,10 +2205,14 @@ end:
 		close_pmc(&node);
 	clock_cleanup(&node);
 	port_cleanup(&node);
+	extts_cleanup(&node);
+	print_set_async(0);
 	config_destroy(cfg);
 	msg_cleanup();
 	return r;
 bad_usage:
+	extts_cleanup(&node);
+	print_set_async(0);
 	usage(progname);
 	config_destroy(cfg);
 	return -1;
@@ -17,7 +17,9 @@
  * with this program; if not, write to the Free Software Foundation, Inc.,
  * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
  */
+#include <inttypes.h>
 #include <stdlib.h>
+#include <string.h>
 #include <math.h>
 
 #include "config.h"
@@ -35,6 +37,27 @@
 
 #define FREQ_EST_MARGIN 0.001
 
+/* Number of lags (powers of 2) of the Allan variance in the adaptive mode */
+#define ALLAN_LAGS 9
+#define ALLAN_LEN (2 * (1 << (ALLAN_LAGS - 1)) + 1)
+/* Minimum number of samples averaged in an Allan variance */
+#define ALLAN_MIN_AVG 64
+/* Ratio of the variance to the squared mean absolute value (pi / 2) */
+#define ALLAN_MAD_VAR 1.5708
+/* Lags which need to be estimated before tracking */
+#define ALLAN_MIN_LAGS 5
+
+/* Minimum scale of the gains */
+#define MIN_GAIN_SCALE 0.01
+/* Smoothing factor of the gain scale in the tracking mode */
+#define GAIN_SMOOTH 0.05
+
+/* Offsets in noise deviations to enter and leave the tracking mode */
+#define TRACK_ENTER_SIGMA 3.0
+#define TRACK_ENTER_COUNT 16
+#define TRACK_LEAVE_SIGMA 8.0
+#define TRACK_LEAVE_COUNT 4
+
 struct pi_servo {
 	struct servo servo;
 	int64_t offset[2];
@@ -43,7 +66,29 @@ struct pi_servo {
 	double kp;
 	double ki;
 	double last_freq;
+	/* Mean interval between the updates in s */
+	double mean_interval;
 	int count;
+	int warm;
+	/* adaptive mode: */
+	enum servo_gain_mode mode;
+	double base_kp;
+	double base_ki;
+	double scale;
+	double interval;
+	/* Offsets without the frequency corrections of the servo */
+	double phase[ALLAN_LEN];
+	double correction;
+	uint64_t last_local;
+	int phase_idx;
+	int phase_cnt;
+	/* Mean absolute second differences with lags 1, 2, 4, ... samples */
+	double adiff[ALLAN_LAGS];
+	int adiff_updates[ALLAN_LAGS];
+	int valid_lags;
+	double noise;
+	double wander;
+	int mode_count;
 	/* configuration: */
 	double configured_pi_kp;
 	double configured_pi_ki;
@@ -61,6 +106,157 @@ static void pi_destroy(struct servo *servo)
 	free(s);
 }
 
+static void pi_set_gains(struct pi_servo *s)
+{
+	/* Scale the bandwidth of the loop and keep its damping. */
+	s->kp = s->scale * s->base_kp;
+	s->ki = s->scale * s->scale * s->base_ki;
+}
+
+static void pi_adaptive_reset(struct pi_servo *s)
+{
+	s->phase_cnt = 0;
+	s->correction = 0.0;
+	s->mode_count = 0;
+	if (s->mode == SERVO_GAINS_TRACK) {
+		s->mode = SERVO_GAINS_ACQUIRE;
+		s->scale = 1.0;
+		pi_set_gains(s);
+	}
+}
+
+static double phase_at(struct pi_servo *s, int age)
+{
+	return s->phase[(s->phase_idx + ALLAN_LEN - age) % ALLAN_LEN];
+}
+
+static void pi_estimate_reset(struct pi_servo *s)
+{
+	memset(s->adiff, 0, sizeof(s->adiff));
+	memset(s->adiff_updates, 0, sizeof(s->adiff_updates));
+	s->valid_lags = 0;
+	s->phase_cnt = 0;
+}
+
+/*
+ * Estimates the Allan variance of the phase which the clock would have
+ * without the corrections of the servo at lags of 1 to 256 samples. The
+ * shortest lag gives the white phase noise of the measurements and the
+ * longest valid lag the random walk of the frequency of the oscillator.
+ * The variance is derived from the mean absolute second difference,
+ * assuming a normal distribution, to limit the impact of outliers.
+ */
+static void pi_estimate(struct pi_servo *s, int64_t offset, uint64_t local_ts)
+{
+	double avar, d, tau, x;
+	int i, m, n;
+
+	if (s->phase_cnt) {
+		s->correction += s->last_freq *
+			((int64_t) (local_ts - s->last_local)) / 1e9;
+	}
+	s->last_local = local_ts;
+
+	x = offset + s->correction;
+	s->phase_idx = (s->phase_idx + 1) % ALLAN_LEN;
+	s->phase[s->phase_idx] = x;
+	if (s->phase_cnt < ALLAN_LEN)
+		s->phase_cnt++;
+
+	s->valid_lags = 0;
+	for (i = 0; i < ALLAN_LAGS; i++) {
+		m = 1 << i;
+		if (s->phase_cnt <= 2 * m)
+			break;
+		d = fabs(x - 2.0 * phase_at(s, m) + phase_at(s, 2 * m));
+
+		n = 4 * m > ALLAN_MIN_AVG ? 4 * m : ALLAN_MIN_AVG;
+		if (s->adiff_updates[i] < n)
+			s->adiff_updates[i]++;
+		s->adiff[i] += (d - s->adiff[i]) / s->adiff_updates[i];
+
+		if (s->adiff_updates[i] < 2 * m)
+			break;
+		s->valid_lags = i + 1;
+	}
+	if (!s->valid_lags)
+		return;
+
+	/*
+	 * With a white phase noise n and a random walk frequency noise w,
+	 * the Allan variance is 3 n^2 / tau^2 + w^2 tau / 3.
+	 */
+	s->noise = sqrt(ALLAN_MAD_VAR * s->adiff[0] * s->adiff[0] / 6.0);
+	i = s->valid_lags - 1;
+	tau = (1 << i) * s->interval;
+	avar = ALLAN_MAD_VAR * s->adiff[i] * s->adiff[i] / (2.0 * tau * tau);
+	d = avar - 3.0 * s->noise * s->noise / (tau * tau);
+	s->wander = d > 0.0 ? sqrt(3.0 * d / tau) : 0.0;
+}
+
+/* Switches between the acquisition and tracking gains with hysteresis. */
+static void pi_schedule(struct pi_servo *s, int64_t offset)
+{
+	double target, tau;
+
+	switch (s->mode) {
+	case SERVO_GAINS_ACQUIRE:
+		if (s->valid_lags < ALLAN_MIN_LAGS ||
+		    llabs(offset) > TRACK_ENTER_SIGMA * s->noise) {
+			s->mode_count = 0;
+			return;
+		}
+		if (++s->mode_count < TRACK_ENTER_COUNT)
+			return;
+		s->mode = SERVO_GAINS_TRACK;
+		s->mode_count = 0;
+		pr_info("PI servo: tracking, noise %.1f ns wander %.3f ppb/s^0.5",
+			s->noise, s->wander);
+		break;
+	case SERVO_GAINS_TRACK:
+		if (llabs(offset) <= TRACK_LEAVE_SIGMA * s->noise) {
+			s->mode_count = 0;
+		} else if (++s->mode_count >= TRACK_LEAVE_COUNT) {
+			s->mode = SERVO_GAINS_ACQUIRE;
+			s->mode_count = 0;
+			s->scale = 1.0;
+			pi_set_gains(s);
+			pr_info("PI servo: acquiring, offset %" PRId64, offset);
+			return;
+		}
+		break;
+	default:
+		return;
+	}
+
+	/*
+	 * The time constant of the loop which balances the averaged noise
+	 * n^2 t / tau and the phase error w^2 tau^3 / 3 caused by the wander.
+	 */
+	tau = s->wander ? pow(3.0 * s->noise * s->noise * s->interval /
+			      (s->wander * s->wander), 0.25) : HUGE_VAL;
+	target = 1.0 / (s->base_kp * tau);
+	if (target < MIN_GAIN_SCALE)
+		target = MIN_GAIN_SCALE;
+	else if (target > 1.0)
+		target = 1.0;
+
+	s->scale += GAIN_SMOOTH * (target - s->scale);
+	pi_set_gains(s);
+}
+
+static enum servo_state pi_lock(struct servo *servo, int64_t offset)
+{
+	if ((servo->first_update &&
+	     servo->first_step_threshold &&
+	     servo->first_step_threshold < llabs(offset)) ||
+	    (servo->step_threshold &&
+	     servo->step_threshold < llabs(offset)))
+		return SERVO_JUMP;
+
+	return SERVO_LOCKED;
+}
+
 static double pi_sample(struct servo *servo,
 			int64_t offset,
 			uint64_t local_ts,
@@ -69,14 +265,25 @@ static double pi_sample(struct servo *servo,
 {
 	struct pi_servo *s = container_of(servo, struct pi_servo, servo);
 	double ki_term, ppb = s->last_freq;
-	double freq_est_interval, localdiff;
+	double freq_est_interval, localdiff, interval, kp, ki;
 
 	switch (s->count) {
 	case 0:
 		s->offset[0] = offset;
 		s->local[0] = local_ts;
+		if (s->mode != SERVO_GAINS_FIXED)
+			pi_adaptive_reset(s);
 		*state = SERVO_UNLOCKED;
 		s->count = 1;
+		if (!s->warm)
+			break;
+
+		/* The frequency is known from a previous run. */
+		s->warm = 0;
+		s->local[1] = local_ts;
+		*state = pi_lock(servo, offset);
+		ppb = s->drift;
+		s->count = 2;
 		break;
 	case 1:
 		s->offset[1] = offset;
@@ -110,15 +317,7 @@ static double pi_sample(struct servo *servo,
 		else if (s->drift > servo->max_frequency)
 			s->drift = servo->max_frequency;
 
-		if ((servo->first_update &&
-		     servo->first_step_threshold &&
-		     servo->first_step_threshold < llabs(offset)) ||
-		    (servo->step_threshold &&
-		     servo->step_threshold < llabs(offset)))
-			*state = SERVO_JUMP;
-		else
-			*state = SERVO_LOCKED;
-
+		*state = pi_lock(servo, offset);
 		ppb = s->drift;
 		s->count = 2;
 		break;
@@ -137,8 +336,28 @@ static double pi_sample(struct servo *servo,
 			break;
 		}
 
-		ki_term = s->ki * offset * weight;
-		ppb = s->kp * offset * weight + s->drift + ki_term;
+		if (s->mode != SERVO_GAINS_FIXED) {
+			pi_estimate(s, offset, local_ts);
+			pi_schedule(s, offset);
+		}
+
+		/*
+		 * Updates may be skipped, e.g. by the offset filter. Scale
+		 * the gains to the mean interval between the updates, as the
+		 * correction lasts until the next update.
+		 */
+		interval = (int64_t) (local_ts - s->local[1]) / 1e9;
+		s->local[1] = local_ts;
+		s->mean_interval += (interval - s->mean_interval) / 16.0;
+		kp = s->kp;
+		ki = s->ki;
+		if (s->interval > 0.0 && s->mean_interval > s->interval) {
+			kp *= s->interval / s->mean_interval;
+			ki *= s->interval / s->mean_interval;
+		}
+
+		ki_term = ki * offset * weight;
+		ppb = kp * offset * weight + s->drift + ki_term;
 		if (ppb < -servo->max_frequency) {
 			ppb = -servo->max_frequency;
 		} else if (ppb > servo->max_frequency) {
@@ -158,13 +377,22 @@ static void pi_sync_interval(struct servo *servo, double interval)
 {
 	struct pi_servo *s = container_of(servo, struct pi_servo, servo);
 
-	s->kp = s->configured_pi_kp_scale * pow(interval, s->configured_pi_kp_exponent);
-	if (s->kp > s->configured_pi_kp_norm_max / interval)
-		s->kp = s->configured_pi_kp_norm_max / interval;
+	s->base_kp = s->configured_pi_kp_scale * pow(interval, s->configured_pi_kp_exponent);
+	if (s->base_kp > s->configured_pi_kp_norm_max / interval)
+		s->base_kp = s->configured_pi_kp_norm_max / interval;
 
-	s->ki = s->configured_pi_ki_scale * pow(interval, s->configured_pi_ki_exponent);
-	if (s->ki > s->configured_pi_ki_norm_max / interval)
-		s->ki = s->configured_pi_ki_norm_max / interval;
+	s->base_ki = s->configured_pi_ki_scale * pow(interval, s->configured_pi_ki_exponent);
+	if (s->base_ki > s->configured_pi_ki_norm_max / interval)
+		s->base_ki = s->configured_pi_ki_norm_max / interval;
+
+	if (s->mode != SERVO_GAINS_FIXED && s->interval != interval) {
+		/* The estimates assume a constant interval. */
+		pi_estimate_reset(s);
+	}
+	if (s->interval != interval)
+		s->mean_interval = interval;
+	s->interval = interval;
+	pi_set_gains(s);
 
 	pr_debug("PI servo: sync interval %.3f kp %.3f ki %.6f",
 		 interval, s->kp, s->ki);
@@ -175,6 +403,28 @@ static void pi_reset(struct servo *servo)
 	struct pi_servo *s = container_of(servo, struct pi_servo, servo);
 
 	s->count = 0;
+	s->warm = 0;
+}
+
+static void pi_warm_start(struct servo *servo, double freq)
+{
+	struct pi_servo *s = container_of(servo, struct pi_servo, servo);
+
+	s->drift = freq;
+	s->last_freq = freq;
+	s->warm = 1;
+}
+
+static int pi_gains(struct servo *servo, struct servo_gains *gains)
+{
+	struct pi_servo *s = container_of(servo, struct pi_servo, servo);
+
+	gains->mode = s->mode;
+	gains->kp = s->kp;
+	gains->ki = s->ki;
+	gains->noise = s->mode != SERVO_GAINS_FIXED ? s->noise : 0.0;
+	gains->wander = s->mode != SERVO_GAINS_FIXED ? s->wander : 0.0;
+	return 0;
 }
 
 struct servo *pi_servo_create(struct config *cfg, int fadj, int sw_ts)
@@ -189,10 +439,13 @@ struct servo *pi_servo_create(struct config *cfg, int fadj, int sw_ts)
 	s->servo.sample  = pi_sample;
 	s->servo.sync_interval = pi_sync_interval;
 	s->servo.reset   = pi_reset;
+	s->servo.gains   = pi_gains;
+	s->servo.warm_start = pi_warm_start;
 	s->drift         = fadj;
 	s->last_freq     = fadj;
 	s->kp            = 0.0;
 	s->ki            = 0.0;
+	s->scale         = 1.0;
 	s->configured_pi_kp = config_get_double(cfg, NULL, "pi_proportional_const");
 	s->configured_pi_ki = config_get_double(cfg, NULL, "pi_integral_const");
 	s->configured_pi_kp_scale = config_get_double(cfg, NULL, "pi_proportional_scale");
@@ -206,6 +459,8 @@ struct servo *pi_servo_create(struct config *cfg, int fadj, int sw_ts)
 		config_get_double(cfg, NULL, "pi_integral_exponent");
 	s->configured_pi_ki_norm_max =
 		config_get_double(cfg, NULL, "pi_integral_norm_max");
+	if (config_get_int(cfg, NULL, "pi_adaptive"))
+		s->mode = SERVO_GAINS_ACQUIRE;
 
 	if (s->configured_pi_kp && s->configured_pi_ki) {
 		/* Use the constants as configured by the user without
@@ -28,8 +28,11 @@
 
 #include "ds.h"
 #include "fsm.h"
+#include "history.h"
+#include "notification.h"
 #include "pmc_common.h"
 #include "print.h"
+#include "servo.h"
 #include "tlv.h"
 #include "uds.h"
 #include "util.h"
@@ -53,9 +56,28 @@ static char *bin2str(Octet *data, int len)
 	return bin2str_impl(data, len, buf, sizeof(buf));
 }
 
+static const char *gain_mode2str(UInteger8 mode)
+{
+	switch (mode) {
+	case SERVO_GAINS_FIXED:
+		return "fixed";
+	case SERVO_GAINS_ACQUIRE:
+		return "acquire";
+	case SERVO_GAINS_TRACK:
+		return "track";
+	}
+	return "unknown";
+}
+
+static int event_subscribed(struct subscribe_events_np *sen,
+			    enum notification event)
+{
+	return sen->bitmask[event / 8] & (1 << (event % 8));
+}
+
 static void pmc_show(struct ptp_message *msg, FILE *fp)
 {
-	int action;
+	int action, i;
 	struct TLV *tlv;
 	struct management_tlv *mgt;
 	struct management_tlv_datum *mtd;
@@ -65,6 +87,15 @@ static void pmc_show(struct ptp_message *msg, FILE *fp)
 	struct timePropertiesDS *tp;
 	struct time_status_np *tsn;
 	struct grandmaster_settings_np *gsn;
+	struct servo_history_record_np *shr;
+	struct time_error_window_np *tew;
+	struct subscribe_events_np *sen;
+	struct time_error_stats_np *tes;
+	struct servo_history_np *shn;
+	struct servo_gains_np *sgn;
+	struct ensemble_master_np *em;
+	struct ensemble_np *en;
+	struct trace_np *trn;
 	struct mgmt_clock_description *cd;
 	struct tlv_extra *extra;
 	struct portDS *p;
@@ -292,6 +323,100 @@ static void pmc_show(struct ptp_message *msg, FILE *fp)
 			gsn->time_flags & FREQ_TRACEABLE ? 1 : 0,
 			gsn->time_source);
 		break;
+	case TLV_SUBSCRIBE_EVENTS_NP:
+		sen = (struct subscribe_events_np *) mgt->data;
+		fprintf(fp, "SUBSCRIBE_EVENTS_NP "
+			IFMT "duration          %hu"
+			IFMT "NOTIFY_PORT_STATE %s"
+			IFMT "NOTIFY_TIME_ERROR %s",
+			sen->duration,
+			event_subscribed(sen, NOTIFY_PORT_STATE) ? "on" : "off",
+			event_subscribed(sen, NOTIFY_TIME_ERROR) ? "on" : "off");
+		break;
+	case TLV_TIME_ERROR_STATS_NP:
+		tes = (struct time_error_stats_np *) mgt->data;
+		fprintf(fp, "TIME_ERROR_STATS_NP "
+			IFMT "samples           %" PRIu64
+			IFMT "logSampleInterval %hhd"
+			IFMT "mtieLimit         %" PRId64
+			IFMT "tdevLimit         %.3f"
+			IFMT "window        mtie         tdev",
+			tes->samples, tes->logSampleInterval, tes->mtieLimit,
+			tes->tdevLimit / 65536.0);
+		for (i = 0; i < tes->count; i++) {
+			tew = &tes->window[i];
+			fprintf(fp, IFMT "%6u", tew->window);
+			if (tew->flags & TIME_ERROR_MTIE_VALID)
+				fprintf(fp, " %10" PRId64 "%s", tew->mtie,
+					tew->flags & TIME_ERROR_MTIE_VIOLATION ?
+					"!" : " ");
+			else
+				fprintf(fp, " %10s ", "-");
+			if (tew->flags & TIME_ERROR_TDEV_VALID)
+				fprintf(fp, " %12.3f%s", tew->tdev / 65536.0,
+					tew->flags & TIME_ERROR_TDEV_VIOLATION ?
+					"!" : "");
+			else
+				fprintf(fp, " %12s", "-");
+		}
+		break;
+	case TLV_TRACE_NP:
+		trn = (struct trace_np *) mgt->data;
+		fprintf(fp, "TRACE_NP "
+			IFMT "size    %u"
+			IFMT "written %" PRIu64
+			IFMT "dumped  %u",
+			trn->size, trn->written, trn->dumped);
+		break;
+	case TLV_SERVO_GAINS_NP:
+		sgn = (struct servo_gains_np *) mgt->data;
+		fprintf(fp, "SERVO_GAINS_NP "
+			IFMT "mode   %s"
+			IFMT "kp     %.6f"
+			IFMT "ki     %.6f"
+			IFMT "noise  %.3f"
+			IFMT "wander %.3f",
+			gain_mode2str(sgn->mode),
+			sgn->kp / 4294967296.0, sgn->ki / 4294967296.0,
+			sgn->noise / 65536.0, sgn->wander / 65536.0);
+		break;
+	case TLV_ENSEMBLE_NP:
+		en = (struct ensemble_np *) mgt->data;
+		fprintf(fp, "ENSEMBLE_NP "
+			IFMT "master                    flags weight     offset"
+			"      delay     stddev");
+		for (i = 0; i < en->count; i++) {
+			em = &en->master[i];
+			fprintf(fp, IFMT "%-25s %c%c%c   %6.3f %10" PRId64
+				" %10" PRId64 " %10.1f",
+				pid2str(&em->master),
+				em->flags & ENSEMBLE_PRIMARY ? 'P' : '-',
+				em->flags & ENSEMBLE_LEARNING ? 'L' : '-',
+				em->flags & ENSEMBLE_REJECTED ? 'R' : '-',
+				em->weight / 65536.0, em->offset, em->delay,
+				em->stddev / 65536.0);
+		}
+		break;
+	case TLV_SERVO_HISTORY_NP:
+		shn = (struct servo_history_np *) mgt->data;
+		fprintf(fp, "SERVO_HISTORY_NP "
+			IFMT "resolution %s"
+			IFMT "total      %u"
+			IFMT "start      %u"
+			IFMT "count      %hu",
+			history_resolution_str(shn->resolution),
+			shn->total, shn->start, shn->count);
+		for (i = 0; i < shn->count; i++) {
+			shr = &shn->record[i];
+			fprintf(fp, IFMT "%" PRId64 ".%09" PRId64
+				" offset %9" PRId64 " min %9" PRId64
+				" max %9" PRId64 " freq %+9d delay %6" PRId64
+				" count %u",
+				shr->time / 1000000000, shr->time % 1000000000,
+				shr->offset, shr->offset_min, shr->offset_max,
+				shr->freq, shr->delay, shr->count);
+		}
+		break;
 	case TLV_PORT_DATA_SET:
 		p = (struct portDS *) mgt->data;
 		if (p->portState > PS_SLAVE) {
@@ -21,6 +21,8 @@
 #include <string.h>
 #include <stdlib.h>
 
+#include "history.h"
+#include "notification.h"
 #include "print.h"
 #include "tlv.h"
 #include "transport.h"
@@ -50,8 +52,14 @@
 
 static void do_get_action(struct pmc *pmc, int action, int index, char *str);
 static void do_set_action(struct pmc *pmc, int action, int index, char *str);
+static void do_history_action(struct pmc *pmc, int action, int index,
+			      char *str);
+static void do_trace_action(struct pmc *pmc, int action, int index,
+			    char *str);
 static void not_supported(struct pmc *pmc, int action, int index, char *str);
 static void null_management(struct pmc *pmc, int action, int index, char *str);
+static int pmc_send_data_action(struct pmc *pmc, int action, int id,
+				void *data, int datasize);
 
 static const char *action_string[] = {
 	"GET",
@@ -101,6 +109,12 @@ struct management_id idtab[] = {
 	{ "PRIMARY_DOMAIN", TLV_PRIMARY_DOMAIN, not_supported },
 	{ "TIME_STATUS_NP", TLV_TIME_STATUS_NP, do_get_action },
 	{ "GRANDMASTER_SETTINGS_NP", TLV_GRANDMASTER_SETTINGS_NP, do_set_action },
+	{ "SUBSCRIBE_EVENTS_NP", TLV_SUBSCRIBE_EVENTS_NP, do_set_action },
+	{ "SERVO_HISTORY_NP", TLV_SERVO_HISTORY_NP, do_history_action },
+	{ "TIME_ERROR_STATS_NP", TLV_TIME_ERROR_STATS_NP, do_get_action },
+	{ "TRACE_NP", TLV_TRACE_NP, do_trace_action },
+	{ "SERVO_GAINS_NP", TLV_SERVO_GAINS_NP, do_get_action },
+	{ "ENSEMBLE_NP", TLV_ENSEMBLE_NP, do_get_action },
 /* Port management ID values */
 	{ "NULL_MANAGEMENT", TLV_NULL_MANAGEMENT, null_management },
 	{ "CLOCK_DESCRIPTION", TLV_CLOCK_DESCRIPTION, do_get_action },
@@ -133,8 +147,11 @@ static void do_get_action(struct pmc *pmc, int action, int index, char *str)
 static void do_set_action(struct pmc *pmc, int action, int index, char *str)
 {
 	struct grandmaster_settings_np gsn;
+	struct subscribe_events_np sen;
 	struct management_tlv_datum mtd;
 	struct port_ds_np pnp;
+	char onoff_port_state[4];
+	char onoff_time_error[4];
 	int cnt, code = idtab[index].code;
 	int leap_61, leap_59, utc_off_valid;
 	int ptp_timescale, time_traceable, freq_traceable;
@@ -221,6 +238,80 @@ static void do_set_action(struct pmc *pmc, int action, int index, char *str)
 		}
 		pmc_send_set_action(pmc, code, &pnp, sizeof(pnp));
 		break;
+	case TLV_SUBSCRIBE_EVENTS_NP:
+		memset(&sen, 0, sizeof(sen));
+		cnt = sscanf(str, " %*s %*s "
+			     "duration          %hu "
+			     "NOTIFY_PORT_STATE %3s "
+			     "NOTIFY_TIME_ERROR %3s ",
+			     &sen.duration,
+			     onoff_port_state,
+			     onoff_time_error);
+		if (cnt != 3) {
+			fprintf(stderr, "%s SET needs 3 values\n",
+				idtab[index].name);
+			break;
+		}
+		if (!strcasecmp(onoff_port_state, "on"))
+			sen.bitmask[NOTIFY_PORT_STATE / 8] |=
+				1 << (NOTIFY_PORT_STATE % 8);
+		if (!strcasecmp(onoff_time_error, "on"))
+			sen.bitmask[NOTIFY_TIME_ERROR / 8] |=
+				1 << (NOTIFY_TIME_ERROR % 8);
+		pmc_send_set_action(pmc, code, &sen, sizeof(sen));
+		break;
+	}
+}
+
+static void do_history_action(struct pmc *pmc, int action, int index,
+			      char *str)
+{
+	char res_str[16 + 1] = {0};
+	struct servo_history_np shn;
+	unsigned int start = 0;
+	int cnt;
+
+	if (action != GET) {
+		fprintf(stderr, "%s only allows GET\n", idtab[index].name);
+		return;
+	}
+	memset(&shn, 0, sizeof(shn));
+	cnt = sscanf(str, " %*s %*s %16s %u", res_str, &start);
+	if (cnt >= 1) {
+		for (shn.resolution = 0; shn.resolution < HISTORY_RESOLUTION_CNT;
+		     shn.resolution++) {
+			if (!strcasecmp(res_str,
+					history_resolution_str(shn.resolution)))
+				break;
+		}
+		if (shn.resolution == HISTORY_RESOLUTION_CNT) {
+			fprintf(stderr, "%s GET needs raw, second or minute\n",
+				idtab[index].name);
+			return;
+		}
+	}
+	shn.start = start;
+	pmc_send_data_action(pmc, GET, idtab[index].code, &shn, sizeof(shn));
+}
+
+static void do_trace_action(struct pmc *pmc, int action, int index,
+			    char *str)
+{
+	struct trace_np trn;
+
+	switch (action) {
+	case GET:
+		pmc_send_get_action(pmc, idtab[index].code);
+		break;
+	case COMMAND:
+		memset(&trn, 0, sizeof(trn));
+		pmc_send_data_action(pmc, COMMAND, idtab[index].code,
+				     &trn, sizeof(trn));
+		break;
+	default:
+		fprintf(stderr, "%s only allows GET or COMMAND\n",
+			idtab[index].name);
+		break;
 	}
 }
 
@@ -456,6 +547,24 @@ static int pmc_tlv_datalen(struct pmc *pmc, int id)
 	case TLV_GRANDMASTER_SETTINGS_NP:
 		len += sizeof(struct grandmaster_settings_np);
 		break;
+	case TLV_SUBSCRIBE_EVENTS_NP:
+		len += sizeof(struct subscribe_events_np);
+		break;
+	case TLV_SERVO_HISTORY_NP:
+		len += sizeof(struct servo_history_np);
+		break;
+	case TLV_TIME_ERROR_STATS_NP:
+		len += sizeof(struct time_error_stats_np);
+		break;
+	case TLV_TRACE_NP:
+		len += sizeof(struct trace_np);
+		break;
+	case TLV_SERVO_GAINS_NP:
+		len += sizeof(struct servo_gains_np);
+		break;
+	case TLV_ENSEMBLE_NP:
+		len += sizeof(struct ensemble_np);
+		break;
 	case TLV_NULL_MANAGEMENT:
 		break;
 	case TLV_CLOCK_DESCRIPTION:
@@ -534,13 +643,14 @@ int pmc_send_get_action(struct pmc *pmc, int id)
 	return 0;
 }
 
-int pmc_send_set_action(struct pmc *pmc, int id, void *data, int datasize)
+static int pmc_send_data_action(struct pmc *pmc, int action, int id,
+				void *data, int datasize)
 {
 	struct management_tlv *mgt;
 	struct ptp_message *msg;
 	struct tlv_extra *extra;
 
-	msg = pmc_message(pmc, SET);
+	msg = pmc_message(pmc, action);
 	if (!msg) {
 		return -1;
 	}
@@ -560,6 +670,11 @@ int pmc_send_set_action(struct pmc *pmc, int id, void *data, int datasize)
 	return 0;
 }
 
+int pmc_send_set_action(struct pmc *pmc, int id, void *data, int datasize)
+{
+	return pmc_send_data_action(pmc, SET, id, data, datasize);
+}
+
 struct ptp_message *pmc_recv(struct pmc *pmc)
 {
 	struct ptp_message *msg;
@@ -26,8 +26,10 @@
 #include <net/if.h>
 
 #include "bmc.h"
+#include "capture.h"
 #include "clock.h"
 #include "designated_fsm.h"
+#include "ensemble.h"
 #include "filter.h"
 #include "missing.h"
 #include "msg.h"
@@ -40,6 +42,7 @@
 #include "tc.h"
 #include "tlv.h"
 #include "tmv.h"
+#include "trace.h"
 #include "tsproc.h"
 #include "unicast_client.h"
 #include "unicast_service.h"
@@ -48,6 +51,7 @@
 #define ALLOWED_LOST_RESPONSES 3
 #define ANNOUNCE_SPAN 1
 #define MAX_NEIGHBOR_FREQ_OFFSET 0.0002
+#define STANDBY_MIN_SAMPLES 4
 
 enum syfu_event {
 	SYNC_MISMATCH,
@@ -106,10 +110,44 @@ static int check_source_identity(struct port *p, struct ptp_message *m)
 	if (p->ignore_source_id) {
 		return 0;
 	}
-	master = clock_parent_identity(p->clock);
+	if (p->state == PS_PASSIVE) {
+		/* A hot standby port follows its own best master. */
+		if (!p->best) {
+			return -1;
+		}
+		master = p->best->dataset.sender;
+	} else {
+		master = clock_parent_identity(p->clock);
+	}
 	return pid_eq(&master, &m->header.sourcePortIdentity) ? 0 : -1;
 }
 
+/*
+ * In the ensemble mode, a slave port also measures the unicast masters
+ * which lost the BMCA only on the tie-breaking attributes.
+ */
+static int port_ensemble_member(struct port *p, struct ptp_message *m)
+{
+	struct PortIdentity *src = &m->header.sourcePortIdentity;
+	struct foreign_clock *fc;
+
+	if (!clock_ensemble(p->clock) || !unicast_client_enabled(p) ||
+	    !p->best) {
+		return 0;
+	}
+	if (p->state != PS_SLAVE && p->state != PS_UNCALIBRATED) {
+		return 0;
+	}
+	LIST_FOREACH(fc, &p->foreign_masters, list) {
+		if (fc == p->best || !pid_eq(&fc->dataset.sender, src)) {
+			continue;
+		}
+		return fc->dataset.quality.clockClass ==
+			p->best->dataset.quality.clockClass;
+	}
+	return 0;
+}
+
 static void extract_address(struct ptp_message *m, struct PortAddress *paddr)
 {
 	int len = 0;
@@ -1132,6 +1170,68 @@ static void port_slave_priority_warning(struct port *p)
 	pr_warning("port %hu: defaultDS.priority1 probably misconfigured", n);
 }
 
+static void port_standby_reset(struct port *p)
+{
+	if (!p->standby) {
+		return;
+	}
+	tsproc_reset(p->standby, 1);
+	p->standby_delays = 0;
+	p->standby_syncs = 0;
+}
+
+/*
+ * The measurements of a hot standby port are only valid for the master
+ * which they were made with.
+ */
+static int port_standby_master(struct port *p)
+{
+	if (!p->best) {
+		return -1;
+	}
+	if (!pid_eq(&p->standby_master, &p->best->dataset.sender)) {
+		port_standby_reset(p);
+		p->standby_master = p->best->dataset.sender;
+	}
+	return 0;
+}
+
+static void port_standby_sync(struct port *p, tmv_t ingress, tmv_t origin)
+{
+	if (port_standby_master(p)) {
+		return;
+	}
+	tsproc_set_clock_rate_ratio(p->standby, clock_rate_ratio(p->clock));
+	tsproc_down_ts(p->standby, origin, ingress);
+	if (tsproc_update_offset(p->standby, &p->standby_offset, NULL)) {
+		return;
+	}
+	p->standby_syncs++;
+}
+
+static void port_standby_delay(struct port *p, tmv_t req, tmv_t rx)
+{
+	if (port_standby_master(p)) {
+		return;
+	}
+	tsproc_up_ts(p->standby, req, rx);
+	if (tsproc_update_delay(p->standby, &p->standby_delay)) {
+		return;
+	}
+	p->standby_delays++;
+}
+
+static void port_standby_peer_delay(struct port *p, tmv_t req, tmv_t rx)
+{
+	if (port_standby_master(p)) {
+		return;
+	}
+	tsproc_set_delay(p->standby, p->peer_delay);
+	tsproc_up_ts(p->standby, req, rx);
+	p->standby_delay = p->peer_delay;
+	p->standby_delays++;
+}
+
 static void port_synchronize(struct port *p,
 			     tmv_t ingress_ts,
 			     struct timestamp origin_ts,
@@ -1142,14 +1242,19 @@ static void port_synchronize(struct port *p,
 	tmv_t t1, t1c, t2, c1, c2;
 	struct servo *s;
 
-	port_set_sync_rx_tmo(p);
-
 	t1 = timestamp_to_tmv(origin_ts);
 	t2 = ingress_ts;
 	c1 = correction_to_tmv(correction1);
 	c2 = correction_to_tmv(correction2);
 	t1c = tmv_add(t1, tmv_add(c1, c2));
 
+	if (p->state == PS_PASSIVE) {
+		port_standby_sync(p, t2, t1c);
+		return;
+	}
+
+	port_set_sync_rx_tmo(p);
+
 	s = clock_servo(p->clock);
 	last_state = clock_servo_state(p->clock);
 	state = clock_synchronize(p->clock, t2, t1c);
@@ -1348,24 +1453,10 @@ out:
 	return -1;
 }
 
-int port_delay_request(struct port *p)
+static int port_send_delay_req(struct port *p, struct address *dst)
 {
 	struct ptp_message *msg;
 
-	/* Time to send a new request, forget current pdelay resp and fup */
-	if (p->peer_delay_resp) {
-		msg_put(p->peer_delay_resp);
-		p->peer_delay_resp = NULL;
-	}
-	if (p->peer_delay_fup) {
-		msg_put(p->peer_delay_fup);
-		p->peer_delay_fup = NULL;
-	}
-
-	if (p->delayMechanism == DM_P2P) {
-		return port_pdelay_request(p);
-	}
-
 	msg = msg_allocate();
 	if (!msg) {
 		return -1;
@@ -1383,9 +1474,8 @@ int port_delay_request(struct port *p)
 	msg->header.control            = CTL_DELAY_REQ;
 	msg->header.logMessageInterval = 0x7f;
 
-	if (p->hybrid_e2e) {
-		struct ptp_message *dst = TAILQ_FIRST(&p->best->messages);
-		msg->address = dst->address;
+	if (dst) {
+		msg->address = *dst;
 		msg->header.flagField[0] |= UNICAST;
 	}
 
@@ -1406,6 +1496,57 @@ out:
 	return -1;
 }
 
+/* Measure the delay to the other masters of the ensemble. */
+static void port_ensemble_delay_request(struct port *p)
+{
+	struct unicast_master_address *ucma;
+	struct PortIdentity parent;
+
+	if (!clock_ensemble(p->clock) || !unicast_client_enabled(p)) {
+		return;
+	}
+	if (p->state != PS_SLAVE && p->state != PS_UNCALIBRATED) {
+		return;
+	}
+	parent = clock_parent_identity(p->clock);
+
+	STAILQ_FOREACH(ucma, &p->unicast_master_table->addrs, list) {
+		if (ucma->state != UC_HAVE_SYDY ||
+		    pid_eq(&ucma->portIdentity, &parent)) {
+			continue;
+		}
+		port_send_delay_req(p, &ucma->address);
+	}
+}
+
+int port_delay_request(struct port *p)
+{
+	struct address *dst = NULL;
+
+	/* Time to send a new request, forget current pdelay resp and fup */
+	if (p->peer_delay_resp) {
+		msg_put(p->peer_delay_resp);
+		p->peer_delay_resp = NULL;
+	}
+	if (p->peer_delay_fup) {
+		msg_put(p->peer_delay_fup);
+		p->peer_delay_fup = NULL;
+	}
+
+	if (p->delayMechanism == DM_P2P) {
+		return port_pdelay_request(p);
+	}
+
+	if (p->hybrid_e2e) {
+		dst = &TAILQ_FIRST(&p->best->messages)->address;
+	}
+	if (port_send_delay_req(p, dst)) {
+		return -1;
+	}
+	port_ensemble_delay_request(p);
+	return 0;
+}
+
 int port_tx_announce(struct port *p, struct address *dst)
 {
 	struct timePropertiesDS *tp = clock_time_properties(p->clock);
@@ -1781,6 +1922,8 @@ int port_initialize(struct port *p)
 
 	/* No need to open rtnl socket on UDS port. */
 	if (transport_type(p->trp) != TRANS_UDS) {
+		capture_add_interface(p->iface->name,
+				      transport_type(p->trp), &p->fda);
 		/*
 		 * The delay timer is usually started when the device
 		 * transitions to PS_LISTENING. But, we are skipping the state
@@ -1821,6 +1964,9 @@ static int port_renew_transport(struct port *p)
 	transport_close(p->trp, &p->fda);
 	port_clear_fda(p, FD_FIRST_TIMER);
 	res = transport_open(p->trp, p->iface, &p->fda, p->timestamping);
+	if (!res && transport_type(p->trp) != TRANS_UDS)
+		capture_add_interface(p->iface->name,
+				      transport_type(p->trp), &p->fda);
 	/* Need to call clock_fda_changed even if transport_open failed in
 	 * order to update clock to the now closed descriptors. */
 	clock_fda_changed(p->clock);
@@ -1971,15 +2117,20 @@ void process_delay_resp(struct port *p, struct ptp_message *m)
 	struct delay_resp_msg *rsp = &m->delay_resp;
 	struct ptp_message *req;
 	tmv_t c3, t3, t4, t4c;
+	int member = 0;
 
-	if (p->state != PS_UNCALIBRATED && p->state != PS_SLAVE) {
+	if (p->state != PS_UNCALIBRATED && p->state != PS_SLAVE &&
+	    !(p->state == PS_PASSIVE && p->standby)) {
 		return;
 	}
 	if (!pid_eq(&rsp->requestingPortIdentity, &p->portIdentity)) {
 		return;
 	}
 	if (check_source_identity(p, m)) {
-		return;
+		if (!port_ensemble_member(p, m)) {
+			return;
+		}
+		member = 1;
 	}
 	TAILQ_FOREACH(req, &p->delay_req, list) {
 		if (rsp->hdr.sequenceId == ntohs(req->delay_req.hdr.sequenceId)) {
@@ -1990,13 +2141,26 @@ void process_delay_resp(struct port *p, struct ptp_message *m)
 		return;
 	}
 
-	pr_debug("Received Delay_Resp: correction %"PRId64" ns", correction_to_tmv(m->header.correction).ns);
+	pr_debug("Received Delay_Resp: correction %.3f ns",
+		 tmv_dbl(correction_to_tmv(m->header.correction)));
 	c3 = correction_to_tmv(m->header.correction);
 	t3 = req->hwts.ts;
 	t4 = timestamp_to_tmv(m->ts.pdu);
 	t4c = tmv_sub(t4, c3);
 
-	clock_path_delay(p->clock, t3, t4c);
+	if (member) {
+		ensemble_delay(clock_ensemble(p->clock),
+			       &m->header.sourcePortIdentity, t3, t4c);
+		TAILQ_REMOVE(&p->delay_req, req, list);
+		msg_put(req);
+		return;
+	}
+
+	if (p->state == PS_PASSIVE) {
+		port_standby_delay(p, t3, t4c);
+	} else {
+		clock_path_delay(p->clock, t3, t4c);
+	}
 
 	TAILQ_REMOVE(&p->delay_req, req, list);
 	msg_put(req);
@@ -2031,18 +2195,25 @@ void process_follow_up(struct port *p, struct ptp_message *m)
 	case PS_PRE_MASTER:
 	case PS_MASTER:
 	case PS_GRAND_MASTER:
-	case PS_PASSIVE:
 		return;
+	case PS_PASSIVE:
+		if (!p->standby) {
+			return;
+		}
+		break;
 	case PS_UNCALIBRATED:
 	case PS_SLAVE:
 		break;
 	}
 
 	if (check_source_identity(p, m)) {
+		if (port_ensemble_member(p, m)) {
+			ensemble_follow_up(clock_ensemble(p->clock), m);
+		}
 		return;
 	}
 
-	if (p->follow_up_info) {
+	if (p->follow_up_info && p->state != PS_PASSIVE) {
 		struct follow_up_info_tlv *fui = follow_up_info_extract(m);
 		if (!fui)
 			return;
@@ -2055,7 +2226,8 @@ void process_follow_up(struct port *p, struct ptp_message *m)
 	} else {
 		event = FUP_MISMATCH;
 	}
-	pr_debug("Received Follow_Up: correction %"PRId64" ns", correction_to_tmv(m->header.correction).ns);
+	pr_debug("Received Follow_Up: correction %.3f ns",
+		 tmv_dbl(correction_to_tmv(m->header.correction)));
 	port_syfufsm(p, event, m);
 }
 
@@ -2260,6 +2432,8 @@ calc:
 	if (p->state == PS_UNCALIBRATED || p->state == PS_SLAVE) {
 		clock_peer_delay(p->clock, p->peer_delay, t1, t2,
 				 p->nrate.ratio);
+	} else if (p->state == PS_PASSIVE && p->standby) {
+		port_standby_peer_delay(p, t1, t2);
 	}
 
 	msg_put(p->peer_delay_req);
@@ -2336,24 +2510,33 @@ void process_sync(struct port *p, struct ptp_message *m)
 	case PS_PRE_MASTER:
 	case PS_MASTER:
 	case PS_GRAND_MASTER:
-	case PS_PASSIVE:
 		return;
+	case PS_PASSIVE:
+		if (!p->standby) {
+			return;
+		}
+		break;
 	case PS_UNCALIBRATED:
 	case PS_SLAVE:
 		break;
 	}
 
 	if (check_source_identity(p, m)) {
+		if (port_ensemble_member(p, m)) {
+			m->header.correction += p->asymmetry;
+			ensemble_sync(clock_ensemble(p->clock), m);
+		}
 		return;
 	}
 
-	if (!msg_unicast(m) &&
+	if (p->state != PS_PASSIVE && !msg_unicast(m) &&
 	    m->header.logMessageInterval != p->log_sync_interval) {
 		p->log_sync_interval = m->header.logMessageInterval;
 		clock_sync_interval(p->clock, p->log_sync_interval);
 	}
 
-	pr_debug("Received Sync: correction %"PRId64" ns", correction_to_tmv(m->header.correction).ns);
+	pr_debug("Received Sync: correction %.3f ns",
+		 tmv_dbl(correction_to_tmv(m->header.correction)));
 	m->header.correction += p->asymmetry;
 
 	if (one_step(m)) {
@@ -2389,6 +2572,9 @@ void port_close(struct port *p)
 	unicast_service_cleanup(p);
 	transport_destroy(p->trp);
 	tsproc_destroy(p->tsproc);
+	if (p->standby) {
+		tsproc_destroy(p->standby);
+	}
 	if (p->fault_fd >= 0) {
 		close(p->fault_fd);
 	}
@@ -2466,6 +2652,12 @@ static void port_e2e_transition(struct port *p, enum port_state next)
 		break;
 	case PS_PASSIVE:
 		port_set_announce_tmo(p);
+		if (p->standby) {
+			flush_last_sync(p);
+			flush_delay_req(p);
+			port_standby_reset(p);
+			port_set_delay_tmo(p);
+		}
 		break;
 	case PS_UNCALIBRATED:
 		flush_last_sync(p);
@@ -2511,6 +2703,10 @@ static void port_p2p_transition(struct port *p, enum port_state next)
 		break;
 	case PS_PASSIVE:
 		port_set_announce_tmo(p);
+		if (p->standby) {
+			flush_last_sync(p);
+			port_standby_reset(p);
+		}
 		break;
 	case PS_UNCALIBRATED:
 		flush_last_sync(p);
@@ -2703,7 +2899,9 @@ static enum fsm_event bc_event(struct port *p, int fd_index)
 
 	msg->hwts.type = p->timestamping;
 
+	trace_point(TRACE_RECV_START, portnum(p), TRACE_NO_MSG, 0, fd_index);
 	cnt = transport_recv(p->trp, fd, msg);
+	trace_point(TRACE_RECV_DONE, portnum(p), TRACE_NO_MSG, 0, cnt);
 	if (cnt < 0) {
 		pr_err("port %hu: recv message failed", portnum(p));
 		msg_put(msg);
@@ -2722,6 +2920,8 @@ static enum fsm_event bc_event(struct port *p, int fd_index)
 		msg_put(msg);
 		return EV_NONE;
 	}
+	trace_point(TRACE_POST_RECV, portnum(p), msg_type(msg),
+		    msg->header.sequenceId, 0);
 	if (port_ignore(p, msg)) {
 		msg_put(msg);
 		return EV_NONE;
@@ -3003,6 +3203,29 @@ err:
 	msg_put(msg);
 }
 
+static struct tsproc *port_standby_create(struct config *cfg)
+{
+	struct tsproc *tsp;
+
+	/* The processor is exchanged with the one of the clock. */
+	tsp = tsproc_create(config_get_int(cfg, NULL, "tsproc_mode"),
+			    config_get_int(cfg, NULL, "delay_filter"),
+			    config_get_int(cfg, NULL, "delay_filter_length"),
+			    config_get_int(cfg, NULL, "delay_filter_percentile"));
+	if (!tsp) {
+		return NULL;
+	}
+	if (config_get_int(cfg, NULL, "offset_filter_length") &&
+	    tsproc_set_offset_filter(tsp,
+			config_get_int(cfg, NULL, "offset_filter"),
+			config_get_int(cfg, NULL, "offset_filter_length"),
+			config_get_int(cfg, NULL, "offset_filter_percentile"))) {
+		tsproc_destroy(tsp);
+		return NULL;
+	}
+	return tsp;
+}
+
 struct port *port_open(int phc_index,
 		       enum timestamp_type timestamping,
 		       int number,
@@ -3150,24 +3373,45 @@ struct port *port_open(int phc_index,
 
 	p->tsproc = tsproc_create(config_get_int(cfg, p->name, "tsproc_mode"),
 				  config_get_int(cfg, p->name, "delay_filter"),
-				  config_get_int(cfg, p->name, "delay_filter_length"));
+				  config_get_int(cfg, p->name, "delay_filter_length"),
+				  config_get_int(cfg, p->name, "delay_filter_percentile"));
 	if (!p->tsproc) {
 		pr_err("Failed to create time stamp processor");
 		goto err_transport;
 	}
 	p->nrate.ratio = 1.0;
 
+	if (number && config_get_int(cfg, p->name, "hot_standby")) {
+		if ((type != CLOCK_TYPE_ORDINARY &&
+		     type != CLOCK_TYPE_BOUNDARY) ||
+		    port_is_ieee8021as(p) || p->jbod) {
+			pr_warning("port %d: hot_standby is not supported with "
+				   "this configuration", number);
+		} else {
+			p->standby = port_standby_create(cfg);
+			if (!p->standby) {
+				pr_err("Failed to create hot standby time stamp "
+				       "processor");
+				goto err_tsproc;
+			}
+		}
+	}
+
 	port_clear_fda(p, N_POLLFD);
 	p->fault_fd = -1;
 	if (number) {
 		p->fault_fd = timerfd_create(CLOCK_MONOTONIC, 0);
 		if (p->fault_fd < 0) {
 			pr_err("timerfd_create failed: %m");
-			goto err_tsproc;
+			goto err_standby;
 		}
 	}
 	return p;
 
+err_standby:
+	if (p->standby) {
+		tsproc_destroy(p->standby);
+	}
 err_tsproc:
 	tsproc_destroy(p->tsproc);
 err_transport:
@@ -3177,6 +3421,36 @@ err_port:
 	return NULL;
 }
 
+int port_standby_takeover(struct port *p, struct tsproc **tsp, tmv_t *delay,
+			  double *nrr)
+{
+	struct tsproc *tmp;
+
+	if (!p->standby || p->state != PS_PASSIVE || !p->best ||
+	    !pid_eq(&p->standby_master, &p->best->dataset.sender) ||
+	    p->standby_delays < STANDBY_MIN_SAMPLES ||
+	    p->standby_syncs < STANDBY_MIN_SAMPLES) {
+		return -1;
+	}
+	pr_notice("port %hu: taking over from hot standby, offset %" PRId64
+		  " path delay %" PRId64, portnum(p),
+		  tmv_to_nanoseconds(p->standby_offset),
+		  tmv_to_nanoseconds(p->standby_delay));
+
+	*delay = p->standby_delay;
+	*nrr = p->delayMechanism == DM_P2P ? p->nrate.ratio : 1.0;
+	tmp = p->standby;
+	p->standby = *tsp;
+	*tsp = tmp;
+	port_standby_reset(p);
+	return 0;
+}
+
+void port_clock_stepped(struct port *p)
+{
+	port_standby_reset(p);
+}
+
 enum port_state port_state(struct port *port)
 {
 	return port->state;
@@ -25,6 +25,7 @@
 #include "fsm.h"
 #include "notification.h"
 #include "transport.h"
+#include "tsproc.h"
 
 /* forward declarations */
 struct interface;
@@ -212,6 +213,28 @@ struct port *port_open(int phc_index,
  */
 enum port_state port_state(struct port *port);
 
+/**
+ * Hand over the measurements of a passive hot standby port to the clock.
+ * The time stamp processor of the port is exchanged with the one of the
+ * clock, which is then reset and used for the next standby period.
+ * @param p        A pointer previously obtained via port_open().
+ * @param tsp      The time stamp processor of the clock, replaced by the
+ *                 one of the port on success.
+ * @param delay    Returns the path delay measured by the port.
+ * @param nrr      Returns the neighbor rate ratio of the port.
+ * @return         Zero on success, non-zero if the port has no converged
+ *                 measurements of the master.
+ */
+int port_standby_takeover(struct port *p, struct tsproc **tsp, tmv_t *delay,
+			  double *nrr);
+
+/**
+ * Discard the hot standby measurements of a port after the clock was
+ * stepped, as they were made with the old time of the clock.
+ * @param p        A pointer previously obtained via port_open().
+ */
+void port_clock_stepped(struct port *p);
+
 /**
  * Update a port's current state based on a given event.
  * @param p        A pointer previously obtained via port_open().
@@ -90,6 +90,13 @@ struct port {
 	} seqnum;
 	tmv_t peer_delay;
 	struct tsproc *tsproc;
+	/* hot standby measurements of a passive port */
+	struct tsproc *standby;
+	struct PortIdentity standby_master;
+	tmv_t standby_delay;
+	tmv_t standby_offset;
+	unsigned int standby_delays;
+	unsigned int standby_syncs;
 	int log_sync_interval;
 	struct nrate_estimator nrate;
 	unsigned int pdr_missing;
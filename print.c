@@ -16,8 +16,13 @@
  * with this program; if not, write to the Free Software Foundation, Inc.,
  * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
  */
+#include <errno.h>
+#include <pthread.h>
 #include <stdarg.h>
+#include <inttypes.h>
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
 #include <syslog.h>
 #include <time.h>
 #include <unistd.h>
@@ -30,6 +35,53 @@ static int use_syslog = 1;
 static const char *progname;
 static const char *message_tag;
 
+/*
+ * In the asynchronous mode print() only saves the format pointer, the
+ * time stamp and the raw arguments in a slot of a bounded lock-free
+ * queue (Vyukov's MPMC algorithm, here with a single consumer) and the
+ * writer thread does the formatting and the I/O. Messages which don't
+ * fit in the queue are counted and reported later by the writer.
+ */
+
+#define SLOT_DATA 200
+#define WRITER_IDLE_NS 5000000
+
+enum arg_class {
+	ARG_NONE,
+	ARG_INT,
+	ARG_LONG,
+	ARG_LLONG,
+	ARG_DOUBLE,
+	ARG_LDOUBLE,
+	ARG_PTR,
+	ARG_STR,
+};
+
+struct conv {
+	int len;		/* length of the conversion specification */
+	int stars;		/* number of '*' width and precision args */
+	enum arg_class class;
+};
+
+struct slot {
+	uint64_t seq;
+	struct timespec ts;
+	const char *format;
+	int level;
+	int err;
+	int truncated;
+	unsigned int len;
+	unsigned char data[SLOT_DATA];
+};
+
+static struct slot *ring;
+static unsigned int ring_mask;
+static uint64_t ring_tail;	/* next slot to be claimed by a producer */
+static uint64_t ring_head;	/* next slot to be read by the writer */
+static uint64_t dropped;
+static int writer_stop;
+static pthread_t writer;
+
 void print_set_progname(const char *name)
 {
 	progname = name;
@@ -55,35 +107,420 @@ void print_set_verbose(int value)
 	verbose = value ? 1 : 0;
 }
 
-void print(int level, char const *format, ...)
+static void print_output(int level, struct timespec *ts, const char *buf)
 {
-	struct timespec ts;
-	va_list ap;
-	char buf[1024];
 	FILE *f;
 
-	if (level > print_level)
-		return;
-
-	clock_gettime(CLOCK_MONOTONIC, &ts);
-
-	va_start(ap, format);
-	vsnprintf(buf, sizeof(buf), format, ap);
-	va_end(ap);
-
 	if (verbose) {
 		f = level >= LOG_NOTICE ? stdout : stderr;
 		fprintf(f, "%s[%ld.%03ld]: %s%s%s\n",
 			progname ? progname : "",
-			ts.tv_sec, ts.tv_nsec / 1000000,
+			ts->tv_sec, ts->tv_nsec / 1000000,
 			message_tag ? message_tag : "", message_tag ? " " : "",
 			buf);
 		fflush(f);
 	}
 	if (use_syslog) {
 		syslog(level, "[%ld.%03ld] %s%s%s",
-		       ts.tv_sec, ts.tv_nsec / 1000000,
+		       ts->tv_sec, ts->tv_nsec / 1000000,
 		       message_tag ? message_tag : "", message_tag ? " " : "",
 		       buf);
 	}
 }
+
+/* Parse one conversion specification, p points after the '%'. */
+static void parse_conv(const char *p, struct conv *c)
+{
+	const char *start = p;
+	int longs = 0, ldbl = 0;
+
+	c->stars = 0;
+	c->class = ARG_NONE;
+
+	while (*p && strchr("#0- +'", *p))
+		p++;
+	for (; *p == '*' || (*p >= '0' && *p <= '9') || *p == '.'; p++) {
+		if (*p == '*')
+			c->stars++;
+	}
+	for (; *p && strchr("hlLqjzt", *p); p++) {
+		switch (*p) {
+		case 'l':
+			longs++;
+			break;
+		case 'L':
+			ldbl = 1;
+			break;
+		case 'q':
+			longs = 2;
+			break;
+		case 'j':
+		case 'z':
+		case 't':
+			longs = 1;
+			break;
+		}
+	}
+	switch (*p) {
+	case 'd': case 'i': case 'o': case 'u': case 'x': case 'X':
+		c->class = longs > 1 || ldbl ? ARG_LLONG :
+			longs ? ARG_LONG : ARG_INT;
+		break;
+	case 'c':
+		c->class = ARG_INT;
+		break;
+	case 'e': case 'E': case 'f': case 'F':
+	case 'g': case 'G': case 'a': case 'A':
+		c->class = ldbl ? ARG_LDOUBLE : ARG_DOUBLE;
+		break;
+	case 's':
+		c->class = ARG_STR;
+		break;
+	case 'p':
+		c->class = ARG_PTR;
+		break;
+	}
+	if (*p)
+		p++;
+	c->len = p - start;
+}
+
+static int slot_put(struct slot *s, const void *val, unsigned int size)
+{
+	if (s->len + size > SLOT_DATA) {
+		s->truncated = 1;
+		return -1;
+	}
+	memcpy(s->data + s->len, val, size);
+	s->len += size;
+	return 0;
+}
+
+static int slot_get(struct slot *s, unsigned int *pos, void *val,
+		    unsigned int size)
+{
+	if (*pos + size > s->len)
+		return -1;
+	memcpy(val, s->data + *pos, size);
+	*pos += size;
+	return 0;
+}
+
+static void slot_pack(struct slot *s, va_list ap)
+{
+	const char *p = s->format, *str;
+	unsigned int n;
+	long double ld;
+	long long ll;
+	struct conv c;
+	void *ptr;
+	double d;
+	long l;
+	int i;
+
+	while ((p = strchr(p, '%'))) {
+		parse_conv(++p, &c);
+		p += c.len;
+		while (c.stars--) {
+			i = va_arg(ap, int);
+			if (slot_put(s, &i, sizeof(i)))
+				return;
+		}
+		switch (c.class) {
+		case ARG_NONE:
+			continue;
+		case ARG_INT:
+			i = va_arg(ap, int);
+			if (slot_put(s, &i, sizeof(i)))
+				return;
+			break;
+		case ARG_LONG:
+			l = va_arg(ap, long);
+			if (slot_put(s, &l, sizeof(l)))
+				return;
+			break;
+		case ARG_LLONG:
+			ll = va_arg(ap, long long);
+			if (slot_put(s, &ll, sizeof(ll)))
+				return;
+			break;
+		case ARG_DOUBLE:
+			d = va_arg(ap, double);
+			if (slot_put(s, &d, sizeof(d)))
+				return;
+			break;
+		case ARG_LDOUBLE:
+			ld = va_arg(ap, long double);
+			if (slot_put(s, &ld, sizeof(ld)))
+				return;
+			break;
+		case ARG_PTR:
+			ptr = va_arg(ap, void *);
+			if (slot_put(s, &ptr, sizeof(ptr)))
+				return;
+			break;
+		case ARG_STR:
+			/* The string may not outlive the call, copy it. */
+			str = va_arg(ap, const char *);
+			if (!str)
+				str = "(null)";
+			n = strnlen(str, SLOT_DATA);
+			if (s->len + n + 1 > SLOT_DATA) {
+				n = s->len + 1 < SLOT_DATA ?
+					SLOT_DATA - s->len - 1 : 0;
+				s->truncated = 1;
+			}
+			slot_put(s, str, n);
+			if (slot_put(s, "", 1) || s->truncated)
+				return;
+			break;
+		}
+	}
+}
+
+/* Copy a conversion specification, replacing '*' with the saved values. */
+static int slot_spec(struct slot *s, unsigned int *pos, const char *q,
+		     struct conv *c, char *spec, size_t size)
+{
+	size_t len = 0;
+	int i, star;
+
+	for (i = 0; i <= c->len && len < size - 12; i++) {
+		if (q[i] != '*') {
+			spec[len++] = q[i];
+			continue;
+		}
+		if (slot_get(s, pos, &star, sizeof(star)))
+			return -1;
+		len += sprintf(spec + len, "%d", star);
+	}
+	spec[len] = 0;
+	return i <= c->len ? -1 : 0;
+}
+
+static void slot_format(struct slot *s, char *buf, size_t size)
+{
+	const char *p = s->format, *q;
+	unsigned int pos = 0;
+	size_t len = 0, n;
+	char spec[64];
+	long double ld;
+	struct conv c;
+	long long ll;
+	void *ptr;
+	double d;
+	long l;
+	int i;
+
+	buf[0] = 0;
+	while (1) {
+		q = strchr(p, '%');
+		n = q ? (size_t) (q - p) : strlen(p);
+		if (n > size - 1 - len)
+			n = size - 1 - len;
+		memcpy(buf + len, p, n);
+		len += n;
+		buf[len] = 0;
+		if (!q || len >= size - 1)
+			break;
+
+		parse_conv(q + 1, &c);
+		p = q + 1 + c.len;
+		if (slot_spec(s, &pos, q, &c, spec, sizeof(spec)))
+			goto truncated;
+
+		switch (c.class) {
+		case ARG_NONE:
+			if (q[c.len] == 'm')
+				n = snprintf(buf + len, size - len, "%s",
+					     strerror(s->err));
+			else
+				n = snprintf(buf + len, size - len, "%s",
+					     q[c.len] == '%' ? "%" : "");
+			break;
+		case ARG_INT:
+			if (slot_get(s, &pos, &i, sizeof(i)))
+				goto truncated;
+			n = snprintf(buf + len, size - len, spec, i);
+			break;
+		case ARG_LONG:
+			if (slot_get(s, &pos, &l, sizeof(l)))
+				goto truncated;
+			n = snprintf(buf + len, size - len, spec, l);
+			break;
+		case ARG_LLONG:
+			if (slot_get(s, &pos, &ll, sizeof(ll)))
+				goto truncated;
+			n = snprintf(buf + len, size - len, spec, ll);
+			break;
+		case ARG_DOUBLE:
+			if (slot_get(s, &pos, &d, sizeof(d)))
+				goto truncated;
+			n = snprintf(buf + len, size - len, spec, d);
+			break;
+		case ARG_LDOUBLE:
+			if (slot_get(s, &pos, &ld, sizeof(ld)))
+				goto truncated;
+			n = snprintf(buf + len, size - len, spec, ld);
+			break;
+		case ARG_PTR:
+			if (slot_get(s, &pos, &ptr, sizeof(ptr)))
+				goto truncated;
+			n = snprintf(buf + len, size - len, spec, ptr);
+			break;
+		case ARG_STR:
+			if (pos >= s->len)
+				goto truncated;
+			q = (const char *) s->data + pos;
+			pos += strnlen(q, s->len - pos) + 1;
+			n = snprintf(buf + len, size - len, spec, q);
+			break;
+		default:
+			n = 0;
+			break;
+		}
+		len += n;
+		if (len >= size - 1)
+			return;
+	}
+	if (!s->truncated)
+		return;
+truncated:
+	if (len > size - 4)
+		len = size - 4;
+	snprintf(buf + len, size - len, "...");
+}
+
+static void *writer_thread(void *arg)
+{
+	struct timespec idle = { 0, WRITER_IDLE_NS }, now;
+	uint64_t seq, lost, reported = 0;
+	char buf[1024];
+	struct slot *s;
+
+	while (1) {
+		s = &ring[ring_head & ring_mask];
+		seq = __atomic_load_n(&s->seq, __ATOMIC_ACQUIRE);
+		if (seq != ring_head + 1) {
+			/* Report the losses once the queue is drained. */
+			lost = __atomic_load_n(&dropped, __ATOMIC_RELAXED);
+			if (lost != reported) {
+				clock_gettime(CLOCK_MONOTONIC, &now);
+				snprintf(buf, sizeof(buf),
+					 "dropped %" PRIu64 " log messages",
+					 lost - reported);
+				print_output(LOG_WARNING, &now, buf);
+				reported = lost;
+			}
+			if (__atomic_load_n(&writer_stop, __ATOMIC_ACQUIRE))
+				break;
+			nanosleep(&idle, NULL);
+			continue;
+		}
+		slot_format(s, buf, sizeof(buf));
+		print_output(s->level, &s->ts, buf);
+
+		/* Hand the slot back to the producers. */
+		__atomic_store_n(&s->seq, ring_head + ring_mask + 1,
+				 __ATOMIC_RELEASE);
+		ring_head++;
+	}
+	return NULL;
+}
+
+static int print_async_enqueue(int level, struct timespec *ts, int err,
+			       const char *format, va_list ap)
+{
+	uint64_t pos, seq;
+	struct slot *s;
+	int64_t dif;
+
+	pos = __atomic_load_n(&ring_tail, __ATOMIC_RELAXED);
+	while (1) {
+		s = &ring[pos & ring_mask];
+		seq = __atomic_load_n(&s->seq, __ATOMIC_ACQUIRE);
+		dif = (int64_t) (seq - pos);
+		if (!dif) {
+			if (__atomic_compare_exchange_n(&ring_tail, &pos,
+							pos + 1, 1,
+							__ATOMIC_RELAXED,
+							__ATOMIC_RELAXED))
+				break;
+		} else if (dif < 0) {
+			__atomic_fetch_add(&dropped, 1, __ATOMIC_RELAXED);
+			return -1;
+		} else {
+			pos = __atomic_load_n(&ring_tail, __ATOMIC_RELAXED);
+		}
+	}
+	s->ts = *ts;
+	s->format = format;
+	s->level = level;
+	s->err = err;
+	s->truncated = 0;
+	s->len = 0;
+	slot_pack(s, ap);
+	__atomic_store_n(&s->seq, pos + 1, __ATOMIC_RELEASE);
+	return 0;
+}
+
+int print_set_async(unsigned int size)
+{
+	unsigned int i, len = 1;
+
+	if (ring) {
+		__atomic_store_n(&writer_stop, 1, __ATOMIC_RELEASE);
+		pthread_join(writer, NULL);
+		free(ring);
+		ring = NULL;
+	}
+	if (!size)
+		return 0;
+
+	while (len < size)
+		len <<= 1;
+	ring = calloc(len, sizeof(*ring));
+	if (!ring)
+		return -1;
+	for (i = 0; i < len; i++)
+		ring[i].seq = i;
+	ring_mask = len - 1;
+	ring_head = 0;
+	ring_tail = 0;
+	writer_stop = 0;
+	if (pthread_create(&writer, NULL, writer_thread, NULL)) {
+		free(ring);
+		ring = NULL;
+		return -1;
+	}
+	return 0;
+}
+
+uint64_t print_dropped(void)
+{
+	return __atomic_load_n(&dropped, __ATOMIC_RELAXED);
+}
+
+void print(int level, char const *format, ...)
+{
+	struct timespec ts;
+	va_list ap;
+	char buf[1024];
+	int err = errno;
+
+	if (level > print_level)
+		return;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	va_start(ap, format);
+	if (ring) {
+		print_async_enqueue(level, &ts, err, format, ap);
+		va_end(ap);
+		return;
+	}
+	vsnprintf(buf, sizeof(buf), format, ap);
+	va_end(ap);
+
+	print_output(level, &ts, buf);
+}
@@ -20,6 +20,7 @@
 #ifndef HAVE_PRINT_H
 #define HAVE_PRINT_H
 
+#include <stdint.h>
 #include <syslog.h>
 
 #include "util.h"
@@ -38,6 +39,23 @@ void print_set_syslog(int value);
 void print_set_level(int level);
 void print_set_verbose(int value);
 
+/**
+ * Switch between the synchronous and asynchronous output. In the
+ * asynchronous mode print() only copies the format and the arguments
+ * into a queue and a background thread formats and writes the messages.
+ * The format must then be a string literal, which all callers pass.
+ * @param size  The number of messages in the queue, or zero to flush
+ *              the queue, stop the thread and print synchronously.
+ * @return      Zero on success, non-zero otherwise.
+ */
+int print_set_async(unsigned int size);
+
+/**
+ * Obtain the number of messages which did not fit in the queue.
+ * @return  The number of dropped messages.
+ */
+uint64_t print_dropped(void);
+
 #define pr_emerg(x...)   print(LOG_EMERG, x)
 #define pr_alert(x...)   print(LOG_ALERT, x)
 #define pr_crit(x...)    print(LOG_CRIT, x)
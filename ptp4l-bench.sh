@@ -0,0 +1,336 @@
+#!/bin/sh
+#
+# Benchmark of ptp4l in network namespaces.
+#
+# Every clock runs in its own network namespace, connected by veth pairs
+# to its neighbours or to a bridge. The clocks use software time stamping
+# over layer 2. As all namespaces share the system clock, the slaves and
+# boundary clocks run the nullf servo and never adjust the clock, so the
+# offsets show the noise of the time stamping and the event loop, and the
+# lock time is the time from the start until the first offset, which
+# covers the BMCA and the first delay measurement.
+#
+# For every clock one JSON object per line is printed with the role, the
+# lock time, the offset and delay statistics, the CPU time, the context
+# switches per second (the wakeups) and, with the -s option, the number
+# of system calls counted by strace.
+#
+# Copyright (C) 2026 The linuxptp contributors
+#
+# This program is free software; you can redistribute it and/or modify
+# it under the terms of the GNU General Public License as published by
+# the Free Software Foundation; either version 2 of the License, or
+# (at your option) any later version.
+#
+# This program is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+#
+# You should have received a copy of the GNU General Public License along
+# with this program; if not, write to the Free Software Foundation, Inc.,
+# 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+#
+
+bindir=`dirname "$0"`
+duration=60
+slaves=4
+depth=2
+interval=0
+use_strace=0
+output=-
+topologies="slaves chain e2e-tc p2p-tc"
+prefix=ptpb$$
+
+usage() {
+	cat >&2 <<EOF
+usage: $0 [options] [topology ...]
+
+Topologies:
+ slaves    a grandmaster and N slaves on a bridge
+ chain     a grandmaster, D boundary clocks and a slave in a line
+ e2e-tc    a grandmaster and N slaves behind an end to end TC
+ p2p-tc    a grandmaster and N slaves behind a peer to peer TC
+
+Options:
+ -b [dir]  directory with the ptp4l binary and the configs ($bindir)
+ -d [num]  number of boundary clocks in the chain ($depth)
+ -i [num]  logSyncInterval of the grandmaster ($interval)
+ -n [num]  number of slaves ($slaves)
+ -o [file] write the results to 'file' instead of stdout
+ -s        count the system calls with strace
+ -t [sec]  duration of each run ($duration)
+ -h        prints this message and exits
+EOF
+	exit 1
+}
+
+while getopts "b:d:i:n:o:st:h" opt; do
+	case $opt in
+	b) bindir=$OPTARG ;;
+	d) depth=$OPTARG ;;
+	i) interval=$OPTARG ;;
+	n) slaves=$OPTARG ;;
+	o) output=$OPTARG ;;
+	s) use_strace=1 ;;
+	t) duration=$OPTARG ;;
+	*) usage ;;
+	esac
+done
+shift $((OPTIND - 1))
+if [ $# -gt 0 ]; then
+	topologies="$*"
+fi
+
+ptp4l=$bindir/ptp4l
+if [ ! -x "$ptp4l" ]; then
+	echo "$ptp4l not found" >&2
+	exit 1
+fi
+if [ $use_strace -eq 1 ] && ! command -v strace > /dev/null; then
+	echo "strace not found" >&2
+	exit 1
+fi
+version=`"$ptp4l" -v`
+hz=`getconf CLK_TCK`
+tmp=`mktemp -d`
+namespaces=
+nodes=
+
+cleanup() {
+	stop_nodes
+	rm -rf "$tmp"
+}
+
+stop_nodes() {
+	for n in $nodes; do
+		[ -f $tmp/$n.pid ] && kill `cat $tmp/$n.pid` 2> /dev/null
+	done
+	wait
+	for ns in $namespaces; do
+		ip netns del $ns
+	done
+	namespaces=
+	nodes=
+}
+
+trap cleanup EXIT
+trap 'exit 1' INT TERM
+
+# node name role config
+node() {
+	ip netns add $prefix-$1 || exit 1
+	namespaces="$namespaces $prefix-$1"
+	ip -n $prefix-$1 link set lo up
+	nodes="$nodes $1"
+	echo $2 > $tmp/$1.role
+	: > $tmp/$1.ifaces
+	{
+		echo "[global]"
+		echo "logSyncInterval $interval"
+		echo "summary_interval $interval"
+		echo "uds_address $tmp/$1.uds"
+		case $2 in
+		gm)
+			echo "priority1 1"
+			;;
+		bc|slave)
+			echo "clock_servo nullf"
+			echo "first_step_threshold 0"
+			echo "step_threshold 0"
+			;;
+		esac
+		[ $2 = slave ] && echo "slaveOnly 1"
+		[ -n "$3" ] && cat "$3"
+	} > $tmp/$1.cfg
+}
+
+# link node1 node2
+link() {
+	i1=eth`wc -l < $tmp/$1.ifaces`
+	i2=eth`wc -l < $tmp/$2.ifaces`
+	ip link add $i1 netns $prefix-$1 type veth \
+		peer name $i2 netns $prefix-$2 || exit 1
+	ip -n $prefix-$1 link set $i1 up
+	ip -n $prefix-$2 link set $i2 up
+	echo $i1 >> $tmp/$1.ifaces
+	echo $i2 >> $tmp/$2.ifaces
+}
+
+# bridge node ...
+bridge() {
+	ip netns add $prefix-br || exit 1
+	namespaces="$namespaces $prefix-br"
+	ip -n $prefix-br link add br0 type bridge
+	ip -n $prefix-br link set br0 up
+	i=0
+	for n in "$@"; do
+		ip link add eth0 netns $prefix-$n type veth \
+			peer name p$i netns $prefix-br || exit 1
+		ip -n $prefix-$n link set eth0 up
+		ip -n $prefix-br link set p$i master br0
+		ip -n $prefix-br link set p$i up
+		echo eth0 >> $tmp/$n.ifaces
+		i=$((i + 1))
+	done
+}
+
+start_nodes() {
+	for n in $nodes; do
+		args="-f $tmp/$n.cfg -S -2 -m"
+		for i in `cat $tmp/$n.ifaces`; do
+			args="$args -i $i"
+		done
+		if [ $use_strace -eq 1 ]; then
+			ip netns exec $prefix-$n strace -c -f -qq \
+				-o $tmp/$n.strace $ptp4l $args \
+				> $tmp/$n.log 2>&1 &
+		else
+			ip netns exec $prefix-$n $ptp4l $args \
+				> $tmp/$n.log 2>&1 &
+		fi
+		echo $! > $tmp/$n.pid
+	done
+}
+
+# Reads the CPU time and the context switches of the running ptp4l.
+sample_nodes() {
+	for n in $nodes; do
+		pid=`cat $tmp/$n.pid`
+		if [ $use_strace -eq 1 ]; then
+			pid=`pgrep -P $pid ptp4l`
+		fi
+		if [ -z "$pid" ] || [ ! -d /proc/$pid ]; then
+			echo "0 0 0" > $tmp/$n.proc
+			continue
+		fi
+		cpu=`awk '{ print $14, $15 }' /proc/$pid/stat`
+		ctx=`awk '/ctxt_switches/ { n += $2 } END { print n }' \
+			/proc/$pid/status`
+		echo "$cpu $ctx" > $tmp/$n.proc
+	done
+}
+
+report_nodes() {
+	for n in $nodes; do
+		syscalls=null
+		if [ -f $tmp/$n.strace ]; then
+			syscalls=`awk '$NF == "total" { print $4 }' $tmp/$n.strace`
+			[ -z "$syscalls" ] && syscalls=null
+		fi
+		awk -v topo=$1 -v role=`cat $tmp/$n.role` -v name=$n \
+		    -v dur=$duration -v hz=$hz -v proc="`cat $tmp/$n.proc`" \
+		    -v syscalls=$syscalls -v version="$version" '
+		function num(x) { return x == "" ? "null" : x }
+		{
+			t = substr($1, 7, length($1) - 8) + 0
+			if (!lines++)
+				t0 = t
+		}
+		/master offset/ {
+			for (i = 1; i < NF; i++)
+				if ($i == "offset")
+					o = $(i + 1)
+			if (!n++)
+				lock = sprintf("%.3f", t - t0)
+			sum += o; sum2 += o * o; delay += $NF
+			if (o < 0)
+				o = -o
+			if (o > max)
+				max = o
+		}
+		END {
+			split(proc, p, " ")
+			if (n) {
+				mean = sum / n
+				rms = sqrt(sum2 / n)
+				sdev = sqrt(sum2 / n - mean * mean)
+				stats = sprintf("%.1f,\"offset_rms\":%.1f," \
+						"\"offset_sdev\":%.1f," \
+						"\"offset_max\":%d," \
+						"\"delay_mean\":%.1f",
+						mean, rms, sdev, max, delay / n)
+			} else {
+				stats = "null,\"offset_rms\":null," \
+					"\"offset_sdev\":null," \
+					"\"offset_max\":null,\"delay_mean\":null"
+			}
+			printf("{\"version\":\"%s\",\"topology\":\"%s\"," \
+			       "\"role\":\"%s\",\"name\":\"%s\"," \
+			       "\"duration\":%d,\"lock_time\":%s," \
+			       "\"samples\":%d,\"offset_mean\":%s," \
+			       "\"cpu_user\":%.2f,\"cpu_sys\":%.2f," \
+			       "\"cpu_percent\":%.3f,\"wakeups_per_s\":%.1f," \
+			       "\"syscalls\":%s}\n",
+			       version, topo, role, name, dur, num(lock), n,
+			       stats, p[1] / hz, p[2] / hz,
+			       100 * (p[1] + p[2]) / hz / dur,
+			       p[3] / dur, syscalls)
+		}' $tmp/$n.log
+	done
+}
+
+run() {
+	start_nodes
+	sleep $duration
+	sample_nodes
+	for n in $nodes; do
+		kill `cat $tmp/$n.pid`
+	done
+	wait
+	report_nodes $1
+	stop_nodes
+}
+
+topo_slaves() {
+	node gm gm
+	list=gm
+	for i in `seq 1 $slaves`; do
+		node s$i slave
+		list="$list s$i"
+	done
+	bridge $list
+}
+
+topo_chain() {
+	node gm gm
+	prev=gm
+	for i in `seq 1 $depth`; do
+		node bc$i bc
+		link $prev bc$i
+		prev=bc$i
+	done
+	node s1 slave
+	link $prev s1
+}
+
+# topo_tc config [delay_mechanism]
+topo_tc() {
+	if [ -n "$2" ]; then
+		echo "delay_mechanism $2" > $tmp/dm.cfg
+	else
+		: > $tmp/dm.cfg
+	fi
+	node tc tc $bindir/configs/$1
+	node gm gm $tmp/dm.cfg
+	link tc gm
+	for i in `seq 1 $slaves`; do
+		node s$i slave $tmp/dm.cfg
+		link tc s$i
+	done
+}
+
+if [ "$output" != - ]; then
+	exec > "$output"
+fi
+
+for t in $topologies; do
+	case $t in
+	slaves) topo_slaves ;;
+	chain) topo_chain ;;
+	e2e-tc) topo_tc E2E-TC.cfg ;;
+	p2p-tc) topo_tc P2P-TC.cfg P2P ;;
+	*) echo "unknown topology $t" >&2; exit 1 ;;
+	esac
+	run $t
+done
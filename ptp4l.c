@@ -18,11 +18,13 @@
  * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
  */
 #include <limits.h>
+#include <signal.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <unistd.h>
 
+#include "capture.h"
 #include "clock.h"
 #include "config.h"
 #include "ntpshm.h"
@@ -30,6 +32,7 @@
 #include "print.h"
 #include "raw.h"
 #include "sk.h"
+#include "trace.h"
 #include "transport.h"
 #include "udp6.h"
 #include "uds.h"
@@ -40,6 +43,19 @@
 #include "sja1105.h"
 #endif
 
+static volatile sig_atomic_t trace_dump_requested;
+
+static void handle_trace_signal(int s)
+{
+	trace_dump_requested = 1;
+}
+
+static void capture_tap(int fd, int tx, struct ptp_message *msg, int len,
+			struct hw_timestamp *hwts)
+{
+	capture_frame(fd, tx ? CAPTURE_TX : CAPTURE_RX, msg, len, hwts);
+}
+
 static void usage(char *progname)
 {
 	fprintf(stderr,
@@ -225,13 +241,18 @@ int main(int argc, char *argv[])
 	print_set_verbose(config_get_int(cfg, NULL, "verbose"));
 	print_set_syslog(config_get_int(cfg, NULL, "use_syslog"));
 	print_set_level(config_get_int(cfg, NULL, "logging_level"));
+	if (print_set_async(config_get_int(cfg, NULL, "logging_buffer_size"))) {
+		fprintf(stderr, "failed to start the logging thread\n");
+		goto out;
+	}
 
 	assume_two_step = config_get_int(cfg, NULL, "assume_two_step");
 	sk_check_fupsync = config_get_int(cfg, NULL, "check_fup_sync");
 	sk_tx_timeout = config_get_int(cfg, NULL, "tx_timestamp_timeout");
 	sk_hwts_filter_mode = config_get_int(cfg, NULL, "hwts_filter");
 
-	if (config_get_int(cfg, NULL, "clock_servo") == CLOCK_SERVO_NTPSHM) {
+	if (config_get_int(cfg, NULL, "clock_servo") == CLOCK_SERVO_NTPSHM ||
+	    config_get_int(cfg, NULL, "clock_servo") == CLOCK_SERVO_CHRONYSOCK) {
 		config_set_int(cfg, "kernel_leap", 0);
 		config_set_int(cfg, "sanity_freq_limit", 0);
 	}
@@ -283,6 +304,26 @@ int main(int argc, char *argv[])
 	sja1105_sync_timer_create(cfg);
 #endif
 
+	if (config_get_int(cfg, NULL, "trace_buffer_size")) {
+		if (trace_init(config_get_int(cfg, NULL, "trace_buffer_size"))) {
+			fprintf(stderr, "failed to allocate the trace buffer\n");
+			goto out;
+		}
+		if (SIG_ERR == signal(SIGUSR1, handle_trace_signal)) {
+			fprintf(stderr, "cannot handle SIGUSR1\n");
+			goto out;
+		}
+	}
+
+	if (config_get_string(cfg, NULL, "capture_file")[0] &&
+	    capture_open(config_get_string(cfg, NULL, "capture_file"),
+			 config_get_int(cfg, NULL, "capture_buffer_size"))) {
+		fprintf(stderr, "failed to start the capture\n");
+		goto out;
+	}
+	if (capture_active)
+		transport_set_tap(capture_tap);
+
 	clock = clock_create(type, cfg, req_phc);
 	if (!clock) {
 		fprintf(stderr, "failed to create a clock\n");
@@ -294,6 +335,10 @@ int main(int argc, char *argv[])
 	while (is_running()) {
 		if (clock_poll(clock))
 			break;
+		if (trace_dump_requested) {
+			trace_dump_requested = 0;
+			clock_trace_dump(clock);
+		}
 	}
 
 #ifdef SJA1105_SYNC
@@ -303,6 +348,10 @@ int main(int argc, char *argv[])
 out:
 	if (clock)
 		clock_destroy(clock);
+	transport_set_tap(NULL);
+	capture_close();
+	trace_cleanup();
+	print_set_async(0);
 	config_destroy(cfg);
 	return err;
 }
@@ -0,0 +1,870 @@
+/**
+ * @file ptp_bench.c
+ * @brief Micro-benchmarks of the message codec, time values, filters and
+ *        servos.
+ * @note Copyright (C) 2026 The linuxptp contributors
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+#include <arpa/inet.h>
+#include <inttypes.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "config.h"
+#include "ds.h"
+#include "filter.h"
+#include "hash.h"
+#include "linreg.h"
+#include "msg.h"
+#include "pqueue.h"
+#include "print.h"
+#include "servo.h"
+#include "tlv.h"
+#include "tmv.h"
+#include "tsproc.h"
+#include "util.h"
+#include "version.h"
+
+#define NS_PER_SEC	1000000000LL
+#define MAX_BENCH	64
+#define BATCH		64
+#define NUM_SAMPLES	4096
+#define MAX_ITER	1000000000L
+
+#define ARRAY_SIZE(x) (sizeof(x) / sizeof((x)[0]))
+
+/*
+ * The program is linked with --wrap for the allocation functions, so
+ * every allocation made by the code under test is counted. Allocations
+ * made inside of the C library itself, e.g. by strdup(), are not.
+ */
+void *__real_malloc(size_t size);
+void *__real_calloc(size_t nmemb, size_t size);
+void *__real_realloc(void *ptr, size_t size);
+
+static long allocations;
+
+void *__wrap_malloc(size_t size)
+{
+	allocations++;
+	return __real_malloc(size);
+}
+
+void *__wrap_calloc(size_t nmemb, size_t size)
+{
+	allocations++;
+	return __real_calloc(nmemb, size);
+}
+
+void *__wrap_realloc(void *ptr, size_t size)
+{
+	allocations++;
+	return __real_realloc(ptr, size);
+}
+
+struct bench {
+	char name[64];
+	void (*run)(struct bench *b, long n);
+	int arg;
+	int len;
+	int64_t ns;
+	long allocs;
+	int64_t start;
+	long allocs_start;
+};
+
+struct msg_template {
+	const char *name;
+	int type;
+	int tlv;
+	int id;
+	int count;
+	int len;
+	int pdulen;
+	uint8_t wire[256];
+};
+
+static struct msg_template msg_templates[] = {
+	{ "SYNC", SYNC },
+	{ "DELAY_REQ", DELAY_REQ },
+	{ "PDELAY_REQ", PDELAY_REQ },
+	{ "PDELAY_RESP", PDELAY_RESP },
+	{ "FOLLOW_UP", FOLLOW_UP },
+	{ "DELAY_RESP", DELAY_RESP },
+	{ "PDELAY_RESP_FOLLOW_UP", PDELAY_RESP_FOLLOW_UP },
+	{ "ANNOUNCE", ANNOUNCE },
+	{ "SIGNALING", SIGNALING, TLV_REQUEST_UNICAST_TRANSMISSION, 0, 3 },
+	{ "MANAGEMENT", MANAGEMENT, TLV_MANAGEMENT, TLV_DEFAULT_DATA_SET, 1 },
+};
+
+static struct msg_template tlv_templates[] = {
+	{ "DEFAULT_DATA_SET", MANAGEMENT, TLV_MANAGEMENT,
+	  TLV_DEFAULT_DATA_SET, 1 },
+	{ "PORT_DATA_SET", MANAGEMENT, TLV_MANAGEMENT, TLV_PORT_DATA_SET, 1 },
+	{ "TIME_STATUS_NP", MANAGEMENT, TLV_MANAGEMENT, TLV_TIME_STATUS_NP, 1 },
+	{ "REQUEST_UNICAST_TRANSMISSION", SIGNALING,
+	  TLV_REQUEST_UNICAST_TRANSMISSION, 0, 1 },
+	{ "GRANT_UNICAST_TRANSMISSION", SIGNALING,
+	  TLV_GRANT_UNICAST_TRANSMISSION, 0, 1 },
+};
+
+static const uint8_t unicast_types[] = { ANNOUNCE, SYNC, DELAY_RESP };
+
+static struct bench benches[MAX_BENCH];
+static int num_benches;
+static struct config *cfg;
+static int64_t samples[NUM_SAMPLES];
+static volatile int64_t sink;
+
+static int64_t now_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * NS_PER_SEC + ts.tv_nsec;
+}
+
+static void bench_start(struct bench *b)
+{
+	b->allocs_start = allocations;
+	b->start = now_ns();
+}
+
+static void bench_stop(struct bench *b)
+{
+	b->ns += now_ns() - b->start;
+	b->allocs += allocations - b->allocs_start;
+}
+
+static void bench_fail(struct bench *b, const char *what)
+{
+	fprintf(stderr, "%s: %s failed\n", b->name, what);
+	exit(1);
+}
+
+/* Message codec */
+
+static int mgt_data_size(int id)
+{
+	switch (id) {
+	case TLV_DEFAULT_DATA_SET:
+		return sizeof(struct defaultDS);
+	case TLV_PORT_DATA_SET:
+		return sizeof(struct portDS);
+	case TLV_TIME_STATUS_NP:
+		return sizeof(struct time_status_np);
+	}
+	return 0;
+}
+
+static int append_tlvs(struct ptp_message *m, struct msg_template *t)
+{
+	struct request_unicast_xmit_tlv *req;
+	struct grant_unicast_xmit_tlv *grant;
+	struct management_tlv *mgt;
+	struct tlv_extra *extra;
+	int i, size;
+
+	for (i = 0; i < t->count; i++) {
+		switch (t->tlv) {
+		case TLV_REQUEST_UNICAST_TRANSMISSION:
+			extra = msg_tlv_append(m, sizeof(*req));
+			if (!extra)
+				return -1;
+			req = (struct request_unicast_xmit_tlv *) extra->tlv;
+			req->type = t->tlv;
+			req->length = sizeof(*req) - sizeof(struct TLV);
+			req->message_type = unicast_types[i] << 4;
+			req->durationField = 300;
+			break;
+		case TLV_GRANT_UNICAST_TRANSMISSION:
+			extra = msg_tlv_append(m, sizeof(*grant));
+			if (!extra)
+				return -1;
+			grant = (struct grant_unicast_xmit_tlv *) extra->tlv;
+			grant->type = t->tlv;
+			grant->length = sizeof(*grant) - sizeof(struct TLV);
+			grant->message_type = unicast_types[i] << 4;
+			grant->durationField = 300;
+			break;
+		case TLV_MANAGEMENT:
+			size = mgt_data_size(t->id);
+			extra = msg_tlv_append(m, sizeof(*mgt) + size);
+			if (!extra)
+				return -1;
+			mgt = (struct management_tlv *) extra->tlv;
+			mgt->type = t->tlv;
+			mgt->length = sizeof(mgt->id) + size;
+			mgt->id = t->id;
+			break;
+		}
+	}
+	return 0;
+}
+
+/*
+ * Builds a message of the template in host byte order and keeps its
+ * network representation, from which the benchmarks start.
+ */
+static int template_init(struct msg_template *t)
+{
+	struct ptp_message *m;
+	int len = 0;
+
+	m = msg_allocate();
+	if (!m)
+		return -1;
+	m->header.tsmt = t->type;
+	m->header.ver = PTP_VERSION;
+	m->header.sequenceId = 1;
+	m->header.sourcePortIdentity.portNumber = 1;
+	memset(&m->header.sourcePortIdentity.clockIdentity, 0x11,
+	       sizeof(m->header.sourcePortIdentity.clockIdentity));
+
+	switch (t->type) {
+	case SYNC:
+		len = sizeof(struct sync_msg);
+		m->header.control = CTL_SYNC;
+		break;
+	case DELAY_REQ:
+		len = sizeof(struct delay_req_msg);
+		m->header.control = CTL_DELAY_REQ;
+		break;
+	case PDELAY_REQ:
+		len = sizeof(struct pdelay_req_msg);
+		m->header.control = CTL_OTHER;
+		break;
+	case PDELAY_RESP:
+		len = sizeof(struct pdelay_resp_msg);
+		m->header.control = CTL_OTHER;
+		m->pdelay_resp.requestReceiptTimestamp.seconds_lsb = 1000;
+		m->pdelay_resp.requestReceiptTimestamp.nanoseconds = 500;
+		m->pdelay_resp.requestingPortIdentity.portNumber = 1;
+		break;
+	case FOLLOW_UP:
+		len = sizeof(struct follow_up_msg);
+		m->header.control = CTL_FOLLOW_UP;
+		m->follow_up.preciseOriginTimestamp.seconds_lsb = 1000;
+		m->follow_up.preciseOriginTimestamp.nanoseconds = 500;
+		break;
+	case DELAY_RESP:
+		len = sizeof(struct delay_resp_msg);
+		m->header.control = CTL_DELAY_RESP;
+		m->delay_resp.receiveTimestamp.seconds_lsb = 1000;
+		m->delay_resp.receiveTimestamp.nanoseconds = 500;
+		m->delay_resp.requestingPortIdentity.portNumber = 1;
+		break;
+	case PDELAY_RESP_FOLLOW_UP:
+		len = sizeof(struct pdelay_resp_fup_msg);
+		m->header.control = CTL_OTHER;
+		m->pdelay_resp_fup.responseOriginTimestamp.seconds_lsb = 1000;
+		m->pdelay_resp_fup.responseOriginTimestamp.nanoseconds = 500;
+		m->pdelay_resp_fup.requestingPortIdentity.portNumber = 1;
+		break;
+	case ANNOUNCE:
+		len = sizeof(struct announce_msg);
+		m->header.control = CTL_OTHER;
+		m->announce.currentUtcOffset = 37;
+		m->announce.grandmasterPriority1 = 128;
+		m->announce.grandmasterClockQuality.clockClass = 248;
+		m->announce.grandmasterClockQuality.offsetScaledLogVariance =
+			0xffff;
+		m->announce.grandmasterPriority2 = 128;
+		m->announce.stepsRemoved = 1;
+		break;
+	case SIGNALING:
+		len = sizeof(struct signaling_msg);
+		m->header.control = CTL_OTHER;
+		memset(&m->signaling.targetPortIdentity, 0xff,
+		       sizeof(m->signaling.targetPortIdentity));
+		break;
+	case MANAGEMENT:
+		len = sizeof(struct management_msg);
+		m->header.control = CTL_MANAGEMENT;
+		memset(&m->management.targetPortIdentity, 0xff,
+		       sizeof(m->management.targetPortIdentity));
+		m->management.flags = RESPONSE;
+		break;
+	}
+	m->header.messageLength = len;
+	t->pdulen = len;
+
+	if (append_tlvs(m, t) || msg_pre_send(m)) {
+		msg_put(m);
+		return -1;
+	}
+	t->len = ntohs(m->header.messageLength);
+	memcpy(t->wire, m->data.buffer, t->len);
+	msg_put(m);
+	return 0;
+}
+
+static void run_msg_post_recv(struct bench *b, long n)
+{
+	struct msg_template *t = &msg_templates[b->arg];
+	struct ptp_message *m[BATCH];
+	long i, k, cnt;
+
+	for (i = 0; i < n; i += cnt) {
+		cnt = n - i < BATCH ? n - i : BATCH;
+		for (k = 0; k < cnt; k++) {
+			m[k] = msg_allocate();
+			if (!m[k])
+				bench_fail(b, "msg_allocate");
+			memcpy(m[k]->data.buffer, t->wire, t->len);
+		}
+		bench_start(b);
+		for (k = 0; k < cnt; k++) {
+			if (msg_post_recv(m[k], t->len))
+				bench_fail(b, "msg_post_recv");
+		}
+		bench_stop(b);
+		for (k = 0; k < cnt; k++)
+			msg_put(m[k]);
+	}
+}
+
+static void run_msg_pre_send(struct bench *b, long n)
+{
+	struct msg_template *t = &msg_templates[b->arg];
+	struct ptp_message *m[BATCH];
+	long i, k, cnt;
+
+	for (i = 0; i < n; i += cnt) {
+		cnt = n - i < BATCH ? n - i : BATCH;
+		for (k = 0; k < cnt; k++) {
+			m[k] = msg_allocate();
+			if (!m[k])
+				bench_fail(b, "msg_allocate");
+			memcpy(m[k]->data.buffer, t->wire, t->len);
+			if (msg_post_recv(m[k], t->len))
+				bench_fail(b, "msg_post_recv");
+		}
+		bench_start(b);
+		for (k = 0; k < cnt; k++) {
+			if (msg_pre_send(m[k]))
+				bench_fail(b, "msg_pre_send");
+		}
+		bench_stop(b);
+		for (k = 0; k < cnt; k++)
+			msg_put(m[k]);
+	}
+}
+
+static void run_tlv_post_recv(struct bench *b, long n)
+{
+	struct msg_template *t = &tlv_templates[b->arg];
+	int len = t->len - t->pdulen;
+	struct tlv_extra *extra[BATCH];
+	uint64_t buf[BATCH][32];
+	long i, k, cnt;
+
+	for (i = 0; i < n; i += cnt) {
+		cnt = n - i < BATCH ? n - i : BATCH;
+		for (k = 0; k < cnt; k++) {
+			extra[k] = tlv_extra_alloc();
+			if (!extra[k])
+				bench_fail(b, "tlv_extra_alloc");
+			memcpy(buf[k], t->wire + t->pdulen, len);
+			extra[k]->tlv = (struct TLV *) buf[k];
+			extra[k]->tlv->type = ntohs(extra[k]->tlv->type);
+			extra[k]->tlv->length = ntohs(extra[k]->tlv->length);
+		}
+		bench_start(b);
+		for (k = 0; k < cnt; k++) {
+			if (tlv_post_recv(extra[k]))
+				bench_fail(b, "tlv_post_recv");
+		}
+		bench_stop(b);
+		for (k = 0; k < cnt; k++)
+			tlv_extra_recycle(extra[k]);
+	}
+}
+
+/* Time values */
+
+/*
+ * Corrections with a fractional part, as accumulated by transparent
+ * clocks, on top of the delays.
+ */
+static Integer64 sample_correction(long i)
+{
+	return ((Integer64) samples[i % NUM_SAMPLES] << 16) + (i & 0xffff);
+}
+
+static void run_tmv_arith(struct bench *b, long n)
+{
+	tmv_t base = nanoseconds_to_tmv(1700000000 * NS_PER_SEC);
+	tmv_t acc = tmv_zero(), t;
+	long i;
+
+	bench_start(b);
+	for (i = 0; i < n; i++) {
+		t = tmv_add(base, correction_to_tmv(sample_correction(i)));
+		t = tmv_sub(t, base);
+		if (tmv_cmp(t, acc) > 0)
+			acc = tmv_div(tmv_add(acc, t), 2);
+		else
+			acc = tmv_sub(acc, t);
+	}
+	bench_stop(b);
+
+	sink = tmv_to_nanoseconds(acc);
+}
+
+static void run_tsproc(struct bench *b, long n)
+{
+	tmv_t t1, t2, t3, t4, delay, offset;
+	struct tsproc *tsp;
+	int64_t sum = 0;
+	double weight;
+	long i;
+
+	tsp = tsproc_create(b->arg, FILTER_MOVING_MEDIAN, 10, 25);
+	if (!tsp)
+		bench_fail(b, "tsproc_create");
+	t1 = nanoseconds_to_tmv(1700000000 * NS_PER_SEC);
+
+	bench_start(b);
+	for (i = 0; i < n; i++) {
+		t1 = tmv_add(t1, nanoseconds_to_tmv(NS_PER_SEC / 16));
+		t2 = tmv_add(t1, correction_to_tmv(sample_correction(i)));
+		t3 = tmv_add(t2, nanoseconds_to_tmv(100000));
+		t4 = tmv_add(t3, correction_to_tmv(sample_correction(i + 1)));
+		tsproc_down_ts(tsp, t1, t2);
+		tsproc_up_ts(tsp, t3, t4);
+		tsproc_update_delay(tsp, &delay);
+		if (!tsproc_update_offset(tsp, &offset, &weight))
+			sum += tmv_to_nanoseconds(offset);
+	}
+	bench_stop(b);
+
+	sink = sum + tmv_to_nanoseconds(delay);
+	tsproc_destroy(tsp);
+}
+
+/* Filters and servos */
+
+static void run_filter(struct bench *b, long n)
+{
+	struct filter *f;
+	int64_t sum = 0;
+	long i;
+
+	f = filter_create(b->arg, b->len, 25);
+	if (!f)
+		bench_fail(b, "filter_create");
+	for (i = 0; i < b->len; i++)
+		filter_sample(f, nanoseconds_to_tmv(samples[i % NUM_SAMPLES]));
+
+	bench_start(b);
+	for (i = 0; i < n; i++) {
+		sum += tmv_to_nanoseconds(filter_sample(f,
+			nanoseconds_to_tmv(samples[i % NUM_SAMPLES])));
+	}
+	bench_stop(b);
+
+	sink = sum;
+	filter_destroy(f);
+}
+
+static void run_servo(struct bench *b, long n)
+{
+	enum servo_state state;
+	uint64_t ts = 1000 * NS_PER_SEC;
+	struct servo *s;
+	double sum = 0.0;
+	long i;
+
+	s = servo_create(cfg, b->arg, 0, 500000, 0);
+	if (!s)
+		bench_fail(b, "servo_create");
+	servo_sync_interval(s, 1.0);
+	/* Let the servo lock and fill its history. */
+	for (i = 0; i < 256; i++, ts += NS_PER_SEC)
+		servo_sample(s, samples[i] / 10, ts, 1.0, &state);
+
+	bench_start(b);
+	for (i = 0; i < n; i++, ts += NS_PER_SEC) {
+		sum += servo_sample(s, samples[i % NUM_SAMPLES] / 10, ts,
+				    1.0, &state);
+	}
+	bench_stop(b);
+
+	sink = sum;
+	servo_destroy(s);
+}
+
+/* Containers */
+
+static void run_hash_lookup(struct bench *b, long n)
+{
+	char (*keys)[32];
+	struct hash *ht;
+	long i, found = 0;
+
+	keys = calloc(b->len, sizeof(*keys));
+	ht = hash_create();
+	if (!keys || !ht)
+		bench_fail(b, "hash_create");
+	for (i = 0; i < b->len; i++) {
+		snprintf(keys[i], sizeof(keys[i]), "port%ld.option%ld",
+			 i % 16, i / 16);
+		if (hash_insert(ht, keys[i], keys[i]))
+			bench_fail(b, "hash_insert");
+	}
+
+	bench_start(b);
+	for (i = 0; i < n; i++) {
+		if (hash_lookup(ht, keys[i % b->len]))
+			found++;
+	}
+	bench_stop(b);
+
+	sink = found;
+	hash_destroy(ht, NULL);
+	free(keys);
+}
+
+struct pq_item {
+	int64_t time;
+};
+
+static int pq_item_cmp(void *a, void *b)
+{
+	struct pq_item *x = a, *y = b;
+
+	return x->time < y->time ? 1 : x->time > y->time ? -1 : 0;
+}
+
+static void run_pqueue(struct bench *b, long n)
+{
+	struct pq_item *items, *item;
+	struct pqueue *q;
+	long i;
+
+	items = calloc(b->len, sizeof(*items));
+	q = pqueue_create(b->len, pq_item_cmp);
+	if (!items || !q)
+		bench_fail(b, "pqueue_create");
+	for (i = 0; i < b->len; i++) {
+		items[i].time = llabs(samples[i % NUM_SAMPLES]);
+		if (pqueue_insert(q, &items[i]))
+			bench_fail(b, "pqueue_insert");
+	}
+
+	/* Like a scheduler, take the earliest item and put it back later. */
+	bench_start(b);
+	for (i = 0; i < n; i++) {
+		item = pqueue_extract(q);
+		item->time += llabs(samples[i % NUM_SAMPLES]);
+		if (pqueue_insert(q, item))
+			bench_fail(b, "pqueue_insert");
+	}
+	bench_stop(b);
+
+	pqueue_destroy(q);
+	free(items);
+}
+
+/* Checks */
+
+/*
+ * Feeds the linreg servo with a fixed sequence of noisy offsets and
+ * weights, which wraps the windows of all sizes many times, steps the
+ * clock and resets the servo, and compares the results of every size
+ * with the two-pass regression after each sample.
+ */
+static int check_linreg(void)
+{
+	double slope, intercept, d_slope = 0.0, d_intercept = 0.0;
+	double step_threshold = config_get_double(cfg, NULL, "step_threshold");
+	uint64_t ts = 1000 * NS_PER_SEC;
+	enum servo_state state;
+	struct servo *servo;
+	int64_t offset;
+	int i, steps = 0;
+
+	config_set_double(cfg, "step_threshold", 0.0001);
+	servo = servo_create(cfg, CLOCK_SERVO_LINREG, 0, 500000, 0);
+	config_set_double(cfg, "step_threshold", step_threshold);
+	if (!servo)
+		return -1;
+	servo_sync_interval(servo, 1.0);
+
+	for (i = 0; i < 3000; i++) {
+		if (i == 1500)
+			servo_reset(servo);
+		offset = samples[i % NUM_SAMPLES] - 10000;
+		if (i >= 1000 && i < 1500)
+			offset += 1000000;
+		ts += NS_PER_SEC + samples[(i + 1) % NUM_SAMPLES] - 10000;
+		servo_sample(servo, offset, ts,
+			     0.5 + samples[(i + 2) % NUM_SAMPLES] % 100 / 200.0,
+			     &state);
+		if (state == SERVO_JUMP)
+			steps++;
+
+		linreg_check(servo, &slope, &intercept);
+		d_slope = fmax(d_slope, slope);
+		d_intercept = fmax(d_intercept, intercept);
+	}
+	servo_destroy(servo);
+
+	printf("%-44s %10.2e %10.2e\n", "linreg_sums", d_slope * 1e9,
+	       d_intercept);
+	if (!steps || d_slope * 1e9 > 1e-3 || d_intercept > 1e-3) {
+		fprintf(stderr, "linreg_sums: %d steps, results differ from "
+			"the two-pass regression\n", steps);
+		return -1;
+	}
+	return 0;
+}
+
+static int run_checks(void)
+{
+	printf("%-44s %10s %10s\n", "check", "slope[ppb]", "offset[ns]");
+	return check_linreg();
+}
+
+/* Driver */
+
+static void add_bench(const char *name, const char *arg_name, int len,
+		      void (*run)(struct bench *b, long n), int arg)
+{
+	struct bench *b = &benches[num_benches++];
+
+	if (arg_name)
+		snprintf(b->name, sizeof(b->name), "%s/%s", name, arg_name);
+	else
+		snprintf(b->name, sizeof(b->name), "%s/%d", name, len);
+	b->run = run;
+	b->arg = arg;
+	b->len = len;
+}
+
+static void add_benches(void)
+{
+	static const int filter_lengths[] = { 10, 100, 1000, 10000 };
+	int i;
+
+	for (i = 0; i < ARRAY_SIZE(msg_templates); i++) {
+		add_bench("msg_post_recv", msg_templates[i].name, 0,
+			  run_msg_post_recv, i);
+	}
+	for (i = 0; i < ARRAY_SIZE(msg_templates); i++) {
+		add_bench("msg_pre_send", msg_templates[i].name, 0,
+			  run_msg_pre_send, i);
+	}
+	for (i = 0; i < ARRAY_SIZE(tlv_templates); i++) {
+		add_bench("tlv_post_recv", tlv_templates[i].name, 0,
+			  run_tlv_post_recv, i);
+	}
+	add_bench("tmv_arith", NULL, 0, run_tmv_arith, 0);
+	add_bench("tsproc_update", "filter", 0, run_tsproc, TSPROC_FILTER);
+	add_bench("tsproc_update", "raw", 0, run_tsproc, TSPROC_RAW);
+	for (i = 0; i < ARRAY_SIZE(filter_lengths); i++) {
+		add_bench("mmedian_sample", NULL, filter_lengths[i],
+			  run_filter, FILTER_MOVING_MEDIAN);
+	}
+	for (i = 0; i < ARRAY_SIZE(filter_lengths); i++) {
+		add_bench("hmedian_sample", NULL, filter_lengths[i],
+			  run_filter, FILTER_MOVING_MEDIAN_HEAP);
+	}
+	for (i = 0; i < ARRAY_SIZE(filter_lengths); i++) {
+		add_bench("mmin_sample", NULL, filter_lengths[i],
+			  run_filter, FILTER_MOVING_MINIMUM);
+	}
+	for (i = 0; i < ARRAY_SIZE(filter_lengths); i++) {
+		add_bench("pmean_sample", NULL, filter_lengths[i],
+			  run_filter, FILTER_PERCENTILE_MEAN);
+	}
+	for (i = 0; i < ARRAY_SIZE(filter_lengths); i++) {
+		add_bench("mave_accumulate", NULL, filter_lengths[i],
+			  run_filter, FILTER_MOVING_AVERAGE);
+	}
+	add_bench("servo_sample", "pi", 0, run_servo, CLOCK_SERVO_PI);
+	add_bench("servo_sample", "linreg", 0, run_servo, CLOCK_SERVO_LINREG);
+	add_bench("servo_sample", "kalman", 0, run_servo, CLOCK_SERVO_KALMAN);
+	add_bench("hash_lookup", NULL, 200, run_hash_lookup, 0);
+	add_bench("hash_lookup", NULL, 2000, run_hash_lookup, 0);
+	add_bench("pqueue_insert_extract", NULL, 16, run_pqueue, 0);
+	add_bench("pqueue_insert_extract", NULL, 1024, run_pqueue, 0);
+	add_bench("pqueue_insert_extract", NULL, 65536, run_pqueue, 0);
+}
+
+/*
+ * Runs a benchmark with a growing number of iterations until it takes
+ * at least the minimum time.
+ */
+static long measure(struct bench *b, int64_t min_ns)
+{
+	long n = 1, next;
+
+	while (1) {
+		b->ns = 0;
+		b->allocs = 0;
+		b->run(b, n);
+		if (b->ns >= min_ns || n >= MAX_ITER)
+			return n;
+		if (b->ns > 0)
+			next = (double) n * min_ns / b->ns * 1.2;
+		else
+			next = n * 100;
+		if (next > n * 100)
+			next = n * 100;
+		if (next <= n)
+			next = n + 1;
+		n = next > MAX_ITER ? MAX_ITER : next;
+	}
+}
+
+static void usage(char *progname)
+{
+	fprintf(stderr,
+		"\n"
+		"usage: %s [options] [pattern ...]\n\n"
+		" Runs the benchmarks whose name contains one of the\n"
+		" patterns, or all of them.\n\n"
+		" -c [num]  repeat each benchmark 'num' times and report the\n"
+		"           fastest run, the default is 3\n"
+		" -C        check the results of the optimized code against\n"
+		"           reference implementations and exit\n"
+		" -t [sec]  minimum time of each run, the default is 0.2\n"
+		" -L        list the benchmarks and exit\n"
+		" -h        prints this message and exits\n"
+		" -v        prints the software version and exits\n"
+		"\n",
+		progname);
+}
+
+static int selected(struct bench *b, int argc, char *argv[])
+{
+	int i;
+
+	if (!argc)
+		return 1;
+	for (i = 0; i < argc; i++) {
+		if (strstr(b->name, argv[i]))
+			return 1;
+	}
+	return 0;
+}
+
+int main(int argc, char *argv[])
+{
+	int c, i, j, count = 3, check = 0, list = 0;
+	double best_ns, best_allocs;
+	double min_time = 0.2;
+	char *progname;
+	struct bench *b;
+	long n;
+
+	progname = strrchr(argv[0], '/');
+	progname = progname ? 1 + progname : argv[0];
+	while (EOF != (c = getopt(argc, argv, "c:Ct:Lhv"))) {
+		switch (c) {
+		case 'c':
+			if (get_arg_val_i(c, optarg, &count, 1, 1000))
+				return -1;
+			break;
+		case 'C':
+			check = 1;
+			break;
+		case 't':
+			if (get_arg_val_d(c, optarg, &min_time, 0.001, 100.0))
+				return -1;
+			break;
+		case 'L':
+			list = 1;
+			break;
+		case 'v':
+			version_show(stdout);
+			return 0;
+		case 'h':
+			usage(progname);
+			return 0;
+		case '?':
+		default:
+			usage(progname);
+			return -1;
+		}
+	}
+	argc -= optind;
+	argv += optind;
+
+	print_set_progname(progname);
+	print_set_verbose(1);
+	print_set_syslog(0);
+	print_set_level(LOG_ERR);
+
+	add_benches();
+	if (list) {
+		for (i = 0; i < num_benches; i++)
+			printf("%s\n", benches[i].name);
+		return 0;
+	}
+
+	cfg = config_create();
+	if (!cfg)
+		return -1;
+	/* Delays with noise from a fixed seed, the same for every run. */
+	srandom(1);
+	for (i = 0; i < NUM_SAMPLES; i++)
+		samples[i] = 10000 + random() % 2000 - 1000;
+	for (i = 0; i < ARRAY_SIZE(msg_templates); i++) {
+		if (template_init(&msg_templates[i]))
+			return -1;
+	}
+	for (i = 0; i < ARRAY_SIZE(tlv_templates); i++) {
+		if (template_init(&tlv_templates[i]))
+			return -1;
+	}
+
+	printf("# ptp_bench %s\n", version_string());
+	if (check) {
+		c = run_checks();
+		config_destroy(cfg);
+		return c;
+	}
+	printf("%-44s %12s %10s %10s\n",
+	       "benchmark", "iterations", "ns/op", "allocs/op");
+	for (i = 0; i < num_benches; i++) {
+		b = &benches[i];
+		if (!selected(b, argc, argv))
+			continue;
+		best_ns = best_allocs = 0.0;
+		for (j = 0; j < count; j++) {
+			n = measure(b, min_time * NS_PER_SEC);
+			if (!j || (double) b->ns / n < best_ns) {
+				best_ns = (double) b->ns / n;
+				best_allocs = (double) b->allocs / n;
+			}
+		}
+		printf("%-44s %12ld %10.1f %10.2f\n",
+		       b->name, n, best_ns, best_allocs);
+		fflush(stdout);
+	}
+
+	msg_cleanup();
+	tlv_extra_cleanup();
+	config_destroy(cfg);
+	return 0;
+}
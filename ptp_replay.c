@@ -0,0 +1,538 @@
+/**
+ * @file ptp_replay.c
+ * @brief Replays recorded time stamps through the servos in virtual time.
+ * @note Copyright (C) 2026 The linuxptp contributors
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+#include <inttypes.h>
+#include <math.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "config.h"
+#include "print.h"
+#include "replay.h"
+#include "version.h"
+
+#define MAX_JOBS 256
+
+#define BT_SHB 0x0A0D0D0A
+#define BT_EPB 0x00000006
+#define OPT_ENDOFOPT 0
+#define OPT_COMMENT 1
+#define EPB_FLAGS 2
+#define ETH_HLEN 14
+#define PTP_HLEN 34
+
+/*
+ * A sample carries either the time stamps of a sync message, the time
+ * stamps of a delay request and response, or both. The corrections are
+ * already applied, a zero ingress or request time stamp marks the part
+ * which is not present.
+ */
+struct sample {
+	int64_t origin;		/* t1 + correction */
+	int64_t ingress;	/* t2 */
+	int64_t req;		/* t3 */
+	int64_t rx;		/* t4 - correction */
+};
+
+struct samples {
+	struct sample *s;
+	unsigned int len;
+	unsigned int max;
+};
+
+struct job {
+	const char *label;
+	struct config *cfg;
+	struct replay_result result;
+	int err;
+};
+
+struct pool {
+	struct samples *samples;
+	struct job *jobs;
+	unsigned int num_jobs;
+	unsigned int next;
+};
+
+static int samples_add(struct samples *ss, struct sample *s)
+{
+	struct sample *p;
+
+	if (ss->len == ss->max) {
+		ss->max = ss->max ? 2 * ss->max : 1024;
+		p = realloc(ss->s, ss->max * sizeof(*p));
+		if (!p)
+			return -1;
+		ss->s = p;
+	}
+	ss->s[ss->len++] = *s;
+	return 0;
+}
+
+static int read_text(FILE *fp, struct samples *ss)
+{
+	int64_t t1, t2, t3, t4, c1, c2;
+	unsigned int line = 0;
+	struct sample s;
+	char buf[256];
+	int n;
+
+	while (fgets(buf, sizeof(buf), fp)) {
+		line++;
+		if (buf[0] == '#' || buf[0] == '\n')
+			continue;
+		c2 = 0;
+		n = sscanf(buf, "%" SCNd64 " %" SCNd64 " %" SCNd64
+			   " %" SCNd64 " %" SCNd64 " %" SCNd64,
+			   &t1, &t2, &t3, &t4, &c1, &c2);
+		if (n < 5) {
+			fprintf(stderr, "line %u: expected at least 5 values\n",
+				line);
+			return -1;
+		}
+		if (n == 5)
+			c2 = c1;
+		s.origin = t1 + c1;
+		s.ingress = t2;
+		s.req = t3;
+		s.rx = t4 - c2;
+		if (samples_add(ss, &s))
+			return -1;
+	}
+	return 0;
+}
+
+static uint16_t get_be16(const unsigned char *p)
+{
+	return p[0] << 8 | p[1];
+}
+
+static uint32_t get_be32(const unsigned char *p)
+{
+	return (uint32_t) get_be16(p) << 16 | get_be16(p + 2);
+}
+
+static int64_t get_timestamp(const unsigned char *p)
+{
+	uint64_t sec = (uint64_t) get_be16(p) << 32 | get_be32(p + 2);
+
+	return sec * 1000000000LL + get_be32(p + 6);
+}
+
+static int64_t get_correction(const unsigned char *p)
+{
+	int64_t c = (int64_t) ((uint64_t) get_be32(p + 8) << 32 |
+			       get_be32(p + 12));
+
+	return c >> 16;
+}
+
+/*
+ * Extracts the time stamp used by ptp4l from the comment written by the
+ * capture, which is always the first one.
+ */
+static int get_comment_ts(const char *comment, uint16_t len, int64_t *ts)
+{
+	char buf[128];
+	int64_t sec, nsec;
+
+	if (len >= sizeof(buf))
+		len = sizeof(buf) - 1;
+	memcpy(buf, comment, len);
+	buf[len] = 0;
+	if (sscanf(buf, "%*s %" SCNd64 ".%" SCNd64, &sec, &nsec) != 2)
+		return -1;
+	*ts = sec * 1000000000LL + nsec;
+	return 0;
+}
+
+struct matcher {
+	int sync_valid;
+	uint16_t sync_seq;
+	struct sample sync;
+	int req_valid;
+	uint16_t req_seq;
+	unsigned char req_port[10];
+	int64_t req_ts;
+};
+
+/*
+ * Matches the messages of a slave port. The ts argument is the time
+ * stamp of the frame, or zero if it has none.
+ */
+static int match_frame(struct matcher *m, struct samples *ss,
+		       const unsigned char *msg, uint32_t len, int tx,
+		       int64_t ts)
+{
+	struct sample s = { 0 };
+	uint16_t seq;
+
+	if (len < PTP_HLEN)
+		return 0;
+	seq = get_be16(msg + 30);
+
+	switch (msg[0] & 0x0f) {
+	case 0x0: /* Sync */
+		if (tx || !ts || len < PTP_HLEN + 10)
+			break;
+		m->sync.origin = get_timestamp(msg + PTP_HLEN) +
+			get_correction(msg);
+		m->sync.ingress = ts;
+		m->sync_seq = seq;
+		m->sync_valid = 1;
+		if (msg[6] & 0x02)
+			break;
+		m->sync_valid = 0;
+		return samples_add(ss, &m->sync);
+	case 0x8: /* Follow_Up */
+		if (tx || !m->sync_valid || seq != m->sync_seq ||
+		    len < PTP_HLEN + 10)
+			break;
+		m->sync.origin += get_timestamp(msg + PTP_HLEN) +
+			get_correction(msg);
+		m->sync_valid = 0;
+		return samples_add(ss, &m->sync);
+	case 0x1: /* Delay_Req */
+		if (!tx || !ts)
+			break;
+		memcpy(m->req_port, msg + 20, sizeof(m->req_port));
+		m->req_seq = seq;
+		m->req_ts = ts;
+		m->req_valid = 1;
+		break;
+	case 0x9: /* Delay_Resp */
+		if (tx || !m->req_valid || seq != m->req_seq ||
+		    len < PTP_HLEN + 20 ||
+		    memcmp(msg + PTP_HLEN + 10, m->req_port,
+			   sizeof(m->req_port)))
+			break;
+		s.req = m->req_ts;
+		s.rx = get_timestamp(msg + PTP_HLEN) - get_correction(msg);
+		m->req_valid = 0;
+		return samples_add(ss, &s);
+	}
+	return 0;
+}
+
+static int read_epb(struct matcher *m, struct samples *ss,
+		    const unsigned char *blk, uint32_t len)
+{
+	uint32_t caplen, flags = 0, off;
+	uint16_t code, size;
+	int64_t ts = 0;
+
+	if (len < 32)
+		return -1;
+	memcpy(&caplen, blk + 20, sizeof(caplen));
+	off = 28 + ((caplen + 3) & ~3);
+	if (off > len - 4 || caplen < ETH_HLEN)
+		return -1;
+
+	while (off + 4 <= len - 4) {
+		memcpy(&code, blk + off, sizeof(code));
+		memcpy(&size, blk + off + 2, sizeof(size));
+		off += 4;
+		if (code == OPT_ENDOFOPT || off + size > len - 4)
+			break;
+		if (code == EPB_FLAGS && size == sizeof(flags))
+			memcpy(&flags, blk + off, sizeof(flags));
+		if (code == OPT_COMMENT &&
+		    get_comment_ts((const char *) blk + off, size, &ts))
+			ts = 0;
+		off += (size + 3) & ~3;
+	}
+	if (!(flags & 3))
+		return 0;
+
+	return match_frame(m, ss, blk + 28 + ETH_HLEN, caplen - ETH_HLEN,
+			   (flags & 3) == 2, ts);
+}
+
+static int read_pcapng(FILE *fp, struct samples *ss)
+{
+	struct matcher m = { 0 };
+	unsigned char *blk = NULL, *p;
+	uint32_t hdr[3], type, len;
+
+	while (fread(hdr, sizeof(hdr), 1, fp) == 1) {
+		type = hdr[0];
+		len = hdr[1];
+		if (type == BT_SHB && hdr[2] != 0x1A2B3C4D) {
+			fprintf(stderr, "unsupported byte order\n");
+			goto failed;
+		}
+		if (len < sizeof(hdr) + 4 || len % 4) {
+			fprintf(stderr, "bad block length %u\n", len);
+			goto failed;
+		}
+		p = realloc(blk, len);
+		if (!p)
+			goto failed;
+		blk = p;
+		memcpy(blk, hdr, sizeof(hdr));
+		if (fread(blk + sizeof(hdr), len - sizeof(hdr), 1, fp) != 1) {
+			fprintf(stderr, "truncated block\n");
+			goto failed;
+		}
+		if (type == BT_EPB && read_epb(&m, ss, blk, len))
+			goto failed;
+	}
+	free(blk);
+	return 0;
+failed:
+	free(blk);
+	return -1;
+}
+
+static int read_samples(const char *path, struct samples *ss)
+{
+	uint32_t magic;
+	FILE *fp;
+	int err;
+
+	fp = fopen(path, "r");
+	if (!fp) {
+		perror(path);
+		return -1;
+	}
+	if (fread(&magic, sizeof(magic), 1, fp) == 1 && magic == BT_SHB) {
+		rewind(fp);
+		err = read_pcapng(fp, ss);
+	} else {
+		rewind(fp);
+		err = read_text(fp, ss);
+	}
+	fclose(fp);
+	return err;
+}
+
+static void run_job(struct job *job, struct samples *ss)
+{
+	struct replay *r;
+	unsigned int i;
+
+	r = replay_create(job->cfg);
+	if (!r) {
+		job->err = 1;
+		return;
+	}
+	for (i = 0; i < ss->len; i++) {
+		if (ss->s[i].ingress)
+			replay_sync(r, ss->s[i].origin, ss->s[i].ingress);
+		if (ss->s[i].req)
+			replay_delay(r, ss->s[i].req, ss->s[i].rx);
+	}
+	replay_get_result(r, &job->result);
+	replay_destroy(r);
+}
+
+static void *worker(void *arg)
+{
+	struct pool *pool = arg;
+	unsigned int i;
+
+	while (1) {
+		i = __atomic_fetch_add(&pool->next, 1, __ATOMIC_RELAXED);
+		if (i >= pool->num_jobs)
+			break;
+		run_job(&pool->jobs[i], pool->samples);
+	}
+	return NULL;
+}
+
+static int run_pool(struct pool *pool, unsigned int threads)
+{
+	pthread_t *tid;
+	unsigned int i;
+	int err = 0;
+
+	if (threads > pool->num_jobs)
+		threads = pool->num_jobs;
+	if (threads <= 1) {
+		worker(pool);
+		return 0;
+	}
+	tid = calloc(threads, sizeof(*tid));
+	if (!tid)
+		return -1;
+	for (i = 0; i < threads; i++) {
+		if (pthread_create(&tid[i], NULL, worker, pool))
+			break;
+	}
+	if (!i)
+		err = -1;
+	while (i--)
+		pthread_join(tid[i], NULL);
+	free(tid);
+	return err;
+}
+
+static void print_results(struct job *jobs, unsigned int num_jobs)
+{
+	struct replay_result *res;
+	unsigned int i;
+
+	printf("%-4s %8s %8s %9s %10s %10s %10s %10s %10s %9s %10s\n",
+	       "cfg", "samples", "locked", "lock[s]", "rms[ns]", "mean[ns]",
+	       "sdev[ns]", "max[ns]", "freq[ppb]", "sdev[ppb]", "delay[ns]");
+	for (i = 0; i < num_jobs; i++) {
+		res = &jobs[i].result;
+		if (jobs[i].err) {
+			printf("%-4u failed\n", i);
+			continue;
+		}
+		printf("%-4u %8" PRIu64 " %8" PRIu64 " %9.3f %10.1f %10.1f"
+		       " %10.1f %10.1f %10.1f %9.1f %10.1f\n",
+		       i, res->samples, res->locked,
+		       res->lock_time < 0 ? NAN : res->lock_time / 1e9,
+		       res->offset_rms, res->offset_mean, res->offset_stddev,
+		       res->offset_max_abs, res->freq_mean, res->freq_stddev,
+		       res->delay_mean);
+	}
+	printf("\n");
+	for (i = 0; i < num_jobs; i++)
+		printf("%-4u %s\n", i, jobs[i].label);
+}
+
+static void usage(char *progname)
+{
+	fprintf(stderr,
+		"\n"
+		"usage: %s [options] file\n\n"
+		" -f [file] read the base configuration from 'file'\n"
+		" -c [opts] add a configuration with the comma separated\n"
+		"           'option=value' pairs applied to the base one\n"
+		" -j [num]  number of threads, the default is the number\n"
+		"           of online processors\n"
+		" -h        prints this message and exits\n"
+		" -v        prints the software version and exits\n"
+		"\n",
+		progname);
+}
+
+int main(int argc, char *argv[])
+{
+	const char *options[MAX_JOBS], *file = NULL;
+	struct timespec start, end;
+	struct samples ss = { 0 };
+	unsigned int i, num_options = 0;
+	struct pool pool = { 0 };
+	int64_t first;
+	long threads;
+	char *progname;
+	double span;
+	int c, err = -1;
+
+	threads = sysconf(_SC_NPROCESSORS_ONLN);
+
+	progname = strrchr(argv[0], '/');
+	progname = progname ? 1 + progname : argv[0];
+	while (EOF != (c = getopt(argc, argv, "c:f:j:hv"))) {
+		switch (c) {
+		case 'c':
+			if (num_options == MAX_JOBS) {
+				fprintf(stderr, "too many configurations\n");
+				return -1;
+			}
+			options[num_options++] = optarg;
+			break;
+		case 'f':
+			file = optarg;
+			break;
+		case 'j':
+			threads = atol(optarg);
+			if (threads < 1) {
+				usage(progname);
+				return -1;
+			}
+			break;
+		case 'v':
+			version_show(stdout);
+			return 0;
+		case 'h':
+			usage(progname);
+			return 0;
+		case '?':
+		default:
+			usage(progname);
+			return -1;
+		}
+	}
+	if (optind != argc - 1) {
+		usage(progname);
+		return -1;
+	}
+
+	print_set_progname(progname);
+	print_set_syslog(0);
+	print_set_verbose(1);
+	print_set_level(LOG_WARNING);
+
+	if (read_samples(argv[optind], &ss))
+		goto out;
+	if (!ss.len) {
+		fprintf(stderr, "%s: no time stamps found\n", argv[optind]);
+		goto out;
+	}
+
+	pool.samples = &ss;
+	pool.num_jobs = num_options ? num_options : 1;
+	pool.jobs = calloc(pool.num_jobs, sizeof(*pool.jobs));
+	if (!pool.jobs)
+		goto out;
+	for (i = 0; i < pool.num_jobs; i++) {
+		pool.jobs[i].label = num_options ? options[i] : "default";
+		pool.jobs[i].cfg = replay_config_create(file, num_options ?
+							options[i] : NULL);
+		if (!pool.jobs[i].cfg)
+			goto out;
+	}
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	if (run_pool(&pool, threads))
+		goto out;
+	clock_gettime(CLOCK_MONOTONIC, &end);
+
+	for (i = 0, first = 0, span = 0; i < ss.len; i++) {
+		if (!ss.s[i].ingress)
+			continue;
+		if (!first)
+			first = ss.s[i].ingress;
+		span = (ss.s[i].ingress - first) / 1e9;
+	}
+	printf("%u samples, %.1f s of time stamps, %u configurations "
+	       "replayed in %.3f s\n\n", ss.len, span, pool.num_jobs,
+	       end.tv_sec - start.tv_sec + (end.tv_nsec - start.tv_nsec) / 1e9);
+	print_results(pool.jobs, pool.num_jobs);
+	err = 0;
+out:
+	if (pool.jobs) {
+		for (i = 0; i < pool.num_jobs; i++) {
+			if (pool.jobs[i].cfg)
+				config_destroy(pool.jobs[i].cfg);
+		}
+		free(pool.jobs);
+	}
+	free(ss.s);
+	return err;
+}
@@ -0,0 +1,1109 @@
+/**
+ * @file ptp_sim.c
+ * @brief Runs many PTP clocks in one process on a simulated network.
+ * @note Copyright (C) 2026 The linuxptp contributors
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+/*
+ * The clocks run unmodified on virtual time. The program is linked with
+ * the --wrap option of the linker for the functions which read the time,
+ * arm the timers, wait for events and access the PHC, see the makefile.
+ * The timers are event descriptors which become readable when the
+ * simulation reaches their expiration time, the PHCs are models with a
+ * frequency error and the network is a set of segments, which deliver
+ * the frames with a delay and hardware time stamps taken from the PHCs.
+ */
+#include <errno.h>
+#include <inttypes.h>
+#include <linux/net_tstamp.h>
+#include <math.h>
+#include <poll.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <sys/timerfd.h>
+#include <sys/uio.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "clock.h"
+#include "config.h"
+#include "ds.h"
+#include "missing.h"
+#include "pqueue.h"
+#include "print.h"
+#include "servo.h"
+#include "simnet.h"
+#include "sk.h"
+#include "transport.h"
+#include "util.h"
+#include "version.h"
+
+#define NS_PER_SEC		1000000000LL
+#define SIM_PHC_INDEX		1000
+#define SIM_CLOCK_FD		0x1000000
+#define SIM_TIMER_FD		0x100000
+#define SIM_TAI_OFFSET		(1700000000LL * NS_PER_SEC)
+#define SIM_SAMPLE_INTERVAL	(NS_PER_SEC / 8)
+#define SIM_MAX_POLLS		64
+#define SIM_MAX_ADJ		500000
+
+/*
+ * The parameters of the simulated system. Each PHC starts with a random
+ * offset and has a random constant frequency error, each frame is
+ * delayed by the base delay plus an exponentially distributed queuing
+ * delay and each time stamp has a Gaussian noise.
+ */
+struct model {
+	double duration;	/* s */
+	double delay;		/* ns */
+	double pdv;		/* ns */
+	double ts_noise;	/* ns */
+	double freq;		/* ppb */
+	double offset;		/* ns */
+	double seed;
+};
+
+static struct model model = {
+	.duration = 300,
+	.delay = 1000,
+	.pdv = 50,
+	.ts_noise = 8,
+	.freq = 50000,
+	.offset = 1000000,
+	.seed = 1,
+};
+
+static struct {
+	const char *name;
+	double *val;
+} model_tab[] = {
+	{ "duration", &model.duration },
+	{ "delay", &model.delay },
+	{ "pdv", &model.pdv },
+	{ "ts_noise", &model.ts_noise },
+	{ "freq", &model.freq },
+	{ "offset", &model.offset },
+	{ "seed", &model.seed },
+};
+
+struct sim_segment;
+
+struct sim_port {
+	struct sim_node *node;
+	struct sim_segment *seg;
+	char name[32];
+	int fd;			/* read by the transport */
+	int peer;		/* written by the network */
+	int64_t last_rx;	/* the frames are received in order */
+};
+
+struct sim_segment {
+	struct sim_port **ports;
+	unsigned int nports;
+};
+
+struct sim_node {
+	char name[16];
+	unsigned int index;
+	unsigned int depth;
+	struct sim_port *ports;
+	unsigned int nports;
+	struct config *cfg;
+	struct clock *clock;
+	/* The simulated PHC. */
+	int64_t phc_base;	/* PHC time at vt_base */
+	double phc_frac;
+	int64_t vt_base;
+	double hw_freq;		/* ppb */
+	double adj_freq;	/* ppb */
+	/* The statistics. */
+	struct ClockIdentity gm;
+	int64_t gm_changed;
+	int64_t lock_time;
+	double err_sum2;
+	double err_max;
+	uint64_t err_num;
+};
+
+/*
+ * The timers are not backed by descriptors of the kernel. They are given
+ * numbers above any real descriptor, which the poll wrapper recognizes.
+ */
+struct sim_timer {
+	struct sim_node *node;	/* NULL if unused */
+	unsigned int gen;
+	int expired;
+	int64_t interval;
+};
+
+enum sim_event_type {
+	SIM_EV_TIMER,
+	SIM_EV_FRAME,
+	SIM_EV_SAMPLE,
+};
+
+struct sim_event {
+	int64_t time;
+	uint64_t seq;
+	enum sim_event_type type;
+	int fd;
+	unsigned int gen;
+	struct sim_port *dst;
+	int len;
+	unsigned char buf[];
+};
+
+static struct {
+	int64_t now;
+	int64_t end;
+	uint64_t seq;
+	uint64_t events;
+	uint64_t frames;
+	uint64_t dropped;
+	uint64_t rng;
+	int poll_result;
+	struct pqueue *queue;
+	struct sim_node *current;
+	struct sim_node *nodes;
+	unsigned int num_nodes;
+	struct sim_segment *segs;
+	unsigned int num_segs;
+	struct sim_port **fds;
+	int num_fds;
+	struct sim_timer *timers;
+	int num_timers;
+} sim;
+
+int __real_clock_gettime(clockid_t clkid, struct timespec *ts);
+int __real_close(int fd);
+clockid_t __real_phc_open(const char *phc);
+void __real_phc_close(clockid_t clkid);
+int __real_phc_max_adj(clockid_t clkid);
+int __real_poll(struct pollfd *fds, nfds_t nfds, int timeout);
+void __real_clockadj_set_freq(clockid_t clkid, double freq);
+double __real_clockadj_get_freq(clockid_t clkid);
+void __real_clockadj_step(clockid_t clkid, int64_t step);
+int __real_sk_get_ts_info(const char *name, struct sk_ts_info *sk_info);
+int __real_rtnl_get_ts_device(char *device, char *ts_device);
+int __real_timerfd_settime(int fd, int flags, const struct itimerspec *new,
+			   struct itimerspec *old);
+
+static double rnd_uniform(void)
+{
+	/* xorshift64* */
+	sim.rng ^= sim.rng >> 12;
+	sim.rng ^= sim.rng << 25;
+	sim.rng ^= sim.rng >> 27;
+	return ((sim.rng * 2685821657736338717ULL) >> 11) * 0x1.0p-53;
+}
+
+static double rnd_gauss(void)
+{
+	double u = rnd_uniform(), v = rnd_uniform();
+
+	return sqrt(-2.0 * log(1.0 - u)) * cos(2.0 * M_PI * v);
+}
+
+static struct timespec ns_to_timespec(int64_t ns)
+{
+	struct timespec ts;
+
+	ts.tv_sec = ns / NS_PER_SEC;
+	ts.tv_nsec = ns % NS_PER_SEC;
+	if (ts.tv_nsec < 0) {
+		ts.tv_sec--;
+		ts.tv_nsec += NS_PER_SEC;
+	}
+	return ts;
+}
+
+static int64_t timespec_to_ns(const struct timespec *ts)
+{
+	return ts->tv_sec * NS_PER_SEC + ts->tv_nsec;
+}
+
+/* The simulated PHC */
+
+static double phc_elapsed(struct sim_node *n)
+{
+	return n->phc_frac + (sim.now - n->vt_base) *
+		(1.0 + (n->hw_freq + n->adj_freq) * 1e-9);
+}
+
+static int64_t phc_time(struct sim_node *n)
+{
+	return n->phc_base + (int64_t) floor(phc_elapsed(n));
+}
+
+/* Moves the reference point of the PHC to the current time. */
+static void phc_update(struct sim_node *n)
+{
+	double d = phc_elapsed(n), i = floor(d);
+
+	n->phc_base += (int64_t) i;
+	n->phc_frac = d - i;
+	n->vt_base = sim.now;
+}
+
+static struct sim_node *clkid_node(clockid_t clkid)
+{
+	unsigned int fd;
+
+	if ((clkid & 7) != CLOCKFD)
+		return NULL;
+	fd = CLOCKID_TO_FD(clkid);
+	if (fd < SIM_CLOCK_FD || fd >= SIM_CLOCK_FD + sim.num_nodes)
+		return NULL;
+	return &sim.nodes[fd - SIM_CLOCK_FD];
+}
+
+static struct sim_port *name_port(const char *name)
+{
+	unsigned int node, port;
+	char end;
+
+	if (sscanf(name, "n%u.%u%c", &node, &port, &end) != 2 ||
+	    node >= sim.num_nodes || port >= sim.nodes[node].nports)
+		return NULL;
+	return &sim.nodes[node].ports[port];
+}
+
+/* The descriptor tables */
+
+static int fd_set_port(int fd, struct sim_port *p)
+{
+	struct sim_port **fds;
+	int num;
+
+	if (fd >= sim.num_fds) {
+		num = fd + 1 > 2 * sim.num_fds ? fd + 1 : 2 * sim.num_fds;
+		fds = realloc(sim.fds, num * sizeof(*fds));
+		if (!fds)
+			return -1;
+		memset(fds + sim.num_fds, 0,
+		       (num - sim.num_fds) * sizeof(*fds));
+		sim.fds = fds;
+		sim.num_fds = num;
+	}
+	sim.fds[fd] = p;
+	return 0;
+}
+
+static struct sim_port *fd_port(int fd)
+{
+	if (fd < 0 || fd >= sim.num_fds)
+		return NULL;
+	return sim.fds[fd];
+}
+
+static struct sim_timer *fd_timer(int fd)
+{
+	if (fd < SIM_TIMER_FD || fd - SIM_TIMER_FD >= sim.num_timers ||
+	    !sim.timers[fd - SIM_TIMER_FD].node)
+		return NULL;
+	return &sim.timers[fd - SIM_TIMER_FD];
+}
+
+static int timer_alloc(struct sim_node *n)
+{
+	struct sim_timer *timers;
+	int i, num;
+
+	for (i = 0; i < sim.num_timers; i++) {
+		if (!sim.timers[i].node)
+			break;
+	}
+	if (i == sim.num_timers) {
+		num = sim.num_timers ? 2 * sim.num_timers : 64;
+		timers = realloc(sim.timers, num * sizeof(*timers));
+		if (!timers)
+			return -1;
+		memset(timers + sim.num_timers, 0,
+		       (num - sim.num_timers) * sizeof(*timers));
+		sim.timers = timers;
+		sim.num_timers = num;
+	}
+	sim.timers[i].node = n;
+	sim.timers[i].expired = 0;
+	return SIM_TIMER_FD + i;
+}
+
+/* The event queue */
+
+static int event_cmp(void *a, void *b)
+{
+	struct sim_event *x = a, *y = b;
+
+	if (x->time != y->time)
+		return x->time < y->time ? 1 : -1;
+	return x->seq < y->seq ? 1 : -1;
+}
+
+static struct sim_event *event_alloc(int64_t time, enum sim_event_type type,
+				     int len)
+{
+	struct sim_event *ev;
+
+	ev = malloc(sizeof(*ev) + len);
+	if (!ev)
+		return NULL;
+	ev->time = time;
+	ev->seq = sim.seq++;
+	ev->type = type;
+	ev->len = len;
+	return ev;
+}
+
+static int event_schedule(struct sim_event *ev)
+{
+	if (pqueue_insert(sim.queue, ev)) {
+		pr_err("sim: failed to schedule an event");
+		free(ev);
+		return -1;
+	}
+	return 0;
+}
+
+static void timer_schedule(int fd, struct sim_timer *t, int64_t time)
+{
+	struct sim_event *ev;
+
+	ev = event_alloc(time, SIM_EV_TIMER, 0);
+	if (!ev)
+		return;
+	ev->fd = fd;
+	ev->gen = t->gen;
+	event_schedule(ev);
+}
+
+/* The wrapped functions */
+
+int __wrap_clock_gettime(clockid_t clkid, struct timespec *ts)
+{
+	struct sim_node *n = clkid_node(clkid);
+
+	if (n) {
+		*ts = ns_to_timespec(phc_time(n));
+		return 0;
+	}
+	switch (clkid) {
+	case CLOCK_MONOTONIC:
+	case CLOCK_MONOTONIC_RAW:
+	case CLOCK_BOOTTIME:
+		*ts = ns_to_timespec(sim.now);
+		return 0;
+	case CLOCK_REALTIME:
+	case CLOCK_TAI:
+		*ts = ns_to_timespec(sim.now + SIM_TAI_OFFSET);
+		return 0;
+	}
+	return __real_clock_gettime(clkid, ts);
+}
+
+int __wrap_timerfd_create(int clockid, int flags)
+{
+	int fd;
+
+	fd = timer_alloc(sim.current);
+	if (fd < 0)
+		errno = ENOMEM;
+	return fd;
+}
+
+int __wrap_timerfd_settime(int fd, int flags, const struct itimerspec *new,
+			   struct itimerspec *old)
+{
+	struct sim_timer *t = fd_timer(fd);
+	int64_t expiry;
+
+	if (!t)
+		return __real_timerfd_settime(fd, flags, new, old);
+	if (old)
+		memset(old, 0, sizeof(*old));
+
+	/* Re-arming the timer clears the pending expiration. */
+	t->expired = 0;
+	t->gen++;
+
+	expiry = timespec_to_ns(&new->it_value);
+	if (!expiry)
+		return 0;
+	if (!(flags & TFD_TIMER_ABSTIME))
+		expiry += sim.now;
+	if (expiry < sim.now)
+		expiry = sim.now;
+	t->interval = timespec_to_ns(&new->it_interval);
+	timer_schedule(fd, t, expiry);
+	return 0;
+}
+
+int __wrap_close(int fd)
+{
+	struct sim_timer *t = fd_timer(fd);
+
+	if (t) {
+		t->node = NULL;
+		t->gen++;
+		return 0;
+	}
+	return __real_close(fd);
+}
+
+int __wrap_poll(struct pollfd *fds, nfds_t nfds, int timeout)
+{
+	struct sim_timer *t;
+	int cnt = 0;
+	nfds_t i;
+
+	/* Hide the timers from the kernel. */
+	for (i = 0; i < nfds; i++) {
+		if (fds[i].fd >= SIM_TIMER_FD)
+			fds[i].fd = ~fds[i].fd;
+	}
+	/* Time only advances between the events. */
+	if (__real_poll(fds, nfds, 0) > 0) {
+		for (i = 0; i < nfds; i++)
+			cnt += fds[i].revents ? 1 : 0;
+	}
+	for (i = 0; i < nfds; i++) {
+		if (fds[i].fd > ~SIM_TIMER_FD)
+			continue;
+		fds[i].fd = ~fds[i].fd;
+		t = fd_timer(fds[i].fd);
+		if (t && t->expired) {
+			fds[i].revents = POLLIN;
+			cnt++;
+		}
+	}
+	sim.poll_result = cnt;
+	return cnt;
+}
+
+clockid_t __wrap_phc_open(const char *phc)
+{
+	int index;
+
+	if (sscanf(phc, "/dev/ptp%d", &index) == 1 &&
+	    index >= SIM_PHC_INDEX && index < SIM_PHC_INDEX + sim.num_nodes)
+		return FD_TO_CLOCKID((SIM_CLOCK_FD + index - SIM_PHC_INDEX));
+	return __real_phc_open(phc);
+}
+
+void __wrap_phc_close(clockid_t clkid)
+{
+	if (!clkid_node(clkid))
+		__real_phc_close(clkid);
+}
+
+int __wrap_phc_max_adj(clockid_t clkid)
+{
+	if (clkid_node(clkid))
+		return SIM_MAX_ADJ;
+	return __real_phc_max_adj(clkid);
+}
+
+void __wrap_clockadj_set_freq(clockid_t clkid, double freq)
+{
+	struct sim_node *n = clkid_node(clkid);
+
+	if (!n) {
+		__real_clockadj_set_freq(clkid, freq);
+		return;
+	}
+	phc_update(n);
+	n->adj_freq = freq;
+}
+
+double __wrap_clockadj_get_freq(clockid_t clkid)
+{
+	struct sim_node *n = clkid_node(clkid);
+
+	if (!n)
+		return __real_clockadj_get_freq(clkid);
+	return n->adj_freq;
+}
+
+void __wrap_clockadj_step(clockid_t clkid, int64_t step)
+{
+	struct sim_node *n = clkid_node(clkid);
+
+	if (!n) {
+		__real_clockadj_step(clkid, step);
+		return;
+	}
+	phc_update(n);
+	n->phc_base += step;
+}
+
+int __wrap_sk_get_ts_info(const char *name, struct sk_ts_info *sk_info)
+{
+	struct sim_port *p = name_port(name);
+
+	if (!p)
+		return __real_sk_get_ts_info(name, sk_info);
+	memset(sk_info, 0, sizeof(*sk_info));
+	sk_info->valid = 1;
+	sk_info->phc_index = SIM_PHC_INDEX + p->node->index;
+	sk_info->so_timestamping = SOF_TIMESTAMPING_TX_HARDWARE |
+		SOF_TIMESTAMPING_RX_HARDWARE | SOF_TIMESTAMPING_RAW_HARDWARE |
+		SOF_TIMESTAMPING_TX_SOFTWARE | SOF_TIMESTAMPING_RX_SOFTWARE |
+		SOF_TIMESTAMPING_SOFTWARE;
+	sk_info->tx_types = 1 << HWTSTAMP_TX_ON;
+	sk_info->rx_filters = 1 << HWTSTAMP_FILTER_ALL;
+	return 0;
+}
+
+int __wrap_rtnl_get_ts_device(char *device, char *ts_device)
+{
+	if (name_port(device))
+		return 0;
+	return __real_rtnl_get_ts_device(device, ts_device);
+}
+
+int __wrap_rtnl_open(void)
+{
+	/* The simulated links never go down. */
+	return -1;
+}
+
+/* The simulated network */
+
+static int net_open(void *ctx, const char *name)
+{
+	struct sim_port *p = name_port(name);
+	int sv[2];
+
+	if (!p || p->fd >= 0)
+		return -1;
+	if (socketpair(AF_UNIX, SOCK_SEQPACKET | SOCK_NONBLOCK | SOCK_CLOEXEC,
+		       0, sv)) {
+		pr_err("sim: socketpair failed: %m");
+		return -1;
+	}
+	if (fd_set_port(sv[0], p)) {
+		__real_close(sv[0]);
+		__real_close(sv[1]);
+		return -1;
+	}
+	p->fd = sv[0];
+	p->peer = sv[1];
+	return p->fd;
+}
+
+static void net_close(void *ctx, int fd)
+{
+	struct sim_port *p = fd_port(fd);
+
+	if (!p)
+		return;
+	sim.fds[fd] = NULL;
+	p->fd = -1;
+	__real_close(p->peer);
+	__real_close(fd);
+}
+
+static int64_t ts_noise(void)
+{
+	return llround(model.ts_noise * rnd_gauss());
+}
+
+static int net_send(void *ctx, int fd, enum transport_event event,
+		    const void *buf, int len, struct timespec *ts)
+{
+	struct sim_port *p = fd_port(fd);
+	struct sim_segment *seg;
+	struct sim_event *ev;
+	struct sim_port *dst;
+	int64_t rx_time;
+	unsigned int i;
+
+	if (!p)
+		return -1;
+	*ts = ns_to_timespec(phc_time(p->node) + ts_noise());
+
+	seg = p->seg;
+	for (i = 0; i < seg->nports; i++) {
+		dst = seg->ports[i];
+		if (dst == p)
+			continue;
+		rx_time = sim.now + llround(model.delay - model.pdv *
+					    log(1.0 - rnd_uniform()));
+		if (rx_time < dst->last_rx)
+			rx_time = dst->last_rx;
+		dst->last_rx = rx_time;
+		ev = event_alloc(rx_time, SIM_EV_FRAME, len);
+		if (!ev)
+			return -1;
+		ev->dst = dst;
+		memcpy(ev->buf, buf, len);
+		if (event_schedule(ev))
+			return -1;
+	}
+	return len;
+}
+
+static const struct simnet_ops net_ops = {
+	.open = net_open,
+	.close = net_close,
+	.send = net_send,
+};
+
+static void node_poll(struct sim_node *n)
+{
+	int i;
+
+	sim.current = n;
+	print_set_progname(n->name);
+	for (i = 0; i < SIM_MAX_POLLS; i++) {
+		if (clock_poll(n->clock)) {
+			pr_err("sim: clock failed");
+			break;
+		}
+		if (sim.poll_result <= 0)
+			break;
+	}
+}
+
+static struct sim_node *deliver(struct sim_event *ev)
+{
+	struct sim_port *p = ev->dst;
+	struct simnet_hdr hdr;
+	struct iovec iov[2] = {
+		{ &hdr, sizeof(hdr) },
+		{ ev->buf, ev->len },
+	};
+
+	if (p->fd < 0)
+		return NULL;
+	hdr.ts = ns_to_timespec(phc_time(p->node) + ts_noise());
+	if (writev(p->peer, iov, 2) < 0) {
+		sim.dropped++;
+		return NULL;
+	}
+	sim.frames++;
+	return p->node;
+}
+
+static struct sim_node *expire(struct sim_event *ev)
+{
+	struct sim_timer *t = fd_timer(ev->fd);
+
+	if (!t || t->gen != ev->gen)
+		return NULL;
+	t->expired = 1;
+	if (t->interval)
+		timer_schedule(ev->fd, t, sim.now + t->interval);
+	return t->node;
+}
+
+static void sample(void)
+{
+	struct sim_node *gm = &sim.nodes[0], *n;
+	int64_t gm_time = phc_time(gm);
+	enum servo_state state;
+	struct ClockIdentity id;
+	unsigned int i;
+	double err;
+
+	for (i = 0; i < sim.num_nodes; i++) {
+		n = &sim.nodes[i];
+		id = clock_parent_ds(n->clock)->pds.grandmasterIdentity;
+		if (!cid_eq(&id, &n->gm)) {
+			n->gm = id;
+			n->gm_changed = sim.now;
+		}
+		if (!i)
+			continue;
+		state = clock_servo_state(n->clock);
+		if (n->lock_time < 0 &&
+		    (state == SERVO_LOCKED || state == SERVO_LOCKED_STABLE))
+			n->lock_time = sim.now;
+		/* The time error is measured over the second half. */
+		if (2 * sim.now < sim.end)
+			continue;
+		err = phc_time(n) - gm_time;
+		n->err_sum2 += err * err;
+		if (fabs(err) > n->err_max)
+			n->err_max = fabs(err);
+		n->err_num++;
+	}
+}
+
+static int run(void)
+{
+	struct sim_event *ev;
+	struct sim_node *n;
+
+	ev = event_alloc(sim.now, SIM_EV_SAMPLE, 0);
+	if (!ev || event_schedule(ev))
+		return -1;
+
+	while ((ev = pqueue_peek(sim.queue)) && ev->time <= sim.end) {
+		pqueue_extract(sim.queue);
+		sim.now = ev->time;
+		sim.events++;
+		n = NULL;
+		switch (ev->type) {
+		case SIM_EV_TIMER:
+			n = expire(ev);
+			break;
+		case SIM_EV_FRAME:
+			n = deliver(ev);
+			break;
+		case SIM_EV_SAMPLE:
+			sample();
+			ev->time += SIM_SAMPLE_INTERVAL;
+			ev->seq = sim.seq++;
+			if (event_schedule(ev))
+				return -1;
+			continue;
+		}
+		free(ev);
+		if (n)
+			node_poll(n);
+	}
+	return 0;
+}
+
+/* The topology */
+
+/*
+ * Builds a tree with the given fanout, where node 0 is the root and the
+ * parent of node i is node (i - 1) / fanout. Every link is a segment
+ * with two ports. With a zero fanout all nodes share a single segment.
+ */
+static int build_topology(unsigned int fanout)
+{
+	unsigned int i, j, parent;
+	struct sim_node *n;
+	struct sim_port *p;
+
+	sim.num_segs = fanout ? sim.num_nodes - 1 : 1;
+	sim.segs = calloc(sim.num_segs, sizeof(*sim.segs));
+	if (!sim.segs)
+		return -1;
+	for (i = 0; i < sim.num_segs; i++) {
+		sim.segs[i].ports = calloc(fanout ? 2 : sim.num_nodes,
+					   sizeof(*sim.segs[i].ports));
+		if (!sim.segs[i].ports)
+			return -1;
+	}
+
+	for (i = 0; i < sim.num_nodes; i++) {
+		n = &sim.nodes[i];
+		n->index = i;
+		snprintf(n->name, sizeof(n->name), "n%u", i);
+		if (!fanout) {
+			n->nports = 1;
+		} else {
+			n->nports = i ? 1 : 0;
+			for (j = fanout * i + 1; j <= fanout * i + fanout &&
+			     j < sim.num_nodes; j++)
+				n->nports++;
+		}
+		n->ports = calloc(n->nports, sizeof(*n->ports));
+		if (!n->ports)
+			return -1;
+		for (j = 0; j < n->nports; j++) {
+			p = &n->ports[j];
+			p->node = n;
+			p->fd = -1;
+			p->peer = -1;
+			snprintf(p->name, sizeof(p->name), "n%u.%u", i, j);
+		}
+	}
+
+	for (i = 0; i < sim.num_nodes; i++) {
+		n = &sim.nodes[i];
+		if (!fanout) {
+			n->depth = i ? 1 : 0;
+			n->ports[0].seg = &sim.segs[0];
+			sim.segs[0].ports[sim.segs[0].nports++] = &n->ports[0];
+			continue;
+		}
+		if (!i)
+			continue;
+		/* Port 0 leads to the parent, the other ports to children. */
+		parent = (i - 1) / fanout;
+		n->depth = sim.nodes[parent].depth + 1;
+		j = (i - 1) % fanout + (parent ? 1 : 0);
+		p = &sim.nodes[parent].ports[j];
+		p->seg = &sim.segs[i - 1];
+		n->ports[0].seg = &sim.segs[i - 1];
+		sim.segs[i - 1].ports[0] = p;
+		sim.segs[i - 1].ports[1] = &n->ports[0];
+		sim.segs[i - 1].nports = 2;
+	}
+	return 0;
+}
+
+static int create_node(struct sim_node *n, char *file)
+{
+	char buf[64];
+	unsigned int j;
+
+	n->cfg = config_create();
+	if (!n->cfg)
+		return -1;
+	if (file && config_read(file, n->cfg)) {
+		fprintf(stderr, "failed to read %s\n", file);
+		return -1;
+	}
+	for (j = 0; j < n->nports; j++) {
+		if (!config_create_interface(n->ports[j].name, n->cfg) ||
+		    config_set_section_int(n->cfg, n->ports[j].name,
+					   "network_transport", TRANS_SIM))
+			return -1;
+	}
+	snprintf(buf, sizeof(buf), "000000.fffe.%06x", n->index + 1);
+	if (config_set_string(n->cfg, "clockIdentity", buf))
+		return -1;
+	snprintf(buf, sizeof(buf), "/tmp/ptp_sim.%d.%u", getpid(), n->index);
+	if (config_set_string(n->cfg, "uds_address", buf))
+		return -1;
+	if (!n->index && config_set_int(n->cfg, "priority1", 127))
+		return -1;
+
+	n->phc_base = SIM_TAI_OFFSET + CURRENT_UTC_OFFSET * NS_PER_SEC +
+		llround(model.offset * (2.0 * rnd_uniform() - 1.0));
+	n->vt_base = sim.now;
+	n->hw_freq = model.freq * (2.0 * rnd_uniform() - 1.0);
+	n->lock_time = -1;
+
+	sim.current = n;
+	print_set_progname(n->name);
+	n->clock = clock_create(n->nports > 1 ? CLOCK_TYPE_BOUNDARY :
+				CLOCK_TYPE_ORDINARY, n->cfg, NULL);
+	if (!n->clock) {
+		fprintf(stderr, "failed to create clock %s\n", n->name);
+		return -1;
+	}
+	return 0;
+}
+
+static void raise_fd_limit(void)
+{
+	struct rlimit rlim;
+
+	if (getrlimit(RLIMIT_NOFILE, &rlim))
+		return;
+	rlim.rlim_cur = rlim.rlim_max;
+	setrlimit(RLIMIT_NOFILE, &rlim);
+}
+
+static int parse_model(char *options)
+{
+	char *opt, *val, *save = NULL;
+	unsigned int i;
+
+	for (opt = strtok_r(options, ",", &save); opt;
+	     opt = strtok_r(NULL, ",", &save)) {
+		val = strchr(opt, '=');
+		if (!val) {
+			fprintf(stderr, "missing value of parameter %s\n", opt);
+			return -1;
+		}
+		*val++ = 0;
+		for (i = 0; i < sizeof(model_tab) / sizeof(model_tab[0]); i++) {
+			if (!strcmp(model_tab[i].name, opt))
+				break;
+		}
+		if (i == sizeof(model_tab) / sizeof(model_tab[0])) {
+			fprintf(stderr, "unknown model parameter %s\n", opt);
+			return -1;
+		}
+		if (sscanf(val, "%lf", model_tab[i].val) != 1) {
+			fprintf(stderr, "bad value %s of parameter %s\n",
+				val, opt);
+			return -1;
+		}
+	}
+	if (model.duration <= 0 || model.delay < 0 || model.pdv < 0 ||
+	    model.ts_noise < 0 || model.offset < 0 ||
+	    fabs(model.freq) > SIM_MAX_ADJ / 2) {
+		fprintf(stderr, "model parameter out of range\n");
+		return -1;
+	}
+	return 0;
+}
+
+static void print_results(void)
+{
+	double lock_sum, lock_max, err_sum2, err_max;
+	unsigned int i, depth, max_depth = 0;
+	unsigned int nodes, locked;
+	struct ClockIdentity gm;
+	int64_t converged = 0;
+	uint64_t err_num;
+	struct sim_node *n;
+	int agree = 1;
+
+	gm = clock_identity(sim.nodes[0].clock);
+
+	for (i = 0; i < sim.num_nodes; i++) {
+		n = &sim.nodes[i];
+		if (n->depth > max_depth)
+			max_depth = n->depth;
+		if (n->gm_changed > converged)
+			converged = n->gm_changed;
+		if (!cid_eq(&n->gm, &gm))
+			agree = 0;
+	}
+	if (agree)
+		printf("BMCA converged after %.3f s\n\n", converged / 1e9);
+	else
+		printf("BMCA did not converge\n\n");
+
+	printf("depth nodes locked  lock[s]    max[s]   rms[ns]   max[ns]\n");
+	for (depth = 1; depth <= max_depth; depth++) {
+		nodes = locked = 0;
+		lock_sum = lock_max = err_sum2 = err_max = 0.0;
+		err_num = 0;
+		for (i = 1; i < sim.num_nodes; i++) {
+			n = &sim.nodes[i];
+			if (n->depth != depth)
+				continue;
+			nodes++;
+			err_sum2 += n->err_sum2;
+			err_num += n->err_num;
+			if (n->err_max > err_max)
+				err_max = n->err_max;
+			if (n->lock_time < 0)
+				continue;
+			locked++;
+			lock_sum += n->lock_time / 1e9;
+			if (n->lock_time / 1e9 > lock_max)
+				lock_max = n->lock_time / 1e9;
+		}
+		printf("%5u %5u %6u %8.3f %9.3f %9.1f %9.0f\n",
+		       depth, nodes, locked, locked ? lock_sum / locked : 0.0,
+		       lock_max, err_num ? sqrt(err_sum2 / err_num) : 0.0,
+		       err_max);
+	}
+}
+
+static void usage(char *progname)
+{
+	fprintf(stderr,
+		"\n"
+		"usage: %s [options]\n\n"
+		" -f [file] read the configuration of the clocks from 'file'\n"
+		" -n [num]  number of clocks, the default is 10\n"
+		" -k [num]  fanout of the tree, the default is 1 (a chain),\n"
+		"           0 connects all clocks to a single segment\n"
+		" -m [opts] set the comma separated 'parameter=value' pairs\n"
+		"           of the oscillator and network model\n"
+		" -l [num]  set the logging level to 'num' (%d)\n"
+		" -h        prints this message and exits\n"
+		" -v        prints the software version and exits\n"
+		"\n",
+		progname, LOG_WARNING);
+}
+
+int main(int argc, char *argv[])
+{
+	int c, err = -1, print_level = LOG_WARNING;
+	unsigned int i, fanout = 1, num_nodes = 10;
+	struct timespec start, end;
+	char *progname, *file = NULL;
+
+	progname = strrchr(argv[0], '/');
+	progname = progname ? 1 + progname : argv[0];
+	while (EOF != (c = getopt(argc, argv, "f:k:l:m:n:hv"))) {
+		switch (c) {
+		case 'f':
+			file = optarg;
+			break;
+		case 'k':
+			fanout = atoi(optarg);
+			break;
+		case 'l':
+			if (get_arg_val_i(c, optarg, &print_level,
+					  PRINT_LEVEL_MIN, PRINT_LEVEL_MAX))
+				return -1;
+			break;
+		case 'm':
+			if (parse_model(optarg))
+				return -1;
+			break;
+		case 'n':
+			num_nodes = atoi(optarg);
+			break;
+		case 'v':
+			version_show(stdout);
+			return 0;
+		case 'h':
+			usage(progname);
+			return 0;
+		case '?':
+		default:
+			usage(progname);
+			return -1;
+		}
+	}
+	if (optind != argc || num_nodes < 2) {
+		usage(progname);
+		return -1;
+	}
+
+	print_set_syslog(0);
+	print_set_verbose(1);
+	print_set_level(print_level);
+	raise_fd_limit();
+
+	sim.rng = model.seed ? (uint64_t) model.seed : 1;
+	sim.num_nodes = num_nodes;
+	sim.nodes = calloc(num_nodes, sizeof(*sim.nodes));
+	sim.queue = pqueue_create(1024, event_cmp);
+	if (!sim.nodes || !sim.queue || build_topology(fanout))
+		goto out;
+	simnet_set_ops(&net_ops, NULL);
+	transport_set_sim(simnet_transport_create);
+
+	__real_clock_gettime(CLOCK_MONOTONIC, &start);
+	sim.now = NS_PER_SEC;
+	for (i = 0; i < num_nodes; i++) {
+		if (create_node(&sim.nodes[i], file))
+			goto out;
+		/* Let the clocks start at different times. */
+		sim.now += 1000;
+	}
+	sim.end = sim.now + llround(model.duration * NS_PER_SEC);
+	if (run())
+		goto out;
+	__real_clock_gettime(CLOCK_MONOTONIC, &end);
+	print_set_progname(progname);
+
+	printf("%u clocks, %.0f s simulated in %.3f s, %" PRIu64 " events, "
+	       "%" PRIu64 " frames, %" PRIu64 " dropped\n",
+	       num_nodes, model.duration,
+	       end.tv_sec - start.tv_sec + (end.tv_nsec - start.tv_nsec) / 1e9,
+	       sim.events, sim.frames, sim.dropped);
+	print_results();
+	err = 0;
+out:
+	for (i = 0; sim.nodes && i < num_nodes; i++) {
+		if (sim.nodes[i].clock)
+			clock_destroy(sim.nodes[i].clock);
+		if (sim.nodes[i].cfg)
+			config_destroy(sim.nodes[i].cfg);
+	}
+	return err;
+}
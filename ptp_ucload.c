@@ -0,0 +1,764 @@
+/**
+ * @file ptp_ucload.c
+ * @brief Emulates many unicast PTP clients to put load on a master.
+ * @note Copyright (C) 2026 The linuxptp contributors
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+#include <arpa/inet.h>
+#include <errno.h>
+#include <inttypes.h>
+#include <math.h>
+#include <netinet/in.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/epoll.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "msg.h"
+#include "pqueue.h"
+#include "print.h"
+#include "stats.h"
+#include "tlv.h"
+#include "util.h"
+#include "version.h"
+
+#define NS_PER_SEC	1000000000LL
+#define EVENT_PORT	319
+#define GENERAL_PORT	320
+#define REQ_TIMEOUT	NS_PER_SEC
+#define REQ_RETRY	NS_PER_SEC
+#define MAX_EVENTS	64
+
+/* The services negotiated by every client. */
+enum {
+	SVC_ANNOUNCE,
+	SVC_SYNC,
+	SVC_DELAY_RESP,
+	N_SVC,
+};
+
+static const uint8_t svc_type[N_SVC] = {
+	[SVC_ANNOUNCE] = ANNOUNCE,
+	[SVC_SYNC] = SYNC,
+	[SVC_DELAY_RESP] = DELAY_RESP,
+};
+
+struct client {
+	unsigned int index;
+	struct in_addr addr;
+	int fd[2];			/* event, general */
+	struct PortIdentity pid;
+	UInteger16 seq_signaling;
+	UInteger16 seq_delay_req;
+	/* The negotiation, all times are monotonic in ns. */
+	int granted[N_SVC];
+	int64_t req_sent[N_SVC];	/* zero if no request is pending */
+	int64_t renew[N_SVC];
+	/* The delay measurement. */
+	int64_t next_delay_req;
+	int64_t delay_req_sent;
+	int delay_pending;
+	/* The sync reception. */
+	int have_sync;
+	Integer8 sync_interval;		/* granted */
+	int64_t sync_rx;		/* receive time stamp */
+	struct stats *jitter;
+	/* The statistics. */
+	uint64_t syncs;
+	uint64_t missed;
+	uint64_t announces;
+	/* The earliest pending entry in the schedule. */
+	int64_t queued;
+};
+
+struct entry {
+	int64_t time;
+	struct client *client;
+};
+
+static struct {
+	struct sockaddr_in master;
+	UInteger8 domain;
+	int log_interval[N_SVC];
+	unsigned int duration;
+	double ramp;
+	struct client *clients;
+	unsigned int num_clients;
+	struct pqueue *schedule;
+	int epfd;
+	/* The statistics. */
+	struct stats *grant_latency;
+	struct stats *delay_latency;
+	uint64_t requests;
+	uint64_t grants;
+	uint64_t denials;
+	uint64_t req_timeouts;
+	uint64_t delay_reqs;
+	uint64_t delay_resps;
+	uint64_t delay_lost;
+	uint64_t errors;
+} ucl = {
+	.log_interval = { 1, 0, 0 },
+	.duration = 300,
+	.ramp = 1.0,
+};
+
+static int64_t now_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * NS_PER_SEC + ts.tv_nsec;
+}
+
+static int64_t interval_ns(int log_interval)
+{
+	return llround(ldexp(NS_PER_SEC, log_interval));
+}
+
+/* The schedule */
+
+static int entry_cmp(void *a, void *b)
+{
+	struct entry *x = a, *y = b;
+
+	return x->time < y->time ? 1 : x->time > y->time ? -1 : 0;
+}
+
+static void schedule(struct client *c, int64_t time)
+{
+	struct entry *e;
+
+	if (c->queued && c->queued <= time)
+		return;
+	e = malloc(sizeof(*e));
+	if (!e)
+		return;
+	e->time = time;
+	e->client = c;
+	if (pqueue_insert(ucl.schedule, e)) {
+		free(e);
+		return;
+	}
+	c->queued = time;
+}
+
+/* Transmission */
+
+static struct ptp_message *client_msg(struct client *c, uint8_t type,
+				      uint8_t control, int length)
+{
+	struct ptp_message *msg;
+
+	msg = msg_allocate();
+	if (!msg)
+		return NULL;
+	msg->hwts.type = TS_SOFTWARE;
+	msg->header.tsmt = type;
+	msg->header.ver = PTP_VERSION;
+	msg->header.messageLength = length;
+	msg->header.domainNumber = ucl.domain;
+	msg->header.flagField[0] |= UNICAST;
+	msg->header.sourcePortIdentity = c->pid;
+	msg->header.control = control;
+	msg->header.logMessageInterval = 0x7f;
+	return msg;
+}
+
+static int client_send(struct client *c, int event, struct ptp_message *msg)
+{
+	struct sockaddr_in addr = ucl.master;
+	int cnt, len = msg->header.messageLength;
+
+	if (msg_pre_send(msg))
+		return -1;
+	addr.sin_port = htons(event ? EVENT_PORT : GENERAL_PORT);
+	cnt = sendto(c->fd[event ? 0 : 1], &msg->header, len, 0,
+		     (struct sockaddr *) &addr, sizeof(addr));
+	if (cnt != len) {
+		ucl.errors++;
+		return -1;
+	}
+	return 0;
+}
+
+static int send_request(struct client *c, unsigned int mask, int64_t now)
+{
+	struct request_unicast_xmit_tlv *req;
+	struct ptp_message *msg;
+	struct tlv_extra *extra;
+	int i, err = -1;
+
+	msg = client_msg(c, SIGNALING, CTL_OTHER,
+			 sizeof(struct signaling_msg));
+	if (!msg)
+		return -1;
+	msg->header.sequenceId = c->seq_signaling++;
+	memset(&msg->signaling.targetPortIdentity, 0xff,
+	       sizeof(msg->signaling.targetPortIdentity));
+
+	for (i = 0; i < N_SVC; i++) {
+		if (!(mask & (1 << i)))
+			continue;
+		extra = msg_tlv_append(msg, sizeof(*req));
+		if (!extra)
+			goto out;
+		req = (struct request_unicast_xmit_tlv *) extra->tlv;
+		req->type = TLV_REQUEST_UNICAST_TRANSMISSION;
+		req->length = sizeof(*req) - sizeof(req->type) -
+			sizeof(req->length);
+		req->message_type = svc_type[i] << 4;
+		req->logInterMessagePeriod = ucl.log_interval[i];
+		req->durationField = ucl.duration;
+	}
+	err = client_send(c, 0, msg);
+	if (!err) {
+		for (i = 0; i < N_SVC; i++) {
+			if (mask & (1 << i)) {
+				c->req_sent[i] = now;
+				ucl.requests++;
+			}
+		}
+	}
+out:
+	msg_put(msg);
+	return err;
+}
+
+static void send_cancel(struct client *c)
+{
+	struct cancel_unicast_xmit_tlv *cancel;
+	struct ptp_message *msg;
+	struct tlv_extra *extra;
+	int i;
+
+	msg = client_msg(c, SIGNALING, CTL_OTHER,
+			 sizeof(struct signaling_msg));
+	if (!msg)
+		return;
+	msg->header.sequenceId = c->seq_signaling++;
+	memset(&msg->signaling.targetPortIdentity, 0xff,
+	       sizeof(msg->signaling.targetPortIdentity));
+	for (i = 0; i < N_SVC; i++) {
+		if (!c->granted[i])
+			continue;
+		extra = msg_tlv_append(msg, sizeof(*cancel));
+		if (!extra)
+			goto out;
+		cancel = (struct cancel_unicast_xmit_tlv *) extra->tlv;
+		cancel->type = TLV_CANCEL_UNICAST_TRANSMISSION;
+		cancel->length = sizeof(*cancel) - sizeof(cancel->type) -
+			sizeof(cancel->length);
+		cancel->message_type_flags = svc_type[i] << 4;
+	}
+	if (msg_tlv_count(msg))
+		client_send(c, 0, msg);
+out:
+	msg_put(msg);
+}
+
+static void send_delay_req(struct client *c, int64_t now)
+{
+	struct ptp_message *msg;
+
+	msg = client_msg(c, DELAY_REQ, CTL_DELAY_REQ,
+			 sizeof(struct delay_req_msg));
+	if (!msg)
+		return;
+	msg->header.sequenceId = ++c->seq_delay_req;
+	if (!client_send(c, 1, msg)) {
+		c->delay_req_sent = now;
+		c->delay_pending = 1;
+		ucl.delay_reqs++;
+	}
+	msg_put(msg);
+}
+
+/* Runs the scheduled actions of a client and reschedules it. */
+static void client_run(struct client *c, int64_t now)
+{
+	int64_t next = now + interval_ns(8);
+	unsigned int mask = 0;
+	int i;
+
+	for (i = 0; i < N_SVC; i++) {
+		if (c->req_sent[i] && now - c->req_sent[i] >= REQ_TIMEOUT) {
+			ucl.req_timeouts++;
+			c->req_sent[i] = 0;
+			c->granted[i] = 0;
+			c->renew[i] = now;
+		}
+		if (!c->req_sent[i] && now >= c->renew[i])
+			mask |= 1 << i;
+	}
+	if (mask)
+		send_request(c, mask, now);
+	for (i = 0; i < N_SVC; i++) {
+		if (c->req_sent[i] && c->req_sent[i] + REQ_TIMEOUT < next)
+			next = c->req_sent[i] + REQ_TIMEOUT;
+		else if (!c->req_sent[i] && c->renew[i] < next)
+			next = c->renew[i];
+	}
+
+	if (c->have_sync && c->granted[SVC_DELAY_RESP]) {
+		if (now >= c->next_delay_req) {
+			if (c->delay_pending)
+				ucl.delay_lost++;
+			send_delay_req(c, now);
+			/* Randomize like ptp4l, between 0 and 2 intervals. */
+			c->next_delay_req = now + llround(2.0 * random() /
+				RAND_MAX * interval_ns(
+					ucl.log_interval[SVC_DELAY_RESP]));
+		}
+		if (c->next_delay_req < next)
+			next = c->next_delay_req;
+	}
+	schedule(c, next);
+}
+
+/* Reception */
+
+static void process_grant(struct client *c, struct tlv_extra *extra,
+			  int64_t now)
+{
+	struct grant_unicast_xmit_tlv *g;
+	int i;
+
+	g = (struct grant_unicast_xmit_tlv *) extra->tlv;
+	for (i = 0; i < N_SVC; i++) {
+		if (svc_type[i] == g->message_type >> 4)
+			break;
+	}
+	if (i == N_SVC || !c->req_sent[i])
+		return;
+	stats_add_value(ucl.grant_latency, (now - c->req_sent[i]) / 1e3);
+	c->req_sent[i] = 0;
+	if (!g->durationField) {
+		ucl.denials++;
+		c->granted[i] = 0;
+		c->renew[i] = now + REQ_RETRY;
+	} else {
+		ucl.grants++;
+		c->granted[i] = 1;
+		if (i == SVC_SYNC)
+			c->sync_interval = g->logInterMessagePeriod;
+		/* Renew in the middle of the granted duration. */
+		c->renew[i] = now + g->durationField * NS_PER_SEC / 2;
+	}
+	schedule(c, c->renew[i]);
+}
+
+/*
+ * The master numbers the Sync messages of all clients in one sequence,
+ * so the missed messages are counted from the gaps in the receive time.
+ */
+static void process_sync(struct client *c, int64_t rx)
+{
+	int64_t interval, n;
+
+	c->syncs++;
+	if (c->have_sync) {
+		interval = interval_ns(c->sync_interval);
+		n = llround((double) (rx - c->sync_rx) / interval);
+		if (n < 1)
+			n = 1;
+		c->missed += n - 1;
+		stats_add_value(c->jitter,
+				(rx - c->sync_rx - n * interval) / 1e3);
+	} else if (c->granted[SVC_DELAY_RESP]) {
+		c->next_delay_req = now_ns();
+		schedule(c, c->next_delay_req);
+	}
+	c->have_sync = 1;
+	c->sync_rx = rx;
+}
+
+static void process_delay_resp(struct client *c, struct ptp_message *msg,
+			       int64_t now)
+{
+	if (!c->delay_pending ||
+	    msg->header.sequenceId != c->seq_delay_req ||
+	    !pid_eq(&msg->delay_resp.requestingPortIdentity, &c->pid))
+		return;
+	c->delay_pending = 0;
+	ucl.delay_resps++;
+	stats_add_value(ucl.delay_latency, (now - c->delay_req_sent) / 1e3);
+}
+
+static void client_recv(struct client *c, int event)
+{
+	unsigned char control[256];
+	struct ptp_message *msg;
+	struct tlv_extra *extra;
+	struct cmsghdr *cm;
+	struct msghdr mh;
+	struct iovec iov;
+	int64_t now, rx;
+	int cnt;
+
+	msg = msg_allocate();
+	if (!msg)
+		return;
+	iov.iov_base = &msg->header;
+	iov.iov_len = sizeof(msg->data);
+	memset(&mh, 0, sizeof(mh));
+	mh.msg_iov = &iov;
+	mh.msg_iovlen = 1;
+	mh.msg_control = control;
+	mh.msg_controllen = sizeof(control);
+
+	cnt = recvmsg(c->fd[event ? 0 : 1], &mh, MSG_DONTWAIT);
+	now = now_ns();
+	if (cnt < 0 || msg_post_recv(msg, cnt))
+		goto out;
+	if (msg->header.domainNumber != ucl.domain)
+		goto out;
+
+	rx = now;
+	for (cm = CMSG_FIRSTHDR(&mh); cm; cm = CMSG_NXTHDR(&mh, cm)) {
+		if (cm->cmsg_level == SOL_SOCKET &&
+		    cm->cmsg_type == SO_TIMESTAMPNS) {
+			struct timespec ts;
+
+			memcpy(&ts, CMSG_DATA(cm), sizeof(ts));
+			rx = ts.tv_sec * NS_PER_SEC + ts.tv_nsec;
+		}
+	}
+
+	switch (msg_type(msg)) {
+	case SYNC:
+		process_sync(c, rx);
+		break;
+	case DELAY_RESP:
+		process_delay_resp(c, msg, now);
+		break;
+	case ANNOUNCE:
+		c->announces++;
+		break;
+	case SIGNALING:
+		TAILQ_FOREACH(extra, &msg->tlv_list, list) {
+			if (extra->tlv->type == TLV_GRANT_UNICAST_TRANSMISSION)
+				process_grant(c, extra, now);
+		}
+		break;
+	}
+out:
+	msg_put(msg);
+}
+
+/* Setup */
+
+static int open_socket(struct client *c, int port)
+{
+	struct sockaddr_in addr;
+	struct epoll_event ev;
+	int fd, on = 1;
+
+	fd = socket(AF_INET, SOCK_DGRAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+	if (fd < 0) {
+		pr_err("socket failed: %m");
+		return -1;
+	}
+	memset(&addr, 0, sizeof(addr));
+	addr.sin_family = AF_INET;
+	addr.sin_addr = c->addr;
+	addr.sin_port = htons(port);
+	if (bind(fd, (struct sockaddr *) &addr, sizeof(addr))) {
+		pr_err("bind %s:%d failed: %m", inet_ntoa(c->addr), port);
+		goto err;
+	}
+	if (port == EVENT_PORT &&
+	    setsockopt(fd, SOL_SOCKET, SO_TIMESTAMPNS, &on, sizeof(on))) {
+		pr_err("setsockopt SO_TIMESTAMPNS failed: %m");
+		goto err;
+	}
+	ev.events = EPOLLIN;
+	/* The index of the client and the socket in one value. */
+	ev.data.u64 = (uint64_t) c->index << 1 | (port == EVENT_PORT);
+	if (epoll_ctl(ucl.epfd, EPOLL_CTL_ADD, fd, &ev)) {
+		pr_err("epoll_ctl failed: %m");
+		goto err;
+	}
+	return fd;
+err:
+	close(fd);
+	return -1;
+}
+
+static int create_clients(struct in_addr first, int64_t start)
+{
+	struct client *c;
+	unsigned int i;
+
+	ucl.clients = calloc(ucl.num_clients, sizeof(*ucl.clients));
+	if (!ucl.clients)
+		return -1;
+	for (i = 0; i < ucl.num_clients; i++) {
+		c = &ucl.clients[i];
+		c->index = i;
+		c->addr.s_addr = htonl(ntohl(first.s_addr) + i);
+		c->fd[0] = open_socket(c, EVENT_PORT);
+		c->fd[1] = open_socket(c, GENERAL_PORT);
+		if (c->fd[0] < 0 || c->fd[1] < 0)
+			return -1;
+		/* The clock identity is derived from the index. */
+		c->pid.clockIdentity.id[0] = 0x02;
+		c->pid.clockIdentity.id[3] = 0xff;
+		c->pid.clockIdentity.id[4] = 0xfe;
+		c->pid.clockIdentity.id[5] = i >> 16;
+		c->pid.clockIdentity.id[6] = i >> 8;
+		c->pid.clockIdentity.id[7] = i;
+		c->pid.portNumber = 1;
+		c->jitter = stats_create();
+		if (!c->jitter)
+			return -1;
+		/* Spread the first requests over the ramp time. */
+		c->renew[SVC_ANNOUNCE] = start +
+			llround(ucl.ramp * NS_PER_SEC * i / ucl.num_clients);
+		c->renew[SVC_SYNC] = c->renew[SVC_ANNOUNCE];
+		c->renew[SVC_DELAY_RESP] = c->renew[SVC_ANNOUNCE];
+		schedule(c, c->renew[SVC_ANNOUNCE]);
+	}
+	return 0;
+}
+
+static void raise_fd_limit(void)
+{
+	struct rlimit rlim;
+
+	if (getrlimit(RLIMIT_NOFILE, &rlim))
+		return;
+	rlim.rlim_cur = rlim.rlim_max;
+	setrlimit(RLIMIT_NOFILE, &rlim);
+}
+
+static void print_stats(const char *label, struct stats *s)
+{
+	struct stats_result r;
+
+	if (stats_get_result(s, &r)) {
+		printf("%-24s -\n", label);
+		return;
+	}
+	printf("%-24s mean %10.1f sdev %10.1f max %10.1f\n",
+	       label, r.mean, r.stddev, r.max);
+}
+
+static void print_results(double elapsed)
+{
+	uint64_t syncs = 0, missed = 0, announces = 0;
+	double sdev_sum = 0.0, sdev_max = 0.0;
+	unsigned int i, num_jitter = 0, worst = 0;
+	struct stats_result r;
+	struct client *c;
+
+	for (i = 0; i < ucl.num_clients; i++) {
+		c = &ucl.clients[i];
+		syncs += c->syncs;
+		missed += c->missed;
+		announces += c->announces;
+		if (stats_get_result(c->jitter, &r))
+			continue;
+		num_jitter++;
+		sdev_sum += r.stddev;
+		if (r.stddev > sdev_max) {
+			sdev_max = r.stddev;
+			worst = i;
+		}
+	}
+
+	printf("%u clients, %.1f s\n\n", ucl.num_clients, elapsed);
+	printf("requests %" PRIu64 " grants %" PRIu64 " denials %" PRIu64
+	       " timeouts %" PRIu64 "\n", ucl.requests, ucl.grants,
+	       ucl.denials, ucl.req_timeouts);
+	printf("delay requests %" PRIu64 " responses %" PRIu64
+	       " lost %" PRIu64 "\n", ucl.delay_reqs, ucl.delay_resps,
+	       ucl.delay_lost);
+	printf("announces %" PRIu64 " syncs %" PRIu64 " missed %" PRIu64
+	       " (%.3f%%)\n", announces, syncs, missed,
+	       syncs + missed ? 100.0 * missed / (syncs + missed) : 0.0);
+	printf("send errors %" PRIu64 "\n\n", ucl.errors);
+	print_stats("grant latency [us]", ucl.grant_latency);
+	print_stats("delay resp latency [us]", ucl.delay_latency);
+	if (num_jitter) {
+		printf("%-24s mean %10.1f max %10.1f (client %s)\n",
+		       "sync jitter sdev [us]", sdev_sum / num_jitter,
+		       sdev_max, inet_ntoa(ucl.clients[worst].addr));
+	}
+}
+
+static void usage(char *progname)
+{
+	fprintf(stderr,
+		"\n"
+		"usage: %s [options] master first-client\n\n"
+		" -n [num]  number of clients, the default is 100\n"
+		" -t [sec]  run time, the default is to run until interrupted\n"
+		" -r [sec]  spread the first requests over 'sec', default 1\n"
+		" -u [sec]  requested duration of the grants, default 300\n"
+		" -A [num]  logInterMessagePeriod of announce, default 1\n"
+		" -S [num]  logInterMessagePeriod of sync, default 0\n"
+		" -D [num]  logInterMessagePeriod of delay resp, default 0\n"
+		" -d [num]  domain number, default 0\n"
+		" -l [num]  set the logging level to 'num'\n"
+		" -h        prints this message and exits\n"
+		" -v        prints the software version and exits\n"
+		"\n",
+		progname);
+}
+
+int main(int argc, char *argv[])
+{
+	int c, i, cnt, err = -1, level = LOG_INFO, domain = 0;
+	struct epoll_event events[MAX_EVENTS];
+	int64_t start, end = 0, now, timeout;
+	double run_time = 0.0, val;
+	struct in_addr first;
+	struct client *cl;
+	struct entry *e;
+	char *progname;
+
+	progname = strrchr(argv[0], '/');
+	progname = progname ? 1 + progname : argv[0];
+	ucl.num_clients = 100;
+	while (EOF != (c = getopt(argc, argv, "A:D:S:d:l:n:r:t:u:hv"))) {
+		switch (c) {
+		case 'A':
+			ucl.log_interval[SVC_ANNOUNCE] = atoi(optarg);
+			break;
+		case 'S':
+			ucl.log_interval[SVC_SYNC] = atoi(optarg);
+			break;
+		case 'D':
+			ucl.log_interval[SVC_DELAY_RESP] = atoi(optarg);
+			break;
+		case 'd':
+			if (get_arg_val_i(c, optarg, &domain, 0, 255))
+				return -1;
+			break;
+		case 'l':
+			if (get_arg_val_i(c, optarg, &level,
+					  PRINT_LEVEL_MIN, PRINT_LEVEL_MAX))
+				return -1;
+			break;
+		case 'n':
+			if (get_arg_val_i(c, optarg, &cnt, 1, 0xffffff))
+				return -1;
+			ucl.num_clients = cnt;
+			break;
+		case 'r':
+			if (get_arg_val_d(c, optarg, &ucl.ramp, 0.0, 3600.0))
+				return -1;
+			break;
+		case 't':
+			if (get_arg_val_d(c, optarg, &run_time, 0.0, 1e9))
+				return -1;
+			break;
+		case 'u':
+			if (get_arg_val_d(c, optarg, &val, 1.0, 86400.0))
+				return -1;
+			ucl.duration = val;
+			break;
+		case 'v':
+			version_show(stdout);
+			return 0;
+		case 'h':
+			usage(progname);
+			return 0;
+		case '?':
+		default:
+			usage(progname);
+			return -1;
+		}
+	}
+	if (argc - optind != 2) {
+		usage(progname);
+		return -1;
+	}
+	ucl.domain = domain;
+	ucl.master.sin_family = AF_INET;
+	if (!inet_aton(argv[optind], &ucl.master.sin_addr) ||
+	    !inet_aton(argv[optind + 1], &first)) {
+		fprintf(stderr, "invalid address\n");
+		return -1;
+	}
+
+	print_set_progname(progname);
+	print_set_verbose(1);
+	print_set_syslog(0);
+	print_set_level(level);
+	raise_fd_limit();
+
+	if (handle_term_signals())
+		return -1;
+
+	ucl.schedule = pqueue_create(1024, entry_cmp);
+	ucl.grant_latency = stats_create();
+	ucl.delay_latency = stats_create();
+	ucl.epfd = epoll_create1(EPOLL_CLOEXEC);
+	if (!ucl.schedule || !ucl.grant_latency || !ucl.delay_latency ||
+	    ucl.epfd < 0)
+		goto out;
+
+	start = now_ns();
+	if (run_time > 0.0)
+		end = start + llround(run_time * NS_PER_SEC);
+	if (create_clients(first, start))
+		goto out;
+	pr_info("started %u clients", ucl.num_clients);
+
+	while (is_running()) {
+		now = now_ns();
+		if (end && now >= end)
+			break;
+		while ((e = pqueue_peek(ucl.schedule)) && e->time <= now) {
+			pqueue_extract(ucl.schedule);
+			cl = e->client;
+			/* Skip the entries superseded by an earlier one. */
+			if (cl->queued == e->time) {
+				cl->queued = 0;
+				client_run(cl, now);
+			}
+			free(e);
+		}
+		timeout = e ? (e->time - now) / 1000000 + 1 : 1000;
+		if (end && (end - now) / 1000000 + 1 < timeout)
+			timeout = (end - now) / 1000000 + 1;
+		cnt = epoll_wait(ucl.epfd, events, MAX_EVENTS, timeout);
+		if (cnt < 0) {
+			if (errno == EINTR)
+				continue;
+			pr_err("epoll_wait failed: %m");
+			goto out;
+		}
+		for (i = 0; i < cnt; i++) {
+			cl = &ucl.clients[events[i].data.u64 >> 1];
+			client_recv(cl, events[i].data.u64 & 1);
+		}
+	}
+
+	for (i = 0; i < ucl.num_clients; i++)
+		send_cancel(&ucl.clients[i]);
+	print_results((now_ns() - start) / 1e9);
+	err = 0;
+out:
+	msg_cleanup();
+	return err;
+}
@@ -0,0 +1,259 @@
+/**
+ * @file replay.c
+ * @note Copyright (C) 2026 The linuxptp contributors
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "msg.h"
+#include "replay.h"
+#include "stats.h"
+#include "tmv.h"
+#include "tsproc.h"
+
+#define REPLAY_MAX_PPB 500000
+
+struct replay {
+	struct servo *servo;
+	struct tsproc *tsproc;
+	struct stats *offset;
+	struct stats *freq;
+	struct stats *delay;
+	/* The virtual clock. */
+	int64_t base;
+	double phase;
+	double ppb;
+	/* The sync interval, estimated from the origin time stamps. */
+	int64_t last_origin;
+	int log_interval;
+	int64_t first_ingress;
+	int64_t lock_time;
+	int64_t last_offset;
+	uint64_t samples;
+};
+
+int64_t replay_clock(struct replay *r, int64_t t)
+{
+	return t + (int64_t) llround(r->phase + r->ppb * 1e-9 * (t - r->base));
+}
+
+static void replay_set_freq(struct replay *r, int64_t t, double ppb)
+{
+	r->phase += r->ppb * 1e-9 * (t - r->base);
+	r->base = t;
+	r->ppb = ppb;
+}
+
+static void replay_update_interval(struct replay *r, int64_t origin)
+{
+	int64_t interval = origin - r->last_origin;
+	int n;
+
+	r->last_origin = origin;
+	if (interval <= 0)
+		return;
+
+	/* Round to the nearest power of two. */
+	n = (int) lround(log2(interval / 1e9));
+	if (n == r->log_interval)
+		return;
+	r->log_interval = n;
+	servo_sync_interval(r->servo, n < 0 ? 1.0 / (1 << -n) : 1 << n);
+}
+
+struct config *replay_config_create(const char *file, const char *options)
+{
+	char *buf, *opt, *val, *save = NULL;
+	struct config *cfg;
+
+	cfg = config_create();
+	if (!cfg)
+		return NULL;
+	if (file && config_read((char *) file, cfg))
+		goto failed;
+	if (!options)
+		return cfg;
+
+	buf = strdup(options);
+	if (!buf)
+		goto failed;
+	for (opt = strtok_r(buf, ",", &save); opt;
+	     opt = strtok_r(NULL, ",", &save)) {
+		val = strchr(opt, '=');
+		if (!val) {
+			fprintf(stderr, "missing value of option %s\n", opt);
+			free(buf);
+			goto failed;
+		}
+		*val++ = 0;
+		if (config_parse_option(cfg, opt, val)) {
+			free(buf);
+			goto failed;
+		}
+	}
+	free(buf);
+	return cfg;
+failed:
+	config_destroy(cfg);
+	return NULL;
+}
+
+struct replay *replay_create(struct config *cfg)
+{
+	struct replay *r;
+	int sw_ts;
+
+	r = calloc(1, sizeof(*r));
+	if (!r)
+		return NULL;
+
+	sw_ts = config_get_int(cfg, NULL, "time_stamping") == TS_SOFTWARE;
+	r->servo = servo_create(cfg, config_get_int(cfg, NULL, "clock_servo"),
+				0, REPLAY_MAX_PPB, sw_ts);
+	if (!r->servo)
+		goto failed;
+	r->tsproc = tsproc_create(config_get_int(cfg, NULL, "tsproc_mode"),
+				  config_get_int(cfg, NULL, "delay_filter"),
+				  config_get_int(cfg, NULL,
+						 "delay_filter_length"),
+				  config_get_int(cfg, NULL,
+						 "delay_filter_percentile"));
+	if (!r->tsproc)
+		goto failed;
+	if (config_get_int(cfg, NULL, "offset_filter_length") &&
+	    tsproc_set_offset_filter(r->tsproc,
+			config_get_int(cfg, NULL, "offset_filter"),
+			config_get_int(cfg, NULL, "offset_filter_length"),
+			config_get_int(cfg, NULL, "offset_filter_percentile")))
+		goto failed;
+	r->offset = stats_create();
+	r->freq = stats_create();
+	r->delay = stats_create();
+	if (!r->offset || !r->freq || !r->delay)
+		goto failed;
+
+	r->log_interval = INT32_MIN;
+	r->first_ingress = -1;
+	r->lock_time = -1;
+	return r;
+failed:
+	replay_destroy(r);
+	return NULL;
+}
+
+void replay_destroy(struct replay *r)
+{
+	if (r->servo)
+		servo_destroy(r->servo);
+	if (r->tsproc)
+		tsproc_destroy(r->tsproc);
+	if (r->offset)
+		stats_destroy(r->offset);
+	if (r->freq)
+		stats_destroy(r->freq);
+	if (r->delay)
+		stats_destroy(r->delay);
+	free(r);
+}
+
+enum servo_state replay_sync(struct replay *r, int64_t origin,
+			     int64_t ingress)
+{
+	enum servo_state state = SERVO_UNLOCKED;
+	int64_t local = replay_clock(r, ingress);
+	double adj, weight;
+	tmv_t offset;
+
+	if (r->first_ingress < 0)
+		r->first_ingress = ingress;
+	if (r->last_origin)
+		replay_update_interval(r, origin);
+	else
+		r->last_origin = origin;
+
+	tsproc_down_ts(r->tsproc, nanoseconds_to_tmv(origin),
+		       nanoseconds_to_tmv(local));
+	if (tsproc_update_offset(r->tsproc, &offset, &weight))
+		return state;
+
+	r->last_offset = tmv_to_nanoseconds(offset);
+	adj = servo_sample(r->servo, r->last_offset, local, weight, &state);
+	r->samples++;
+
+	switch (state) {
+	case SERVO_UNLOCKED:
+		break;
+	case SERVO_JUMP:
+		replay_set_freq(r, ingress, -adj);
+		r->phase -= r->last_offset;
+		tsproc_reset(r->tsproc, 0);
+		break;
+	case SERVO_LOCKED:
+	case SERVO_LOCKED_STABLE:
+		replay_set_freq(r, ingress, -adj);
+		if (r->lock_time < 0)
+			r->lock_time = ingress - r->first_ingress;
+		stats_add_value(r->offset, r->last_offset);
+		stats_add_value(r->freq, -adj);
+		break;
+	}
+	return state;
+}
+
+void replay_delay(struct replay *r, int64_t req, int64_t rx)
+{
+	tmv_t delay;
+
+	tsproc_up_ts(r->tsproc, nanoseconds_to_tmv(replay_clock(r, req)),
+		     nanoseconds_to_tmv(rx));
+	if (tsproc_update_delay(r->tsproc, &delay))
+		return;
+	stats_add_value(r->delay, tmv_dbl(delay));
+}
+
+int64_t replay_offset(struct replay *r)
+{
+	return r->last_offset;
+}
+
+void replay_get_result(struct replay *r, struct replay_result *result)
+{
+	struct stats_result s;
+
+	result->samples = r->samples;
+	result->locked = stats_get_num_values(r->offset);
+	result->lock_time = r->lock_time;
+
+	if (!stats_get_result(r->offset, &s)) {
+		result->offset_rms = s.rms;
+		result->offset_mean = s.mean;
+		result->offset_stddev = s.stddev;
+		result->offset_max_abs = s.max_abs;
+	} else {
+		result->offset_rms = result->offset_mean = NAN;
+		result->offset_stddev = result->offset_max_abs = NAN;
+	}
+	if (!stats_get_result(r->freq, &s)) {
+		result->freq_mean = s.mean;
+		result->freq_stddev = s.stddev;
+	} else {
+		result->freq_mean = result->freq_stddev = NAN;
+	}
+	result->delay_mean = stats_get_result(r->delay, &s) ? NAN : s.mean;
+}
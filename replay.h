@@ -0,0 +1,115 @@
+/**
+ * @file replay.h
+ * @brief Drives the time stamp processing and the servo in virtual time.
+ * @note Copyright (C) 2026 The linuxptp contributors
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+#ifndef HAVE_REPLAY_H
+#define HAVE_REPLAY_H
+
+#include <stdint.h>
+
+#include "config.h"
+#include "servo.h"
+
+/*
+ * The local time stamps passed to a replay instance are taken from a
+ * free running clock. The instance keeps a virtual clock, which is the
+ * free running clock corrected by the frequency adjustments and steps
+ * requested by the servo, and processes the time stamps as they would
+ * have been measured by the virtual clock.
+ */
+struct replay;
+
+struct replay_result {
+	uint64_t samples;	/* offsets passed to the servo */
+	uint64_t locked;	/* offsets measured in a locked state */
+	int64_t lock_time;	/* ns from the first sample to the first lock,
+				   or -1 if never locked */
+	double offset_rms;	/* statistics of the locked offsets in ns */
+	double offset_mean;
+	double offset_stddev;
+	double offset_max_abs;
+	double freq_mean;	/* statistics of the locked frequency in ppb */
+	double freq_stddev;
+	double delay_mean;	/* mean path delay in ns */
+};
+
+/**
+ * Create a configuration for a replay instance.
+ * @param file     The name of a configuration file, or NULL.
+ * @param options  Comma separated option=value pairs applied on top of
+ *                 the file, or NULL.
+ * @return         A pointer to a new configuration on success,
+ *                 NULL otherwise.
+ */
+struct config *replay_config_create(const char *file, const char *options);
+
+/**
+ * Create a replay instance.
+ * @param cfg  The configuration which selects and tunes the servo
+ *             and the time stamp processing.
+ * @return     A pointer to a new instance on success, NULL otherwise.
+ */
+struct replay *replay_create(struct config *cfg);
+
+/**
+ * Destroy a replay instance.
+ * @param r  A pointer obtained via @ref replay_create().
+ */
+void replay_destroy(struct replay *r);
+
+/**
+ * Process the time stamps of a sync message.
+ * @param r           A replay instance.
+ * @param origin      The origin time stamp plus the corrections, in ns.
+ * @param ingress     The free running receive time stamp, in ns.
+ * @return            The state of the servo.
+ */
+enum servo_state replay_sync(struct replay *r, int64_t origin,
+			     int64_t ingress);
+
+/**
+ * Process the time stamps of a delay request and response.
+ * @param r           A replay instance.
+ * @param req         The free running transmit time stamp, in ns.
+ * @param rx          The receive time stamp minus the corrections, in ns.
+ */
+void replay_delay(struct replay *r, int64_t req, int64_t rx);
+
+/**
+ * Convert a free running time stamp to the time of the virtual clock.
+ * @param r  A replay instance.
+ * @param t  A free running time stamp in ns.
+ * @return   The corresponding time of the virtual clock in ns.
+ */
+int64_t replay_clock(struct replay *r, int64_t t);
+
+/**
+ * Obtain the last offset passed to the servo.
+ * @param r  A replay instance.
+ * @return   The offset in ns.
+ */
+int64_t replay_offset(struct replay *r);
+
+/**
+ * Obtain the statistics collected so far.
+ * @param r       A replay instance.
+ * @param result  Where to store the statistics.
+ */
+void replay_get_result(struct replay *r, struct replay_result *result);
+
+#endif
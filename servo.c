@@ -20,7 +20,9 @@
 #include <stdlib.h>
 
 #include "config.h"
+#include "kalman.h"
 #include "linreg.h"
+#include "chronysock.h"
 #include "ntpshm.h"
 #include "nullf.h"
 #include "pi.h"
@@ -51,6 +53,12 @@ struct servo *servo_create(struct config *cfg, enum servo_type type,
 	case CLOCK_SERVO_NULLF:
 		servo = nullf_servo_create();
 		break;
+	case CLOCK_SERVO_KALMAN:
+		servo = kalman_servo_create(cfg, fadj, sw_ts);
+		break;
+	case CLOCK_SERVO_CHRONYSOCK:
+		servo = chronysock_servo_create(cfg);
+		break;
 	default:
 		return NULL;
 	}
@@ -166,6 +174,20 @@ void servo_leap(struct servo *servo, int leap)
 		servo->leap(servo, leap);
 }
 
+int servo_gains(struct servo *servo, struct servo_gains *gains)
+{
+	if (servo->gains)
+		return servo->gains(servo, gains);
+
+	return -1;
+}
+
+void servo_warm_start(struct servo *servo, double freq)
+{
+	if (servo->warm_start)
+		servo->warm_start(servo, freq);
+}
+
 int servo_offset_threshold(struct servo *servo)
 {
 	return servo->offset_threshold;
@@ -35,6 +35,8 @@ enum servo_type {
 	CLOCK_SERVO_LINREG,
 	CLOCK_SERVO_NTPSHM,
 	CLOCK_SERVO_NULLF,
+	CLOCK_SERVO_KALMAN,
+	CLOCK_SERVO_CHRONYSOCK,
 };
 
 /**
@@ -65,6 +67,39 @@ enum servo_state {
 	SERVO_LOCKED_STABLE,
 };
 
+/**
+ * Defines how the gains of a PI servo are chosen.
+ */
+enum servo_gain_mode {
+
+	/**
+	 * The gains are fixed by the configuration and the sync interval.
+	 */
+	SERVO_GAINS_FIXED,
+
+	/**
+	 * The adaptive servo uses the full gains to acquire the master.
+	 */
+	SERVO_GAINS_ACQUIRE,
+
+	/**
+	 * The adaptive servo scales down the gains according to the
+	 * measured noise and wander to track the master.
+	 */
+	SERVO_GAINS_TRACK,
+};
+
+/**
+ * Describes the current gains of a PI servo.
+ */
+struct servo_gains {
+	enum servo_gain_mode mode;
+	double kp;     /* proportional constant */
+	double ki;     /* integral constant */
+	double noise;  /* offset noise in nanoseconds */
+	double wander; /* frequency wander in ppb per square root of second */
+};
+
 /**
  * Create a new instance of a clock servo.
  * @param type    The type of the servo to create.
@@ -129,6 +164,24 @@ double servo_rate_ratio(struct servo *servo);
  */
 void servo_leap(struct servo *servo, int leap);
 
+/**
+ * Obtain the current gains of a clock servo.
+ * @param servo   Pointer to a servo obtained via @ref servo_create().
+ * @param gains   Returns the gains.
+ * @return        Zero on success, -1 if the servo has no such gains.
+ */
+int servo_gains(struct servo *servo, struct servo_gains *gains);
+
+/**
+ * Start a clock servo with a frequency known from a previous run. The
+ * servo skips the estimation of the frequency and locks on the first
+ * sample. Must be called before the first sample.
+ * @param servo   Pointer to a servo obtained via @ref servo_create().
+ * @param freq    The frequency adjustment in ppb, which has to be already
+ *                applied to the clock.
+ */
+void servo_warm_start(struct servo *servo, double freq);
+
 /**
  * Get the offset threshold for triggering the interval change request.
  * @param servo   Pointer to a servo obtained via @ref servo_create().
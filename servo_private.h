@@ -46,6 +46,10 @@ struct servo {
 	double (*rate_ratio)(struct servo *servo);
 
 	void (*leap)(struct servo *servo, int leap);
+
+	int (*gains)(struct servo *servo, struct servo_gains *gains);
+
+	void (*warm_start)(struct servo *servo, double freq);
 };
 
 #endif
@@ -0,0 +1,605 @@
+/**
+ * @file servo_sim.c
+ * @brief Simulates the servos with synthetic oscillator and network models.
+ * @note Copyright (C) 2026 The linuxptp contributors
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+#include <inttypes.h>
+#include <math.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "config.h"
+#include "print.h"
+#include "replay.h"
+#include "tie.h"
+#include "version.h"
+
+#define MAX_JOBS 4096
+#define MAX_SWEEPS 8
+#define MAX_PDV 1e8
+
+/*
+ * The parameters of the simulated system. The slave oscillator has a
+ * constant frequency error, a random walk frequency noise and an
+ * optional temperature step, which changes the frequency exponentially
+ * with the given time constant. The delay of each message is the base
+ * delay plus a Pareto distributed queuing delay, the master to slave
+ * direction can be given an extra delay at some point in time, and each
+ * time stamp has a Gaussian noise.
+ */
+struct model {
+	double duration;	/* s */
+	double interval;	/* log2 of the sync interval in s */
+	double freq;		/* ppb */
+	double wander;		/* ppb / sqrt(s) */
+	double temp_step;	/* ppb */
+	double temp_time;	/* s */
+	double temp_tau;	/* s */
+	double delay;		/* ns */
+	double pdv;		/* ns */
+	double pdv_alpha;
+	double asym;		/* ns */
+	double asym_time;	/* s */
+	double ts_noise;	/* ns */
+	double threshold;	/* ns */
+	double conv_window;	/* s */
+	double conv_percentile;
+	double seed;
+};
+
+static struct model model = {
+	.duration = 3600,
+	.interval = 0,
+	.freq = 10000,
+	.wander = 0.1,
+	.temp_step = 0,
+	.temp_time = 1800,
+	.temp_tau = 60,
+	.delay = 10000,
+	.pdv = 100,
+	.pdv_alpha = 1.5,
+	.asym = 0,
+	.asym_time = 2400,
+	.ts_noise = 10,
+	.threshold = 1000,
+	.conv_window = 16,
+	.conv_percentile = 50,
+	.seed = 1,
+};
+
+static struct {
+	const char *name;
+	double *val;
+} model_tab[] = {
+	{ "duration", &model.duration },
+	{ "interval", &model.interval },
+	{ "freq", &model.freq },
+	{ "wander", &model.wander },
+	{ "temp_step", &model.temp_step },
+	{ "temp_time", &model.temp_time },
+	{ "temp_tau", &model.temp_tau },
+	{ "delay", &model.delay },
+	{ "pdv", &model.pdv },
+	{ "pdv_alpha", &model.pdv_alpha },
+	{ "asym", &model.asym },
+	{ "asym_time", &model.asym_time },
+	{ "ts_noise", &model.ts_noise },
+	{ "threshold", &model.threshold },
+	{ "conv_window", &model.conv_window },
+	{ "conv_percentile", &model.conv_percentile },
+	{ "seed", &model.seed },
+};
+
+struct sim_result {
+	double conv_time;	/* s, or negative if never converged */
+	double rms;		/* ns */
+	double max_abs;		/* ns */
+	int64_t mtie;		/* ns */
+	unsigned int mtie_window;
+	uint64_t samples;
+};
+
+struct job {
+	char *label;
+	struct config *cfg;
+	struct sim_result result;
+	int err;
+};
+
+struct pool {
+	struct job *jobs;
+	unsigned int num_jobs;
+	unsigned int next;
+};
+
+/* The simulated slave oscillator. */
+struct osc {
+	uint64_t rng;
+	double base;		/* true time of the last update in ns */
+	double local;		/* local time at base in ns */
+	double wander;		/* random walk part of the frequency in ppb */
+};
+
+static double rnd_uniform(uint64_t *x)
+{
+	/* xorshift64* */
+	*x ^= *x >> 12;
+	*x ^= *x << 25;
+	*x ^= *x >> 27;
+	return ((*x * 2685821657736338717ULL) >> 11) * 0x1.0p-53;
+}
+
+static double rnd_gauss(uint64_t *x)
+{
+	double u = rnd_uniform(x), v = rnd_uniform(x);
+
+	return sqrt(-2.0 * log(1.0 - u)) * cos(2.0 * M_PI * v);
+}
+
+static double rnd_pareto(uint64_t *x, double scale, double alpha)
+{
+	double d = scale * (pow(1.0 - rnd_uniform(x), -1.0 / alpha) - 1.0);
+
+	return d < MAX_PDV ? d : MAX_PDV;
+}
+
+static double osc_freq(struct osc *o, double t)
+{
+	double f = model.freq + o->wander, s = t / 1e9 - model.temp_time;
+
+	if (model.temp_step && s > 0)
+		f += model.temp_step * (1.0 - exp(-s / model.temp_tau));
+	return f;
+}
+
+/* Moves the oscillator to the true time t, t must not decrease. */
+static void osc_update(struct osc *o, double t)
+{
+	double dt = t - o->base;
+
+	o->local += dt * (1.0 + 1e-9 * osc_freq(o, o->base));
+	o->wander += model.wander * sqrt(dt / 1e9) * rnd_gauss(&o->rng);
+	o->base = t;
+}
+
+/* Local time at the true time t, which is not earlier than the base. */
+static int64_t osc_local(struct osc *o, double t)
+{
+	return (int64_t) llround(o->local + (t - o->base) *
+				 (1.0 + 1e-9 * osc_freq(o, o->base)));
+}
+
+static double path_delay(struct osc *o, double t, int m2s)
+{
+	double d;
+
+	d = model.delay + rnd_pareto(&o->rng, model.pdv, model.pdv_alpha);
+
+	if (m2s && model.asym && t >= model.asym_time * 1e9)
+		d += model.asym;
+	return d;
+}
+
+static int64_t ts_noise(struct osc *o)
+{
+	if (!model.ts_noise)
+		return 0;
+	return llround(model.ts_noise * rnd_gauss(&o->rng));
+}
+
+/*
+ * With a heavy-tailed delay a single sample above the threshold says more
+ * about the last outlier than about the servo. A window of conv_window
+ * seconds is bad when more than (100 - conv_percentile) % of its samples
+ * exceed the threshold, i.e. when that percentile of the absolute error is
+ * above it. The servo converged after the last sample above the threshold
+ * which is in a bad window. The windows at the start are shorter.
+ */
+static uint64_t conv_index(double *te, uint64_t n, double interval)
+{
+	uint64_t i, w, bad = 0, last = 0, conv = 0;
+
+	w = model.conv_window * 1e9 / interval;
+	if (w < 1)
+		w = 1;
+
+	for (i = 0; i < n; i++) {
+		if (fabs(te[i]) > model.threshold) {
+			bad++;
+			last = i + 1;
+		}
+		if (i >= w && fabs(te[i - w]) > model.threshold)
+			bad--;
+		if (bad * 100.0 > (i < w ? i + 1 : w) *
+		    (100.0 - model.conv_percentile))
+			conv = last;
+	}
+	return conv;
+}
+
+static void run_job(struct job *job)
+{
+	double t, ingress_t, req_t, interval, end, *te = NULL;
+	struct sim_result *res = &job->result;
+	int64_t origin, ingress, req, rx;
+	struct tie_result tr;
+	struct replay *r;
+	struct osc osc;
+	uint64_t i, n;
+	struct tie *tie;
+	int w;
+
+	memset(&osc, 0, sizeof(osc));
+	osc.rng = (uint64_t) model.seed * 0x9E3779B97F4A7C15ULL + 1;
+	interval = 1e9 * pow(2.0, model.interval);
+	end = model.duration * 1e9;
+	n = (uint64_t) (end / interval);
+
+	r = replay_create(job->cfg);
+	tie = tie_create(0, 0);
+	te = calloc(n ? n : 1, sizeof(*te));
+	if (!r || !tie || !te) {
+		job->err = 1;
+		goto out;
+	}
+
+	/*
+	 * The master sends a sync message at the start of each interval
+	 * and the slave sends a delay request in the middle of it.
+	 */
+	for (i = 0; i < n; i++) {
+		t = i * interval;
+		osc_update(&osc, t);
+
+		origin = (int64_t) t + ts_noise(&osc);
+		ingress_t = t + path_delay(&osc, t, 1);
+		ingress = osc_local(&osc, ingress_t) + ts_noise(&osc);
+		replay_sync(r, origin, ingress);
+		te[i] = replay_clock(r, osc_local(&osc, ingress_t)) - ingress_t;
+
+		req_t = t + interval / 2;
+		req = osc_local(&osc, req_t) + ts_noise(&osc);
+		rx = (int64_t) (req_t + path_delay(&osc, req_t, 0)) +
+			ts_noise(&osc);
+		replay_delay(r, req, rx);
+	}
+
+	i = conv_index(te, n, interval);
+	res->samples = n - i;
+	res->conv_time = i < n ? i * interval / 1e9 : -1.0;
+	res->rms = res->max_abs = NAN;
+	res->mtie = -1;
+	res->mtie_window = 0;
+	if (i == n)
+		goto out;
+
+	res->rms = res->max_abs = 0;
+	for (; i < n; i++) {
+		res->rms += te[i] * te[i];
+		if (fabs(te[i]) > res->max_abs)
+			res->max_abs = fabs(te[i]);
+		tie_sample(tie, llround(te[i]));
+	}
+	res->rms = sqrt(res->rms / res->samples);
+	for (w = TIE_WINDOWS - 1; w >= 0; w--) {
+		tie_get_result(tie, w, &tr);
+		if (tr.mtie_valid) {
+			res->mtie = tr.mtie;
+			res->mtie_window = tr.window;
+			break;
+		}
+	}
+out:
+	free(te);
+	if (tie)
+		tie_destroy(tie);
+	if (r)
+		replay_destroy(r);
+}
+
+static void *worker(void *arg)
+{
+	struct pool *pool = arg;
+	unsigned int i;
+
+	while (1) {
+		i = __atomic_fetch_add(&pool->next, 1, __ATOMIC_RELAXED);
+		if (i >= pool->num_jobs)
+			break;
+		run_job(&pool->jobs[i]);
+	}
+	return NULL;
+}
+
+static int run_pool(struct pool *pool, unsigned int threads)
+{
+	pthread_t *tid;
+	unsigned int i;
+	int err = 0;
+
+	if (threads > pool->num_jobs)
+		threads = pool->num_jobs;
+	if (threads <= 1) {
+		worker(pool);
+		return 0;
+	}
+	tid = calloc(threads, sizeof(*tid));
+	if (!tid)
+		return -1;
+	for (i = 0; i < threads; i++) {
+		if (pthread_create(&tid[i], NULL, worker, pool))
+			break;
+	}
+	if (!i)
+		err = -1;
+	while (i--)
+		pthread_join(tid[i], NULL);
+	free(tid);
+	return err;
+}
+
+static int parse_model(char *options)
+{
+	char *opt, *val, *save = NULL;
+	unsigned int i;
+
+	for (opt = strtok_r(options, ",", &save); opt;
+	     opt = strtok_r(NULL, ",", &save)) {
+		val = strchr(opt, '=');
+		if (!val) {
+			fprintf(stderr, "missing value of parameter %s\n", opt);
+			return -1;
+		}
+		*val++ = 0;
+		for (i = 0; i < sizeof(model_tab) / sizeof(model_tab[0]); i++) {
+			if (!strcmp(model_tab[i].name, opt))
+				break;
+		}
+		if (i == sizeof(model_tab) / sizeof(model_tab[0])) {
+			fprintf(stderr, "unknown model parameter %s\n", opt);
+			return -1;
+		}
+		if (sscanf(val, "%lf", model_tab[i].val) != 1) {
+			fprintf(stderr, "bad value %s of parameter %s\n",
+				val, opt);
+			return -1;
+		}
+	}
+	if (model.duration <= 0 || model.pdv < 0 || model.pdv_alpha <= 0 ||
+	    model.temp_tau <= 0 || model.interval < -10 ||
+	    model.interval > 10) {
+		fprintf(stderr, "model parameter out of range\n");
+		return -1;
+	}
+	return 0;
+}
+
+/*
+ * Expands the labels by a sweep of the form option=start:step:stop, the
+ * result is the cartesian product of the labels and the sweep values.
+ */
+static int expand_sweep(char ***labels, unsigned int *num, const char *sweep)
+{
+	unsigned int i, k, n = 0, cnt;
+	double start, step, stop;
+	char opt[64], **l;
+
+	if (sscanf(sweep, "%63[^=]=%lf:%lf:%lf",
+		   opt, &start, &step, &stop) != 4 ||
+	    step <= 0 || stop < start) {
+		fprintf(stderr, "bad sweep %s\n", sweep);
+		return -1;
+	}
+	cnt = (unsigned int) floor((stop - start) / step + 1e-9) + 1;
+	if ((uint64_t) cnt * *num > MAX_JOBS) {
+		fprintf(stderr, "too many configurations\n");
+		return -1;
+	}
+	l = calloc(cnt * *num, sizeof(*l));
+	if (!l)
+		return -1;
+	for (i = 0; i < *num; i++) {
+		for (k = 0; k < cnt; k++) {
+			l[n] = malloc(strlen((*labels)[i]) + strlen(opt) + 32);
+			if (!l[n])
+				goto failed;
+			sprintf(l[n++], "%s%s%s=%.9g", (*labels)[i],
+				(*labels)[i][0] ? "," : "", opt,
+				start + k * step);
+		}
+	}
+	for (i = 0; i < *num; i++)
+		free((*labels)[i]);
+	free(*labels);
+	*labels = l;
+	*num = n;
+	return 0;
+failed:
+	while (n--)
+		free(l[n]);
+	free(l);
+	return -1;
+}
+
+static void print_results(struct job *jobs, unsigned int num_jobs)
+{
+	struct sim_result *res;
+	unsigned int i;
+
+	printf("%-4s %10s %10s %10s %10s %10s\n", "cfg", "conv[s]",
+	       "rms[ns]", "max[ns]", "mtie[ns]", "window[s]");
+	for (i = 0; i < num_jobs; i++) {
+		res = &jobs[i].result;
+		if (jobs[i].err) {
+			printf("%-4u failed\n", i);
+			continue;
+		}
+		if (res->conv_time < 0) {
+			printf("%-4u %10s\n", i, "-");
+			continue;
+		}
+		printf("%-4u %10.1f %10.1f %10.1f %10" PRId64 " %10.1f\n",
+		       i, res->conv_time, res->rms, res->max_abs, res->mtie,
+		       res->mtie_window * pow(2.0, model.interval));
+	}
+	printf("\n");
+	for (i = 0; i < num_jobs; i++)
+		printf("%-4u %s\n", i, jobs[i].label[0] ?
+		       jobs[i].label : "default");
+}
+
+static void usage(char *progname)
+{
+	fprintf(stderr,
+		"\n"
+		"usage: %s [options]\n\n"
+		" -f [file] read the base configuration from 'file'\n"
+		" -c [opts] add a configuration with the comma separated\n"
+		"           'option=value' pairs applied to the base one\n"
+		" -s [swp]  sweep an option over 'option=start:step:stop'\n"
+		" -m [opts] set the comma separated 'parameter=value' pairs\n"
+		"           of the oscillator and network model\n"
+		" -j [num]  number of threads, the default is the number\n"
+		"           of online processors\n"
+		" -h        prints this message and exits\n"
+		" -v        prints the software version and exits\n"
+		"\n",
+		progname);
+}
+
+int main(int argc, char *argv[])
+{
+	const char *sweeps[MAX_SWEEPS], *file = NULL;
+	unsigned int i, num_labels = 0, num_sweeps = 0;
+	struct timespec start, end;
+	struct pool pool = { 0 };
+	char **labels, *progname;
+	int c, err = -1;
+	long threads;
+
+	threads = sysconf(_SC_NPROCESSORS_ONLN);
+	labels = calloc(MAX_JOBS, sizeof(*labels));
+	if (!labels)
+		return -1;
+
+	progname = strrchr(argv[0], '/');
+	progname = progname ? 1 + progname : argv[0];
+	while (EOF != (c = getopt(argc, argv, "c:f:j:m:s:hv"))) {
+		switch (c) {
+		case 'c':
+			if (num_labels == MAX_JOBS) {
+				fprintf(stderr, "too many configurations\n");
+				goto out;
+			}
+			labels[num_labels] = strdup(optarg);
+			if (!labels[num_labels++])
+				goto out;
+			break;
+		case 'f':
+			file = optarg;
+			break;
+		case 'j':
+			threads = atol(optarg);
+			if (threads < 1) {
+				usage(progname);
+				goto out;
+			}
+			break;
+		case 'm':
+			if (parse_model(optarg))
+				goto out;
+			break;
+		case 's':
+			if (num_sweeps == MAX_SWEEPS) {
+				fprintf(stderr, "too many sweeps\n");
+				goto out;
+			}
+			sweeps[num_sweeps++] = optarg;
+			break;
+		case 'v':
+			version_show(stdout);
+			err = 0;
+			goto out;
+		case 'h':
+			usage(progname);
+			err = 0;
+			goto out;
+		case '?':
+		default:
+			usage(progname);
+			goto out;
+		}
+	}
+	if (optind != argc) {
+		usage(progname);
+		goto out;
+	}
+
+	print_set_progname(progname);
+	print_set_syslog(0);
+	print_set_verbose(1);
+	print_set_level(LOG_WARNING);
+
+	if (!num_labels) {
+		labels[0] = strdup("");
+		if (!labels[num_labels++])
+			goto out;
+	}
+	for (i = 0; i < num_sweeps; i++) {
+		if (expand_sweep(&labels, &num_labels, sweeps[i]))
+			goto out;
+	}
+
+	pool.num_jobs = num_labels;
+	pool.jobs = calloc(pool.num_jobs, sizeof(*pool.jobs));
+	if (!pool.jobs)
+		goto out;
+	for (i = 0; i < pool.num_jobs; i++) {
+		pool.jobs[i].label = labels[i];
+		pool.jobs[i].cfg = replay_config_create(file, labels[i][0] ?
+							labels[i] : NULL);
+		if (!pool.jobs[i].cfg)
+			goto out;
+	}
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	if (run_pool(&pool, threads))
+		goto out;
+	clock_gettime(CLOCK_MONOTONIC, &end);
+
+	printf("%.0f s simulated, %u configurations in %.3f s\n\n",
+	       model.duration, pool.num_jobs,
+	       end.tv_sec - start.tv_sec + (end.tv_nsec - start.tv_nsec) / 1e9);
+	print_results(pool.jobs, pool.num_jobs);
+	err = 0;
+out:
+	if (pool.jobs) {
+		for (i = 0; i < pool.num_jobs; i++) {
+			if (pool.jobs[i].cfg)
+				config_destroy(pool.jobs[i].cfg);
+		}
+		free(pool.jobs);
+	}
+	for (i = 0; i < num_labels; i++)
+		free(labels[i]);
+	free(labels);
+	return err;
+}
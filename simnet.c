@@ -0,0 +1,135 @@
+/**
+ * @file simnet.c
+ * @note Copyright (C) 2026 The linuxptp contributors
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+#include <stdlib.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+
+#include "address.h"
+#include "config.h"
+#include "msg.h"
+#include "print.h"
+#include "simnet.h"
+#include "transport_private.h"
+
+static const struct simnet_ops *simnet_ops;
+static void *simnet_ctx;
+
+void simnet_set_ops(const struct simnet_ops *ops, void *ctx)
+{
+	simnet_ops = ops;
+	simnet_ctx = ctx;
+}
+
+static int simnet_close(struct transport *t, struct fdarray *fda)
+{
+	if (simnet_ops && fda->fd[FD_EVENT] >= 0)
+		simnet_ops->close(simnet_ctx, fda->fd[FD_EVENT]);
+	return 0;
+}
+
+static int simnet_open(struct transport *t, struct interface *iface,
+		       struct fdarray *fda, enum timestamp_type tt)
+{
+	int fd;
+
+	if (!simnet_ops) {
+		pr_err("simnet: no simulated network");
+		return -1;
+	}
+	fd = simnet_ops->open(simnet_ctx, iface->name);
+	if (fd < 0) {
+		pr_err("simnet: failed to attach %s", iface->name);
+		return -1;
+	}
+	/* All messages arrive on a single descriptor. */
+	fda->fd[FD_EVENT] = fd;
+	fda->fd[FD_GENERAL] = -1;
+	return 0;
+}
+
+static int simnet_recv(struct transport *t, int fd, void *buf, int buflen,
+		       struct address *addr, struct hw_timestamp *hwts)
+{
+	struct simnet_hdr hdr;
+	struct iovec iov[2] = {
+		{ &hdr, sizeof(hdr) },
+		{ buf, buflen },
+	};
+	struct msghdr msg = {
+		.msg_iov = iov,
+		.msg_iovlen = 2,
+	};
+	int cnt;
+
+	cnt = recvmsg(fd, &msg, 0);
+	if (cnt < (int) sizeof(hdr)) {
+		pr_err("simnet: recvmsg failed: %m");
+		return -1;
+	}
+	addr->len = 0;
+	hwts->ts = timespec_to_tmv(hdr.ts);
+	hwts->sw = hwts->ts;
+	return cnt - sizeof(hdr);
+}
+
+static int simnet_send(struct transport *t, struct fdarray *fda,
+		       enum transport_event event, int peer, void *buf,
+		       int buflen, struct address *addr,
+		       struct hw_timestamp *hwts)
+{
+	struct timespec ts;
+	int cnt;
+
+	cnt = simnet_ops->send(simnet_ctx, fda->fd[FD_EVENT], event, buf,
+			       buflen, &ts);
+	if (cnt <= 0)
+		return cnt;
+
+	switch (event) {
+	case TRANS_GENERAL:
+	case TRANS_ONESTEP:
+	case TRANS_P2P1STEP:
+		break;
+	case TRANS_EVENT:
+	case TRANS_DEFER_EVENT:
+		hwts->ts = timespec_to_tmv(ts);
+		break;
+	}
+	return cnt;
+}
+
+static void simnet_release(struct transport *t)
+{
+	free(t);
+}
+
+struct transport *simnet_transport_create(void)
+{
+	struct transport *t;
+
+	t = calloc(1, sizeof(*t));
+	if (!t)
+		return NULL;
+	t->close   = simnet_close;
+	t->open    = simnet_open;
+	t->recv    = simnet_recv;
+	t->send    = simnet_send;
+	t->release = simnet_release;
+	return t;
+}
@@ -0,0 +1,84 @@
+/**
+ * @file simnet.h
+ * @brief Implements transport over a simulated network.
+ * @note Copyright (C) 2026 The linuxptp contributors
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+#ifndef HAVE_SIMNET_H
+#define HAVE_SIMNET_H
+
+#include <time.h>
+
+#include "fd.h"
+#include "transport.h"
+
+/*
+ * The frames are read by the transport from a descriptor provided by
+ * the simulated network. Every frame is preceded by this header, which
+ * carries the receive time stamp.
+ */
+struct simnet_hdr {
+	struct timespec ts;
+};
+
+/**
+ * The simulated network, provided by the simulator.
+ */
+struct simnet_ops {
+	/**
+	 * Attach an interface to the network.
+	 * @param ctx   The context passed to @ref simnet_set_ops().
+	 * @param name  The name of the interface.
+	 * @return      A descriptor from which the received frames are
+	 *              read, or -1 on error.
+	 */
+	int (*open)(void *ctx, const char *name);
+
+	/**
+	 * Detach an interface from the network.
+	 * @param ctx  The context passed to @ref simnet_set_ops().
+	 * @param fd   A descriptor returned by the open method.
+	 */
+	void (*close)(void *ctx, int fd);
+
+	/**
+	 * Transmit a frame.
+	 * @param ctx    The context passed to @ref simnet_set_ops().
+	 * @param fd     A descriptor returned by the open method.
+	 * @param event  One of the @ref transport_event values.
+	 * @param buf    The frame.
+	 * @param len    The length of the frame.
+	 * @param ts     Returns the transmit time stamp.
+	 * @return       The number of bytes sent, or -1 on error.
+	 */
+	int (*send)(void *ctx, int fd, enum transport_event event,
+		    const void *buf, int len, struct timespec *ts);
+};
+
+/**
+ * Install the simulated network used by all instances of the transport.
+ * @param ops  The network operations, or NULL to remove the network.
+ * @param ctx  A context passed to the operations.
+ */
+void simnet_set_ops(const struct simnet_ops *ops, void *ctx);
+
+/**
+ * Allocate an instance of a simulated network transport.
+ * @return Pointer to a new transport instance on success, NULL otherwise.
+ */
+struct transport *simnet_transport_create(void);
+
+#endif
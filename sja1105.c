@@ -31,6 +31,11 @@
 #include "print.h"
 #include "sja1105.h"
 
+/* Interval of the sync timer in seconds */
+#define SJA1105_SYNC_INTERVAL	0.125
+/* Maximum adjustment of the clock ratio by a clock servo */
+#define SJA1105_MAX_PPB		1000000
+
 int SJA1105_VERBOSE_CONDITION = 1;
 int SJA1105_DEBUG_CONDITION = 1;
 
@@ -116,6 +121,7 @@ int sja1105_sync_timer_create(struct config *config)
 {
 	struct sja1105_sync_timer    *t = &sja1105_sync_t;
 	struct sja1105_sync_pi_servo *s = &t->sync_pi_s;
+	int servo_type;
 
 	t->max_offset = config_get_int(config, NULL, "sja1105_max_offset");
 	if (!t->max_offset) {
@@ -145,6 +151,17 @@ int sja1105_sync_timer_create(struct config *config)
 	s->kp = config_get_double(config, NULL, "sja1105_sync_kp");
 	s->ki = config_get_double(config, NULL, "sja1105_sync_ki");
 
+	servo_type = config_get_int(config, NULL, "sja1105_sync_servo");
+	if (servo_type != SJA1105_SERVO_BUILTIN) {
+		t->servo = servo_create(config, servo_type, 0,
+					SJA1105_MAX_PPB, 0);
+		if (!t->servo) {
+			pr_err("sja1105: failed to create servo for sync");
+			return -1;
+		}
+		servo_sync_interval(t->servo, SJA1105_SYNC_INTERVAL);
+	}
+
 	if (sja1105_parse_staging_area("/lib/firmware/sja1105.bin") < 0) {
 		pr_err("Parsing staging area failed");
 		return -1;
@@ -179,9 +196,11 @@ int sja1105_sync_timer_settime(void)
 }
 
 /* Calculate delay and offset between
- * clkid and SJA1105 PTP clock
+ * clkid and SJA1105 PTP clock, and the
+ * SJA1105 time of the measurement
  */
-static int sja1105_calculate(clockid_t clkid, int64_t *delay, int64_t *offset)
+static int sja1105_calculate(clockid_t clkid, int64_t *delay, int64_t *offset,
+			     uint64_t *ts)
 {
 	struct timespec t1_spec, t2_spec, t3_spec;
 	int gettings;
@@ -208,6 +227,7 @@ static int sja1105_calculate(clockid_t clkid, int64_t *delay, int64_t *offset)
 			*offset = t2_spec.tv_sec * NS_PER_SEC + t2_spec.tv_nsec -
 			         (t1_spec.tv_sec * NS_PER_SEC + t1_spec.tv_nsec) -
 			          interval / 2;
+			*ts = t2_spec.tv_sec * NS_PER_SEC + t2_spec.tv_nsec;
 		}
 	}
 	*delay = best_interval / 2;
@@ -238,6 +258,30 @@ static double sja1105_sync_run_pi_servo(int64_t offset)
 	return (double)adj / (double)ADJ_SCALE;
 }
 
+/* Calculate the clock ratio by the configured clock servo.
+ * Returns 1 if the clock needs to be stepped.
+ **/
+static int sja1105_sync_run_servo(int64_t offset, uint64_t ts, double *ratio)
+{
+	struct sja1105_sync_timer *t = &sja1105_sync_t;
+	enum servo_state state;
+	double adj;
+
+	adj = servo_sample(t->servo, offset, ts, 1.0, &state);
+
+	switch (state) {
+	case SERVO_UNLOCKED:
+		return 0;
+	case SERVO_JUMP:
+		return 1;
+	case SERVO_LOCKED:
+	case SERVO_LOCKED_STABLE:
+		break;
+	}
+	*ratio = 1.0 - adj / 1e9;
+	return 0;
+}
+
 int timespec_lower(const struct timespec *lhs, const struct timespec *rhs)
 {
 	if (lhs->tv_sec == rhs->tv_sec)
@@ -411,6 +455,7 @@ int sja1105_sync(clockid_t clkid)
 	struct timespec cur_t;
 	int64_t delay, offset;
 	struct timespec offset_ts;
+	uint64_t ts;
 
 	if (t->reset_req) {
 		pr_err("sja1105 reset requested");
@@ -438,7 +483,7 @@ int sja1105_sync(clockid_t clkid)
 			return -1;
 		}
 		/* Step 3, calculate delay and offset */
-		if (sja1105_calculate(clkid, &delay, &offset))
+		if (sja1105_calculate(clkid, &delay, &offset, &ts))
 			return -1;
 		/* Step 4, set offset into PTPCLKADD */
 		if (offset > 0)
@@ -450,9 +495,11 @@ int sja1105_sync(clockid_t clkid)
 			return -1;
 		}
 		s->drift_sum = 0;
+		if (t->servo)
+			servo_reset(t->servo);
 	}
 
-	if (sja1105_calculate(clkid, &delay, &offset))
+	if (sja1105_calculate(clkid, &delay, &offset, &ts))
 		return -1;
 
 	pr_debug("sja1105: offset %9lld ns, delay %9lld ns", offset, delay);
@@ -467,8 +514,14 @@ int sja1105_sync(clockid_t clkid)
 	}
 
 	/* Apply adjustment to the SJA1105 clock ratio
-	 * according to the PI algorithm */
-	t->ratio = 1 + sja1105_sync_run_pi_servo(offset);
+	 * according to the PI algorithm or the clock servo.
+	 * The clock can only be stepped by the reset. */
+	if (!t->servo) {
+		t->ratio = 1 + sja1105_sync_run_pi_servo(offset);
+	} else if (sja1105_sync_run_servo(offset, ts, &t->ratio)) {
+		t->reset_req = 1;
+		return 0;
+	}
 	if (sja1105_ptp_clk_rate_set(&spi_setup, t->ratio)) {
 		pr_err("sja1105: set_clock_ratio failed");
 		return -1;
@@ -481,5 +534,11 @@ int sja1105_sync(clockid_t clkid)
 
 void sja1105_sync_timer_destroy()
 {
+	struct sja1105_sync_timer *t = &sja1105_sync_t;
+
 	sja1105_qbv_stop();
+	if (t->servo) {
+		servo_destroy(t->servo);
+		t->servo = NULL;
+	}
 }
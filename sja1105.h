@@ -23,6 +23,10 @@
 #include <poll.h>
 
 #include "config.h"
+#include "servo.h"
+
+/* The PI loop of the sja1105 sync instead of a clock servo */
+#define SJA1105_SERVO_BUILTIN	-1
 
 enum qbv_state {
 	QBV_STATE_DISABLED,
@@ -47,6 +51,7 @@ struct sja1105_sync_timer {
 	struct  timespec qbv_cycle_len;
 	struct  timespec qbv_start_time;
 	struct  sja1105_sync_pi_servo sync_pi_s;
+	struct  servo *servo;
 };
 
 int sja1105_sync_timer_is_valid();
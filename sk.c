@@ -502,6 +502,7 @@ int sk_timestamping_init(int fd, const char *device, enum timestamp_type type,
 		case TRANS_CONTROLNET:
 		case TRANS_PROFINET:
 		case TRANS_UDS:
+		case TRANS_SIM:
 			return -1;
 		}
 		err = hwts_init(fd, device, filter1, filter2, tx_type);
@@ -17,9 +17,12 @@
  * with this program; if not, write to the Free Software Foundation, Inc.,
  * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
  */
+#include <pthread.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 #include <sys/ioctl.h>
+#include <time.h>
 #include <linux/ptp_clock.h>
 
 #include "print.h"
@@ -29,18 +32,50 @@
 
 #ifdef PTP_SYS_OFFSET
 
-static int64_t pctns(struct ptp_clock_time *t)
-{
-	return t->sec * NS_PER_SEC + t->nsec;
-}
+/* Number of the newest samples kept by the sampler, a power of two */
+#define SAMPLER_RING 1024
+/* Minimum time span of samples needed to fit the drift of the clocks */
+#define MIN_FIT_SPAN 1000000
 
-static struct {
+struct sysoff_sample {
 	int64_t interval;
 	int64_t offset;
 	uint64_t timestamp;
-} samples[PTP_MAX_SAMPLES];
+};
+
+/*
+ * The sampler thread is the only writer of the ring. Each slot works as a
+ * sequence lock: the sequence number is cleared while the slot is being
+ * written and set to the position of the sample plus one when it is
+ * complete, so the reader can detect a slot overwritten under its hands.
+ */
+struct sampler_slot {
+	uint64_t seq;
+	uint64_t burst;		/* CLOCK_MONOTONIC time of the burst */
+	struct sysoff_sample s;
+};
+
+struct sysoff_sampler {
+	int fd;
+	int method;
+	int n_samples;
+	struct timespec interval;
+	pthread_t thread;
+	int stop;
+	struct sampler_slot *ring;
+	uint64_t head;		/* next position written by the sampler */
+	/* Reader state */
+	uint64_t tail;		/* next position to be read */
+	uint64_t flushed;	/* bursts started before this time are ignored */
+	struct sysoff_sample buf[SAMPLER_RING];
+};
+
+static int64_t pctns(struct ptp_clock_time *t)
+{
+	return t->sec * NS_PER_SEC + t->nsec;
+}
 
-static int sysoff_precise(int fd, int64_t *result, uint64_t *ts)
+static int sysoff_precise(int fd, struct sysoff_sample *s)
 {
 #ifdef PTP_SYS_OFFSET_PRECISE
 	struct ptp_sys_offset_precise pso;
@@ -49,33 +84,19 @@ static int sysoff_precise(int fd, int64_t *result, uint64_t *ts)
 		pr_debug("ioctl PTP_SYS_OFFSET_PRECISE: %m");
 		return SYSOFF_RUN_TIME_MISSING;
 	}
-	*result = pctns(&pso.sys_realtime) - pctns(&pso.device);
-	*ts = pctns(&pso.sys_realtime);
+	s->interval = 0;
+	s->offset = pctns(&pso.sys_realtime) - pctns(&pso.device);
+	s->timestamp = pctns(&pso.sys_realtime);
 	return SYSOFF_PRECISE;
 #else
 	return SYSOFF_COMPILE_TIME_MISSING;
 #endif
 }
 
-static void insertion_sort(int length, int64_t interval, int64_t offset, uint64_t ts)
-{
-	int i = length - 1;
-	while (i >= 0) {
-		if (samples[i].interval < interval)
-			break;
-		samples[i+1] = samples[i];
-		i--;
-	}
-	samples[i+1].interval = interval;
-	samples[i+1].offset = offset;
-	samples[i+1].timestamp = ts;
-}
-
-static int64_t sysoff_estimate(struct ptp_clock_time *pct, int extended,
-			       int n_samples, uint64_t *ts, int64_t *delay)
+static void sysoff_samples(struct ptp_clock_time *pct, int extended,
+			   int n_samples, struct sysoff_sample *s)
 {
 	int64_t t1, t2, tp;
-	int64_t interval, offset;
 	int i;
 
 	for (i = 0; i < n_samples; i++) {
@@ -88,17 +109,74 @@ static int64_t sysoff_estimate(struct ptp_clock_time *pct, int extended,
 			tp = pctns(&pct[2*i+1]);
 			t2 = pctns(&pct[2*i+2]);
 		}
-		interval = t2 - t1;
-		offset = (t2 + t1) / 2 - tp;
-		insertion_sort(i, interval, offset, (t2 + t1) / 2);
+		s[i].interval = t2 - t1;
+		s[i].offset = (t2 + t1) / 2 - tp;
+		s[i].timestamp = (t2 + t1) / 2;
 	}
-	*ts = samples[0].timestamp;
-	*delay = samples[0].interval;
-	return samples[0].offset;
 }
 
-static int sysoff_extended(int fd, int n_samples,
-			   int64_t *result, uint64_t *ts, int64_t *delay)
+static int cmp_interval(const void *a, const void *b)
+{
+	const struct sysoff_sample *x = a, *y = b;
+
+	return (x->interval > y->interval) - (x->interval < y->interval);
+}
+
+/*
+ * The samples with the shortest intervals are the least disturbed by
+ * interrupts and bus contention, but taking only the single fastest one
+ * throws away the rest of the information. The fastest quarter of the
+ * samples, extended by samples of an equal interval, is kept and a line
+ * is fitted to their offsets, which averages out the jitter of the
+ * readings and, with samples spread over a longer time, follows the
+ * drift between the clocks. The offset is evaluated at the newest kept
+ * sample and the fitted drift is returned, so that the offset can be
+ * brought to another time.
+ */
+static int64_t sysoff_estimate(struct sysoff_sample *s, int n,
+			       uint64_t *ts, int64_t *delay, double *drift)
+{
+	double x, y, sx = 0.0, sy = 0.0, sxx = 0.0, sxy = 0.0, b = 0.0;
+	uint64_t t_ref, t_min;
+	int64_t o_ref;
+	int i, k;
+
+	qsort(s, n, sizeof(*s), cmp_interval);
+	for (k = (n + 3) / 4; k < n && s[k].interval == s[k-1].interval; k++)
+		;
+
+	t_ref = t_min = s[0].timestamp;
+	for (i = 1; i < k; i++) {
+		if ((int64_t) (s[i].timestamp - t_ref) > 0)
+			t_ref = s[i].timestamp;
+		if ((int64_t) (s[i].timestamp - t_min) < 0)
+			t_min = s[i].timestamp;
+	}
+	o_ref = s[0].offset;
+
+	for (i = 0; i < k; i++) {
+		x = (int64_t) (s[i].timestamp - t_ref);
+		y = s[i].offset - o_ref;
+		sx += x;
+		sy += y;
+		sxx += x * x;
+		sxy += x * y;
+	}
+	if (k >= 3 && t_ref - t_min >= MIN_FIT_SPAN) {
+		b = (sxy - sx * sy / k) / (sxx - sx * sx / k);
+	} else {
+		/* Too close to see the drift, use the mean time. */
+		t_ref += (int64_t) (sx / k);
+		sx = 0.0;
+	}
+
+	*ts = t_ref;
+	*delay = s[0].interval;
+	*drift = b;
+	return o_ref + (int64_t) ((sy - b * sx) / k);
+}
+
+static int sysoff_extended(int fd, int n_samples, struct sysoff_sample *s)
 {
 #ifdef PTP_SYS_OFFSET_EXTENDED
 	struct ptp_sys_offset_extended pso;
@@ -108,15 +186,14 @@ static int sysoff_extended(int fd, int n_samples,
 		pr_debug("ioctl PTP_SYS_OFFSET_EXTENDED: %m");
 		return SYSOFF_RUN_TIME_MISSING;
 	}
-	*result = sysoff_estimate(&pso.ts[0][0], 1, n_samples, ts, delay);
+	sysoff_samples(&pso.ts[0][0], 1, n_samples, s);
 	return SYSOFF_EXTENDED;
 #else
 	return SYSOFF_COMPILE_TIME_MISSING;
 #endif
 }
 
-static int sysoff_basic(int fd, int n_samples,
-			int64_t *result, uint64_t *ts, int64_t *delay)
+static int sysoff_basic(int fd, int n_samples, struct sysoff_sample *s)
 {
 	struct ptp_sys_offset pso;
 	memset(&pso, 0, sizeof(pso));
@@ -125,23 +202,43 @@ static int sysoff_basic(int fd, int n_samples,
 		perror("ioctl PTP_SYS_OFFSET");
 		return SYSOFF_RUN_TIME_MISSING;
 	}
-	*result = sysoff_estimate(pso.ts, 0, n_samples, ts, delay);
+	sysoff_samples(pso.ts, 0, n_samples, s);
 	return SYSOFF_BASIC;
 }
 
-int sysoff_measure(int fd, int method, int n_samples,
-		   int64_t *result, uint64_t *ts, int64_t *delay)
+/* Returns the number of samples or a negative SYSOFF_ value. */
+static int sysoff_read(int fd, int method, int n_samples,
+		       struct sysoff_sample *s)
 {
+	int r = SYSOFF_COMPILE_TIME_MISSING;
+
 	switch (method) {
 	case SYSOFF_PRECISE:
-		*delay = 0;
-		return sysoff_precise(fd, result, ts);
+		r = sysoff_precise(fd, s);
+		n_samples = 1;
+		break;
 	case SYSOFF_EXTENDED:
-		return sysoff_extended(fd, n_samples, result, ts, delay);
+		r = sysoff_extended(fd, n_samples, s);
+		break;
 	case SYSOFF_BASIC:
-		return sysoff_basic(fd, n_samples, result, ts, delay);
+		r = sysoff_basic(fd, n_samples, s);
+		break;
 	}
-	return SYSOFF_COMPILE_TIME_MISSING;
+	return r < 0 ? r : n_samples;
+}
+
+int sysoff_measure(int fd, int method, int n_samples,
+		   int64_t *result, uint64_t *ts, int64_t *delay)
+{
+	struct sysoff_sample s[PTP_MAX_SAMPLES];
+	double drift;
+	int n;
+
+	n = sysoff_read(fd, method, n_samples, s);
+	if (n < 0)
+		return n;
+	*result = sysoff_estimate(s, n, ts, delay, &drift);
+	return method;
 }
 
 int sysoff_probe(int fd, int n_samples)
@@ -166,9 +263,141 @@ int sysoff_probe(int fd, int n_samples)
 	return SYSOFF_RUN_TIME_MISSING;
 }
 
+static uint64_t monotonic_ns(void)
+{
+	struct timespec now;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return now.tv_sec * NS_PER_SEC + now.tv_nsec;
+}
+
+static void *sampler_thread(void *arg)
+{
+	struct sysoff_sample s[PTP_MAX_SAMPLES];
+	struct sysoff_sampler *sm = arg;
+	struct sampler_slot *slot;
+	struct timespec next;
+	int i, n, failed = 0;
+	uint64_t burst, pos;
+
+	clock_gettime(CLOCK_MONOTONIC, &next);
+
+	while (!__atomic_load_n(&sm->stop, __ATOMIC_ACQUIRE)) {
+		next.tv_sec += sm->interval.tv_sec;
+		next.tv_nsec += sm->interval.tv_nsec;
+		if (next.tv_nsec >= NS_PER_SEC) {
+			next.tv_sec++;
+			next.tv_nsec -= NS_PER_SEC;
+		}
+		clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &next, NULL);
+
+		burst = monotonic_ns();
+		n = sysoff_read(sm->fd, sm->method, sm->n_samples, s);
+		if (n < 0) {
+			if (!failed)
+				pr_err("sysoff sampler: failed to read clock");
+			failed = 1;
+			continue;
+		}
+		failed = 0;
+
+		pos = sm->head;
+		for (i = 0; i < n; i++, pos++) {
+			slot = &sm->ring[pos % SAMPLER_RING];
+			__atomic_store_n(&slot->seq, 0, __ATOMIC_RELAXED);
+			__atomic_thread_fence(__ATOMIC_RELEASE);
+			slot->burst = burst;
+			slot->s = s[i];
+			__atomic_store_n(&slot->seq, pos + 1, __ATOMIC_RELEASE);
+		}
+		__atomic_store_n(&sm->head, pos, __ATOMIC_RELEASE);
+	}
+	return NULL;
+}
+
+struct sysoff_sampler *sysoff_sampler_create(int fd, int method,
+					     int n_samples, double rate)
+{
+	struct sysoff_sampler *sm;
+	double interval;
+
+	if (method < 0 || method >= SYSOFF_LAST || rate <= 0.0)
+		return NULL;
+
+	sm = calloc(1, sizeof(*sm));
+	if (!sm)
+		return NULL;
+	sm->ring = calloc(SAMPLER_RING, sizeof(*sm->ring));
+	if (!sm->ring) {
+		free(sm);
+		return NULL;
+	}
+	sm->fd = fd;
+	sm->method = method;
+	sm->n_samples = n_samples;
+	interval = 1.0 / rate;
+	sm->interval.tv_sec = interval;
+	sm->interval.tv_nsec = (interval - sm->interval.tv_sec) * 1e9;
+
+	if (pthread_create(&sm->thread, NULL, sampler_thread, sm)) {
+		free(sm->ring);
+		free(sm);
+		return NULL;
+	}
+	return sm;
+}
+
+void sysoff_sampler_destroy(struct sysoff_sampler *sm)
+{
+	__atomic_store_n(&sm->stop, 1, __ATOMIC_RELEASE);
+	pthread_join(sm->thread, NULL);
+	free(sm->ring);
+	free(sm);
+}
+
+void sysoff_sampler_flush(struct sysoff_sampler *sm)
+{
+	sm->tail = __atomic_load_n(&sm->head, __ATOMIC_ACQUIRE);
+	sm->flushed = monotonic_ns();
+}
+
+int sysoff_sampler_get(struct sysoff_sampler *sm, int64_t *result,
+		       uint64_t *ts, int64_t *delay, double *drift)
+{
+	struct sampler_slot *slot;
+	struct sysoff_sample s;
+	uint64_t head, pos, burst;
+	int n = 0;
+
+	head = __atomic_load_n(&sm->head, __ATOMIC_ACQUIRE);
+	pos = sm->tail;
+	if (head - pos > SAMPLER_RING)
+		pos = head - SAMPLER_RING;
+
+	for (; pos != head; pos++) {
+		slot = &sm->ring[pos % SAMPLER_RING];
+		if (__atomic_load_n(&slot->seq, __ATOMIC_ACQUIRE) != pos + 1)
+			continue;
+		burst = slot->burst;
+		s = slot->s;
+		__atomic_thread_fence(__ATOMIC_ACQUIRE);
+		if (__atomic_load_n(&slot->seq, __ATOMIC_RELAXED) != pos + 1)
+			continue;
+		if ((int64_t) (burst - sm->flushed) < 0)
+			continue;
+		sm->buf[n++] = s;
+	}
+	sm->tail = head;
+
+	if (!n)
+		return -1;
+	*result = sysoff_estimate(sm->buf, n, ts, delay, drift);
+	return 0;
+}
+
 #else /* !PTP_SYS_OFFSET */
 
-int sysoff_measure(int fd, int n_samples,
+int sysoff_measure(int fd, int method, int n_samples,
 		   int64_t *result, uint64_t *ts, int64_t *delay)
 {
 	return SYSOFF_COMPILE_TIME_MISSING;
@@ -179,4 +408,24 @@ int sysoff_probe(int fd, int n_samples)
 	return SYSOFF_COMPILE_TIME_MISSING;
 }
 
+struct sysoff_sampler *sysoff_sampler_create(int fd, int method,
+					     int n_samples, double rate)
+{
+	return NULL;
+}
+
+void sysoff_sampler_destroy(struct sysoff_sampler *sm)
+{
+}
+
+void sysoff_sampler_flush(struct sysoff_sampler *sm)
+{
+}
+
+int sysoff_sampler_get(struct sysoff_sampler *sm, int64_t *result,
+		       uint64_t *ts, int64_t *delay, double *drift)
+{
+	return -1;
+}
+
 #endif /* PTP_SYS_OFFSET */
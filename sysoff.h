@@ -48,3 +48,44 @@ int sysoff_probe(int fd, int n_samples);
  */
 int sysoff_measure(int fd, int method, int n_samples,
 		   int64_t *result, uint64_t *ts, int64_t *delay);
+
+/** Opaque type */
+struct sysoff_sampler;
+
+/**
+ * Start a thread which measures the offset between a PHC and the system
+ * time in the background.
+ * @param fd         An open file descriptor to a PHC device.
+ * @param method     A non-negative SYSOFF_ value returned by sysoff_probe().
+ * @param n_samples  The number of consecutive readings in each burst.
+ * @param rate       The number of bursts per second.
+ * @return  A pointer to a new sampler on success, NULL otherwise.
+ */
+struct sysoff_sampler *sysoff_sampler_create(int fd, int method,
+					     int n_samples, double rate);
+
+/**
+ * Stop the thread and destroy the sampler.
+ * @param sm  Pointer obtained via @ref sysoff_sampler_create().
+ */
+void sysoff_sampler_destroy(struct sysoff_sampler *sm);
+
+/**
+ * Discard the samples collected so far, e.g. after the clock was adjusted.
+ * @param sm  Pointer obtained via @ref sysoff_sampler_create().
+ */
+void sysoff_sampler_flush(struct sysoff_sampler *sm);
+
+/**
+ * Estimate the offset from the samples collected since the last call.
+ * This function never waits for the sampler thread.
+ * @param sm      Pointer obtained via @ref sysoff_sampler_create().
+ * @param result  The estimated offset in nanoseconds.
+ * @param ts      The system time corresponding to the 'result'.
+ * @param delay   The delay in reading of the clock in nanoseconds.
+ * @param drift   The rate of change of the offset in ns per ns of the
+ *                system time, 0 if the samples were too close to fit it.
+ * @return  Zero on success, -1 if no new samples are available.
+ */
+int sysoff_sampler_get(struct sysoff_sampler *sm, int64_t *result,
+		       uint64_t *ts, int64_t *delay, double *drift);
@@ -0,0 +1,255 @@
+/**
+ * @file tie.c
+ * @note Copyright (C) 2026 The linuxptp contributors
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+#include <math.h>
+#include <stdlib.h>
+
+#include "tie.h"
+
+/*
+ * MTIE of window n is the largest peak-to-peak time error over any n
+ * consecutive sample intervals (n + 1 samples). It is computed with a
+ * pair of monotonic deques per window, so each sample costs O(1)
+ * amortized per window.
+ *
+ * TDEV of window n is estimated as
+ *
+ *   TDEV^2 = < S_j^2 > / (6 n^2),
+ *   S_j    = W(j + 2n) - 2 W(j + n) + W(j),
+ *
+ * where W(a) is the sum of the n samples starting at a. The window
+ * sums are differences of a running prefix sum, so every sample adds
+ * one term to each accumulator.
+ */
+
+#define X_LEN (1 << TIE_WINDOWS)       /* > largest window + 1 */
+#define P_LEN (1 << (TIE_WINDOWS + 1)) /* > 3 * largest window + 1 */
+
+struct deque {
+	uint64_t *idx;
+	unsigned int mask;
+	unsigned int head;
+	unsigned int tail;
+};
+
+struct tie_window {
+	unsigned int n;
+	struct deque max;
+	struct deque min;
+	int64_t mtie;
+	double tdev_sum;
+	uint64_t tdev_cnt;
+	int mtie_violation;
+	int tdev_violation;
+};
+
+struct tie {
+	int64_t mtie_limit;
+	double tdev_limit;
+	uint64_t num;               /* samples added so far */
+	int64_t x[X_LEN];           /* the latest samples */
+	uint64_t prefix[P_LEN];     /* prefix[a] = x(0) + ... + x(a - 1) */
+	struct tie_window win[TIE_WINDOWS];
+	uint64_t *storage;
+};
+
+static int deque_empty(struct deque *d)
+{
+	return d->head == d->tail;
+}
+
+static uint64_t deque_front(struct deque *d)
+{
+	return d->idx[d->head & d->mask];
+}
+
+static uint64_t deque_back(struct deque *d)
+{
+	return d->idx[(d->tail - 1) & d->mask];
+}
+
+static void deque_push(struct deque *d, uint64_t i)
+{
+	d->idx[d->tail & d->mask] = i;
+	d->tail++;
+}
+
+static int64_t sample(struct tie *t, uint64_t i)
+{
+	return t->x[i & (X_LEN - 1)];
+}
+
+static uint64_t prefix(struct tie *t, uint64_t a)
+{
+	return t->prefix[a & (P_LEN - 1)];
+}
+
+static void window_mtie(struct tie *t, struct tie_window *w, uint64_t i)
+{
+	int64_t x = sample(t, i), pp;
+
+	/* Drop the samples falling out of the window first, so that the
+	   deques never hold more than n + 1 entries. */
+	if (i >= w->n) {
+		while (!deque_empty(&w->max) && deque_front(&w->max) < i - w->n)
+			w->max.head++;
+		while (!deque_empty(&w->min) && deque_front(&w->min) < i - w->n)
+			w->min.head++;
+	}
+
+	while (!deque_empty(&w->max) && sample(t, deque_back(&w->max)) <= x)
+		w->max.tail--;
+	deque_push(&w->max, i);
+	while (!deque_empty(&w->min) && sample(t, deque_back(&w->min)) >= x)
+		w->min.tail--;
+	deque_push(&w->min, i);
+
+	if (i < w->n)
+		return;
+
+	pp = sample(t, deque_front(&w->max)) - sample(t, deque_front(&w->min));
+	if (w->mtie < pp)
+		w->mtie = pp;
+}
+
+static void window_tdev(struct tie *t, struct tie_window *w, uint64_t i)
+{
+	uint64_t a = i + 1, n = w->n;
+	int64_t s;
+
+	if (a < 3 * n)
+		return;
+
+	/* Unsigned wrap around cancels out in the differences. */
+	s = (int64_t) (prefix(t, a) - 3 * prefix(t, a - n) +
+		       3 * prefix(t, a - 2 * n) - prefix(t, a - 3 * n));
+	w->tdev_sum += (double) s * s;
+	w->tdev_cnt++;
+}
+
+static double window_tdev_result(struct tie_window *w)
+{
+	if (!w->tdev_cnt)
+		return 0.0;
+	return sqrt(w->tdev_sum / w->tdev_cnt / 6.0) / w->n;
+}
+
+struct tie *tie_create(int64_t mtie_limit, double tdev_limit)
+{
+	unsigned int i, len = 0;
+	uint64_t *p;
+	struct tie *t;
+
+	t = calloc(1, sizeof(*t));
+	if (!t)
+		return NULL;
+
+	for (i = 0; i < TIE_WINDOWS; i++)
+		len += 2 * (2U << i);
+	t->storage = calloc(len, sizeof(*t->storage));
+	if (!t->storage) {
+		free(t);
+		return NULL;
+	}
+
+	p = t->storage;
+	for (i = 0; i < TIE_WINDOWS; i++) {
+		t->win[i].n = 1U << i;
+		t->win[i].max.idx = p;
+		t->win[i].max.mask = (2U << i) - 1;
+		p += 2U << i;
+		t->win[i].min.idx = p;
+		t->win[i].min.mask = (2U << i) - 1;
+		p += 2U << i;
+	}
+	t->mtie_limit = mtie_limit;
+	t->tdev_limit = tdev_limit;
+	return t;
+}
+
+void tie_destroy(struct tie *t)
+{
+	free(t->storage);
+	free(t);
+}
+
+int tie_sample(struct tie *t, int64_t offset)
+{
+	struct tie_window *w;
+	uint64_t i = t->num;
+	int k, violation = 0;
+
+	t->x[i & (X_LEN - 1)] = offset;
+	t->prefix[(i + 1) & (P_LEN - 1)] = prefix(t, i) + (uint64_t) offset;
+	t->num++;
+
+	for (k = 0; k < TIE_WINDOWS; k++) {
+		w = &t->win[k];
+		window_mtie(t, w, i);
+		window_tdev(t, w, i);
+
+		if (t->mtie_limit && !w->mtie_violation &&
+		    w->mtie > t->mtie_limit) {
+			w->mtie_violation = 1;
+			violation = 1;
+		}
+		if (t->tdev_limit > 0.0 && !w->tdev_violation &&
+		    window_tdev_result(w) > t->tdev_limit) {
+			w->tdev_violation = 1;
+			violation = 1;
+		}
+	}
+	return violation;
+}
+
+uint64_t tie_num_samples(struct tie *t)
+{
+	return t->num;
+}
+
+void tie_get_result(struct tie *t, int index, struct tie_result *result)
+{
+	struct tie_window *w = &t->win[index];
+
+	result->window = w->n;
+	result->mtie_valid = t->num > w->n;
+	result->tdev_valid = w->tdev_cnt > 0;
+	result->mtie_violation = w->mtie_violation;
+	result->tdev_violation = w->tdev_violation;
+	result->mtie = w->mtie;
+	result->tdev = window_tdev_result(w);
+}
+
+void tie_reset(struct tie *t)
+{
+	struct tie_window *w;
+	int k;
+
+	t->num = 0;
+	t->prefix[0] = 0;
+	for (k = 0; k < TIE_WINDOWS; k++) {
+		w = &t->win[k];
+		w->max.head = w->max.tail = 0;
+		w->min.head = w->min.tail = 0;
+		w->mtie = 0;
+		w->tdev_sum = 0.0;
+		w->tdev_cnt = 0;
+		w->mtie_violation = 0;
+		w->tdev_violation = 0;
+	}
+}
@@ -0,0 +1,89 @@
+/**
+ * @file tie.h
+ * @brief Implements streaming MTIE and TDEV estimation of the time error.
+ * @note Copyright (C) 2026 The linuxptp contributors
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+#ifndef HAVE_TIE_H
+#define HAVE_TIE_H
+
+#include <stdint.h>
+
+/**
+ * The number of observation windows. Window i spans 2^i sample
+ * intervals.
+ */
+#define TIE_WINDOWS 12
+
+/** Opaque type */
+struct tie;
+
+struct tie_result {
+	unsigned int window;  /* observation interval in samples */
+	int mtie_valid;
+	int tdev_valid;
+	int mtie_violation;
+	int tdev_violation;
+	int64_t mtie;         /* nanoseconds */
+	double tdev;          /* nanoseconds */
+};
+
+/**
+ * Create a new time error estimator.
+ * @param mtie_limit  MTIE mask in nanoseconds, zero to disable the check.
+ * @param tdev_limit  TDEV mask in nanoseconds, zero to disable the check.
+ * @return A pointer to a new estimator on success, NULL otherwise.
+ */
+struct tie *tie_create(int64_t mtie_limit, double tdev_limit);
+
+/**
+ * Destroy a time error estimator.
+ * @param t  Pointer obtained via @ref tie_create().
+ */
+void tie_destroy(struct tie *t);
+
+/**
+ * Add a time error sample. The samples are expected to be taken at a
+ * constant interval.
+ * @param t       Pointer obtained via @ref tie_create().
+ * @param offset  The time error in nanoseconds.
+ * @return        One if a mask was exceeded for the first time since
+ *                the last reset, zero otherwise.
+ */
+int tie_sample(struct tie *t, int64_t offset);
+
+/**
+ * Obtain the number of samples added since the last reset.
+ * @param t  Pointer obtained via @ref tie_create().
+ * @return   The number of samples.
+ */
+uint64_t tie_num_samples(struct tie *t);
+
+/**
+ * Obtain the statistics of one observation window.
+ * @param t       Pointer obtained via @ref tie_create().
+ * @param index   Window index, from 0 to TIE_WINDOWS - 1.
+ * @param result  Returns the statistics.
+ */
+void tie_get_result(struct tie *t, int index, struct tie_result *result);
+
+/**
+ * Discard all samples and clear the violation flags.
+ * @param t  Pointer obtained via @ref tie_create().
+ */
+void tie_reset(struct tie *t);
+
+#endif
@@ -46,6 +46,7 @@
 
 #define DEFAULT_FIRST_SHM_SEGMENT 0
 #define DEFAULT_RESTART_PROCESSES 1
+#define DEFAULT_SOCK_REFCLOCK 0
 
 #define DEFAULT_NTP_PROGRAM CHRONYD
 #define DEFAULT_NTP_MINPOLL 6
@@ -111,6 +112,7 @@ struct timemaster_config {
 	char *rundir;
 	int first_shm_segment;
 	int restart_processes;
+	int sock_refclock;
 	struct program_config chronyd;
 	struct program_config ntpd;
 	struct program_config phc2sys;
@@ -393,6 +395,8 @@ static int parse_timemaster_settings(char **settings,
 			r = parse_int(value, &config->first_shm_segment);
 		} else if (!strcasecmp(name, "restart_processes")) {
 			r = parse_int(value, &config->restart_processes);
+		} else if (!strcasecmp(name, "sock_refclock")) {
+			r = parse_int(value, &config->sock_refclock);
 		} else {
 			pr_err("unknown timemaster setting %s", name);
 			return 1;
@@ -533,6 +537,7 @@ static struct timemaster_config *config_parse(char *path)
 	config->rundir = xstrdup(DEFAULT_RUNDIR);
 	config->first_shm_segment = DEFAULT_FIRST_SHM_SEGMENT;
 	config->restart_processes = DEFAULT_RESTART_PROCESSES;
+	config->sock_refclock = DEFAULT_SOCK_REFCLOCK;
 
 	init_program_config(&config->chronyd, "chronyd",
 			    NULL, DEFAULT_CHRONYD_SETTINGS, NULL);
@@ -626,8 +631,8 @@ static char **get_ptp4l_command(struct program_config *config,
 }
 
 static char **get_phc2sys_command(struct program_config *config, int domain,
-				  int poll, int shm_segment, char *uds_path,
-				  char *message_tag)
+				  int poll, int shm_segment, char *sock_path,
+				  char *uds_path, char *message_tag)
 {
 	char **command = (char **)parray_new();
 
@@ -639,9 +644,18 @@ static char **get_phc2sys_command(struct program_config *config, int domain,
 						1.0 / (1 << poll) : 1 << -poll),
 		      xstrdup("-z"), xstrdup(uds_path),
 		      xstrdup("-t"), xstrdup(message_tag),
-		      xstrdup("-n"), string_newf("%d", domain),
-		      xstrdup("-E"), xstrdup("ntpshm"),
-		      xstrdup("-M"), string_newf("%d", shm_segment), NULL);
+		      xstrdup("-n"), string_newf("%d", domain), NULL);
+
+	if (sock_path)
+		parray_extend((void ***)&command,
+			      xstrdup("-E"), xstrdup("chronysock"),
+			      xstrdup("--chronysock_path"), xstrdup(sock_path),
+			      NULL);
+	else
+		parray_extend((void ***)&command,
+			      xstrdup("-E"), xstrdup("ntpshm"),
+			      xstrdup("-M"), string_newf("%d", shm_segment),
+			      NULL);
 
 	return command;
 }
@@ -696,6 +710,20 @@ static void add_shm_source(int shm_segment, int poll, int dpoll, double delay,
 	free(refid);
 }
 
+static void add_sock_source(char *sock_path, int shm_segment, int poll,
+			    double delay, char *ntp_options, char *prefix,
+			    char **ntp_config)
+{
+	char *refid = get_refid(prefix, shm_segment);
+
+	string_appendf(ntp_config,
+		       "refclock SOCK %s poll %d "
+		       "refid %s precision 1.0e-9 delay %.1e %s\n",
+		       sock_path, poll, refid, delay, ntp_options);
+
+	free(refid);
+}
+
 static int add_ntp_source(struct ntp_server *source, char **ntp_config)
 {
 	pr_debug("adding NTP server %s", source->address);
@@ -712,7 +740,7 @@ static int add_ptp_source(struct ptp_domain *source,
 			  char **ntp_config, struct script *script)
 {
 	struct config_file *config_file;
-	char **command, *uds_path, **interfaces, *message_tag;
+	char **command, *uds_path, *sock_path, **interfaces, *message_tag;
 	char ts_interface[IF_NAMESIZE];
 	int i, j, num_interfaces, *phc, *phcs, hw_ts, sw_ts;
 	struct sk_ts_info ts_info;
@@ -810,6 +838,12 @@ static int add_ptp_source(struct ptp_domain *source,
 		uds_path = string_newf("%s/ptp4l.%d.socket",
 				       config->rundir, *shm_segment);
 
+		/* only chronyd has the SOCK reference clock */
+		sock_path = NULL;
+		if (config->sock_refclock && config->ntp_program == CHRONYD)
+			sock_path = string_newf("%s/chrony.%d.sock",
+						config->rundir, *shm_segment);
+
 		message_tag = string_newf("[%d", source->domain);
 		for (j = 0; interfaces[j]; j++)
 			string_appendf(&message_tag, "%s%s", j ? "+" : ":",
@@ -844,8 +878,8 @@ static int add_ptp_source(struct ptp_domain *source,
 			command = get_phc2sys_command(&config->phc2sys,
 						      source->domain,
 						      source->phc2sys_poll,
-						      *shm_segment, uds_path,
-						      message_tag);
+						      *shm_segment, sock_path,
+						      uds_path, message_tag);
 			add_command(command, (*command_group)++, script);
 		} else {
 			/* SW time stamping */
@@ -853,20 +887,34 @@ static int add_ptp_source(struct ptp_domain *source,
 						    interfaces, 0);
 			add_command(command, (*command_group)++, script);
 
-			string_appendf(&config_file->content,
-				       "clock_servo ntpshm\n"
-				       "ntpshm_segment %d\n", *shm_segment);
+			if (sock_path)
+				string_appendf(&config_file->content,
+					       "clock_servo chronysock\n"
+					       "chronysock_path %s\n",
+					       sock_path);
+			else
+				string_appendf(&config_file->content,
+					       "clock_servo ntpshm\n"
+					       "ntpshm_segment %d\n",
+					       *shm_segment);
 		}
 
 		parray_append((void ***)&script->configs, config_file);
 
-		add_shm_source(*shm_segment, source->ntp_poll,
-			       source->phc2sys_poll, source->delay,
-			       source->ntp_options, "PTP", config, ntp_config);
+		if (sock_path)
+			add_sock_source(sock_path, *shm_segment,
+					source->ntp_poll, source->delay,
+					source->ntp_options, "PTP", ntp_config);
+		else
+			add_shm_source(*shm_segment, source->ntp_poll,
+				       source->phc2sys_poll, source->delay,
+				       source->ntp_options, "PTP", config,
+				       ntp_config);
 
 		(*shm_segment)++;
 
 		free(message_tag);
+		free(sock_path);
 		free(uds_path);
 		free(interfaces);
 	}
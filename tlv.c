@@ -79,6 +79,102 @@ static int64_t net2host64_unaligned(int64_t *p)
 	return v;
 }
 
+static void servo_history_n2h(struct servo_history_np *shn)
+{
+	struct servo_history_record_np *r;
+	int i;
+
+	for (i = 0; i < shn->count; i++) {
+		r = &shn->record[i];
+		r->time = net2host64(r->time);
+		r->offset = net2host64(r->offset);
+		r->offset_min = net2host64(r->offset_min);
+		r->offset_max = net2host64(r->offset_max);
+		r->delay = net2host64(r->delay);
+		r->freq = ntohl(r->freq);
+		r->count = ntohl(r->count);
+	}
+}
+
+static void servo_history_h2n(struct servo_history_np *shn)
+{
+	struct servo_history_record_np *r;
+	int i;
+
+	for (i = 0; i < shn->count; i++) {
+		r = &shn->record[i];
+		r->time = host2net64(r->time);
+		r->offset = host2net64(r->offset);
+		r->offset_min = host2net64(r->offset_min);
+		r->offset_max = host2net64(r->offset_max);
+		r->delay = host2net64(r->delay);
+		r->freq = htonl(r->freq);
+		r->count = htonl(r->count);
+	}
+}
+
+static void time_error_stats_n2h(struct time_error_stats_np *tes)
+{
+	struct time_error_window_np *w;
+	int i;
+
+	tes->samples = net2host64(tes->samples);
+	tes->mtieLimit = net2host64(tes->mtieLimit);
+	tes->tdevLimit = net2host64(tes->tdevLimit);
+	for (i = 0; i < tes->count; i++) {
+		w = &tes->window[i];
+		w->window = ntohl(w->window);
+		w->mtie = net2host64(w->mtie);
+		w->tdev = net2host64(w->tdev);
+	}
+}
+
+static void time_error_stats_h2n(struct time_error_stats_np *tes)
+{
+	struct time_error_window_np *w;
+	int i;
+
+	for (i = 0; i < tes->count; i++) {
+		w = &tes->window[i];
+		w->window = htonl(w->window);
+		w->mtie = host2net64(w->mtie);
+		w->tdev = host2net64(w->tdev);
+	}
+	tes->samples = host2net64(tes->samples);
+	tes->mtieLimit = host2net64(tes->mtieLimit);
+	tes->tdevLimit = host2net64(tes->tdevLimit);
+}
+
+static void ensemble_n2h(struct ensemble_np *en)
+{
+	struct ensemble_master_np *em;
+	int i;
+
+	for (i = 0; i < en->count; i++) {
+		em = &en->master[i];
+		em->master.portNumber = ntohs(em->master.portNumber);
+		em->weight = ntohl(em->weight);
+		em->offset = net2host64(em->offset);
+		em->delay = net2host64(em->delay);
+		em->stddev = net2host64(em->stddev);
+	}
+}
+
+static void ensemble_h2n(struct ensemble_np *en)
+{
+	struct ensemble_master_np *em;
+	int i;
+
+	for (i = 0; i < en->count; i++) {
+		em = &en->master[i];
+		em->master.portNumber = htons(em->master.portNumber);
+		em->weight = htonl(em->weight);
+		em->offset = host2net64(em->offset);
+		em->delay = host2net64(em->delay);
+		em->stddev = host2net64(em->stddev);
+	}
+}
+
 static int mgt_post_recv(struct management_tlv *m, uint16_t data_len,
 			 struct tlv_extra *extra)
 {
@@ -92,6 +188,11 @@ static int mgt_post_recv(struct management_tlv *m, uint16_t data_len,
 	struct grandmaster_settings_np *gsn;
 	struct subscribe_events_np *sen;
 	struct port_properties_np *ppn;
+	struct servo_history_np *shn;
+	struct time_error_stats_np *tes;
+	struct servo_gains_np *sgn;
+	struct ensemble_np *en;
+	struct trace_np *trn;
 	struct mgmt_clock_description *cd;
 	int extra_len = 0, len;
 	uint8_t *buf;
@@ -286,6 +387,60 @@ static int mgt_post_recv(struct management_tlv *m, uint16_t data_len,
 		extra_len = sizeof(struct port_properties_np);
 		extra_len += ppn->interface.length;
 		break;
+	case TLV_SERVO_HISTORY_NP:
+		if (data_len < sizeof(struct servo_history_np))
+			goto bad_length;
+		shn = (struct servo_history_np *)m->data;
+		shn->count = ntohs(shn->count);
+		shn->total = ntohl(shn->total);
+		shn->start = ntohl(shn->start);
+		if (shn->count > SERVO_HISTORY_PAGE_MAX)
+			goto bad_length;
+		extra_len = sizeof(struct servo_history_np);
+		extra_len += shn->count * sizeof(struct servo_history_record_np);
+		if (extra_len > data_len)
+			goto bad_length;
+		servo_history_n2h(shn);
+		break;
+	case TLV_TIME_ERROR_STATS_NP:
+		if (data_len < sizeof(struct time_error_stats_np))
+			goto bad_length;
+		tes = (struct time_error_stats_np *)m->data;
+		extra_len = sizeof(struct time_error_stats_np);
+		extra_len += tes->count * sizeof(struct time_error_window_np);
+		if (extra_len > data_len)
+			goto bad_length;
+		time_error_stats_n2h(tes);
+		break;
+	case TLV_TRACE_NP:
+		if (data_len < sizeof(struct trace_np))
+			goto bad_length;
+		trn = (struct trace_np *)m->data;
+		trn->size = ntohl(trn->size);
+		trn->dumped = ntohl(trn->dumped);
+		trn->written = net2host64(trn->written);
+		extra_len = sizeof(struct trace_np);
+		break;
+	case TLV_SERVO_GAINS_NP:
+		if (data_len < sizeof(struct servo_gains_np))
+			goto bad_length;
+		sgn = (struct servo_gains_np *)m->data;
+		sgn->kp = net2host64(sgn->kp);
+		sgn->ki = net2host64(sgn->ki);
+		sgn->noise = net2host64(sgn->noise);
+		sgn->wander = net2host64(sgn->wander);
+		extra_len = sizeof(struct servo_gains_np);
+		break;
+	case TLV_ENSEMBLE_NP:
+		if (data_len < sizeof(struct ensemble_np))
+			goto bad_length;
+		en = (struct ensemble_np *)m->data;
+		extra_len = sizeof(struct ensemble_np);
+		extra_len += en->count * sizeof(struct ensemble_master_np);
+		if (extra_len > data_len)
+			goto bad_length;
+		ensemble_n2h(en);
+		break;
 	case TLV_SAVE_IN_NON_VOLATILE_STORAGE:
 	case TLV_RESET_NON_VOLATILE_STORAGE:
 	case TLV_INITIALIZE:
@@ -319,6 +474,11 @@ static void mgt_pre_send(struct management_tlv *m, struct tlv_extra *extra)
 	struct grandmaster_settings_np *gsn;
 	struct subscribe_events_np *sen;
 	struct port_properties_np *ppn;
+	struct servo_history_np *shn;
+	struct time_error_stats_np *tes;
+	struct servo_gains_np *sgn;
+	struct ensemble_np *en;
+	struct trace_np *trn;
 	struct mgmt_clock_description *cd;
 	switch (m->id) {
 	case TLV_CLOCK_DESCRIPTION:
@@ -391,6 +551,34 @@ static void mgt_pre_send(struct management_tlv *m, struct tlv_extra *extra)
 		ppn = (struct port_properties_np *)m->data;
 		ppn->portIdentity.portNumber = htons(ppn->portIdentity.portNumber);
 		break;
+	case TLV_SERVO_HISTORY_NP:
+		shn = (struct servo_history_np *)m->data;
+		servo_history_h2n(shn);
+		shn->count = htons(shn->count);
+		shn->total = htonl(shn->total);
+		shn->start = htonl(shn->start);
+		break;
+	case TLV_TIME_ERROR_STATS_NP:
+		tes = (struct time_error_stats_np *)m->data;
+		time_error_stats_h2n(tes);
+		break;
+	case TLV_TRACE_NP:
+		trn = (struct trace_np *)m->data;
+		trn->size = htonl(trn->size);
+		trn->dumped = htonl(trn->dumped);
+		trn->written = host2net64(trn->written);
+		break;
+	case TLV_SERVO_GAINS_NP:
+		sgn = (struct servo_gains_np *)m->data;
+		sgn->kp = host2net64(sgn->kp);
+		sgn->ki = host2net64(sgn->ki);
+		sgn->noise = host2net64(sgn->noise);
+		sgn->wander = host2net64(sgn->wander);
+		break;
+	case TLV_ENSEMBLE_NP:
+		en = (struct ensemble_np *)m->data;
+		ensemble_h2n(en);
+		break;
 	}
 }
 
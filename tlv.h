@@ -84,6 +84,11 @@ enum management_action {
 #define TLV_TIME_STATUS_NP				0xC000
 #define TLV_GRANDMASTER_SETTINGS_NP			0xC001
 #define TLV_SUBSCRIBE_EVENTS_NP				0xC003
+#define TLV_SERVO_HISTORY_NP				0xC005
+#define TLV_TIME_ERROR_STATS_NP				0xC006
+#define TLV_TRACE_NP					0xC007
+#define TLV_SERVO_GAINS_NP				0xC008
+#define TLV_ENSEMBLE_NP					0xC009
 
 /* Port management ID values */
 #define TLV_NULL_MANAGEMENT				0x0000
@@ -280,6 +285,87 @@ struct port_properties_np {
 	struct PTPText interface;
 } PACKED;
 
+struct servo_history_record_np {
+	int64_t       time;       /*monotonic nanoseconds*/
+	int64_t       offset;     /*nanoseconds*/
+	int64_t       offset_min; /*nanoseconds*/
+	int64_t       offset_max; /*nanoseconds*/
+	int64_t       delay;      /*nanoseconds, -1 if unknown*/
+	Integer32     freq;       /*ppb*/
+	UInteger32    count;
+} PACKED;
+
+struct servo_history_np {
+	UInteger8     resolution;
+	UInteger8     reserved;
+	UInteger16    count;      /*records in this page*/
+	UInteger32    total;      /*records available*/
+	UInteger32    start;      /*age of the first record, 0 is newest*/
+	struct servo_history_record_np record[0];
+} PACKED;
+
+#define SERVO_HISTORY_PAGE_MAX \
+	((sizeof(struct message_data) - sizeof(struct management_msg) - \
+	  sizeof(struct management_tlv) - sizeof(struct servo_history_np)) / \
+	 sizeof(struct servo_history_record_np))
+
+#define TIME_ERROR_MTIE_VALID		(1<<0)
+#define TIME_ERROR_TDEV_VALID		(1<<1)
+#define TIME_ERROR_MTIE_VIOLATION	(1<<2)
+#define TIME_ERROR_TDEV_VIOLATION	(1<<3)
+
+struct time_error_window_np {
+	UInteger32    window;     /*sample intervals*/
+	UInteger8     flags;
+	UInteger8     reserved[3];
+	Integer64     mtie;       /*nanoseconds*/
+	TimeInterval  tdev;
+} PACKED;
+
+struct time_error_stats_np {
+	uint64_t      samples;
+	Integer8      logSampleInterval;
+	UInteger8     count;
+	Integer64     mtieLimit;  /*nanoseconds*/
+	TimeInterval  tdevLimit;
+	struct time_error_window_np window[0];
+} PACKED;
+
+struct trace_np {
+	UInteger32    size;    /* records in the ring */
+	UInteger32    dumped;  /* records written by the last dump */
+	uint64_t      written; /* records produced since start up */
+} PACKED;
+
+struct servo_gains_np {
+	UInteger8     mode;    /* enum servo_gain_mode */
+	UInteger8     reserved[3];
+	Integer64     kp;      /* scaled by 2^32 */
+	Integer64     ki;      /* per second, scaled by 2^32 */
+	TimeInterval  noise;   /* measurement noise */
+	Integer64     wander;  /* ppb/s^0.5, scaled by 2^16 */
+} PACKED;
+
+#define ENSEMBLE_PRIMARY	(1<<0)
+#define ENSEMBLE_LEARNING	(1<<1)
+#define ENSEMBLE_REJECTED	(1<<2)
+
+struct ensemble_master_np {
+	struct PortIdentity master;
+	UInteger8     flags;
+	UInteger8     reserved;
+	UInteger32    weight;  /* share of the combined offset, scaled by 2^16 */
+	Integer64     offset;  /* nanoseconds */
+	Integer64     delay;   /* nanoseconds */
+	TimeInterval  stddev;  /* deviation from the other masters */
+} PACKED;
+
+struct ensemble_np {
+	UInteger8     count;
+	UInteger8     reserved;
+	struct ensemble_master_np master[0];
+} PACKED;
+
 #define PROFILE_ID_LEN 6
 
 struct mgmt_clock_description {
@@ -31,84 +31,137 @@
 
 /**
  * We implement the time value as a 64 bit signed integer containing
- * nanoseconds. Using this representation, we could really spare the
- * arithmetic functions such as @ref tmv_add() and the like, and just
- * use plain old math operators in the code.
+ * nanoseconds and a 16 bit fraction of a nanosecond, the same resolution
+ * as the correction fields. The value is the sum of the two, so the
+ * nanoseconds are rounded down and the fraction is never negative.
  *
- * However, we are going to be a bit pedantic here and enforce the
- * use of the these functions, so that we can easily upgrade the code
- * to a finer representation later on. In that way, we can make use of
- * the fractional nanosecond parts of the correction fields, if and
- * when people start asking for them.
+ * The functions such as @ref tmv_add() and the like must be used for
+ * all arithmetic, so the representation can be changed again in one
+ * place. The fractions of the correction fields are carried through the
+ * filters and the time stamp processing, and a transparent clock adds
+ * the residence time to the correction without rounding it.
  */
+#define TMV_FRAC_BITS 16
+#define TMV_FRAC_MASK ((1 << TMV_FRAC_BITS) - 1)
+
 typedef struct {
 	int64_t ns;
+	uint16_t frac; /* 2^-16 ns */
 } tmv_t;
 
 static inline tmv_t tmv_add(tmv_t a, tmv_t b)
 {
+	uint32_t frac = a.frac + b.frac;
 	tmv_t t;
-	t.ns = a.ns + b.ns;
+	t.ns = a.ns + b.ns + (frac >> TMV_FRAC_BITS);
+	t.frac = frac & TMV_FRAC_MASK;
 	return t;
 }
 
+static inline TimeInterval tmv_to_TimeInterval(tmv_t x);
+
+/*
+ * The divisor must be positive. Time intervals, which is what the
+ * filters average, are divided in a single step.
+ */
 static inline tmv_t tmv_div(tmv_t a, int divisor)
 {
+	int64_t q, r;
 	tmv_t t;
-	t.ns = a.ns / divisor;
+	if (a.ns >= (int64_t)MIN_TMV_TO_TIMEINTERVAL &&
+	    a.ns <= (int64_t)MAX_TMV_TO_TIMEINTERVAL) {
+		r = tmv_to_TimeInterval(a);
+		q = r / divisor;
+		if (q * divisor > r)
+			q--;
+		t.ns = q >> TMV_FRAC_BITS;
+		t.frac = q & TMV_FRAC_MASK;
+		return t;
+	}
+	q = a.ns / divisor;
+	r = a.ns % divisor;
+	if (r < 0) {
+		q--;
+		r += divisor;
+	}
+	t.ns = q;
+	t.frac = ((r << TMV_FRAC_BITS) + a.frac) / divisor;
 	return t;
 }
 
 static inline int tmv_cmp(tmv_t a, tmv_t b)
 {
-	return a.ns == b.ns ? 0 : a.ns > b.ns ? +1 : -1;
+	if (a.ns != b.ns)
+		return a.ns > b.ns ? +1 : -1;
+	return a.frac == b.frac ? 0 : a.frac > b.frac ? +1 : -1;
 }
 
 static inline int tmv_sign(tmv_t x)
 {
-	return x.ns == 0 ? 0 : x.ns > 0 ? +1 : -1;
+	return x.ns < 0 ? -1 : x.ns > 0 || x.frac ? +1 : 0;
 }
 
 static inline int tmv_is_zero(tmv_t x)
 {
-	return x.ns == 0 ? 1 : 0;
+	return x.ns == 0 && x.frac == 0 ? 1 : 0;
 }
 
 static inline tmv_t tmv_sub(tmv_t a, tmv_t b)
 {
+	int32_t frac = a.frac - b.frac;
 	tmv_t t;
-	t.ns = a.ns - b.ns;
+	t.ns = a.ns - b.ns - (frac < 0);
+	t.frac = frac & TMV_FRAC_MASK;
 	return t;
 }
 
 static inline tmv_t tmv_zero(void)
 {
-	tmv_t t = { 0 };
+	tmv_t t = { 0, 0 };
 	return t;
 }
 
 static inline tmv_t correction_to_tmv(Integer64 c)
 {
 	tmv_t t;
-	t.ns = (c >> 16);
+	t.ns = (c >> TMV_FRAC_BITS);
+	t.frac = c & TMV_FRAC_MASK;
 	return t;
 }
 
 static inline double tmv_dbl(tmv_t x)
 {
-	return (double) x.ns;
+	return (double) x.ns + x.frac / (double) (1 << TMV_FRAC_BITS);
 }
 
 static inline tmv_t dbl_tmv(double x)
 {
+	uint32_t frac;
 	tmv_t t;
 	t.ns = x;
+	if (t.ns > x)
+		t.ns--;
+	frac = (x - t.ns) * (1 << TMV_FRAC_BITS);
+	if (frac > TMV_FRAC_MASK) {
+		t.ns++;
+		frac = 0;
+	}
+	t.frac = frac;
 	return t;
 }
 
+/* Rounds to the nearest nanosecond. */
 static inline int64_t tmv_to_nanoseconds(tmv_t x)
 {
-	return x.ns;
+	return x.ns + (x.frac >> (TMV_FRAC_BITS - 1));
+}
+
+static inline tmv_t nanoseconds_to_tmv(int64_t ns)
+{
+	tmv_t t;
+	t.ns = ns;
+	t.frac = 0;
+	return t;
 }
 
 static inline TimeInterval tmv_to_TimeInterval(tmv_t x)
@@ -118,9 +171,10 @@ static inline TimeInterval tmv_to_TimeInterval(tmv_t x)
 	} else if (x.ns > (int64_t)MAX_TMV_TO_TIMEINTERVAL) {
 		return MAX_TMV_TO_TIMEINTERVAL << 16;
 	}
-	return x.ns << 16;
+	return (x.ns << 16) | x.frac;
 }
 
+/* The fraction of a nanosecond is dropped. */
 static inline struct Timestamp tmv_to_Timestamp(tmv_t x)
 {
 	struct Timestamp result;
@@ -140,6 +194,7 @@ static inline tmv_t timespec_to_tmv(struct timespec ts)
 {
 	tmv_t t;
 	t.ns = ts.tv_sec * NS_PER_SEC + ts.tv_nsec;
+	t.frac = 0;
 	return t;
 }
 
@@ -147,6 +202,7 @@ static inline tmv_t timestamp_to_tmv(struct timestamp ts)
 {
 	tmv_t t;
 	t.ns = ts.sec * NS_PER_SEC + ts.nsec;
+	t.frac = 0;
 	return t;
 }
 
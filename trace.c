@@ -0,0 +1,143 @@
+/**
+ * @file trace.c
+ * @note Copyright (C) 2026 The linuxptp contributors
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "trace.h"
+
+int trace_active;
+
+static struct trace_record *ring;
+static unsigned int ring_mask;
+static uint64_t ring_head;
+
+static const char *stage_str[TRACE_STAGE_CNT] = {
+	"POLL_WAKEUP",
+	"RECV_START",
+	"RECV_DONE",
+	"POST_RECV",
+	"SYNC_START",
+	"SERVO_START",
+	"SERVO_DONE",
+	"ADJ_START",
+	"ADJ_DONE",
+	"EVENT_DONE",
+};
+
+int trace_init(unsigned int size)
+{
+	unsigned int len = 1;
+
+	trace_cleanup();
+
+	while (len < size)
+		len <<= 1;
+	ring = calloc(len, sizeof(*ring));
+	if (!ring)
+		return -1;
+	ring_mask = len - 1;
+	ring_head = 0;
+	trace_active = 1;
+	return 0;
+}
+
+void trace_cleanup(void)
+{
+	trace_active = 0;
+	free(ring);
+	ring = NULL;
+	ring_mask = 0;
+	ring_head = 0;
+}
+
+void trace_write(int stage, int port, int msg_type, int seq, int64_t arg)
+{
+	struct trace_record *rec;
+	struct timespec ts;
+	uint64_t slot;
+
+	clock_gettime(CLOCK_MONOTONIC_RAW, &ts);
+
+	/* Claim a slot without a lock, writers never wait for each other. */
+	slot = __atomic_fetch_add(&ring_head, 1, __ATOMIC_RELAXED);
+	rec = &ring[slot & ring_mask];
+	rec->ts = ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+	rec->stage = stage;
+	rec->port = port;
+	rec->seq = seq;
+	rec->msg_type = msg_type;
+	rec->reserved = 0;
+	rec->arg = arg;
+}
+
+int trace_dump(const char *path)
+{
+	struct trace_file_header hdr;
+	uint64_t head, first, i;
+	FILE *fp;
+
+	if (!ring)
+		return -1;
+
+	fp = fopen(path, "w");
+	if (!fp)
+		return -1;
+
+	head = __atomic_load_n(&ring_head, __ATOMIC_ACQUIRE);
+	first = head > ring_mask + 1 ? head - ring_mask - 1 : 0;
+
+	memset(&hdr, 0, sizeof(hdr));
+	memcpy(hdr.magic, TRACE_MAGIC, sizeof(hdr.magic));
+	hdr.version = TRACE_VERSION;
+	hdr.record_size = sizeof(struct trace_record);
+	hdr.records = head - first;
+	hdr.overwritten = first;
+
+	if (fwrite(&hdr, sizeof(hdr), 1, fp) != 1)
+		goto failed;
+	for (i = first; i < head; i++) {
+		if (fwrite(&ring[i & ring_mask], sizeof(*ring), 1, fp) != 1)
+			goto failed;
+	}
+	if (fclose(fp))
+		return -1;
+	return head - first;
+failed:
+	fclose(fp);
+	return -1;
+}
+
+unsigned int trace_size(void)
+{
+	return ring ? ring_mask + 1 : 0;
+}
+
+uint64_t trace_written(void)
+{
+	return __atomic_load_n(&ring_head, __ATOMIC_RELAXED);
+}
+
+const char *trace_stage_str(int stage)
+{
+	if (stage < 0 || stage >= TRACE_STAGE_CNT)
+		return "UNKNOWN";
+	return stage_str[stage];
+}
@@ -0,0 +1,137 @@
+/**
+ * @file trace.h
+ * @brief Implements a binary ring of time stamped trace points.
+ * @note Copyright (C) 2026 The linuxptp contributors
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+#ifndef HAVE_TRACE_H
+#define HAVE_TRACE_H
+
+#include <stdint.h>
+
+#define TRACE_MAGIC "PTPTRACE"
+#define TRACE_VERSION 1
+
+/**
+ * Defines the places in the code where trace points are located.
+ */
+enum trace_stage {
+	TRACE_POLL_WAKEUP,	/* poll() returned, arg is the event count */
+	TRACE_RECV_START,	/* before transport_recv() */
+	TRACE_RECV_DONE,	/* after transport_recv(), arg is the length */
+	TRACE_POST_RECV,	/* after msg_post_recv() */
+	TRACE_SYNC_START,	/* clock_synchronize() entered */
+	TRACE_SERVO_START,	/* before servo_sample() */
+	TRACE_SERVO_DONE,	/* after servo_sample(), arg is the offset */
+	TRACE_ADJ_START,	/* before clockadj_set_freq() */
+	TRACE_ADJ_DONE,		/* after clockadj_set_freq(), arg is the ppb */
+	TRACE_EVENT_DONE,	/* port_event() returned, arg is the event */
+	TRACE_STAGE_CNT,
+};
+
+/**
+ * One trace record. The records are written to the dump file in the
+ * host byte order.
+ */
+struct trace_record {
+	uint64_t ts;		/* CLOCK_MONOTONIC_RAW nanoseconds */
+	uint16_t stage;
+	uint16_t port;
+	uint16_t seq;		/* sequenceId of the message, if any */
+	uint8_t  msg_type;	/* 0xff if not related to a message */
+	uint8_t  reserved;
+	int64_t  arg;
+};
+
+/**
+ * Header of a trace dump file, followed by the records oldest first.
+ */
+struct trace_file_header {
+	char     magic[8];
+	uint32_t version;
+	uint32_t record_size;
+	uint64_t records;	/* number of records in the file */
+	uint64_t overwritten;	/* records lost due to the ring wrapping */
+};
+
+#define TRACE_NO_MSG 0xff
+
+extern int trace_active;
+
+#ifdef NO_TRACE
+#define trace_point(stage, port, msg_type, seq, arg) do {} while (0)
+#else
+/**
+ * Record a trace point. Compiled out when building with NO_TRACE and
+ * a single test of a global flag when tracing is not enabled.
+ */
+#define trace_point(stage, port, msg_type, seq, arg)			\
+	do {								\
+		if (trace_active)					\
+			trace_write(stage, port, msg_type, seq, arg);	\
+	} while (0)
+#endif
+
+/**
+ * Allocate the trace ring and enable the trace points.
+ * @param size  The number of records, rounded up to a power of two.
+ * @return      Zero on success, non-zero otherwise.
+ */
+int trace_init(unsigned int size);
+
+/**
+ * Disable the trace points and free the ring.
+ */
+void trace_cleanup(void);
+
+/**
+ * Write a trace record. Use the @ref trace_point() macro instead of
+ * calling this directly.
+ * @param stage     One of the @ref trace_stage values.
+ * @param port      The port number, or zero.
+ * @param msg_type  The PTP message type, or TRACE_NO_MSG.
+ * @param seq       The sequenceId of the message.
+ * @param arg       Stage specific value.
+ */
+void trace_write(int stage, int port, int msg_type, int seq, int64_t arg);
+
+/**
+ * Write the content of the ring to a file.
+ * @param path  The file name.
+ * @return      The number of records written, or -1 on error.
+ */
+int trace_dump(const char *path);
+
+/**
+ * Obtain the size of the ring.
+ * @return  The number of records in the ring, zero if not enabled.
+ */
+unsigned int trace_size(void);
+
+/**
+ * Obtain the number of records written since the ring was created.
+ * @return  The number of records.
+ */
+uint64_t trace_written(void);
+
+/**
+ * Obtain the name of a trace stage.
+ * @param stage  One of the @ref trace_stage values.
+ * @return       A static string.
+ */
+const char *trace_stage_str(int stage);
+
+#endif
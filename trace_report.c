@@ -0,0 +1,250 @@
+/**
+ * @file trace_report.c
+ * @brief Analyzes the trace files written by ptp4l.
+ * @note Copyright (C) 2026 The linuxptp contributors
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "trace.h"
+#include "version.h"
+
+#define MSG_TYPES 16
+
+struct series {
+	uint64_t *val;
+	unsigned int len;
+	unsigned int max;
+};
+
+static const char *msg_str[MSG_TYPES] = {
+	"SYNC", "DELAY_REQ", "PDELAY_REQ", "PDELAY_RESP",
+	NULL, NULL, NULL, NULL,
+	"FOLLOW_UP", "DELAY_RESP", "PDELAY_RESP_FOLLOW_UP", "ANNOUNCE",
+	"SIGNALING", "MANAGEMENT", NULL, NULL,
+};
+
+static struct series transition[TRACE_STAGE_CNT][TRACE_STAGE_CNT];
+static struct series message[MSG_TYPES];
+
+static const char *msg_type_str(int type)
+{
+	if (type >= MSG_TYPES || !msg_str[type])
+		return "UNKNOWN";
+	return msg_str[type];
+}
+
+static int series_add(struct series *s, uint64_t val)
+{
+	uint64_t *v;
+
+	if (s->len == s->max) {
+		s->max = s->max ? 2 * s->max : 64;
+		v = realloc(s->val, s->max * sizeof(*v));
+		if (!v)
+			return -1;
+		s->val = v;
+	}
+	s->val[s->len++] = val;
+	return 0;
+}
+
+static int cmp_u64(const void *a, const void *b)
+{
+	uint64_t x = *(const uint64_t *) a, y = *(const uint64_t *) b;
+
+	return x < y ? -1 : x > y;
+}
+
+static void series_print(const char *label, struct series *s)
+{
+	long double sum = 0;
+	unsigned int i;
+
+	if (!s->len)
+		return;
+	qsort(s->val, s->len, sizeof(*s->val), cmp_u64);
+	for (i = 0; i < s->len; i++)
+		sum += s->val[i];
+
+	printf("%-36s %8u %9" PRIu64 " %9.0Lf %9" PRIu64 " %9" PRIu64
+	       " %9" PRIu64 "\n", label, s->len, s->val[0], sum / s->len,
+	       s->val[s->len / 2], s->val[(uint64_t) s->len * 99 / 100],
+	       s->val[s->len - 1]);
+}
+
+static void print_header(const char *title)
+{
+	printf("%-36s %8s %9s %9s %9s %9s %9s\n", title, "count",
+	       "min", "mean", "p50", "p99", "max");
+}
+
+static void print_timeline(struct trace_record *rec, unsigned int first,
+			   unsigned int last, int type, int seq)
+{
+	unsigned int i;
+
+	printf("%" PRIu64 ".%09" PRIu64 " port %hu %s seq %d\n",
+	       rec[first].ts / 1000000000, rec[first].ts % 1000000000,
+	       rec[first].port, msg_type_str(type), seq);
+	for (i = first; i <= last; i++) {
+		printf("  %+9" PRId64 " ns  %-12s %" PRId64 "\n",
+		       (int64_t) (rec[i].ts - rec[first].ts),
+		       trace_stage_str(rec[i].stage), rec[i].arg);
+	}
+}
+
+/*
+ * A message is handled between the RECV_START and EVENT_DONE records of
+ * the same port. The type of the message is known from the POST_RECV
+ * record in between, records of events without a message (timers, the
+ * reception of TX time stamps) are not counted.
+ */
+static void analyze(struct trace_record *rec, unsigned int n, int timeline)
+{
+	int type = -1, seq = 0;
+	unsigned int i, start = 0;
+	char label[64];
+
+	for (i = 1; i < n; i++) {
+		if (rec[i].stage >= TRACE_STAGE_CNT ||
+		    rec[i - 1].stage >= TRACE_STAGE_CNT)
+			continue;
+		/* The time spent waiting in poll() is not interesting. */
+		if (rec[i].stage != TRACE_POLL_WAKEUP) {
+			series_add(&transition[rec[i - 1].stage][rec[i].stage],
+				   rec[i].ts - rec[i - 1].ts);
+		}
+	}
+
+	for (i = 0; i < n; i++) {
+		switch (rec[i].stage) {
+		case TRACE_RECV_START:
+			start = i;
+			type = -1;
+			break;
+		case TRACE_POST_RECV:
+			if (rec[i].port == rec[start].port &&
+			    rec[i].msg_type < MSG_TYPES) {
+				type = rec[i].msg_type;
+				seq = rec[i].seq;
+			}
+			break;
+		case TRACE_EVENT_DONE:
+			if (type < 0 || rec[i].port != rec[start].port)
+				break;
+			series_add(&message[type], rec[i].ts - rec[start].ts);
+			if (timeline)
+				print_timeline(rec, start, i, type, seq);
+			type = -1;
+			break;
+		}
+	}
+
+	if (timeline)
+		printf("\n");
+
+	print_header("transition [ns]");
+	for (i = 0; i < TRACE_STAGE_CNT * TRACE_STAGE_CNT; i++) {
+		snprintf(label, sizeof(label), "%s -> %s",
+			 trace_stage_str(i / TRACE_STAGE_CNT),
+			 trace_stage_str(i % TRACE_STAGE_CNT));
+		series_print(label, &transition[i / TRACE_STAGE_CNT]
+			     [i % TRACE_STAGE_CNT]);
+	}
+	printf("\n");
+	print_header("message, receive to done [ns]");
+	for (i = 0; i < MSG_TYPES; i++)
+		series_print(msg_type_str(i), &message[i]);
+}
+
+static void usage(char *progname)
+{
+	fprintf(stderr,
+		"\n"
+		"usage: %s [options] file\n\n"
+		" -t        print the timeline of every message\n"
+		" -h        prints this message and exits\n"
+		" -v        prints the software version and exits\n"
+		"\n",
+		progname);
+}
+
+int main(int argc, char *argv[])
+{
+	struct trace_file_header hdr;
+	struct trace_record *rec;
+	int c, timeline = 0;
+	char *progname;
+	FILE *fp;
+
+	progname = strrchr(argv[0], '/');
+	progname = progname ? 1 + progname : argv[0];
+	while (EOF != (c = getopt(argc, argv, "thv"))) {
+		switch (c) {
+		case 't':
+			timeline = 1;
+			break;
+		case 'v':
+			version_show(stdout);
+			return 0;
+		case 'h':
+			usage(progname);
+			return 0;
+		case '?':
+		default:
+			usage(progname);
+			return -1;
+		}
+	}
+	if (optind != argc - 1) {
+		usage(progname);
+		return -1;
+	}
+
+	fp = fopen(argv[optind], "r");
+	if (!fp) {
+		perror(argv[optind]);
+		return -1;
+	}
+	if (fread(&hdr, sizeof(hdr), 1, fp) != 1 ||
+	    memcmp(hdr.magic, TRACE_MAGIC, sizeof(hdr.magic)) ||
+	    hdr.version != TRACE_VERSION ||
+	    hdr.record_size != sizeof(*rec)) {
+		fprintf(stderr, "%s: not a trace file\n", argv[optind]);
+		fclose(fp);
+		return -1;
+	}
+	rec = calloc(hdr.records ? hdr.records : 1, sizeof(*rec));
+	if (!rec) {
+		fprintf(stderr, "out of memory\n");
+		fclose(fp);
+		return -1;
+	}
+	hdr.records = fread(rec, sizeof(*rec), hdr.records, fp);
+	fclose(fp);
+
+	printf("%" PRIu64 " records, %" PRIu64 " overwritten\n\n",
+	       hdr.records, hdr.overwritten);
+	analyze(rec, hdr.records, timeline);
+
+	free(rec);
+	return 0;
+}
@@ -26,6 +26,19 @@
 #include "udp6.h"
 #include "uds.h"
 
+static transport_tap_fn transport_tap;
+static struct transport *(*sim_create)(void);
+
+void transport_set_tap(transport_tap_fn tap)
+{
+	transport_tap = tap;
+}
+
+void transport_set_sim(struct transport *(*create)(void))
+{
+	sim_create = create;
+}
+
 int transport_close(struct transport *t, struct fdarray *fda)
 {
 	return t->close(t, fda);
@@ -37,33 +50,68 @@ int transport_open(struct transport *t, struct interface *iface,
 	return t->open(t, iface, fda, tt);
 }
 
+static void transport_tap_tx(struct fdarray *fda,
+			     enum transport_event event,
+			     struct ptp_message *msg, int len)
+{
+	switch (event) {
+	case TRANS_GENERAL:
+		transport_tap(fda->fd[FD_GENERAL], 1, msg, len, NULL);
+		break;
+	case TRANS_EVENT:
+		transport_tap(fda->fd[FD_EVENT], 1, msg, len, &msg->hwts);
+		break;
+	case TRANS_ONESTEP:
+	case TRANS_P2P1STEP:
+		transport_tap(fda->fd[FD_EVENT], 1, msg, len, NULL);
+		break;
+	case TRANS_DEFER_EVENT:
+		/* Captured with the time stamp in transport_txts(). */
+		break;
+	}
+}
+
 int transport_recv(struct transport *t, int fd, struct ptp_message *msg)
 {
-	return t->recv(t, fd, msg, sizeof(msg->data), &msg->address, &msg->hwts);
+	int cnt;
+
+	cnt = t->recv(t, fd, msg, sizeof(msg->data), &msg->address, &msg->hwts);
+	if (transport_tap && cnt > 0)
+		transport_tap(fd, 0, msg, cnt, &msg->hwts);
+	return cnt;
 }
 
 int transport_send(struct transport *t, struct fdarray *fda,
 		   enum transport_event event, struct ptp_message *msg)
 {
-	int len = ntohs(msg->header.messageLength);
+	int cnt, len = ntohs(msg->header.messageLength);
 
-	return t->send(t, fda, event, 0, msg, len, NULL, &msg->hwts);
+	cnt = t->send(t, fda, event, 0, msg, len, NULL, &msg->hwts);
+	if (transport_tap && cnt > 0)
+		transport_tap_tx(fda, event, msg, len);
+	return cnt;
 }
 
 int transport_peer(struct transport *t, struct fdarray *fda,
 		   enum transport_event event, struct ptp_message *msg)
 {
-	int len = ntohs(msg->header.messageLength);
+	int cnt, len = ntohs(msg->header.messageLength);
 
-	return t->send(t, fda, event, 1, msg, len, NULL, &msg->hwts);
+	cnt = t->send(t, fda, event, 1, msg, len, NULL, &msg->hwts);
+	if (transport_tap && cnt > 0)
+		transport_tap_tx(fda, event, msg, len);
+	return cnt;
 }
 
 int transport_sendto(struct transport *t, struct fdarray *fda,
 		     enum transport_event event, struct ptp_message *msg)
 {
-	int len = ntohs(msg->header.messageLength);
+	int cnt, len = ntohs(msg->header.messageLength);
 
-	return t->send(t, fda, event, 0, msg, len, &msg->address, &msg->hwts);
+	cnt = t->send(t, fda, event, 0, msg, len, &msg->address, &msg->hwts);
+	if (transport_tap && cnt > 0)
+		transport_tap_tx(fda, event, msg, len);
+	return cnt;
 }
 
 int transport_txts(struct fdarray *fda,
@@ -74,6 +122,8 @@ int transport_txts(struct fdarray *fda,
 	unsigned char pkt[1600];
 
 	cnt = sk_receive(fda->fd[FD_EVENT], pkt, len, NULL, hwts, MSG_ERRQUEUE);
+	if (transport_tap && cnt > 0)
+		transport_tap(fda->fd[FD_EVENT], 1, msg, len, hwts);
 	return cnt > 0 ? 0 : cnt;
 }
 
@@ -115,6 +165,10 @@ struct transport *transport_create(struct config *cfg,
 	case TRANS_IEEE_802_3:
 		t = raw_transport_create();
 		break;
+	case TRANS_SIM:
+		if (sim_create)
+			t = sim_create();
+		break;
 	case TRANS_DEVICENET:
 	case TRANS_CONTROLNET:
 	case TRANS_PROFINET:
@@ -39,6 +39,8 @@ enum transport_type {
 	TRANS_DEVICENET,
 	TRANS_CONTROLNET,
 	TRANS_PROFINET,
+	/* Not in the spec, the simulated network of ptp_sim. */
+	TRANS_SIM = 0xF000,
 };
 
 /**
@@ -55,6 +57,31 @@ enum transport_event {
 
 struct transport;
 
+/**
+ * Function called with every message received or sent by a transport.
+ * @param fd    The descriptor on which the message was received or sent.
+ * @param tx    Non-zero if the message was sent.
+ * @param msg   The message in the network byte order.
+ * @param len   The length of the message.
+ * @param hwts  The time stamps of the message, or NULL if none.
+ */
+typedef void (*transport_tap_fn)(int fd, int tx, struct ptp_message *msg,
+				 int len, struct hw_timestamp *hwts);
+
+/**
+ * Install a function which sees all messages of all transports, e.g. to
+ * capture them to a file.
+ * @param tap  The function, or NULL to remove it.
+ */
+void transport_set_tap(transport_tap_fn tap);
+
+/**
+ * Install the constructor of the TRANS_SIM transport. Without it, no
+ * transport of that type can be created.
+ * @param create  The constructor, or NULL to remove it.
+ */
+void transport_set_sim(struct transport *(*create)(void));
+
 int transport_close(struct transport *t, struct fdarray *fda);
 
 int transport_open(struct transport *t, struct interface *iface,
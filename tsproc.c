@@ -45,6 +45,9 @@ struct tsproc {
 
 	/* Delay filter */
 	struct filter *delay_filter;
+
+	/* Optional offset filter */
+	struct filter *offset_filter;
 };
 
 static int weighting(struct tsproc *tsp)
@@ -61,7 +64,8 @@ static int weighting(struct tsproc *tsp)
 }
 
 struct tsproc *tsproc_create(enum tsproc_mode mode,
-			     enum filter_type delay_filter, int filter_length)
+			     enum filter_type delay_filter, int filter_length,
+			     int filter_percentile)
 {
 	struct tsproc *tsp;
 
@@ -81,7 +85,8 @@ struct tsproc *tsproc_create(enum tsproc_mode mode,
 		return NULL;
 	}
 
-	tsp->delay_filter = filter_create(delay_filter, filter_length);
+	tsp->delay_filter = filter_create(delay_filter, filter_length,
+					  filter_percentile);
 	if (!tsp->delay_filter) {
 		free(tsp);
 		return NULL;
@@ -95,9 +100,25 @@ struct tsproc *tsproc_create(enum tsproc_mode mode,
 void tsproc_destroy(struct tsproc *tsp)
 {
 	filter_destroy(tsp->delay_filter);
+	if (tsp->offset_filter)
+		filter_destroy(tsp->offset_filter);
 	free(tsp);
 }
 
+int tsproc_set_offset_filter(struct tsproc *tsp, enum filter_type type,
+			     int length, int percentile)
+{
+	struct filter *filter;
+
+	filter = filter_create(type, length, percentile);
+	if (!filter)
+		return -1;
+	if (tsp->offset_filter)
+		filter_destroy(tsp->offset_filter);
+	tsp->offset_filter = filter;
+	return 0;
+}
+
 void tsproc_down_ts(struct tsproc *tsp, tmv_t remote_ts, tmv_t local_ts)
 {
 	tsp->t1 = remote_ts;
@@ -180,7 +201,7 @@ int tsproc_update_delay(struct tsproc *tsp, tmv_t *delay)
 
 int tsproc_update_offset(struct tsproc *tsp, tmv_t *offset, double *weight)
 {
-	tmv_t delay = tmv_zero(), raw_delay = tmv_zero();
+	tmv_t delay = tmv_zero(), raw_delay = tmv_zero(), raw_offset;
 
 	if (tmv_is_zero(tsp->t1) || tmv_is_zero(tsp->t2))
 		return -1;
@@ -210,7 +231,21 @@ int tsproc_update_offset(struct tsproc *tsp, tmv_t *offset, double *weight)
 	}
 
 	/* offset = t2 - t1 - delay */
-	*offset = tmv_sub(tmv_sub(tsp->t2, tsp->t1), delay);
+	raw_offset = tmv_sub(tmv_sub(tsp->t2, tsp->t1), delay);
+
+	if (tsp->offset_filter && !tmv_is_zero(tsp->t3)) {
+		if (tmv_is_zero(raw_delay))
+			raw_delay = get_raw_delay(tsp);
+		/*
+		 * Only the offset of a selected exchange is passed on. The
+		 * older offsets were already passed to the servo, which has
+		 * corrected the clock since they were measured.
+		 */
+		filter_sample_keyed(tsp->offset_filter, raw_delay, raw_offset);
+		if (!filter_selected(tsp->offset_filter))
+			return 1;
+	}
+	*offset = raw_offset;
 
 	if (!weight)
 		return 0;
@@ -234,6 +269,10 @@ void tsproc_reset(struct tsproc *tsp, int full)
 	tsp->t3 = tmv_zero();
 	tsp->t4 = tmv_zero();
 
+	/* The offsets from before a reset are not valid anymore. */
+	if (tsp->offset_filter)
+		filter_reset(tsp->offset_filter);
+
 	if (full) {
 		tsp->clock_rate_ratio = 1.0;
 		filter_reset(tsp->delay_filter);
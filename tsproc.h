@@ -37,13 +37,16 @@ enum tsproc_mode {
 
 /**
  * Create a new instance of the time stamp processor.
- * @param mode           Time stamp processing mode.
- * @param delay_filter   Type of the filter that will be applied to delay.
- * @param filter_length  Length of the filter.
- * @return               A pointer to a new tsproc on success, NULL otherwise.
+ * @param mode               Time stamp processing mode.
+ * @param delay_filter       Type of the filter that will be applied to delay.
+ * @param filter_length      Length of the filter.
+ * @param filter_percentile  Percentile of the percentile mean filter.
+ * @return                   A pointer to a new tsproc on success, NULL
+ *                           otherwise.
  */
 struct tsproc *tsproc_create(enum tsproc_mode mode,
-			     enum filter_type delay_filter, int filter_length);
+			     enum filter_type delay_filter, int filter_length,
+			     int filter_percentile);
 
 /**
  * Destroy a time stamp processor.
@@ -51,6 +54,21 @@ struct tsproc *tsproc_create(enum tsproc_mode mode,
  */
 void tsproc_destroy(struct tsproc *tsp);
 
+/**
+ * Set a filter for the offset. The offset samples are keyed by the delay
+ * measured with the latest time stamps, so the moving minimum filter selects
+ * the offset of the exchange with the shortest delay (lucky packet) and the
+ * percentile mean filter averages the offsets of the exchanges with the
+ * shortest delays.
+ * @param tsp         Pointer obtained via @ref tsproc_create().
+ * @param type        Type of the filter that will be applied to offset.
+ * @param length      Length of the filter.
+ * @param percentile  Percentile of the percentile mean filter.
+ * @return            Zero on success, non-zero otherwise.
+ */
+int tsproc_set_offset_filter(struct tsproc *tsp, enum filter_type type,
+			     int length, int percentile);
+
 /**
  * Feed a downstream measurement into a time stamp processor.
  * @param tsp       Pointer obtained via @ref tsproc_create().
@@ -95,7 +113,9 @@ int tsproc_update_delay(struct tsproc *tsp, tmv_t *delay);
  * @param tsp    Pointer obtained via @ref tsproc_create().
  * @param offset A pointer to store the new offset.
  * @param weight A pointer to store the weight of the sample, may be NULL.
- * @return       0 on success, -1 when missing a measurement.
+ * @return       0 on success, -1 when missing a measurement, 1 when the
+ *               offset filter did not select the new measurement and there
+ *               is no new offset.
  */
 int tsproc_update_offset(struct tsproc *tsp, tmv_t *offset, double *weight);
 
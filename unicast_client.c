@@ -107,6 +107,18 @@ static struct unicast_master_address *unicast_client_ok(struct port *p,
 	return ucma;
 }
 
+/*
+ * In the ensemble mode, a slave port requests the Sync and Delay_Resp
+ * messages from all masters, not only from the selected one.
+ */
+static int unicast_client_ensemble(struct port *p)
+{
+	if (!clock_ensemble(p->clock)) {
+		return 0;
+	}
+	return p->state == PS_SLAVE || p->state == PS_UNCALIBRATED;
+}
+
 static int unicast_client_peer_renew(struct port *p)
 {
 	struct unicast_master_address *peer;
@@ -460,7 +472,8 @@ void unicast_client_state_changed(struct port *p)
 	pid = clock_parent_identity(p->clock);
 
 	STAILQ_FOREACH(ucma, &p->unicast_master_table->addrs, list) {
-		if (pid_eq(&ucma->portIdentity, &pid)) {
+		if (pid_eq(&ucma->portIdentity, &pid) ||
+		    unicast_client_ensemble(p)) {
 			ucma->state = unicast_fsm(ucma->state, UC_EV_SELECTED);
 		} else {
 			ucma->state = unicast_fsm(ucma->state, UC_EV_UNSELECTED);
@@ -482,6 +495,12 @@ int unicast_client_timer(struct port *p)
 			err = unicast_client_announce(p, master);
 			break;
 		case UC_HAVE_ANN:
+			if (unicast_client_ensemble(p)) {
+				master->state = unicast_fsm(master->state,
+							    UC_EV_SELECTED);
+				err = unicast_client_sydy(p, master);
+				break;
+			}
 			err = unicast_client_renew(p, master);
 			break;
 		case UC_NEED_SYDY:
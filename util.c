@@ -94,6 +94,7 @@ int addreq(enum transport_type type, struct address *a, struct address *b)
 	case TRANS_DEVICENET:
 	case TRANS_CONTROLNET:
 	case TRANS_PROFINET:
+	case TRANS_SIM:
 	default:
 		pr_err("sorry, cannot compare addresses for this transport");
 		return 0;
@@ -184,6 +185,7 @@ int str2addr(enum transport_type type, const char *s, struct address *addr)
 	case TRANS_DEVICENET:
 	case TRANS_CONTROLNET:
 	case TRANS_PROFINET:
+	case TRANS_SIM:
 		pr_err("sorry, cannot convert addresses for this transport");
 		return -1;
 	case TRANS_UDP_IPV4:
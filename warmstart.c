@@ -0,0 +1,183 @@
+/**
+ * @file warmstart.c
+ * @brief Persists the frequency of a servo across restarts.
+ * @note Copyright (C) 2026 The linuxptp contributors
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+#include <inttypes.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "print.h"
+#include "util.h"
+#include "warmstart.h"
+
+/* Number of the newest offsets saved with the frequency */
+#define WARMSTART_OFFSETS 16
+
+/*
+ * The checkpoint holds the mean frequency adjustment over an interval in
+ * which the servo was continuously locked, which averages out the
+ * corrections of the offset, and the last offsets of the interval, which
+ * show how well the clock was synchronized.
+ */
+struct warmstart {
+	char *path;
+	int interval;
+	int max_age;
+	/* Samples of the current interval */
+	struct timespec start;
+	double freq_sum;
+	unsigned int count;
+	int64_t offset[WARMSTART_OFFSETS];
+};
+
+struct warmstart *warmstart_create(struct config *cfg, const char *key)
+{
+	struct warmstart *ws;
+	const char *dir;
+
+	dir = config_get_string(cfg, NULL, "warm_start_dir");
+	if (!dir || !dir[0])
+		return NULL;
+
+	ws = calloc(1, sizeof(*ws));
+	if (!ws)
+		return NULL;
+	ws->path = string_newf("%s/%s", dir, key);
+	ws->interval = config_get_int(cfg, NULL, "warm_start_interval");
+	ws->max_age = config_get_int(cfg, NULL, "warm_start_max_age");
+	return ws;
+}
+
+static void warmstart_write(struct warmstart *ws)
+{
+	unsigned int i, n;
+	struct timespec now;
+	char *tmp;
+	FILE *fp;
+
+	clock_gettime(CLOCK_REALTIME, &now);
+	tmp = string_newf("%s.tmp", ws->path);
+
+	fp = fopen(tmp, "w");
+	if (!fp) {
+		pr_err("failed to open %s: %m", tmp);
+		free(tmp);
+		return;
+	}
+	fprintf(fp, "time %lld\nfreq %.3f\noffsets",
+		(long long) now.tv_sec, ws->freq_sum / ws->count);
+	n = ws->count < WARMSTART_OFFSETS ? ws->count : WARMSTART_OFFSETS;
+	for (i = ws->count - n; i < ws->count; i++)
+		fprintf(fp, " %" PRId64, ws->offset[i % WARMSTART_OFFSETS]);
+	fprintf(fp, "\n");
+
+	if (fclose(fp) || rename(tmp, ws->path))
+		pr_err("failed to write %s: %m", ws->path);
+	free(tmp);
+}
+
+void warmstart_destroy(struct warmstart *ws)
+{
+	if (ws->count >= WARMSTART_OFFSETS)
+		warmstart_write(ws);
+	free(ws->path);
+	free(ws);
+}
+
+int warmstart_load(struct warmstart *ws, double max_freq, double *freq)
+{
+	double f = NAN, sum = 0.0, offset;
+	long long saved = -1;
+	int len, n = 0, pos;
+	struct timespec now;
+	char line[512];
+	FILE *fp;
+
+	fp = fopen(ws->path, "r");
+	if (!fp)
+		return -1;
+	while (fgets(line, sizeof(line), fp)) {
+		if (sscanf(line, "time %lld", &saved) == 1 ||
+		    sscanf(line, "freq %lf", &f) == 1)
+			continue;
+		if (strncmp(line, "offsets", 7))
+			continue;
+		for (pos = 7; sscanf(line + pos, "%lf%n", &offset, &len) == 1;
+		     pos += len) {
+			sum += offset * offset;
+			n++;
+		}
+	}
+	fclose(fp);
+
+	clock_gettime(CLOCK_REALTIME, &now);
+	if (saved < 0 || isnan(f)) {
+		pr_warning("ignoring invalid warm start state in %s", ws->path);
+		return -1;
+	}
+	if (now.tv_sec < saved || now.tv_sec - saved > ws->max_age) {
+		pr_info("ignoring stale warm start state in %s", ws->path);
+		return -1;
+	}
+	if (fabs(f) > max_freq) {
+		pr_warning("ignoring warm start frequency %.3f ppb out of range",
+			   f);
+		return -1;
+	}
+
+	pr_info("warm start with frequency %.3f ppb saved %lld s ago, "
+		"rms offset %.0f ns", f, (long long) now.tv_sec - saved,
+		n ? sqrt(sum / n) : 0.0);
+	*freq = f;
+	return 0;
+}
+
+void warmstart_sample(struct warmstart *ws, enum servo_state state,
+		      double freq, int64_t offset)
+{
+	struct timespec now;
+
+	switch (state) {
+	case SERVO_UNLOCKED:
+	case SERVO_JUMP:
+		ws->count = 0;
+		return;
+	case SERVO_LOCKED:
+	case SERVO_LOCKED_STABLE:
+		break;
+	}
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	if (!ws->count) {
+		ws->start = now;
+		ws->freq_sum = 0.0;
+	}
+	ws->freq_sum += freq;
+	ws->offset[ws->count % WARMSTART_OFFSETS] = offset;
+	ws->count++;
+
+	if (now.tv_sec - ws->start.tv_sec < ws->interval ||
+	    ws->count < WARMSTART_OFFSETS)
+		return;
+
+	warmstart_write(ws);
+	ws->count = 0;
+}
@@ -0,0 +1,69 @@
+/**
+ * @file warmstart.h
+ * @brief Persists the frequency of a servo across restarts.
+ * @note Copyright (C) 2026 The linuxptp contributors
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+#ifndef HAVE_WARMSTART_H
+#define HAVE_WARMSTART_H
+
+#include <stdint.h>
+
+#include "config.h"
+#include "servo.h"
+
+/** Opaque type */
+struct warmstart;
+
+/**
+ * Create a new warm start state for one clock.
+ * @param cfg  The configuration providing the warm_start_* options.
+ * @param key  Unique name of the clock, used as the name of the file.
+ * @return     A pointer to a new warm start state on success, NULL if the
+ *             warm start is disabled in the configuration or on error.
+ */
+struct warmstart *warmstart_create(struct config *cfg, const char *key);
+
+/**
+ * Destroy a warm start state, writing the last checkpoint if the servo
+ * has been locked since the previous one.
+ * @param ws  Pointer obtained via @ref warmstart_create().
+ */
+void warmstart_destroy(struct warmstart *ws);
+
+/**
+ * Read the frequency saved by a previous instance.
+ * @param ws        Pointer obtained via @ref warmstart_create().
+ * @param max_freq  The maximum frequency adjustment of the clock in ppb.
+ * @param freq      Returns the saved frequency adjustment in ppb.
+ * @return          Zero if a checkpoint was found, which is not older than
+ *                  the warm_start_max_age option and whose frequency is
+ *                  within the limit, non-zero otherwise.
+ */
+int warmstart_load(struct warmstart *ws, double max_freq, double *freq);
+
+/**
+ * Record a servo sample and write a checkpoint when the servo has been
+ * locked for the interval given by the warm_start_interval option.
+ * @param ws      Pointer obtained via @ref warmstart_create().
+ * @param state   The state of the servo.
+ * @param freq    The frequency adjustment in ppb.
+ * @param offset  The measured offset in nanoseconds.
+ */
+void warmstart_sample(struct warmstart *ws, enum servo_state state,
+		      double freq, int64_t offset);
+
+#endif